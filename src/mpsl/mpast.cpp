@@ -125,7 +125,9 @@ AstBuilder::AstBuilder(ZoneAllocator* allocator) noexcept
   : _allocator(allocator),
     _globalScope(nullptr),
     _programNode(nullptr),
-    _mainFunction(nullptr) {}
+    _mainFunction(nullptr) {
+  ::memset(_layouts, 0, sizeof(_layouts));
+}
 AstBuilder::~AstBuilder() noexcept {}
 
 // ============================================================================
@@ -203,9 +205,9 @@ void AstBuilder::deleteNode(AstNode* node) noexcept {
 // [mpsl::AstBuilder - Initialization]
 // ============================================================================
 
-Error AstBuilder::addProgramScope() noexcept {
+Error AstBuilder::addProgramScope(AstScope* builtInScope) noexcept {
   if (_globalScope == nullptr) {
-    _globalScope = newScope(nullptr, AstScope::kTypeGlobal);
+    _globalScope = newScope(builtInScope, AstScope::kTypeGlobal);
     MPSL_NULLCHECK(_globalScope);
   }
 
@@ -322,6 +324,15 @@ Error AstBuilder::addBuiltInIntrinsics() noexcept {
   return kErrorOk;
 }
 
+//! \internal
+//!
+//! Get whether the member `m` of `layout` is accessible without the name of
+//! its layout - all members of anonymous layouts, members having `kTypeDenest`,
+//! and hidden members like `@ret`.
+static MPSL_INLINE bool mpLayoutMemberIsDenested(const Layout* layout, const Layout::Member* m) noexcept {
+  return !layout->hasName() || (m->typeInfo & kTypeDenest) != 0 || m->name[0] == '@';
+}
+
 Error AstBuilder::addBuiltInObject(uint32_t slot, const Layout* layout, AstSymbol** collidedSymbol) noexcept {
   AstScope* scope = globalScope();
   if (scope == nullptr)
@@ -341,8 +352,9 @@ Error AstBuilder::addBuiltInObject(uint32_t slot, const Layout* layout, AstSymbo
     name.set(layout->name(), layout->nameSize());
   }
 
+  // Resolve (instead of get) to also check the built-in scope, if used.
   uint32_t hashCode = HashUtils::hashString(name);
-  AstSymbol* symbol = scope->getSymbol(name, hashCode);
+  AstSymbol* symbol = scope->resolveSymbol(name, hashCode);
 
   if (symbol) {
     *collidedSymbol = symbol;
@@ -359,43 +371,76 @@ Error AstBuilder::addBuiltInObject(uint32_t slot, const Layout* layout, AstSymbo
   symbol->setLayout(layout);
   scope->putSymbol(symbol);
 
-  // Create all members if the root is anonymous or a member has `kTypeDenest`.
+  // Denested members are created by `resolveLayoutMember()` when they are
+  // referenced, but collisions are still checked here. `resolveSymbol()`
+  // also checks members of layouts of previous slots.
   const Layout::Member* members = layout->membersArray();
   uint32_t count = layout->membersCount();
 
-  // Filter to clear these flags as they are only used to define the layout.
-  uint32_t kTypeInfoFilter = ~kTypeDenest;
-
   for (uint32_t i = 0; i < count; i++) {
     const Layout::Member* m = &members[i];
-    uint32_t typeInfo = m->typeInfo;
+    if (!mpLayoutMemberIsDenested(layout, m))
+      continue;
 
-    bool denest = isAnonymous || ((typeInfo & kTypeDenest) != 0) || (m->name[0] == '@');
-    if (denest) {
-      name.set(m->name, m->nameSize);
-      hashCode = HashUtils::hashString(name);
+    symbol = scope->resolveSymbol(StringRef(m->name, m->nameSize), m->hashCode);
+    if (symbol) {
+      *collidedSymbol = symbol;
+      return MPSL_TRACE_ERROR(kErrorSymbolCollision);
+    }
+  }
 
-      symbol = scope->getSymbol(name, hashCode);
-      if (symbol) {
-        *collidedSymbol = symbol;
-        return MPSL_TRACE_ERROR(kErrorSymbolCollision);
-      }
+  _layouts[slot] = layout;
+  return kErrorOk;
+}
 
-      symbol = newSymbol(name, hashCode, AstSymbol::kTypeVariable, AstScope::kTypeGlobal);
-      MPSL_NULLCHECK(symbol);
+AstSymbol* AstBuilder::resolveLayoutMember(const StringRef& name, uint32_t hashCode) noexcept {
+  for (uint32_t slot = 0; slot < Globals::kMaxArgumentsCount; slot++) {
+    const Layout* layout = _layouts[slot];
+    if (layout == nullptr)
+      continue;
 
-      // NOTE: Denested symbols don't have a data layout as they don't act
-      // as objects, but variables. However, denested variables need data
-      // offset, as it's then used to access memory of its data slot.
-      symbol->setDeclared();
-      symbol->setTypeInfo(m->typeInfo & kTypeInfoFilter);
-      symbol->setDataSlot(slot);
-      symbol->setDataOffset(m->offset);
-      scope->putSymbol(symbol);
+    const Layout::Member* m = mpLayoutFind(layout, name.data(), name.size(), hashCode);
+    if (m == nullptr || !mpLayoutMemberIsDenested(layout, m))
+      continue;
+
+    AstSymbol* symbol = newSymbol(name, hashCode, AstSymbol::kTypeVariable, AstScope::kTypeGlobal);
+    if (MPSL_UNLIKELY(symbol == nullptr))
+      return nullptr;
+
+    // NOTE: Denested symbols don't have a data layout as they don't act
+    // as objects, but variables. However, denested variables need data
+    // offset, as it's then used to access memory of its data slot. Constant
+    // members are not in memory, they are built-in constants instead, and
+    // uniforms are in the uniform block.
+    symbol->setDeclared();
+    symbol->setTypeInfo(m->typeInfo & ~(kTypeDenest | kTypeUniform));
+
+    if (m->isConst()) {
+      symbol->setValue(*m->value);
+    }
+    else {
+      symbol->setDataSlot(m->isUniform() ? static_cast<uint32_t>(kUniformDataSlot) : slot);
+      symbol->setDataOffset(layoutMemberOffset(slot, m));
     }
+
+    _globalScope->putSymbol(symbol);
+    return symbol;
   }
 
-  return kErrorOk;
+  return nullptr;
+}
+
+int32_t AstBuilder::layoutMemberOffset(uint32_t slot, const Layout::Member* m) const noexcept {
+  if (!m->isUniform())
+    return m->offset;
+
+  // Uniforms of all layouts share a single block, see `ProgramUniforms`.
+  uint32_t base = 0;
+  for (uint32_t i = 0; i < slot; i++)
+    if (_layouts[i])
+      base += mpLayoutUniformsSize(_layouts[i]);
+
+  return static_cast<int32_t>(base) + m->offset;
 }
 
 // ============================================================================
@@ -439,12 +484,128 @@ AstSymbol* AstScope::resolveSymbol(const StringRef& name, uint32_t hashCode, Ast
 
   do {
     symbol = scope->_symbols.get(name, hashCode);
-  } while (symbol == nullptr && (scope = scope->parent()) != nullptr);
+    if (symbol)
+      break;
+
+    // Members of layouts are added to the global scope on the first use.
+    AstBuilder* ast = scope->_ast;
+    if (scope == ast->_globalScope && (symbol = ast->resolveLayoutMember(name, hashCode)) != nullptr)
+      break;
+  } while ((scope = scope->parent()) != nullptr);
 
   if (scopeOut) *scopeOut = scope;
   return symbol;
 }
 
+// ============================================================================
+// [mpsl::AstBuiltIns - Construction / Destruction]
+// ============================================================================
+
+AstBuiltIns::AstBuiltIns() noexcept
+  : _refCount(1),
+    _zone(8192 - Zone::kBlockOverhead),
+    _allocator(&_zone),
+    _ast(&_allocator) {}
+AstBuiltIns::~AstBuiltIns() noexcept {}
+
+AstBuiltIns* AstBuiltIns::create() noexcept {
+  void* p = ::malloc(sizeof(AstBuiltIns));
+  if (MPSL_UNLIKELY(p == nullptr))
+    return nullptr;
+
+  AstBuiltIns* self = new(p) AstBuiltIns();
+  AstBuilder& ast = self->_ast;
+
+  // Only the scope is needed, built-ins don't have a program node.
+  ast._globalScope = ast.newScope(nullptr, AstScope::kTypeGlobal);
+
+  if (ast._globalScope == nullptr ||
+      ast.addBuiltInTypes(mpTypeInfo, kTypeCount) != kErrorOk ||
+      ast.addBuiltInConstants(mpConstInfo, MPSL_ARRAY_SIZE(mpConstInfo)) != kErrorOk ||
+      ast.addBuiltInIntrinsics() != kErrorOk) {
+    self->destroy();
+    return nullptr;
+  }
+
+  return self;
+}
+
+AstBuiltIns* AstBuiltIns::clone(const AstBuiltIns* other) noexcept {
+  AstBuiltIns* self = create();
+  if (MPSL_UNLIKELY(self == nullptr))
+    return nullptr;
+
+  // Replay constants added to `other`, see `addConstant()` for the format.
+  const char* p = other->_signature.data();
+  const char* end = p + other->_signature.size();
+
+  while (p != end) {
+    uint32_t nameSize;
+    double value;
+
+    ::memcpy(&nameSize, p, sizeof(uint32_t));
+    ::memcpy(&value, p + sizeof(uint32_t) + nameSize, sizeof(double));
+
+    if (self->addConstant(StringRef(p + sizeof(uint32_t), nameSize), value) != kErrorOk) {
+      self->destroy();
+      return nullptr;
+    }
+
+    p += sizeof(uint32_t) + nameSize + sizeof(double);
+  }
+
+  return self;
+}
+
+// ============================================================================
+// [mpsl::AstBuiltIns - Ops]
+// ============================================================================
+
+Error AstBuiltIns::addConstant(const StringRef& name, double value) noexcept {
+  const char* s = name.data();
+  size_t size = name.size();
+
+  if (size == 0 || size > Globals::kMaxIdentifierLength)
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  // Must be a valid identifier, otherwise it couldn't be referenced.
+  for (size_t i = 0; i < size; i++) {
+    unsigned int c = static_cast<unsigned char>(s[i]);
+    bool isAlpha = (c | 0x20) - 'a' < 26u || c == '_';
+
+    if (!isAlpha && (i == 0 || c - '0' >= 10u))
+      return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+  }
+
+  AstScope* scope = this->scope();
+  uint32_t hashCode = HashUtils::hashString(name);
+
+  if (scope->getSymbol(name, hashCode) != nullptr)
+    return MPSL_TRACE_ERROR(kErrorAlreadyExists);
+
+  uint32_t nameSize = static_cast<uint32_t>(size);
+  size_t sigIndex = _signature.size();
+
+  AstSymbol* symbol = _ast.newSymbol(name, hashCode, AstSymbol::kTypeVariable, AstScope::kTypeGlobal);
+  MPSL_NULLCHECK(symbol);
+
+  if (_signature.appendString(reinterpret_cast<const char*>(&nameSize), sizeof(uint32_t)) != asmjit::kErrorOk ||
+      _signature.appendString(s, size) != asmjit::kErrorOk ||
+      _signature.appendString(reinterpret_cast<const char*>(&value), sizeof(double)) != asmjit::kErrorOk) {
+    _ast.deleteSymbol(symbol);
+    _signature.truncate(sigIndex);
+    return MPSL_TRACE_ERROR(kErrorNoMemory);
+  }
+
+  symbol->setTypeInfo(kTypeDouble | kTypeRead);
+  symbol->setDeclared();
+  symbol->setAssigned();
+  symbol->_value.d[0] = value;
+
+  scope->putSymbol(symbol);
+  return kErrorOk;
+}
+
 // ============================================================================
 // [mpsl::AstNode - Ops]
 // ============================================================================
@@ -867,6 +1028,9 @@ AstAnalysis::AstAnalysis(AstBuilder* ast, ErrorReporter* errorReporter) noexcept
   : AstVisitor<AstAnalysis>(ast),
     _errorReporter(errorReporter),
     _currentRet(nullptr),
+    _maskBranch(nullptr),
+    _maskDepth(0),
+    _loopMaskDepth(0),
     _unreachable(false) {}
 AstAnalysis::~AstAnalysis() noexcept {}
 
@@ -927,11 +1091,32 @@ Error AstAnalysis::onBlock(AstBlock* node) noexcept {
 }
 
 Error AstAnalysis::onBranch(AstBranch* node) noexcept {
+  uint32_t isMasked = 0;
+
   if (node->condition()) {
     MPSL_PROPAGATE(onNode(node->condition()));
-    MPSL_PROPAGATE(boolCast(node, node->condition()));
+
+    // A vector condition is not a jump, both bodies are executed, but each of
+    // them only assigns lanes selected by the condition (or its complement).
+    isMasked = (node->condition()->typeInfo() & kTypeVecMask) >= kTypeVec2;
+    if (isMasked)
+      MPSL_PROPAGATE(maskCast(node, node->condition()));
+    else
+      MPSL_PROPAGATE(boolCast(node, node->condition()));
+
+    // Masks of nested vector conditions are combined lane by lane.
+    if (isMasked && _maskBranch &&
+        !TypeInfo::isSameLaneShape(_maskBranch->condition()->typeInfo(), node->condition()->typeInfo()))
+      return _errorReporter->onError(kErrorInvalidProgram, node->position(),
+        "Can't nest vector conditions of different shapes.");
   }
 
+  AstBranch* prevMaskBranch = _maskBranch;
+  if (isMasked)
+    _maskBranch = node;
+
+  _maskDepth += isMasked;
+
   bool prevUnreachable = _unreachable;
   bool thenUnreachable = prevUnreachable;
   bool elseUnreachable = prevUnreachable;
@@ -948,11 +1133,16 @@ Error AstAnalysis::onBranch(AstBranch* node) noexcept {
     elseUnreachable = _unreachable;
   }
 
+  _maskDepth -= isMasked;
+  _maskBranch = prevMaskBranch;
   _unreachable = prevUnreachable || (thenUnreachable & elseUnreachable);
   return kErrorOk;
 }
 
 Error AstAnalysis::onLoop(AstLoop* node) noexcept {
+  uint32_t prevLoopMaskDepth = _loopMaskDepth;
+  _loopMaskDepth = _maskDepth;
+
   if (node->forInit()) {
     MPSL_PROPAGATE(onNode(node->forInit()));
   }
@@ -975,6 +1165,7 @@ Error AstAnalysis::onLoop(AstLoop* node) noexcept {
   if (node->nodeType() != AstNode::kTypeFor && !node->condition())
     return MPSL_TRACE_ERROR(kErrorInvalidState);
 
+  _loopMaskDepth = prevLoopMaskDepth;
   return kErrorOk;
 }
 
@@ -982,6 +1173,10 @@ Error AstAnalysis::onBreak(AstBreak* node) noexcept {
   if (!node->loop())
     return MPSL_TRACE_ERROR(kErrorInvalidState);
 
+  if (_maskDepth != _loopMaskDepth)
+    return _errorReporter->onError(kErrorInvalidProgram, node->position(),
+      "Can't use '%s' in a branch of a vector condition.", "break");
+
   _unreachable = true;
   return kErrorOk;
 }
@@ -990,6 +1185,10 @@ Error AstAnalysis::onContinue(AstContinue* node) noexcept {
   if (!node->loop())
     return MPSL_TRACE_ERROR(kErrorInvalidState);
 
+  if (_maskDepth != _loopMaskDepth)
+    return _errorReporter->onError(kErrorInvalidProgram, node->position(),
+      "Can't use '%s' in a branch of a vector condition.", "continue");
+
   _unreachable = true;
   return kErrorOk;
 }
@@ -998,6 +1197,11 @@ Error AstAnalysis::onReturn(AstReturn* node) noexcept {
   uint32_t retType = kTypeVoid;
   uint32_t srcType = kTypeVoid;
 
+  // Lanes of a vector are not separate invocations, they can't return.
+  if (_maskDepth != 0)
+    return _errorReporter->onError(kErrorInvalidProgram, node->position(),
+      "Can't use '%s' in a branch of a vector condition.", "return");
+
   if (_currentRet) {
     retType = _currentRet->typeInfo();
     node->setTypeInfo(retType);
@@ -1058,8 +1262,8 @@ Error AstAnalysis::onVarMemb(AstVarMemb* node) noexcept {
       return _errorReporter->onError(kErrorInvalidProgram, node->position(),
         "Object '%s' doesn't have a member '%s'", sym->name(), node->field().data());
 
-    node->setTypeInfo(m->typeInfo | kTypeRef | (typeInfo & kTypeRW));
-    node->setOffset(m->offset);
+    node->setTypeInfo((m->typeInfo & ~kTypeUniform) | kTypeRef | (typeInfo & kTypeRW));
+    node->setOffset(_ast->layoutMemberOffset(sym->dataSlot(), m));
   }
   else {
     // Swizzle operation.
@@ -1314,8 +1518,8 @@ Error AstAnalysis::onBinaryOp(AstBinaryOp* node) noexcept {
     }
 
     if (op.isConditional()) {
-      // Result of a conditional is a boolean.
-      dstTypeInfo = TypeInfo::boolIdByTypeId(lTypeId & kTypeIdMask) | kTypeRead;
+      // Result of a conditional is a boolean (or a vector of booleans).
+      dstTypeInfo = TypeInfo::boolIdByTypeId(lTypeId & kTypeIdMask) | (dstTypeInfo & kTypeVecMask) | kTypeRead;
     }
     else {
       // Results in a new temporary, clear the reference/write flags.
@@ -1405,6 +1609,27 @@ Error AstAnalysis::checkAssignment(AstNode* node, uint32_t op) noexcept {
     return _errorReporter->onError(kErrorInvalidProgram, node->position(),
       "Can't assign '%s' to a non-writable variable.", mpOpInfo[op].name());
 
+  // A branch of a vector condition only assigns lanes selected by the mask.
+  // Variables declared outside of the branch and members are blended, which
+  // requires them to have lanes of the same shape as the condition.
+  if (_maskBranch && !TypeInfo::isSameLaneShape(_maskBranch->condition()->typeInfo(), typeInfo)) {
+    AstNode* root = node;
+    while (root->nodeType() == AstNode::kTypeVarMemb && static_cast<AstVarMemb*>(root)->child())
+      root = static_cast<AstVarMemb*>(root)->child();
+
+    bool isLocal = false;
+    if (root->nodeType() == AstNode::kTypeVar) {
+      AstNode* decl = static_cast<AstVar*>(root)->symbol()->node();
+      while (decl && decl != _maskBranch)
+        decl = decl->parent();
+      isLocal = decl != nullptr;
+    }
+
+    if (!isLocal)
+      return _errorReporter->onError(kErrorInvalidProgram, node->position(),
+        "Can't assign a variable of a different shape than the vector condition in its branch.");
+  }
+
   // Assignment has always a side-effect - used by optimizer to not remove code
   // that has to be executed.
   node->addNodeFlags(AstNode::kFlagSideEffect);
@@ -1464,6 +1689,20 @@ uint32_t AstAnalysis::boolCast(AstNode* node, AstNode* child) noexcept {
   }
 }
 
+uint32_t AstAnalysis::maskCast(AstNode* node, AstNode* child) noexcept {
+  uint32_t vecMask = child->typeInfo() & kTypeVecMask;
+  uint32_t size = mpTypeInfo[child->typeInfo() & kTypeIdMask].size();
+
+  switch (size) {
+    case 4: return implicitCast(node, child, kTypeBool | vecMask);
+    case 8: return implicitCast(node, child, kTypeQBool | vecMask);
+
+    default:
+      return _errorReporter->onError(kErrorInvalidProgram, node->_position,
+        "%s from '%{Type}' to 'bool'.", "Invalid boolean cast", child->typeInfo());
+  }
+}
+
 Error AstAnalysis::invalidCast(uint32_t position, const char* msg, uint32_t fromTypeInfo, uint32_t toTypeInfo) noexcept {
   return _errorReporter->onError(kErrorInvalidProgram, position,
     "%s from '%{Type}' to '%{Type}'.", msg, fromTypeInfo, toTypeInfo);
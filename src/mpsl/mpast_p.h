@@ -104,12 +104,24 @@ public:
   // [Initialization]
   // --------------------------------------------------------------------------
 
-  Error addProgramScope() noexcept;
+  Error addProgramScope(AstScope* builtInScope = nullptr) noexcept;
   Error addBuiltInTypes(const TypeInfo* data, size_t count) noexcept;
   Error addBuiltInConstants(const ConstInfo* data, size_t count) noexcept;
   Error addBuiltInIntrinsics() noexcept;
   Error addBuiltInObject(uint32_t slot, const Layout* layout, AstSymbol** collidedSymbol) noexcept;
 
+  //! Create a symbol of a denested member `name` of a layout added by
+  //! `addBuiltInObject()`, returns null if there is no such member.
+  //!
+  //! Members are only added to the global scope when they are referenced,
+  //! called by `AstScope::resolveSymbol()` when `name` is not in the global
+  //! scope.
+  AstSymbol* resolveLayoutMember(const StringRef& name, uint32_t hashCode) noexcept;
+
+  //! Get the data offset of a member `m` of the layout of `slot`, which is an
+  //! offset in the uniform block (`kUniformDataSlot`) if `m` is a uniform.
+  int32_t layoutMemberOffset(uint32_t slot, const Layout::Member* m) const noexcept;
+
   // --------------------------------------------------------------------------
   // [Dump]
   // --------------------------------------------------------------------------
@@ -125,6 +137,9 @@ public:
   AstScope* _globalScope;                //!< Global scope.
   AstProgram* _programNode;              //!< Root node.
   AstFunction* _mainFunction;            //!< Program `main()` node.
+
+  //! Layouts of all data slots, their denested members are resolved lazily.
+  const Layout* _layouts[Globals::kMaxArgumentsCount];
 };
 
 // ============================================================================
@@ -269,6 +284,12 @@ public:
   //! Set `_isAssigned` to true and `_value` to `value`.
   inline void setValue(const Value& value) noexcept { _value = value; setAssigned(); }
 
+  //! Get whether the symbol is a constant provided by the embedder - a built-in
+  //! constant or a constant member of a `Layout`. Its value never changes.
+  inline bool isBuiltInConst() const noexcept {
+    return _node == nullptr && _dataSlot == kInvalidDataSlot && isAssigned();
+  }
+
   inline const Layout* layout() const noexcept { return _layout; }
   inline void setLayout(const Layout* layout) noexcept { _layout = layout; }
 
@@ -366,6 +387,67 @@ public:
   uint32_t _scopeType;                   //!< Scope type, see \ref Type.
 };
 
+// ============================================================================
+// [mpsl::AstBuiltIns]
+// ============================================================================
+
+//! \internal
+//!
+//! Built-in scope of a `Context`.
+//!
+//! Contains built-in types, constants, and intrinsics, and all constants
+//! added by `Context::addConstant()`. It's created once per context and used
+//! as a parent of the global scope of each compiled program, which makes it
+//! read-only during compilation. A built-in scope shared by multiple contexts
+//! (after `Context::clone()`) is copied before it's modified.
+class AstBuiltIns {
+public:
+  MPSL_NONCOPYABLE(AstBuiltIns)
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  AstBuiltIns() noexcept;
+  ~AstBuiltIns() noexcept;
+
+  //! Create a new built-in scope, with a reference count set to one.
+  static AstBuiltIns* create() noexcept;
+  //! Create a copy of `other`, including constants added to it.
+  static AstBuiltIns* clone(const AstBuiltIns* other) noexcept;
+
+  MPSL_INLINE void destroy() noexcept {
+    this->~AstBuiltIns();
+    ::free(this);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get the built-in scope.
+  MPSL_INLINE AstScope* scope() const noexcept { return _ast.globalScope(); }
+  //! Get the serialized constants added by `addConstant()`.
+  MPSL_INLINE const String& signature() const noexcept { return _signature; }
+
+  // --------------------------------------------------------------------------
+  // [Ops]
+  // --------------------------------------------------------------------------
+
+  //! Add a constant `name` of `value` (of `double` type).
+  Error addConstant(const StringRef& name, double value) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uintptr_t _refCount;                   //!< Reference count.
+  Zone _zone;                            //!< Zone that holds all symbols.
+  ZoneAllocator _allocator;              //!< Zone allocator.
+  AstBuilder _ast;                       //!< AST builder that owns the scope.
+  String _signature;                     //!< Constants added by `addConstant()` (name, value).
+};
+
 // ============================================================================
 // [mpsl::AstNode]
 // ============================================================================
@@ -1364,6 +1446,10 @@ public:
   //! Perform an internal cast to `bool` or `__qbool`.
   uint32_t boolCast(AstNode* node, AstNode* child) noexcept;
 
+  //! Perform an internal cast to a vector of `bool` or `__qbool` of the same
+  //! width as `child`, used by conditions that select vector lanes.
+  uint32_t maskCast(AstNode* node, AstNode* child) noexcept;
+
   // TODO: Move to `AstBuilder::onInvalidCast()`.
   //! Report an invalid implicit or explicit cast.
   Error invalidCast(uint32_t position, const char* msg, uint32_t fromTypeInfo, uint32_t toTypeInfo) noexcept;
@@ -1375,6 +1461,9 @@ public:
   ErrorReporter* _errorReporter;
   AstSymbol* _currentRet;
 
+  AstBranch* _maskBranch;                //!< Innermost branch that has a vector condition.
+  uint32_t _maskDepth;                   //!< Count of enclosing branches that have a vector condition.
+  uint32_t _loopMaskDepth;               //!< `_maskDepth` of the innermost loop.
   bool _unreachable;
 };
 
@@ -145,7 +145,8 @@ Error AstOptimizer::onBranch(AstBranch* node) noexcept {
     MPSL_PROPAGATE(onNode(node->condition()));
     AstNode* condition = node->condition();
 
-    if (condition->isImm()) {
+    // A vector condition can select different bodies for each lane.
+    if (condition->isImm() && (condition->typeInfo() & kTypeVecMask) <= kTypeVec1) {
       uint32_t typeId = condition->typeInfo() & kTypeIdMask;
 
       AstImm* imm = condition->as<AstImm>();
@@ -169,20 +170,27 @@ Error AstOptimizer::onBranch(AstBranch* node) noexcept {
       if (neverTaken)
         _ast->deleteNode(neverTaken);
 
+      // A branch that is never taken and has no else body is replaced by an
+      // empty block, the parent can't have a null child.
+      if (alwaysTaken == nullptr)
+        MPSL_NULLCHECK(alwaysTaken = _ast->newNode<AstBlock>());
+
       _ast->deleteNode(
         node->parent()->replaceNode(
           node, alwaysTaken));
 
-      if (alwaysTaken) {
-        bool prevUnreachable = _unreachable;
-        MPSL_PROPAGATE(onNode(alwaysTaken));
-        _unreachable = prevUnreachable;
-      }
+      bool prevUnreachable = _unreachable;
+      MPSL_PROPAGATE(onNode(alwaysTaken));
+      _unreachable = prevUnreachable;
 
       return kErrorOk;
     }
   }
 
+  // Variables assigned by either body are not constant after the branch.
+  bool prevConditional = _isConditional;
+  _isConditional = true;
+
   if (node->thenBody()) {
     bool prevUnreachable = _unreachable;
     MPSL_PROPAGATE(onNode(node->thenBody()));
@@ -195,6 +203,7 @@ Error AstOptimizer::onBranch(AstBranch* node) noexcept {
     _unreachable = prevUnreachable;
   }
 
+  _isConditional = prevConditional;
   return kErrorOk;
 }
 
@@ -202,6 +211,11 @@ Error AstOptimizer::onLoop(AstLoop* node) noexcept {
   if (node->forInit())
     MPSL_PROPAGATE(onNode(node->forInit()));
 
+  // Everything except the initializer is executed repeatedly, a variable
+  // assigned by any part of the loop can't be folded anywhere in the loop.
+  bool prevConditional = _isConditional;
+  _isConditional = true;
+
   if (node->forIter())
     MPSL_PROPAGATE(onNode(node->forIter()));
 
@@ -214,6 +228,7 @@ Error AstOptimizer::onLoop(AstLoop* node) noexcept {
     _unreachable = prevUnreachable;
   }
 
+  _isConditional = prevConditional;
   return kErrorOk;
 }
 
@@ -275,8 +290,17 @@ Error AstOptimizer::onVarMemb(AstVarMemb* node) noexcept {
       return _errorReporter->onError(kErrorInvalidProgram, node->position(),
         "Object '%s' doesn't have member '%s'", symbol->name(), node->field().data());
 
-    node->setTypeInfo(m->typeInfo | kTypeRef | (typeInfo & kTypeRW));
-    node->setOffset(m->offset);
+    // Replace a constant member by its value.
+    if (m->isConst() && !isUnreachable()) {
+      AstImm* imm = _ast->newNode<AstImm>(*m->value, (m->typeInfo & ~(kTypeDenest | kTypeWrite)) | kTypeRead);
+      MPSL_NULLCHECK(imm);
+
+      _ast->deleteNode(node->parent()->replaceNode(node, imm));
+      return kErrorOk;
+    }
+
+    node->setTypeInfo((m->typeInfo & ~kTypeUniform) | kTypeRef | (typeInfo & kTypeRW));
+    node->setOffset(_ast->layoutMemberOffset(symbol->dataSlot(), m));
   }
   else {
     // The field should access/shuffle a vector.
@@ -294,9 +318,10 @@ Error AstOptimizer::onVar(AstVar* node) noexcept {
   AstSymbol* sym = node->symbol();
   uint32_t typeInfo = node->typeInfo();
 
+  // Built-in constants can be replaced even in conditional code, because
+  // they are never assigned.
   if (!isUnreachable() &&
-      !isConditional() &&
-      sym->isAssigned() &&
+      (sym->isBuiltInConst() || (!isConditional() && sym->isAssigned())) &&
       !node->hasNodeFlag(AstNode::kFlagSideEffect)) {
     typeInfo |= kTypeRead;
     typeInfo &= ~(kTypeWrite | kTypeRef);
@@ -379,6 +404,10 @@ Error AstOptimizer::onUnaryOp(AstUnaryOp* node) noexcept {
         _ast->deleteNode(oldNode);
       }
     }
+    // The value is unknown after a conditional assignment.
+    else if (op.isAssignment() && child->isVar()) {
+      static_cast<AstVar*>(child)->symbol()->clearAssigned();
+    }
     // Simplify `-(-(x))` -> `x` and `~(~(x))` -> `x`.
     else if (child->nodeType() == AstNode::kTypeUnaryOp && node->opType() == child->opType()) {
       if (node->opType() == kOpNeg || node->opType() == kOpBitNeg) {
@@ -431,6 +460,11 @@ Error AstOptimizer::onBinaryOp(AstBinaryOp* node) noexcept {
   MPSL_PROPAGATE(onNode(right));
   right = node->right();
 
+  // Only an assignment of a constant, which is not conditional, keeps the
+  // variable constant.
+  if (op.isAssignment() && left->isVar() && (isConditional() || !right->isImm()))
+    static_cast<AstVar*>(left)->symbol()->clearAssigned();
+
   if (!isUnreachable()) {
     uint32_t typeInfo = node->typeInfo();
 
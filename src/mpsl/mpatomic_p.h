@@ -27,12 +27,56 @@ namespace mpsl {
 
 //! \internal
 static MPSL_INLINE uintptr_t mpAtomicGet(const uintptr_t* atomic) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return __atomic_load_n(atomic, __ATOMIC_RELAXED);
+#else
   return *(const uintptr_t volatile *)atomic;
+#endif
 }
 
 //! \internal
 static MPSL_INLINE void mpAtomicSet(uintptr_t* atomic, size_t value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  __atomic_store_n(atomic, value, __ATOMIC_RELAXED);
+#else
   *(uintptr_t volatile *)atomic = value;
+#endif
+}
+
+//! \internal
+//!
+//! Load with acquire semantics - loads that follow can't be moved before it.
+static MPSL_INLINE uintptr_t mpAtomicGetAcquire(const uintptr_t* atomic) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return __atomic_load_n(atomic, __ATOMIC_ACQUIRE);
+#else
+  // MSVC gives volatile accesses acquire/release semantics.
+  return *(const uintptr_t volatile *)atomic;
+#endif
+}
+
+//! \internal
+//!
+//! Store with release semantics - accesses that precede can't be moved after
+//! it.
+static MPSL_INLINE void mpAtomicSetRelease(uintptr_t* atomic, uintptr_t value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  __atomic_store_n(atomic, value, __ATOMIC_RELEASE);
+#else
+  *(uintptr_t volatile *)atomic = value;
+#endif
+}
+
+//! \internal
+//!
+//! Full memory barrier, a store that precedes it is visible to all threads
+//! before a load that follows it is performed.
+static MPSL_INLINE void mpAtomicFence() noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#else
+  _mm_mfence();
+#endif
 }
 
 #if defined(_MSC_VER)
@@ -91,6 +135,40 @@ MPSL_INLINE T mpAtomicSetXchgT(T* atomic, T value) noexcept {
   return (T)mpAtomicSetXchg((uintptr_t *)atomic, (uintptr_t)value);
 }
 
+template<typename T>
+MPSL_INLINE T mpAtomicGetAcquireT(const T* atomic) noexcept {
+  return (T)mpAtomicGetAcquire((const uintptr_t *)atomic);
+}
+
+template<typename T>
+MPSL_INLINE void mpAtomicSetReleaseT(T* atomic, T value) noexcept {
+  mpAtomicSetRelease((uintptr_t *)atomic, (uintptr_t)value);
+}
+
+// ============================================================================
+// [mpsl::mpObject]
+// ============================================================================
+
+//! \internal
+//!
+//! Add a reference to a reference-counted `Impl`, statically allocated (null)
+//! instances have a zero reference count and are never destroyed.
+template<typename T>
+MPSL_INLINE T* mpObjectAddRef(T* self) noexcept {
+  if (mpAtomicGet(&self->_refCount) == 0)
+    return self;
+
+  mpAtomicInc(&self->_refCount);
+  return self;
+}
+
+//! \internal
+template<typename T>
+MPSL_INLINE void mpObjectRelease(T* self) noexcept {
+  if (mpAtomicGet(&self->_refCount) != 0 && !mpAtomicDec(&self->_refCount))
+    self->destroy();
+}
+
 } // mpsl namespace
 
 // [Api-End]
@@ -0,0 +1,690 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define MPSL_EXPORTS
+
+// [Dependencies - MPSL]
+#include "./mpatomic_p.h"
+#include "./mpcache_p.h"
+#include "./mphash_p.h"
+#include "./mpirtox86_p.h"
+
+// [Dependencies - OS]
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+# include <io.h>
+# include <process.h>
+#else
+# include <unistd.h>
+#endif
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+//! \internal
+//!
+//! Options that only affect the output log, not the generated code, and
+//! options that are canonicalized by `mpProgramCacheOptions()`.
+static const uint32_t kProgramCacheIgnoredOptions =
+  kOptionVerbose | kOptionDebugAst | kOptionDebugIR | kOptionDebugASM | kInternalOptionLog |
+  kOptionDisableSSE3 | kOptionDisableSSSE3 | kOptionDisableSSE4_1 | kOptionDisableSSE4_2 |
+  kOptionDisableAVX | kOptionDisableAVX2 | kOptionOptLevelMask;
+
+//! \internal
+//!
+//! 64-bit FNV-1a hash of `data`, used to hash keys and blobs. The hash of
+//! consecutive chunks is calculated by passing the previous hash as `hashCode`.
+static uint64_t mpProgramCacheHash(const void* data, size_t size, uint64_t hashCode = 0xCBF29CE484222325u) noexcept {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+
+  for (size_t i = 0; i < size; i++)
+    hashCode = (hashCode ^ p[i]) * 0x00000100000001B3u;
+  return hashCode;
+}
+
+static MPSL_INLINE uint64_t mpProgramCacheHash(const String& key) noexcept {
+  return mpProgramCacheHash(key.data(), key.size());
+}
+
+static MPSL_INLINE Error mpProgramCacheAppend(String& key, const void* data, size_t size) noexcept {
+  if (key.appendString(static_cast<const char*>(data), size) != asmjit::kErrorOk)
+    return MPSL_TRACE_ERROR(kErrorNoMemory);
+  return kErrorOk;
+}
+
+static MPSL_INLINE Error mpProgramCacheAppendU32(String& key, uint32_t value) noexcept {
+  return mpProgramCacheAppend(key, &value, sizeof(value));
+}
+
+//! \internal
+//!
+//! Get `options` in a canonical form, so options that generate the same code
+//! produce the same key. An implicit and explicit optimization level are the
+//! same and disabled features are replaced by the features the code uses.
+static MPSL_INLINE uint32_t mpProgramCacheOptions(uint32_t options) noexcept {
+  return (options & ~kProgramCacheIgnoredOptions) |
+         ((mpGetOptLevel(options) + 1) << 14) |
+         (IRToX86::usedFeatures(options) << 16);
+}
+
+// ============================================================================
+// [mpsl::ProgramBlob]
+// ============================================================================
+
+//! \internal
+//!
+//! Counter that makes names of temporary files unique within the process.
+static uintptr_t mpProgramBlobTmpCounter;
+
+//! \internal
+//!
+//! Checksum of a blob - the hash of its header (with a zero checksum) and
+//! everything that follows it, so no field of the header can be modified.
+static uint64_t mpProgramBlobChecksum(const ProgramBlobHeader& header, const uint8_t* data, size_t size) noexcept {
+  ProgramBlobHeader copy = header;
+  copy.checksum = 0;
+  return mpProgramCacheHash(data, size, mpProgramCacheHash(&copy, sizeof(copy)));
+}
+
+//! \internal
+//!
+//! Create a new file at `path` for writing, fails if the file already exists.
+static FILE* mpProgramBlobCreate(const char* path) noexcept {
+#if defined(_WIN32)
+  int fd = ::_open(path, _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+  if (fd < 0)
+    return nullptr;
+
+  FILE* file = ::_fdopen(fd, "wb");
+  if (file == nullptr)
+    ::_close(fd);
+#else
+  int fd = ::open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (fd < 0)
+    return nullptr;
+
+  FILE* file = ::fdopen(fd, "wb");
+  if (file == nullptr)
+    ::close(fd);
+#endif
+  return file;
+}
+
+//! \internal
+//!
+//! Write `blob` to `path` through a temporary file, which is renamed when
+//! complete, so other processes never read a partially written blob.
+static Error mpProgramBlobWrite(const char* path, const uint8_t* blob, size_t size) noexcept {
+  // The process id and the counter make the temporary name unique, the file
+  // is created exclusively, so a collision fails instead of sharing it.
+#if defined(_WIN32)
+  unsigned int pid = static_cast<unsigned int>(::_getpid());
+#else
+  unsigned int pid = static_cast<unsigned int>(::getpid());
+#endif
+
+  StringTmp<512> tmpPath;
+  if (tmpPath.assignFormat("%s.%u.%llX.tmp", path, pid, static_cast<unsigned long long>(mpAtomicInc(&mpProgramBlobTmpCounter))) != asmjit::kErrorOk)
+    return MPSL_TRACE_ERROR(kErrorNoMemory);
+
+  FILE* file = mpProgramBlobCreate(tmpPath.data());
+  if (file == nullptr)
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  bool ok = ::fwrite(blob, 1, size, file) == size;
+  ok &= ::fclose(file) == 0;
+
+  if (ok) {
+    // Fails on Windows if the blob exists, which only happens if another
+    // process has saved the same program in the meantime.
+    ok = ::rename(tmpPath.data(), path) == 0;
+  }
+
+  if (!ok) {
+    ::remove(tmpPath.data());
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+  }
+
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! Get whether the opened blob `file` can be trusted. On POSIX systems it has
+//! to be a regular file owned by the effective user and not writable by anyone
+//! else. Windows relies only on permissions of the cache directory.
+static bool mpProgramBlobIsTrusted(FILE* file) noexcept {
+#if defined(_WIN32)
+  (void)file;
+  return true;
+#else
+  struct stat st;
+  if (::fstat(::fileno(file), &st) != 0)
+    return false;
+
+  return S_ISREG(st.st_mode) && st.st_uid == ::geteuid() && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+#endif
+}
+
+//! \internal
+//!
+//! Read the whole file at `path`, the returned buffer has to be freed.
+static uint8_t* mpProgramBlobRead(const char* path, size_t& size) noexcept {
+  FILE* file = ::fopen(path, "rb");
+  if (file == nullptr)
+    return nullptr;
+
+  uint8_t* blob = nullptr;
+  long fileSize = -1;
+
+  if (mpProgramBlobIsTrusted(file) && ::fseek(file, 0, SEEK_END) == 0)
+    fileSize = ::ftell(file);
+
+  if (fileSize > 0 && ::fseek(file, 0, SEEK_SET) == 0) {
+    size = static_cast<size_t>(fileSize);
+    blob = static_cast<uint8_t*>(::malloc(size));
+
+    if (blob && ::fread(blob, 1, size, file) != size) {
+      ::free(blob);
+      blob = nullptr;
+    }
+  }
+
+  ::fclose(file);
+  return blob;
+}
+
+//! \internal
+//!
+//! Validate a blob at `path` and copy its code into memory allocated by
+//! `rt`. Returns the address of the code or null on failure.
+static void* mpProgramBlobLoad(RuntimeData* rt, const char* path, const String& key, size_t& batchOffset, size_t& codeSize) noexcept {
+  size_t blobSize = 0;
+  uint8_t* blob = mpProgramBlobRead(path, blobSize);
+
+  if (blob == nullptr)
+    return nullptr;
+
+  ProgramBlobHeader header;
+  void* rx = nullptr;
+  void* rw = nullptr;
+
+  if (blobSize < sizeof(ProgramBlobHeader))
+    goto _Invalid;
+
+  ::memcpy(&header, blob, sizeof(header));
+  if (header.magic       != ProgramBlobHeader::kMagic   ||
+      header.version     != ProgramBlobHeader::kVersion ||
+      header.pointerSize != sizeof(void*)               ||
+      header.reserved    != 0                           ||
+      header.keySize     != key.size()                  ||
+      header.batchOffset >= header.codeSize             )
+    goto _Invalid;
+
+  // All sizes are 32-bit, so the sum can't overflow 64-bit integer.
+  if (static_cast<uint64_t>(blobSize) != static_cast<uint64_t>(sizeof(ProgramBlobHeader)) +
+                                         static_cast<uint64_t>(header.keySize) +
+                                         static_cast<uint64_t>(header.codeSize) +
+                                         static_cast<uint64_t>(header.relocCount) * sizeof(ProgramBlobReloc))
+    goto _Invalid;
+
+  if (mpProgramBlobChecksum(header, blob + sizeof(ProgramBlobHeader), blobSize - sizeof(ProgramBlobHeader)) != header.checksum)
+    goto _Invalid;
+
+  {
+    const uint8_t* keyData = blob + sizeof(ProgramBlobHeader);
+    const uint8_t* codeData = keyData + header.keySize;
+    const uint8_t* relocData = codeData + header.codeSize;
+
+    // Same hash, but a different program.
+    if (::memcmp(keyData, key.data(), header.keySize) != 0)
+      goto _Invalid;
+
+    if (rt->alloc(&rx, &rw, header.codeSize) != asmjit::kErrorOk)
+      goto _Invalid;
+
+    uint8_t* code = static_cast<uint8_t*>(rw);
+    ::memcpy(code, codeData, header.codeSize);
+
+    for (uint32_t i = 0; i < header.relocCount; i++) {
+      ProgramBlobReloc reloc;
+      ::memcpy(&reloc, relocData + i * sizeof(ProgramBlobReloc), sizeof(reloc));
+
+      uint64_t value = reloc.payload;
+      if (reloc.addBase)
+        value += static_cast<uint64_t>(reinterpret_cast<uintptr_t>(rx));
+
+      if (reloc.size == 4 && header.codeSize >= 4 && reloc.offset <= header.codeSize - 4 && value <= 0xFFFFFFFFu) {
+        uint32_t value32 = static_cast<uint32_t>(value);
+        ::memcpy(code + reloc.offset, &value32, 4);
+      }
+      else if (reloc.size == 8 && header.codeSize >= 8 && reloc.offset <= header.codeSize - 8) {
+        ::memcpy(code + reloc.offset, &value, 8);
+      }
+      else {
+        rt->release(rx);
+        rx = nullptr;
+        goto _Invalid;
+      }
+    }
+
+    rt->runtime()->flush(rx, header.codeSize);
+  }
+
+  batchOffset = header.batchOffset;
+  codeSize = header.codeSize;
+
+  ::free(blob);
+  return rx;
+
+_Invalid:
+  ::free(blob);
+  return nullptr;
+}
+
+// ============================================================================
+// [mpsl::ProgramCache - Construction / Destruction]
+// ============================================================================
+
+ProgramCache::ProgramCache() noexcept
+  : _buckets(nullptr),
+    _bucketsCount(0),
+    _entriesCount(0),
+    _lruFirst(nullptr),
+    _lruLast(nullptr),
+    _codeSize(0),
+    _codeLimit(0),
+    _hits(0),
+    _misses(0),
+    _diskHits(0),
+    _diskMisses(0),
+    _directory(nullptr) {}
+
+ProgramCache::~ProgramCache() noexcept {
+  _evict(0);
+  ::free(_buckets);
+  ::free(_directory);
+}
+
+// ============================================================================
+// [mpsl::ProgramCache - Interface]
+// ============================================================================
+
+Error ProgramCache::makeKey(String& key, const Context::CompileArgs& ca, const char* body, size_t size, uint32_t options, const String& builtIns) noexcept {
+  key.clear();
+  MPSL_PROPAGATE(mpProgramCacheAppendU32(key, mpProgramCacheOptions(options)));
+  MPSL_PROPAGATE(mpProgramCacheAppendU32(key, static_cast<uint32_t>(builtIns.size())));
+  MPSL_PROPAGATE(mpProgramCacheAppend(key, builtIns.data(), builtIns.size()));
+  MPSL_PROPAGATE(mpProgramCacheAppendU32(key, ca.numArgs));
+
+  for (uint32_t slot = 0; slot < ca.numArgs; slot++) {
+    const Layout* layout = ca.layout[slot];
+    const Layout::Member* members = layout->membersArray();
+    uint32_t count = layout->membersCount();
+
+    MPSL_PROPAGATE(mpProgramCacheAppendU32(key, layout->_flags));
+    MPSL_PROPAGATE(mpProgramCacheAppendU32(key, layout->nameSize()));
+    MPSL_PROPAGATE(mpProgramCacheAppend(key, layout->name(), layout->nameSize()));
+    MPSL_PROPAGATE(mpProgramCacheAppendU32(key, count));
+
+    for (uint32_t i = 0; i < count; i++) {
+      const Layout::Member& m = members[i];
+      MPSL_PROPAGATE(mpProgramCacheAppendU32(key, m.nameSize));
+      MPSL_PROPAGATE(mpProgramCacheAppend(key, m.name, m.nameSize));
+      MPSL_PROPAGATE(mpProgramCacheAppendU32(key, m.typeInfo));
+      MPSL_PROPAGATE(mpProgramCacheAppendU32(key, static_cast<uint32_t>(m.offset)));
+
+      // Programs are specialized for values of constant members.
+      MPSL_PROPAGATE(mpProgramCacheAppendU32(key, m.value != nullptr));
+      if (m.value)
+        MPSL_PROPAGATE(mpProgramCacheAppend(key, m.value, sizeof(Value)));
+    }
+  }
+
+  return mpProgramCacheAppend(key, body, size);
+}
+
+Program::Impl* ProgramCache::get(const String& key) noexcept {
+  uint64_t hashCode = mpProgramCacheHash(key);
+  ScopedLock lock(_mutex);
+
+  if (_codeLimit == 0)
+    return nullptr;
+
+  ProgramCacheEntry* entry = _find(key, hashCode);
+  if (entry == nullptr) {
+    _misses++;
+    return nullptr;
+  }
+
+  _hits++;
+  _lruUnlink(entry);
+  _lruLink(entry);
+  return mpObjectAddRef(entry->program._d);
+}
+
+Error ProgramCache::put(const String& key, const Program& program, size_t codeSize) noexcept {
+  uint64_t hashCode = mpProgramCacheHash(key);
+  ScopedLock lock(_mutex);
+
+  // A program that doesn't fit into the cache at all is not cached.
+  if (codeSize > _codeLimit)
+    return kErrorOk;
+
+  // Another thread could have compiled the same program in the meantime.
+  if (_find(key, hashCode) != nullptr)
+    return kErrorOk;
+
+  size_t keySize = key.size();
+  void* p = ::malloc(sizeof(ProgramCacheEntry) + keySize);
+  MPSL_NULLCHECK(p);
+
+  ProgramCacheEntry* entry = new(p) ProgramCacheEntry(program, hashCode, codeSize, keySize);
+  ::memcpy(entry->key(), key.data(), keySize);
+
+  if (_entriesCount >= _bucketsCount)
+    _rehash(HashUtils::closestPrime(static_cast<uint32_t>(_entriesCount) * 2 + 1));
+
+  if (_bucketsCount == 0) {
+    entry->~ProgramCacheEntry();
+    ::free(entry);
+    return MPSL_TRACE_ERROR(kErrorNoMemory);
+  }
+
+  uint32_t hMod = static_cast<uint32_t>(hashCode % _bucketsCount);
+  entry->hashNext = _buckets[hMod];
+  _buckets[hMod] = entry;
+  _lruLink(entry);
+
+  _entriesCount++;
+  _codeSize += codeSize;
+
+  _evict(_codeLimit);
+  return kErrorOk;
+}
+
+bool ProgramCache::load(RuntimeData* rt, const String& key, void** funcOut, size_t& batchOffset, size_t& codeSize) noexcept {
+  StringTmp<512> path;
+  if (!_blobPath(path, mpProgramCacheHash(key)))
+    return false;
+
+  void* func = mpProgramBlobLoad(rt, path.data(), key, batchOffset, codeSize);
+  {
+    ScopedLock lock(_mutex);
+    if (func)
+      _diskHits++;
+    else
+      _diskMisses++;
+  }
+
+  *funcOut = func;
+  return func != nullptr;
+}
+
+Error ProgramCache::save(const String& key, asmjit::CodeHolder& code, size_t batchOffset) noexcept {
+  StringTmp<512> path;
+  if (!_blobPath(path, mpProgramCacheHash(key)))
+    return kErrorOk;
+
+  if (code.flatten() != asmjit::kErrorOk || code.resolveUnresolvedLinks() != asmjit::kErrorOk)
+    return MPSL_TRACE_ERROR(kErrorJITFailed);
+
+  const asmjit::ZoneVector<asmjit::RelocEntry*>& relocEntries = code.relocEntries();
+  uint32_t relocCount = relocEntries.size();
+
+  size_t keySize = key.size();
+  size_t codeSize = code.codeSize();
+  size_t blobSize = sizeof(ProgramBlobHeader) + keySize + codeSize + relocCount * sizeof(ProgramBlobReloc);
+
+  if (codeSize > 0xFFFFFFFFu || batchOffset >= codeSize)
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  uint8_t* blob = static_cast<uint8_t*>(::calloc(1, blobSize));
+  MPSL_NULLCHECK(blob);
+
+  uint8_t* keyData = blob + sizeof(ProgramBlobHeader);
+  uint8_t* codeData = keyData + keySize;
+  uint8_t* relocData = codeData + codeSize;
+
+  ::memcpy(keyData, key.data(), keySize);
+  if (code.copyFlattenedData(codeData, codeSize) != asmjit::kErrorOk) {
+    ::free(blob);
+    return MPSL_TRACE_ERROR(kErrorJITFailed);
+  }
+
+  for (uint32_t i = 0; i < relocCount; i++) {
+    const asmjit::RelocEntry* re = relocEntries[i];
+
+    ProgramBlobReloc reloc;
+    ::memset(&reloc, 0, sizeof(reloc));
+
+    // Only relocations that don't refer to other code can be replayed, MPSL
+    // doesn't call external functions, so anything else is unexpected.
+    switch (re->relocType()) {
+      case asmjit::RelocEntry::kTypeAbsToAbs: reloc.addBase = 0; break;
+      case asmjit::RelocEntry::kTypeRelToAbs: reloc.addBase = 1; break;
+
+      default:
+        ::free(blob);
+        return MPSL_TRACE_ERROR(kErrorInvalidState);
+    }
+
+    reloc.offset = static_cast<uint32_t>(re->sourceOffset());
+    reloc.size = static_cast<uint8_t>(re->valueSize());
+    reloc.payload = re->payload();
+    ::memcpy(relocData + i * sizeof(ProgramBlobReloc), &reloc, sizeof(reloc));
+  }
+
+  ProgramBlobHeader header;
+  header.magic = ProgramBlobHeader::kMagic;
+  header.version = ProgramBlobHeader::kVersion;
+  header.pointerSize = static_cast<uint32_t>(sizeof(void*));
+  header.keySize = static_cast<uint32_t>(keySize);
+  header.codeSize = static_cast<uint32_t>(codeSize);
+  header.batchOffset = static_cast<uint32_t>(batchOffset);
+  header.relocCount = relocCount;
+  header.reserved = 0;
+  header.checksum = mpProgramBlobChecksum(header, keyData, blobSize - sizeof(ProgramBlobHeader));
+  ::memcpy(blob, &header, sizeof(header));
+
+  Error err = mpProgramBlobWrite(path.data(), blob, blobSize);
+  ::free(blob);
+  return err;
+}
+
+void ProgramCache::setLimit(size_t codeLimit) noexcept {
+  ScopedLock lock(_mutex);
+
+  _codeLimit = codeLimit;
+  _evict(codeLimit);
+}
+
+Error ProgramCache::setDirectory(const char* directory) noexcept {
+  char* copy = nullptr;
+
+  if (directory && directory[0] != '\0') {
+    size_t size = ::strlen(directory) + 1;
+    copy = static_cast<char*>(::malloc(size));
+    MPSL_NULLCHECK(copy);
+    ::memcpy(copy, directory, size);
+  }
+
+  ScopedLock lock(_mutex);
+  ::free(_directory);
+  _directory = copy;
+  return kErrorOk;
+}
+
+Error ProgramCache::copySettings(ProgramCache& other) noexcept {
+  ScopedLock lock(other._mutex);
+
+  setLimit(other._codeLimit);
+  return setDirectory(other._directory);
+}
+
+void ProgramCache::getInfo(Context::CacheInfo& out) noexcept {
+  ScopedLock lock(_mutex);
+
+  out.hits = _hits;
+  out.misses = _misses;
+  out.diskHits = _diskHits;
+  out.diskMisses = _diskMisses;
+  out.entriesCount = _entriesCount;
+  out.codeSize = _codeSize;
+  out.codeLimit = _codeLimit;
+}
+
+void ProgramCache::clear() noexcept {
+  ScopedLock lock(_mutex);
+
+  _evict(0);
+  _hits = 0;
+  _misses = 0;
+  _diskHits = 0;
+  _diskMisses = 0;
+}
+
+// ============================================================================
+// [mpsl::ProgramCache - Internal]
+// ============================================================================
+
+ProgramCacheEntry* ProgramCache::_find(const String& key, uint64_t hashCode) noexcept {
+  if (_bucketsCount == 0)
+    return nullptr;
+
+  ProgramCacheEntry* entry = _buckets[hashCode % _bucketsCount];
+  size_t keySize = key.size();
+
+  while (entry) {
+    if (entry->hashCode == hashCode && entry->keySize == keySize && ::memcmp(entry->key(), key.data(), keySize) == 0)
+      return entry;
+    entry = entry->hashNext;
+  }
+
+  return nullptr;
+}
+
+bool ProgramCache::_blobPath(String& path, uint64_t hashCode) noexcept {
+  ScopedLock lock(_mutex);
+
+  if (_directory == nullptr)
+    return false;
+
+  size_t size = ::strlen(_directory);
+  char last = _directory[size - 1];
+
+  path.assignString(_directory, size);
+  if (last != '/' && last != '\\')
+    path.appendChar('/');
+
+  return path.appendFormat("%08X%08X.mpslc",
+    static_cast<unsigned int>(hashCode >> 32),
+    static_cast<unsigned int>(hashCode & 0xFFFFFFFFu)) == asmjit::kErrorOk;
+}
+
+void ProgramCache::_rehash(uint32_t bucketsCount) noexcept {
+  ProgramCacheEntry** buckets = static_cast<ProgramCacheEntry**>(
+    ::calloc(bucketsCount, sizeof(ProgramCacheEntry*)));
+
+  // Keep the old buckets if the allocation failed, they still work.
+  if (buckets == nullptr)
+    return;
+
+  for (uint32_t i = 0; i < _bucketsCount; i++) {
+    ProgramCacheEntry* entry = _buckets[i];
+    while (entry) {
+      ProgramCacheEntry* next = entry->hashNext;
+      uint32_t hMod = static_cast<uint32_t>(entry->hashCode % bucketsCount);
+
+      entry->hashNext = buckets[hMod];
+      buckets[hMod] = entry;
+      entry = next;
+    }
+  }
+
+  ::free(_buckets);
+  _buckets = buckets;
+  _bucketsCount = bucketsCount;
+}
+
+void ProgramCache::_evict(size_t codeLimit) noexcept {
+  while (_lruLast && (_codeSize > codeLimit || codeLimit == 0))
+    _remove(_lruLast);
+}
+
+void ProgramCache::_remove(ProgramCacheEntry* entry) noexcept {
+  ProgramCacheEntry** pPrev = &_buckets[entry->hashCode % _bucketsCount];
+  while (*pPrev != entry)
+    pPrev = &(*pPrev)->hashNext;
+
+  *pPrev = entry->hashNext;
+  _lruUnlink(entry);
+
+  _entriesCount--;
+  _codeSize -= entry->codeSize;
+
+  entry->~ProgramCacheEntry();
+  ::free(entry);
+}
+
+void ProgramCache::_lruLink(ProgramCacheEntry* entry) noexcept {
+  entry->lruPrev = nullptr;
+  entry->lruNext = _lruFirst;
+
+  if (_lruFirst)
+    _lruFirst->lruPrev = entry;
+  else
+    _lruLast = entry;
+
+  _lruFirst = entry;
+}
+
+void ProgramCache::_lruUnlink(ProgramCacheEntry* entry) noexcept {
+  ProgramCacheEntry* prev = entry->lruPrev;
+  ProgramCacheEntry* next = entry->lruNext;
+
+  if (prev)
+    prev->lruNext = next;
+  else
+    _lruFirst = next;
+
+  if (next)
+    next->lruPrev = prev;
+  else
+    _lruLast = prev;
+
+  entry->lruPrev = nullptr;
+  entry->lruNext = nullptr;
+}
+
+// ============================================================================
+// [mpsl::mpProgramCache]
+// ============================================================================
+
+void* mpProgramCacheCreate() noexcept {
+  void* p = ::malloc(sizeof(ProgramCache));
+  if (p == nullptr)
+    return nullptr;
+  return new(p) ProgramCache();
+}
+
+void mpProgramCacheDestroy(void* cacheData) noexcept {
+  if (cacheData) {
+    ProgramCache* cache = static_cast<ProgramCache*>(cacheData);
+    cache->~ProgramCache();
+    ::free(cache);
+  }
+}
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
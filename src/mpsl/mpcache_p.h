@@ -0,0 +1,215 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _MPSL_MPCACHE_P_H
+#define _MPSL_MPCACHE_P_H
+
+// [Dependencies - MPSL]
+#include "./mpruntime_p.h"
+#include "./mpsl_p.h"
+#include "./mpthread_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::ProgramCacheEntry]
+// ============================================================================
+
+//! \internal
+//!
+//! A compiled program and the key it was compiled from. The key is stored
+//! right after the entry and compared as a whole, so a hash collision can't
+//! return a wrong program.
+struct ProgramCacheEntry {
+  MPSL_INLINE ProgramCacheEntry(const Program& program, uint64_t hashCode, size_t codeSize, size_t keySize) noexcept
+    : hashNext(nullptr),
+      lruPrev(nullptr),
+      lruNext(nullptr),
+      hashCode(hashCode),
+      codeSize(codeSize),
+      keySize(keySize),
+      program(program) {}
+
+  MPSL_INLINE uint8_t* key() noexcept { return reinterpret_cast<uint8_t*>(this + 1); }
+
+  ProgramCacheEntry* hashNext;           //!< Next entry in the same bucket.
+  ProgramCacheEntry* lruPrev;            //!< More recently used entry.
+  ProgramCacheEntry* lruNext;            //!< Less recently used entry.
+
+  uint64_t hashCode;                     //!< Hash of the key.
+  size_t codeSize;                       //!< Size of the machine code (in bytes).
+  size_t keySize;                        //!< Size of the key (in bytes).
+  Program program;                       //!< Compiled program (holds a reference).
+};
+
+// ============================================================================
+// [mpsl::ProgramBlob]
+// ============================================================================
+
+//! \internal
+//!
+//! Header of a program serialized to the cache directory.
+//!
+//! The header is followed by the key, the machine code (with the embedded
+//! const pool), and relocations. The code is stored before it's relocated,
+//! relocations are applied when the blob is loaded at its final address.
+struct ProgramBlobHeader {
+  enum {
+    kMagic = 0x4C53504Du,                //!< "MPSL" (little endian).
+    kVersion = (MPSL_VERSION_MAJOR << 24) | (MPSL_VERSION_MINOR << 16) | 2
+  };
+
+  uint32_t magic;                        //!< Must be `kMagic`.
+  uint32_t version;                      //!< Must be `kVersion`.
+  uint32_t pointerSize;                  //!< Size of a pointer of the process that wrote it.
+  uint32_t keySize;                      //!< Size of the key (in bytes).
+  uint32_t codeSize;                     //!< Size of the machine code (in bytes).
+  uint32_t batchOffset;                  //!< Offset of the `batch()` entry-point.
+  uint32_t relocCount;                   //!< Count of `ProgramBlobReloc` records.
+  uint32_t reserved;                     //!< Reserved, must be zero.
+  uint64_t checksum;                     //!< Hash of the header and everything that follows it.
+};
+
+//! \internal
+//!
+//! Relocation of a serialized program.
+struct ProgramBlobReloc {
+  uint32_t offset;                       //!< Offset of the value in the machine code.
+  uint8_t size;                          //!< Size of the value (4 or 8 bytes).
+  uint8_t addBase;                       //!< Add the address of the code to `payload`.
+  uint8_t reserved[2];                   //!< Reserved, must be zero.
+  uint64_t payload;                      //!< Value to write.
+};
+
+// ============================================================================
+// [mpsl::ProgramCache]
+// ============================================================================
+
+//! \internal
+//!
+//! Cache of compiled programs used by `Context`.
+//!
+//! The key of a program is everything that affects the generated code - the
+//! body, options, CPU features, constants added to the context, and all
+//! layouts, see \ref makeKey(). Entries
+//! are evicted in least-recently-used order when their code exceeds the limit
+//! set by `Context::setCacheLimit()`, zero (the default) disables the cache.
+//!
+//! Programs can be also serialized to a directory set by
+//! `Context::setCacheDirectory()`, which works independently of the limit.
+class ProgramCache {
+public:
+  MPSL_NONCOPYABLE(ProgramCache)
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ProgramCache() noexcept;
+  ~ProgramCache() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Serialize everything that affects the code generated by `ca` to `key`.
+  //!
+  //! Options are canonicalized, so options that generate the same code (like
+  //! an implicit and explicit O2) produce the same key, and only CPU features
+  //! the code generator uses are included, see `IRToX86::usedFeatures()`.
+  //!
+  //! The `builtIns` is a signature of constants added to the context, see
+  //! `AstBuiltIns::signature()`.
+  static Error makeKey(String& key, const Context::CompileArgs& ca, const char* body, size_t size, uint32_t options, const String& builtIns) noexcept;
+
+  //! Get whether the cache is enabled (without locking, only a hint).
+  MPSL_INLINE bool isEnabled() const noexcept { return _codeLimit != 0; }
+  //! Get whether the cache directory is set (without locking, only a hint).
+  MPSL_INLINE bool hasDirectory() const noexcept { return _directory != nullptr; }
+
+  //! Get a program of `key` with an added reference, or null if not cached.
+  Program::Impl* get(const String& key) noexcept;
+  //! Add `program` of `key` having `codeSize` bytes of machine code.
+  Error put(const String& key, const Program& program, size_t codeSize) noexcept;
+
+  //! Load a program of `key` from the cache directory into `rt`.
+  //!
+  //! Returns false if the program is not there or its blob doesn't validate.
+  bool load(RuntimeData* rt, const String& key, void** funcOut, size_t& batchOffset, size_t& codeSize) noexcept;
+  //! Save a program of `key` compiled into `code` to the cache directory.
+  //!
+  //! Must be called before the code is relocated by `JitRuntime::add()`.
+  Error save(const String& key, asmjit::CodeHolder& code, size_t batchOffset) noexcept;
+
+  void setLimit(size_t codeLimit) noexcept;
+  Error setDirectory(const char* directory) noexcept;
+  //! Use the same limit and directory as `other` (used by `Context::clone()`).
+  Error copySettings(ProgramCache& other) noexcept;
+  void getInfo(Context::CacheInfo& out) noexcept;
+  void clear() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  ProgramCacheEntry* _find(const String& key, uint64_t hashCode) noexcept;
+  bool _blobPath(String& path, uint64_t hashCode) noexcept;
+  void _rehash(uint32_t bucketsCount) noexcept;
+  void _evict(size_t codeLimit) noexcept;
+  void _remove(ProgramCacheEntry* entry) noexcept;
+
+  void _lruLink(ProgramCacheEntry* entry) noexcept;
+  void _lruUnlink(ProgramCacheEntry* entry) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  Mutex _mutex;                          //!< Guards everything below.
+
+  ProgramCacheEntry** _buckets;          //!< Hash buckets.
+  uint32_t _bucketsCount;                //!< Count of hash buckets.
+  size_t _entriesCount;                  //!< Count of entries.
+
+  ProgramCacheEntry* _lruFirst;          //!< Most recently used entry.
+  ProgramCacheEntry* _lruLast;           //!< Least recently used entry.
+
+  size_t _codeSize;                      //!< Machine code of all entries (in bytes).
+  size_t _codeLimit;                     //!< Limit of `_codeSize`, zero if disabled.
+
+  uint64_t _hits;                        //!< Count of successful lookups.
+  uint64_t _misses;                      //!< Count of failed lookups.
+  uint64_t _diskHits;                    //!< Count of programs loaded from the directory.
+  uint64_t _diskMisses;                  //!< Count of programs not found in the directory.
+
+  char* _directory;                      //!< Cache directory, null if not set.
+};
+
+// ============================================================================
+// [mpsl::mpProgramCache]
+// ============================================================================
+
+//! \internal
+//!
+//! Create a program cache stored as `void*` (used by `Context`).
+void* mpProgramCacheCreate() noexcept;
+
+//! \internal
+//!
+//! Destroy a program cache stored as `void*` (used by `Context`).
+void mpProgramCacheDestroy(void* cacheData) noexcept;
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
+
+// [Guard]
+#endif // _MPSL_MPCACHE_P_H
@@ -72,6 +72,22 @@ static MPSL_INLINE bool mpIsValueLoHiEqual(const Value& val) noexcept {
   return (val.q[0] == val.q[2]) && (val.q[1] == val.q[3]);
 }
 
+// Get whether `node` contains a `return` that is nested in a branch.
+static bool mpHasReturnInBranch(AstNode* node, bool inBranch) noexcept {
+  if (node->nodeType() == AstNode::kTypeReturn)
+    return inBranch;
+
+  if (node->nodeType() == AstNode::kTypeBranch)
+    inBranch = true;
+
+  AstNode** children = node->children();
+  for (uint32_t i = 0, count = node->size(); i < count; i++)
+    if (children[i] && mpHasReturnInBranch(children[i], inBranch))
+      return true;
+
+  return false;
+}
+
 // ============================================================================
 // [mpsl::CodeGen - Construction / Destruction]
 // ============================================================================
@@ -84,6 +100,10 @@ CodeGen::CodeGen(AstBuilder* ast, IRBuilder* ir) noexcept
     _hasV256(false),
     _hiddenRet(nullptr),
     _currentRet(),
+    _retBlock(nullptr),
+    _loopTarget(nullptr),
+    _maskScope(nullptr),
+    _maskedReturns(0),
     _nestedFunctions(ir->allocator()),
     _varMap(ir->allocator()),
     _memMap(ir->allocator()) {
@@ -118,12 +138,18 @@ Error CodeGen::onProgram(AstProgram* node, Result& out) noexcept {
 // NOTE: This is only called once per "main()". Other functions are simply
 // inlined during AST to IR translation.
 Error CodeGen::onFunction(AstFunction* node, Result& out) noexcept {
+  MaskScope scope(nullptr, IRPair<IRReg>(), kTypeVoid, 0, true);
+
   if (node->body()) {
     MPSL_PROPAGATE(_nestedFunctions.put(node));
+    MPSL_PROPAGATE(enterFunction(node, scope));
     MPSL_PROPAGATE(onNode(node->body(), out));
   }
 
-  return kErrorOk;
+  MPSL_PROPAGATE(endFunction());
+  leaveFunction(scope);
+
+  return ir()->addExit(block());
 }
 
 Error CodeGen::onBlock(AstBlock* node, Result& out) noexcept {
@@ -139,38 +165,140 @@ Error CodeGen::onBlock(AstBlock* node, Result& out) noexcept {
 }
 
 Error CodeGen::onBranch(AstBranch* node, Result& out) noexcept {
-  // TODO:
-  MPSL_ASSERT(!"Implemented");
+  if (MPSL_UNLIKELY(!node->condition()))
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  // Lanes of a vector (or of a SPMD program) can take different paths, which
+  // can't be done by a jump.
+  if (isPredicated(node))
+    return onPredicatedBranch(node);
+
+  IRBlock* thenBlock;
+  IRBlock* elseBlock = nullptr;
+  IRBlock* joinBlock;
+
+  MPSL_PROPAGATE(newBlock(thenBlock));
+  if (node->elseBody())
+    MPSL_PROPAGATE(newBlock(elseBlock));
+  MPSL_PROPAGATE(newBlock(joinBlock));
+
+  MPSL_PROPAGATE(emitBranch(node->condition(), thenBlock, elseBlock ? elseBlock : joinBlock));
+
+  _block = thenBlock;
+  if (node->thenBody()) {
+    Result noResult(false);
+    MPSL_PROPAGATE(onNode(node->thenBody(), noResult));
+  }
+  MPSL_PROPAGATE(emitJump(joinBlock));
+
+  if (elseBlock) {
+    Result noResult(false);
+
+    _block = elseBlock;
+    MPSL_PROPAGATE(onNode(node->elseBody(), noResult));
+    MPSL_PROPAGATE(emitJump(joinBlock));
+  }
+
+  _block = joinBlock;
   return kErrorOk;
 }
 
+// Loops are lowered into these blocks:
+//
+//   [init]  - Emitted into the current block, jumps to `cond` (do-while jumps
+//             to `body`).
+//   cond    - Jumps to `body` if the condition holds, otherwise to `break`.
+//   body    - Loop body, falls to `iter` (if any) or `cond`.
+//   iter    - Iteration expression of the `for` loop, jumps to `cond`.
+//   break   - Code that follows the loop.
+//
+// `continue` jumps to `iter`, or to `cond` if there is no iteration expression.
+// A `for` loop without condition uses `body` in place of `cond`.
 Error CodeGen::onLoop(AstLoop* node, Result& out) noexcept {
-  // TODO:
-  MPSL_ASSERT(!"Implemented");
+  if (isSPMD())
+    return MPSL_TRACE_ERROR(kErrorInvalidProgram);
+
+  bool isDoWhile = node->nodeType() == AstNode::kTypeDoWhile;
+  Result noResult(false);
+
+  if (node->forInit())
+    MPSL_PROPAGATE(onNode(node->forInit(), noResult));
+
+  IRBlock* condBlock = nullptr;
+  IRBlock* bodyBlock;
+  IRBlock* iterBlock = nullptr;
+  IRBlock* breakBlock;
+
+  if (node->condition())
+    MPSL_PROPAGATE(newBlock(condBlock));
+  MPSL_PROPAGATE(newBlock(bodyBlock));
+  if (node->forIter())
+    MPSL_PROPAGATE(newBlock(iterBlock));
+  MPSL_PROPAGATE(newBlock(breakBlock));
+
+  IRBlock* headBlock = condBlock ? condBlock : bodyBlock;
+  IRBlock* continueBlock = iterBlock ? iterBlock : headBlock;
+
+  MPSL_PROPAGATE(emitJump(isDoWhile ? bodyBlock : headBlock));
+
+  if (condBlock && !isDoWhile) {
+    _block = condBlock;
+    MPSL_PROPAGATE(emitBranch(node->condition(), bodyBlock, breakBlock));
+  }
+
+  LoopTarget target(_loopTarget, breakBlock, continueBlock);
+  _block = bodyBlock;
+  _loopTarget = &target;
+
+  Error err = node->body() ? onNode(node->body(), noResult) : static_cast<Error>(kErrorOk);
+  _loopTarget = target.prev;
+
+  MPSL_PROPAGATE(err);
+  MPSL_PROPAGATE(emitJump(continueBlock));
+
+  if (iterBlock) {
+    _block = iterBlock;
+    MPSL_PROPAGATE(onNode(node->forIter(), noResult));
+    MPSL_PROPAGATE(emitJump(headBlock));
+  }
+
+  if (condBlock && isDoWhile) {
+    _block = condBlock;
+    MPSL_PROPAGATE(emitBranch(node->condition(), bodyBlock, breakBlock));
+  }
+
+  _block = breakBlock;
   return kErrorOk;
 }
 
 Error CodeGen::onBreak(AstBreak* node, Result& out) noexcept {
-  // TODO:
-  MPSL_ASSERT(!"Implemented");
-  return kErrorOk;
+  if (MPSL_UNLIKELY(!_loopTarget))
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  MPSL_PROPAGATE(emitJump(_loopTarget->breakBlock));
+  return newUnreachableBlock();
 }
 
 Error CodeGen::onContinue(AstContinue* node, Result& out) noexcept {
-  // TODO:
-  MPSL_ASSERT(!"Implemented");
-  return kErrorOk;
+  if (MPSL_UNLIKELY(!_loopTarget))
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  MPSL_PROPAGATE(emitJump(_loopTarget->continueBlock));
+  return newUnreachableBlock();
 }
 
 Error CodeGen::onReturn(AstReturn* node, Result& out) noexcept {
+  // Only lanes that took the branch return, others continue.
+  bool isPredicated = _maskScope && !_maskScope->isFunction;
+
   if (node->child()) {
     Result val(true);
     MPSL_PROPAGATE(onNode(node->child(), val));
 
-    uint32_t typeInfo = _hiddenRet->typeInfo();
-    uint32_t width = TypeInfo::widthOf(typeInfo);
-
     if (_functionLevel == 0) {
+      uint32_t typeInfo = _hiddenRet->typeInfo();
+      uint32_t width = TypeInfo::widthOf(typeInfo);
+
       IRPair<IRReg> var;
       MPSL_PROPAGATE(asVar(var, val.result, typeInfo));
 
@@ -179,11 +307,29 @@ Error CodeGen::onReturn(AstReturn* node, Result& out) noexcept {
       MPSL_PROPAGATE(emitStore(mem, var, typeInfo));
     }
     else {
-      _currentRet = val.result;
+      uint32_t typeInfo = node->typeInfo();
+
+      IRPair<IRReg> var;
+      MPSL_PROPAGATE(asVar(var, val.result, typeInfo));
+
+      // All returns of an inlined function assign the same variable.
+      IRPair<IRReg> ret;
+      if (!_currentRet.lo)
+        MPSL_PROPAGATE(newVar(_currentRet, typeInfo));
+
+      ret.set(_currentRet);
+      MPSL_PROPAGATE(emitAssign(ret, var, typeInfo));
     }
   }
 
-  return kErrorOk;
+  if (isPredicated)
+    return onPredicatedReturn();
+
+  if (!_retBlock)
+    MPSL_PROPAGATE(newBlock(_retBlock));
+
+  MPSL_PROPAGATE(emitJump(_retBlock));
+  return newUnreachableBlock();
 }
 
 Error CodeGen::onVarDecl(AstVarDecl* node, Result& out) noexcept {
@@ -193,7 +339,7 @@ Error CodeGen::onVarDecl(AstVarDecl* node, Result& out) noexcept {
   if (node->child()) {
     Result exp(true);
     MPSL_PROPAGATE(onNode(node->child(), exp));
-    MPSL_PROPAGATE(asVar(var, exp.result, typeInfo));
+    MPSL_PROPAGATE(copyVar(var, exp.result, node->child(), typeInfo));
   }
   else {
     MPSL_PROPAGATE(newVar(var, typeInfo));
@@ -211,7 +357,16 @@ Error CodeGen::onVarMemb(AstVarMemb* node, Result& out) noexcept {
 
   uint32_t typeInfo = node->typeInfo();
   uint32_t width = TypeInfo::widthOf(typeInfo);
-  return addrOfData(out.result, DataSlot(child->symbol()->dataSlot(), node->offset()), width);
+
+  // Constant members are only replaced by `AstOptimizer`, which doesn't run
+  // at `kOptionO0`.
+  const Layout* layout = child->symbol()->layout();
+  const Layout::Member* m = layout ? layout->member(node->field()) : nullptr;
+  if (m && m->isConst())
+    return newImm(out.result, *m->value, typeInfo & ~(kTypeRef | kTypeWrite));
+
+  uint32_t slot = m && m->isUniform() ? static_cast<uint32_t>(kUniformDataSlot) : child->symbol()->dataSlot();
+  return addrOfData(out.result, DataSlot(slot, node->offset()), width);
 }
 
 Error CodeGen::onVar(AstVar* node, Result& out) noexcept {
@@ -222,6 +377,10 @@ Error CodeGen::onVar(AstVar* node, Result& out) noexcept {
     uint32_t width = TypeInfo::widthOf(typeInfo);
     return addrOfData(out.result, DataSlot(symbol->dataSlot(), symbol->dataOffset()), width);
   }
+  else if (symbol->isBuiltInConst()) {
+    // Not replaced by `AstOptimizer`, which doesn't run at `kOptionO0`.
+    return newImm(out.result, symbol->value(), node->typeInfo() & ~(kTypeRef | kTypeWrite));
+  }
   else {
     out.result.set(_varMap.get(symbol));
     // Unmapped variable at this stage is a bug in MPSL.
@@ -274,14 +433,23 @@ Error CodeGen::onUnaryOp(AstUnaryOp* node, Result& out) noexcept {
     if (out.dependsOnResult)
       MPSL_PROPAGATE(newVar(result, typeInfo));
 
+    // A predicated variable is calculated into a temporary and then blended.
+    IRPair<IRReg> value(var);
+    if (isMasked(var))
+      MPSL_PROPAGATE(newVar(value, typeInfo));
+
     if (op.isPostAssignment()) {
       MPSL_PROPAGATE(emitMove(result, var, typeInfo));
-      MPSL_PROPAGATE(emitInst3(instCode, var, var, imm, typeInfo));
+      MPSL_PROPAGATE(emitInst3(instCode, value, var, imm, typeInfo));
+      if (value.lo != var.lo)
+        MPSL_PROPAGATE(emitAssign(var, value, typeInfo));
       if (tmp.result.lo->isMem())
         MPSL_PROPAGATE(emitStore(reinterpret_cast<IRPair<IRMem>&>(tmp.result), var, typeInfo));
     }
     else {
-      MPSL_PROPAGATE(emitInst3(instCode, var, var, imm, typeInfo));
+      MPSL_PROPAGATE(emitInst3(instCode, value, var, imm, typeInfo));
+      if (value.lo != var.lo)
+        MPSL_PROPAGATE(emitAssign(var, value, typeInfo));
       MPSL_PROPAGATE(emitMove(result, var, typeInfo));
       if (tmp.result.lo->isMem())
         MPSL_PROPAGATE(emitStore(reinterpret_cast<IRPair<IRMem>&>(tmp.result), var, typeInfo));
@@ -294,21 +462,30 @@ Error CodeGen::onUnaryOp(AstUnaryOp* node, Result& out) noexcept {
 
     if (op.isCast()) {
       // TODO: Vector casting doesn't work right now.
+      uint32_t toId = typeInfo & kTypeIdMask;
       uint32_t fromId = node->child()->typeInfo() & kTypeIdMask;
       uint32_t instCode = kInstCodeNone;
 
-      switch (COMBINE_OP_CAST(typeInfo & kTypeIdMask, fromId)) {
+      switch (COMBINE_OP_CAST(toId, fromId)) {
         case COMBINE_OP_CAST(kTypeFloat , kTypeDouble): instCode = kInstCodeCvtdtof; break;
-        case COMBINE_OP_CAST(kTypeFloat , kTypeInt   ): instCode = kInstCodeCvtdtoi; break;
+        case COMBINE_OP_CAST(kTypeFloat , kTypeInt   ): instCode = kInstCodeCvtitof; break;
         case COMBINE_OP_CAST(kTypeDouble, kTypeFloat ): instCode = kInstCodeCvtftod; break;
-        case COMBINE_OP_CAST(kTypeDouble, kTypeInt   ): instCode = kInstCodeCvtftoi; break;
-        case COMBINE_OP_CAST(kTypeInt   , kTypeFloat ): instCode = kInstCodeCvtitof; break;
-        case COMBINE_OP_CAST(kTypeInt   , kTypeDouble): instCode = kInstCodeCvtitod; break;
+        case COMBINE_OP_CAST(kTypeDouble, kTypeInt   ): instCode = kInstCodeCvtitod; break;
+        case COMBINE_OP_CAST(kTypeInt   , kTypeFloat ): instCode = kInstCodeCvtftoi; break;
+        case COMBINE_OP_CAST(kTypeInt   , kTypeDouble): instCode = kInstCodeCvtdtoi; break;
 
         default:
           return MPSL_TRACE_ERROR(kErrorInvalidState);
       }
-      MPSL_PROPAGATE(emitInst2(instCode, out.result, tmp.result, typeInfo));
+
+      // SPMD lanes of 32-bit and 64-bit types don't have the same shape, only
+      // casts between `int` and `float` are vectorized.
+      if (isSPMD() && (toId == kTypeDouble || fromId == kTypeDouble))
+        return MPSL_TRACE_ERROR(kErrorInvalidProgram);
+
+      IRPair<IRReg> src;
+      MPSL_PROPAGATE(asVar(src, tmp.result, node->child()->typeInfo()));
+      MPSL_PROPAGATE(emitInst2(instCode, out.result, src, typeInfo));
     }
     else if (op.isSwizzle()) {
       uint32_t width = TypeInfo::widthOf(typeInfo);
@@ -355,16 +532,22 @@ Error CodeGen::onBinaryOp(AstBinaryOp* node, Result& out) noexcept {
   IRPair<IRReg> rVar;
   MPSL_PROPAGATE(newVar(result, typeInfo));
 
-  uint32_t instCode = op.instByTypeId(typeInfo & kTypeIdMask);
+  // The result of a conditional is a boolean, but the instruction and its
+  // operands are of the compared type.
+  uint32_t opTypeInfo = op.isConditional() ? node->left()->typeInfo() : typeInfo;
+  uint32_t instCode = op.instByTypeId(opTypeInfo & kTypeIdMask);
   if (op.isAssignment()) {
     if (op.type() == kOpAssign) {
       // Pure assignment operator `=`.
       MPSL_PROPAGATE(asVar(rVar, rValue.result, typeInfo));
 
-      if (lValue.result.lo->isMem())
+      if (lValue.result.lo->isMem()) {
         MPSL_PROPAGATE(emitStore(lValue.result, rVar, typeInfo));
-      else
-        MPSL_PROPAGATE(emitMove(lVar, rVar, typeInfo));
+      }
+      else {
+        lVar.set(lValue.result);
+        MPSL_PROPAGATE(emitAssign(lVar, rVar, typeInfo));
+      }
 
       if (out.dependsOnResult) {
         MPSL_PROPAGATE(emitMove(result, rVar, typeInfo));
@@ -374,13 +557,19 @@ Error CodeGen::onBinaryOp(AstBinaryOp* node, Result& out) noexcept {
     else {
       MPSL_PROPAGATE(asVar(lVar, lValue.result, typeInfo));
       MPSL_PROPAGATE(asVar(rVar, rValue.result, typeInfo));
-      MPSL_PROPAGATE(emitInst3(instCode, lVar, lVar, rVar, typeInfo));
 
       if (lValue.result.lo->isMem()) {
+        MPSL_PROPAGATE(emitInst3(instCode, lVar, lVar, rVar, typeInfo));
         MPSL_PROPAGATE(emitStore(lValue.result, lVar, typeInfo));
         out.result.set(lVar);
       }
+      else if (isMasked(lVar)) {
+        MPSL_PROPAGATE(emitInst3(instCode, result, lVar, rVar, typeInfo));
+        MPSL_PROPAGATE(emitAssign(lVar, result, typeInfo));
+        out.result.set(result);
+      }
       else {
+        MPSL_PROPAGATE(emitInst3(instCode, lVar, lVar, rVar, typeInfo));
         MPSL_PROPAGATE(emitMove(result, lVar, typeInfo));
         out.result.set(result);
       }
@@ -398,9 +587,9 @@ Error CodeGen::onBinaryOp(AstBinaryOp* node, Result& out) noexcept {
       MPSL_PROPAGATE(emitInst3(instCode, result, lVar, rValue.result, typeInfo));
     }
     else {
-      MPSL_PROPAGATE(asVar(lVar, lValue.result, typeInfo));
-      MPSL_PROPAGATE(asVar(rVar, rValue.result, typeInfo));
-      MPSL_PROPAGATE(emitInst3(instCode, result, lVar, rVar, typeInfo));
+      MPSL_PROPAGATE(asVar(lVar, lValue.result, opTypeInfo));
+      MPSL_PROPAGATE(asVar(rVar, rValue.result, opTypeInfo));
+      MPSL_PROPAGATE(emitInst3(instCode, result, lVar, rVar, opTypeInfo));
     }
 
     out.result.set(result);
@@ -443,7 +632,7 @@ Error CodeGen::onCall(AstCall* node, Result& out) noexcept {
     MPSL_PROPAGATE(onNode(node->childAt(i), value));
 
     IRPair<IRReg> var;
-    MPSL_PROPAGATE(asVar(var, value.result, argDecl->typeInfo()));
+    MPSL_PROPAGATE(copyVar(var, value.result, node->childAt(i), argDecl->typeInfo()));
 
     mapVarToAst(argDecl->symbol(), var);
   }
@@ -464,13 +653,27 @@ Error CodeGen::onCall(AstCall* node, Result& out) noexcept {
 
   // Emit the function body.
   if (func->body()) {
+    IRPair<IRObject> prevRet(_currentRet);
+    IRBlock* prevRetBlock = _retBlock;
+
+    _currentRet.reset();
+    _retBlock = nullptr;
+
+    MaskScope scope(nullptr, IRPair<IRReg>(), kTypeVoid, 0, true);
+
     _functionLevel++;
     MPSL_PROPAGATE(_nestedFunctions.put(func));
+    MPSL_PROPAGATE(enterFunction(func, scope));
     MPSL_PROPAGATE(onNode(func->body(), out));
+    MPSL_PROPAGATE(endFunction());
+    leaveFunction(scope);
 
     _functionLevel--;
     _nestedFunctions.del(func);
     out.result = _currentRet;
+
+    _currentRet = prevRet;
+    _retBlock = prevRetBlock;
   }
 
   return kErrorOk;
@@ -490,7 +693,22 @@ Error CodeGen::mapVarToAst(AstSymbol* sym, IRPair<IRReg> var) noexcept {
   return kErrorOk;
 }
 
+Error CodeGen::toLaneType(uint32_t& typeInfo) noexcept {
+  if (!isSPMD())
+    return kErrorOk;
+
+  // SPMD mode only vectorizes scalar programs, each scalar becomes a vector
+  // that holds one element per lane.
+  if ((typeInfo & kTypeVecMask) >= kTypeVec2)
+    return MPSL_TRACE_ERROR(kErrorInvalidProgram);
+
+  MPSL_ASSERT(ir()->numLanes() == 4);
+  typeInfo = (typeInfo & ~kTypeVecMask) | kTypeVec4;
+  return kErrorOk;
+}
+
 Error CodeGen::newVar(IRPair<IRObject>& dst, uint32_t typeInfo) noexcept {
+  MPSL_PROPAGATE(toLaneType(typeInfo));
   uint32_t width = TypeInfo::widthOf(typeInfo);
 
   IRReg* lo = nullptr;
@@ -513,9 +731,20 @@ Error CodeGen::newVar(IRPair<IRObject>& dst, uint32_t typeInfo) noexcept {
   return dst.set(lo, hi);
 }
 
-Error CodeGen::newImm(IRPair<IRObject>& dst, const Value& value, uint32_t typeInfo) noexcept {
+Error CodeGen::newImm(IRPair<IRObject>& dst, const Value& value_, uint32_t typeInfo) noexcept {
+  Value value(value_);
+
+  if (isSPMD()) {
+    // Broadcast the scalar to all lanes.
+    if (TypeInfo::sizeOf(typeInfo & kTypeIdMask) == 8)
+      value.q.set(value.q[0]);
+    else
+      value.i.set(value.i[0]);
+    MPSL_PROPAGATE(toLaneType(typeInfo));
+  }
+
   uint32_t width = TypeInfo::widthOf(typeInfo);
-  if (width > 16 && !hasV256()) {
+  if (needSplit(width)) {
     uint32_t loTI, hiTI;
     mpSplitTypeInfo(loTI, hiTI, typeInfo);
 
@@ -551,7 +780,28 @@ Error CodeGen::addrOfData(IRPair<IRObject>& dst, DataSlot data, uint32_t width)
   IRMem* lo = nullptr;
   IRMem* hi = nullptr;
 
-  if (width > 16 && !hasV256()) {
+  if (isSPMD()) {
+    // Uniform data is shared by all lanes, `asVar()` broadcasts it.
+    if (!ir()->isSoASlot(data.slot)) {
+      lo = ir()->newMem(base, nullptr, data.offset);
+      MPSL_NULLCHECK(lo);
+
+      dst.set(lo, needSplit(width * ir()->numLanes()) ? lo : nullptr);
+      return kErrorOk;
+    }
+
+    // Structure-of-arrays - the element of the first lane is at `offset +
+    // laneIndex * width` and all other lanes follow consecutively.
+    uint32_t shift = width == 8 ? 3 : 2;
+    lo = ir()->newLaneMem(base, data.offset, shift, 0);
+    MPSL_NULLCHECK(lo);
+
+    if (needSplit(width * ir()->numLanes())) {
+      hi = ir()->newLaneMem(base, data.offset + 16, shift, 16 / width);
+      MPSL_NULLCHECK(hi);
+    }
+  }
+  else if (needSplit(width)) {
     lo = ir()->newMem(base, nullptr, data.offset);
     hi = ir()->newMem(base, nullptr, data.offset + 16);
 
@@ -571,6 +821,9 @@ Error CodeGen::asVar(IRPair<IRObject>& out, IRPair<IRObject> in, uint32_t typeIn
   if (in.lo == nullptr && in.hi == nullptr)
     return out.set(nullptr, nullptr);
 
+  uint32_t scalarTI = typeInfo;
+  MPSL_PROPAGATE(toLaneType(typeInfo));
+
   uint32_t ti[2] = { typeInfo, kTypeVoid };
   uint32_t width = TypeInfo::widthOf(typeInfo);
 
@@ -596,9 +849,23 @@ Error CodeGen::asVar(IRPair<IRObject>& out, IRPair<IRObject> in, uint32_t typeIn
 
         IRMem* mem = inObj->as<IRMem>();
         IRReg* var = ir()->newVarByTypeInfo(typeInfo);
-
         MPSL_NULLCHECK(var);
-        MPSL_PROPAGATE(emitFetchX(var, mem, typeInfo));
+
+        if (isSPMD() && !mem->hasIndex()) {
+          // Uniform data - fetch a single element and broadcast it.
+          Value shufValue;
+          shufValue.q.set(0);
+          shufValue.i[0] = TypeInfo::sizeOf(scalarTI & kTypeIdMask) == 8 ? 0x44 : 0x00;
+
+          IRImm* shufImm = ir()->newImm(shufValue, IRReg::kKindNone, 4);
+          MPSL_NULLCHECK(shufImm);
+
+          MPSL_PROPAGATE(emitFetchX(var, mem, scalarTI));
+          MPSL_PROPAGATE(ir()->emitInst(block(), kInstCodePshufd | kInstVec128, var, var, shufImm));
+        }
+        else {
+          MPSL_PROPAGATE(emitFetchX(var, mem, typeInfo));
+        }
 
         out.obj[i] = var;
         break;
@@ -621,6 +888,22 @@ Error CodeGen::asVar(IRPair<IRObject>& out, IRPair<IRObject> in, uint32_t typeIn
   return kErrorOk;
 }
 
+Error CodeGen::copyVar(IRPair<IRObject>& out, IRPair<IRObject> in, AstNode* node, uint32_t typeInfo) noexcept {
+  // Only a variable evaluates to a register owned by something else, all other
+  // expressions result in a new temporary that can be used as is.
+  if (!node->isVar() || !in.lo || !in.lo->isReg())
+    return asVar(out, in, typeInfo);
+
+  IRPair<IRReg> src;
+  IRPair<IRReg> dst;
+
+  src.set(in);
+  MPSL_PROPAGATE(newVar(dst, typeInfo));
+  MPSL_PROPAGATE(emitMove(dst, src, typeInfo));
+
+  return out.set(dst);
+}
+
 Error CodeGen::emitMove(IRPair<IRReg> dst, IRPair<IRReg> src, uint32_t typeInfo) noexcept {
   uint32_t width = TypeInfo::widthOf(typeInfo);
 
@@ -631,6 +914,22 @@ Error CodeGen::emitMove(IRPair<IRReg> dst, IRPair<IRReg> src, uint32_t typeInfo)
 }
 
 Error CodeGen::emitStore(IRPair<IRObject> dst, IRPair<IRReg> src, uint32_t typeInfo) noexcept {
+  // Uniform data is read-only in SPMD mode as all lanes would write to it.
+  if (isSPMD() && !dst.lo->as<IRMem>()->hasIndex())
+    return MPSL_TRACE_ERROR(kErrorInvalidProgram);
+
+  // Predicated store - lanes that are not executed keep their previous value.
+  if (_maskScope) {
+    IRPair<IRReg> prev;
+    IRPair<IRReg> blended;
+
+    MPSL_PROPAGATE(asVar(prev, dst, typeInfo));
+    MPSL_PROPAGATE(newVar(blended, typeInfo));
+    MPSL_PROPAGATE(emitBlend(blended, prev, src, typeInfo));
+    src = blended;
+  }
+
+  MPSL_PROPAGATE(toLaneType(typeInfo));
   uint32_t width = TypeInfo::widthOf(typeInfo);
 
   if (needSplit(width)) {
@@ -651,6 +950,7 @@ Error CodeGen::emitInst2(uint32_t instCode,
   IRPair<IRObject> o0,
   IRPair<IRObject> o1, uint32_t typeInfo) noexcept {
 
+  MPSL_PROPAGATE(toLaneType(typeInfo));
   uint32_t width = TypeInfo::widthOf(typeInfo);
 
   if (needSplit(width)) {
@@ -671,6 +971,7 @@ Error CodeGen::emitInst3(uint32_t instCode,
   IRPair<IRObject> o1,
   IRPair<IRObject> o2, uint32_t typeInfo) noexcept {
 
+  MPSL_PROPAGATE(toLaneType(typeInfo));
   uint32_t width = TypeInfo::widthOf(typeInfo);
 
   if (needSplit(width)) {
@@ -773,6 +1074,353 @@ Error CodeGen::emitStoreX(IRMem* dst, IRReg* src, uint32_t typeInfo) noexcept {
   return kErrorOk;
 }
 
+// ============================================================================
+// [mpsl::CodeGen - Control Flow]
+// ============================================================================
+
+Error CodeGen::newBlock(IRBlock*& out) noexcept {
+  out = ir()->newBlock();
+  MPSL_NULLCHECK(out);
+  return kErrorOk;
+}
+
+Error CodeGen::newUnreachableBlock() noexcept {
+  // Code that follows `break`, `continue`, and `return` is generated into a
+  // block that is never connected, `IRToX86` doesn't compile it.
+  return newBlock(_block);
+}
+
+Error CodeGen::endFunction() noexcept {
+  if (!_retBlock)
+    return kErrorOk;
+
+  MPSL_PROPAGATE(emitJump(_retBlock));
+  _block = _retBlock;
+  return kErrorOk;
+}
+
+Error CodeGen::emitJump(IRBlock* target) noexcept {
+  IRBlock* block = _block;
+  if (!isReachable(block))
+    return kErrorOk;
+
+  MPSL_PROPAGATE(ir()->emitInst(block, kInstCodeJmp, target));
+  return ir()->connectBlocks(block, target);
+}
+
+Error CodeGen::emitBranch(AstNode* condition, IRBlock* thenBlock, IRBlock* elseBlock) noexcept {
+  // A jump can only test a single condition.
+  uint32_t typeInfo = condition->typeInfo();
+  if ((typeInfo & kTypeVecMask) >= kTypeVec2)
+    return MPSL_TRACE_ERROR(kErrorInvalidProgram);
+
+  Result cond(true);
+  MPSL_PROPAGATE(onNode(condition, cond));
+
+  IRBlock* block = _block;
+  if (!isReachable(block))
+    return kErrorOk;
+
+  IRPair<IRReg> var;
+  MPSL_PROPAGATE(asVar(var, cond.result, typeInfo));
+  MPSL_PROPAGATE(ir()->emitInst(block, kInstCodeJnz, var.lo, thenBlock, elseBlock));
+
+  MPSL_PROPAGATE(ir()->connectBlocks(block, thenBlock));
+  return ir()->connectBlocks(block, elseBlock);
+}
+
+// ============================================================================
+// [mpsl::CodeGen - Predication]
+// ============================================================================
+
+// A predicated branch is lowered into these blocks:
+//
+//   [cond]  - Emitted into the current block, calculates the masks of both
+//             bodies and jumps to `then` if any of its lanes is selected.
+//   then    - The `then` body, predicated by the `then` mask.
+//   test    - Jumps to `else` if any of the lanes of the `else` mask is set.
+//   else    - The `else` body, predicated by the `else` mask.
+//   join    - Code that follows the branch.
+//
+// Both bodies are executed when the lanes diverge. The masks are combined with
+// the mask of the enclosing scope, so nested branches only execute lanes that
+// were selected by all of them.
+Error CodeGen::onPredicatedBranch(AstBranch* node) noexcept {
+  AstNode* condition = node->condition();
+  uint32_t condTypeInfo = condition->typeInfo() & (kTypeIdMask | kTypeVecMask);
+  uint32_t maskTypeInfo = condTypeInfo;
+
+  Result cond(true);
+  MPSL_PROPAGATE(onNode(condition, cond));
+
+  if (!isReachable(block()))
+    return kErrorOk;
+
+  IRPair<IRReg> c;
+  MPSL_PROPAGATE(asVar(c, cond.result, condTypeInfo));
+
+  if (isSPMD()) {
+    // SPMD masks have 32-bit lanes. The `__qbool` condition has LO and HI
+    // halves of 64-bit lanes that are packed into a single register.
+    maskTypeInfo = kTypeBool;
+
+    if ((condTypeInfo & kTypeIdMask) == kTypeQBool) {
+      IRPair<IRReg> packed;
+      MPSL_PROPAGATE(newVar(packed, maskTypeInfo));
+      MPSL_PROPAGATE(ir()->emitInst(block(), kInstCodePackssdw | kInstVec128, packed.lo, c.lo, c.hi));
+      c = packed;
+    }
+  }
+  else if (_maskScope && !TypeInfo::isSameLaneShape(_maskScope->typeInfo, maskTypeInfo)) {
+    // Rejected by `AstAnalysis::onBranch()`.
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+  }
+
+  IRPair<IRReg> thenMask;
+  IRPair<IRReg> elseMask;
+
+  MPSL_PROPAGATE(newVar(thenMask, maskTypeInfo));
+  if (_maskScope)
+    MPSL_PROPAGATE(emitInst3(kInstCodeAndi, thenMask, c, _maskScope->mask, maskTypeInfo));
+  else
+    MPSL_PROPAGATE(emitMove(thenMask, c, maskTypeInfo));
+
+  // The `else` mask is calculated before the `then` body, which can change
+  // the condition.
+  if (node->elseBody()) {
+    IRPair<IRReg> ones;
+    MPSL_PROPAGATE(newOnesMask(ones, maskTypeInfo));
+    MPSL_PROPAGATE(newVar(elseMask, maskTypeInfo));
+    MPSL_PROPAGATE(emitInst3(kInstCodeXori, elseMask, c, ones, maskTypeInfo));
+
+    if (_maskScope)
+      MPSL_PROPAGATE(emitInst3(kInstCodeAndi, elseMask, elseMask, _maskScope->mask, maskTypeInfo));
+  }
+
+  IRBlock* thenBlock;
+  IRBlock* testBlock = nullptr;
+  IRBlock* elseBlock = nullptr;
+  IRBlock* joinBlock;
+
+  MPSL_PROPAGATE(newBlock(thenBlock));
+  if (node->elseBody()) {
+    MPSL_PROPAGATE(newBlock(testBlock));
+    MPSL_PROPAGATE(newBlock(elseBlock));
+  }
+  MPSL_PROPAGATE(newBlock(joinBlock));
+
+  IRBlock* afterThen = testBlock ? testBlock : joinBlock;
+  uint32_t prevReturns = _maskedReturns;
+
+  // Skip the `then` body if none of its lanes is selected.
+  MPSL_PROPAGATE(emitAnyJump(thenMask, thenBlock, afterThen));
+
+  MaskScope thenScope(_maskScope, thenMask, maskTypeInfo, ir()->lastVarId(), false);
+  _block = thenBlock;
+  _maskScope = &thenScope;
+
+  Result noResult(false);
+  Error err = node->thenBody() ? onNode(node->thenBody(), noResult) : static_cast<Error>(kErrorOk);
+
+  _maskScope = thenScope.prev;
+  MPSL_PROPAGATE(err);
+  MPSL_PROPAGATE(emitJump(afterThen));
+
+  if (elseBlock) {
+    _block = testBlock;
+    MPSL_PROPAGATE(emitAnyJump(elseMask, elseBlock, joinBlock));
+
+    MaskScope elseScope(_maskScope, elseMask, maskTypeInfo, ir()->lastVarId(), false);
+    _block = elseBlock;
+    _maskScope = &elseScope;
+
+    err = onNode(node->elseBody(), noResult);
+
+    _maskScope = elseScope.prev;
+    MPSL_PROPAGATE(err);
+    MPSL_PROPAGATE(emitJump(joinBlock));
+  }
+
+  _block = joinBlock;
+
+  // Leave the function if all of its lanes have returned.
+  if (_maskedReturns != prevReturns) {
+    MaskScope* scope = _maskScope;
+    while (!scope->isFunction)
+      scope = scope->prev;
+
+    IRBlock* nextBlock;
+    MPSL_PROPAGATE(newBlock(nextBlock));
+
+    if (!_retBlock)
+      MPSL_PROPAGATE(newBlock(_retBlock));
+
+    MPSL_PROPAGATE(emitAnyJump(scope->mask, nextBlock, _retBlock));
+    _block = nextBlock;
+  }
+
+  return kErrorOk;
+}
+
+// Lanes that return are removed from the masks of all scopes of the current
+// function, code that follows is only executed by the remaining lanes.
+Error CodeGen::onPredicatedReturn() noexcept {
+  uint32_t maskTypeInfo = _maskScope->typeInfo;
+
+  IRPair<IRReg> ones;
+  IRPair<IRReg> remaining;
+
+  MPSL_PROPAGATE(newOnesMask(ones, maskTypeInfo));
+  MPSL_PROPAGATE(newVar(remaining, maskTypeInfo));
+  MPSL_PROPAGATE(emitInst3(kInstCodeXori, remaining, _maskScope->mask, ones, maskTypeInfo));
+
+  for (MaskScope* scope = _maskScope; ; scope = scope->prev) {
+    MPSL_PROPAGATE(emitInst3(kInstCodeAndi, scope->mask, scope->mask, remaining, maskTypeInfo));
+    if (scope->isFunction)
+      break;
+  }
+
+  _maskedReturns++;
+  return kErrorOk;
+}
+
+// Functions always enter a new scope if they are called by a predicated code,
+// so a `return` only leaves the function it belongs to. A SPMD function that
+// returns from a branch has its own mask of lanes that haven't returned yet.
+Error CodeGen::enterFunction(AstFunction* func, MaskScope& scope) noexcept {
+  if (!isSPMD() || !mpHasReturnInBranch(func->body(), false)) {
+    if (_maskScope) {
+      scope = MaskScope(_maskScope, _maskScope->mask, _maskScope->typeInfo, ir()->lastVarId(), true);
+      _maskScope = &scope;
+    }
+    return kErrorOk;
+  }
+
+  // Returned lanes are blended into `_currentRet`, it must exist before any
+  // lane returns.
+  if (_functionLevel != 0 && func->ret()) {
+    uint32_t retTypeInfo = func->ret()->typeInfo();
+
+    Value zero;
+    zero.q.set(0);
+
+    IRPair<IRObject> imm;
+    MPSL_PROPAGATE(newImm(imm, zero, retTypeInfo));
+    MPSL_PROPAGATE(asVar(_currentRet, imm, retTypeInfo));
+  }
+
+  IRPair<IRReg> mask;
+  if (_maskScope) {
+    MPSL_PROPAGATE(newVar(mask, kTypeBool));
+    MPSL_PROPAGATE(emitMove(mask, _maskScope->mask, kTypeBool));
+  }
+  else {
+    MPSL_PROPAGATE(newOnesMask(mask, kTypeBool));
+  }
+
+  scope = MaskScope(_maskScope, mask, kTypeBool, ir()->lastVarId(), true);
+  _maskScope = &scope;
+  return kErrorOk;
+}
+
+void CodeGen::leaveFunction(MaskScope& scope) noexcept {
+  if (_maskScope == &scope)
+    _maskScope = scope.prev;
+}
+
+Error CodeGen::newOnesMask(IRPair<IRReg>& dst, uint32_t typeInfo) noexcept {
+  Value ones;
+  ones.q.set(~static_cast<uint64_t>(0));
+
+  IRPair<IRObject> imm;
+  MPSL_PROPAGATE(newImm(imm, ones, typeInfo));
+  return asVar(dst, imm, typeInfo);
+}
+
+Error CodeGen::maskOf(IRPair<IRReg>& dst, uint32_t typeInfo) noexcept {
+  const MaskScope* scope = _maskScope;
+
+  if (isSPMD()) {
+    if (TypeInfo::sizeOf(typeInfo & kTypeIdMask) == 4)
+      return dst.set(scope->mask);
+
+    // 64-bit lanes are split into LO and HI parts, each of them is selected by
+    // two lanes of the mask that are duplicated by `pshufd`.
+    Value loValue, hiValue;
+    loValue.q.set(0);
+    hiValue.q.set(0);
+    loValue.i[0] = 0x50;
+    hiValue.i[0] = 0xFA;
+
+    IRImm* loImm = ir()->newImm(loValue, IRReg::kKindNone, 4);
+    MPSL_NULLCHECK(loImm);
+    IRImm* hiImm = ir()->newImm(hiValue, IRReg::kKindNone, 4);
+    MPSL_NULLCHECK(hiImm);
+
+    MPSL_PROPAGATE(newVar(dst, kTypeQBool));
+    MPSL_PROPAGATE(ir()->emitInst(block(), kInstCodePshufd | kInstVec128, dst.lo, scope->mask.lo, loImm));
+    MPSL_PROPAGATE(ir()->emitInst(block(), kInstCodePshufd | kInstVec128, dst.hi, scope->mask.lo, hiImm));
+    return kErrorOk;
+  }
+
+  // A vector mask can only select lanes of a vector of the same shape, other
+  // assignments are rejected by `AstAnalysis::checkAssignment()`.
+  if (!TypeInfo::isSameLaneShape(scope->typeInfo, typeInfo))
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  return dst.set(scope->mask);
+}
+
+Error CodeGen::emitAnyJump(IRPair<IRReg> mask, IRBlock* thenBlock, IRBlock* elseBlock) noexcept {
+  IRBlock* block = _block;
+  if (!isReachable(block))
+    return kErrorOk;
+
+  // Both parts of a split mask are tested.
+  if (mask.hi) {
+    IRBlock* hiBlock;
+    MPSL_PROPAGATE(newBlock(hiBlock));
+
+    MPSL_PROPAGATE(ir()->emitInst(block, kInstCodeJany, mask.lo, thenBlock, hiBlock));
+    MPSL_PROPAGATE(ir()->connectBlocks(block, thenBlock));
+    MPSL_PROPAGATE(ir()->connectBlocks(block, hiBlock));
+
+    block = hiBlock;
+  }
+
+  IRReg* last = mask.hi ? mask.hi : mask.lo;
+  MPSL_PROPAGATE(ir()->emitInst(block, kInstCodeJany, last, thenBlock, elseBlock));
+  MPSL_PROPAGATE(ir()->connectBlocks(block, thenBlock));
+  return ir()->connectBlocks(block, elseBlock);
+}
+
+Error CodeGen::emitAssign(IRPair<IRReg> dst, IRPair<IRReg> src, uint32_t typeInfo) noexcept {
+  if (isMasked(dst))
+    return emitBlend(dst, dst, src, typeInfo);
+  else
+    return emitMove(dst, src, typeInfo);
+}
+
+Error CodeGen::emitBlend(IRPair<IRReg> dst, IRPair<IRReg> a, IRPair<IRReg> b, uint32_t typeInfo) noexcept {
+  IRPair<IRReg> mask;
+  MPSL_PROPAGATE(maskOf(mask, typeInfo));
+
+  MPSL_PROPAGATE(toLaneType(typeInfo));
+  uint32_t width = TypeInfo::widthOf(typeInfo);
+
+  if (needSplit(width)) {
+    uint32_t loTI, hiTI;
+    mpSplitTypeInfo(loTI, hiTI, typeInfo);
+
+    MPSL_PROPAGATE(ir()->emitInst(block(), kInstCodeBlend | mpGetVecFlags(loTI), dst.lo, a.lo, b.lo, mask.lo));
+    MPSL_PROPAGATE(ir()->emitInst(block(), kInstCodeBlend | mpGetVecFlags(hiTI), dst.hi, a.hi, b.hi, mask.hi));
+    return kErrorOk;
+  }
+  else {
+    return ir()->emitInst(block(), kInstCodeBlend | mpGetVecFlags(typeInfo), dst.lo, a.lo, b.lo, mask.lo);
+  }
+}
+
 } // mpsl namespace
 
 // [Api-End]
@@ -56,6 +56,40 @@ public:
     int32_t offset;
   };
 
+  //! Blocks targeted by `break` and `continue` of a loop, linked to the loop
+  //! that encloses it.
+  struct LoopTarget {
+    MPSL_INLINE LoopTarget(LoopTarget* prev, IRBlock* breakBlock, IRBlock* continueBlock) noexcept
+      : prev(prev),
+        breakBlock(breakBlock),
+        continueBlock(continueBlock) {}
+
+    LoopTarget* prev;
+    IRBlock* breakBlock;
+    IRBlock* continueBlock;
+  };
+
+  //! Lanes executed by a predicated branch (or by the whole function if it
+  //! has predicated returns), linked to the enclosing scope.
+  //!
+  //! Registers created after the scope has been entered (their id is greater
+  //! than `varId`) don't outlive it and are assigned as is. Other registers
+  //! and data are blended, so only the executed lanes are changed.
+  struct MaskScope {
+    MPSL_INLINE MaskScope(MaskScope* prev, IRPair<IRReg> mask, uint32_t typeInfo, uint32_t varId, bool isFunction) noexcept
+      : prev(prev),
+        mask(mask),
+        typeInfo(typeInfo),
+        varId(varId),
+        isFunction(isFunction) {}
+
+    MaskScope* prev;
+    IRPair<IRReg> mask;
+    uint32_t typeInfo;
+    uint32_t varId;
+    bool isFunction;
+  };
+
   // --------------------------------------------------------------------------
   // [Construction / Destruction]
   // --------------------------------------------------------------------------
@@ -92,19 +126,77 @@ public:
   MPSL_INLINE ZoneAllocator* allocator() const noexcept { return _ir->allocator(); }
 
   MPSL_INLINE bool hasV256() const noexcept { return _hasV256; }
-  MPSL_INLINE bool needSplit(uint32_t width) const { return width > 16 && !_hasV256; }
+  MPSL_INLINE bool isSPMD() const noexcept { return _ir->isSPMD(); }
+
+  //! Get whether a value of `width` bytes is split into LO/HI 128-bit parts.
+  //!
+  //! Only full 256-bit values (not `double3`) use a single register. SPMD
+  //! programs always use 128-bit gangs as uniforms are broadcasted by `pshufd`,
+  //! so 64-bit lanes are always split into two parts.
+  MPSL_INLINE bool needSplit(uint32_t width) const {
+    return width > 16 && (width != 32 || !_hasV256 || isSPMD());
+  }
+
+  //! Get whether `block` can be reached from the entry block.
+  //!
+  //! Blocks are connected when a jump is emitted into them, so a block that
+  //! has no predecessors at the time code is generated into it is dead (it
+  //! follows `break`, `continue`, or `return`).
+  MPSL_INLINE bool isReachable(IRBlock* block) const noexcept {
+    return block == _ir->entryBlock() || block->hasPredecessors();
+  }
+
+  //! Get whether `node` is lowered to predicated code instead of a jump.
+  MPSL_INLINE bool isPredicated(AstBranch* node) const noexcept {
+    return isSPMD() || (node->condition()->typeInfo() & kTypeVecMask) >= kTypeVec2;
+  }
+
+  //! Get whether an assignment to `var` has to be blended by the current mask.
+  MPSL_INLINE bool isMasked(IRPair<IRReg> var) const noexcept {
+    return _maskScope && var.lo->id() <= _maskScope->varId;
+  }
 
   // --------------------------------------------------------------------------
   // [Utilities]
   // --------------------------------------------------------------------------
 
   Error mapVarToAst(AstSymbol* sym, IRPair<IRReg> var) noexcept;
+  Error toLaneType(uint32_t& typeInfo) noexcept;
 
   Error newVar(IRPair<IRObject>& dst, uint32_t typeInfo) noexcept;
   Error newImm(IRPair<IRObject>& dst, const Value& value, uint32_t typeInfo) noexcept;
   Error addrOfData(IRPair<IRObject>& dst, DataSlot data, uint32_t width) noexcept;
 
   Error asVar(IRPair<IRObject>& out, IRPair<IRObject> in, uint32_t typeInfo) noexcept;
+  Error copyVar(IRPair<IRObject>& out, IRPair<IRObject> in, AstNode* node, uint32_t typeInfo) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Control Flow]
+  // --------------------------------------------------------------------------
+
+  Error newBlock(IRBlock*& out) noexcept;
+  Error newUnreachableBlock() noexcept;
+  Error endFunction() noexcept;
+
+  Error emitJump(IRBlock* target) noexcept;
+  Error emitBranch(AstNode* condition, IRBlock* thenBlock, IRBlock* elseBlock) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Predication]
+  // --------------------------------------------------------------------------
+
+  Error onPredicatedBranch(AstBranch* node) noexcept;
+  Error onPredicatedReturn() noexcept;
+
+  Error enterFunction(AstFunction* func, MaskScope& scope) noexcept;
+  void leaveFunction(MaskScope& scope) noexcept;
+
+  Error newOnesMask(IRPair<IRReg>& dst, uint32_t typeInfo) noexcept;
+  Error maskOf(IRPair<IRReg>& dst, uint32_t typeInfo) noexcept;
+
+  Error emitAnyJump(IRPair<IRReg> mask, IRBlock* thenBlock, IRBlock* elseBlock) noexcept;
+  Error emitAssign(IRPair<IRReg> dst, IRPair<IRReg> src, uint32_t typeInfo) noexcept;
+  Error emitBlend(IRPair<IRReg> dst, IRPair<IRReg> a, IRPair<IRReg> b, uint32_t typeInfo) noexcept;
 
   Error emitMove(IRPair<IRReg> dst, IRPair<IRReg> src, uint32_t typeInfo) noexcept;
   Error emitStore(IRPair<IRObject> dst, IRPair<IRReg> src, uint32_t typeInfo) noexcept;
@@ -133,6 +225,10 @@ public:
 
   AstSymbol* _hiddenRet;                 //!< A hidden return variable internally named `@ret`.
   IRPair<IRObject> _currentRet;          //!< Current return, required by \ref onReturn().
+  IRBlock* _retBlock;                    //!< Block that follows the current function, created by `return`.
+  LoopTarget* _loopTarget;               //!< Innermost loop, required by `break` and `continue`.
+  MaskScope* _maskScope;                 //!< Innermost predicated scope, null if all lanes are executed.
+  uint32_t _maskedReturns;               //!< Count of predicated returns, see \ref onPredicatedReturn().
 
   FunctionSet _nestedFunctions;          //!< Hash of all nested functions.
   VarMap _varMap;                        //!< Mapping of `AstVar` to `IRPair<IRReg>`.
@@ -0,0 +1,595 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define MPSL_EXPORTS
+
+// [Dependencies - MPSL]
+#include "./mpatomic_p.h"
+#include "./mpcompilequeue_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// Declared in public "mpsl.h" header.
+MPSL_INLINE void CompileTask::Impl::destroy() noexcept {
+  CompileJob* job = static_cast<CompileJob*>(this);
+
+  job->~CompileJob();
+  ::free(job);
+}
+
+// ============================================================================
+// [mpsl::CompileJob - Construction / Destruction]
+// ============================================================================
+
+CompileJob::CompileJob(AstBuiltIns* builtIns, uint32_t options, uint32_t numArgs, uint32_t priority) noexcept
+  : next(nullptr),
+    state(kStateQueued),
+    error(kErrorOk),
+    builtIns(mpObjectAddRef(builtIns)),
+    options(options),
+    priority(priority),
+    body(nullptr),
+    bodySize(0) {
+  _refCount = 1;
+  _numArgs = numArgs;
+}
+
+CompileJob::~CompileJob() noexcept {
+  mpObjectRelease(builtIns);
+  ::free(body);
+}
+
+Error CompileJob::create(CompileJob** out, AstBuiltIns* builtIns, const Context::CompileArgs& ca, uint32_t priority) noexcept {
+  const char* src = ca.body.data();
+  size_t size = ca.body.size();
+
+  if (size == Globals::kInvalidIndex)
+    size = ::strlen(src);
+
+  void* p = ::malloc(sizeof(CompileJob));
+  MPSL_NULLCHECK(p);
+
+  CompileJob* job = new(p) CompileJob(builtIns, ca.options, ca.numArgs, priority);
+  Error err = kErrorOk;
+
+  job->body = static_cast<char*>(::malloc(size + 1));
+  if (job->body == nullptr) {
+    err = MPSL_TRACE_ERROR(kErrorNoMemory);
+  }
+  else {
+    ::memcpy(job->body, src, size);
+    job->body[size] = '\0';
+    job->bodySize = size;
+
+    for (uint32_t slot = 0; slot < ca.numArgs && err == kErrorOk; slot++)
+      err = mpLayoutCopy(&job->layouts[slot], ca.layout[slot]);
+  }
+
+  if (err) {
+    job->destroy();
+    return err;
+  }
+
+  *out = job;
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::CompileJob - Interface]
+// ============================================================================
+
+bool CompileJob::start() noexcept {
+  ScopedLock guard(lock);
+  if (state != kStateQueued)
+    return false;
+
+  state = kStateRunning;
+  return true;
+}
+
+Error CompileJob::wait() noexcept {
+  ScopedLock guard(lock);
+  while (state != kStateDone)
+    doneCond.wait(lock);
+  return error;
+}
+
+void CompileJob::finish(Error err, Program& result) noexcept {
+  ScopedLock guard(lock);
+  if (state == kStateDone)
+    return;
+
+  // Swap, the old (null) program is released with `result`.
+  Program::Impl* programD = program._d;
+  program._d = result._d;
+  result._d = programD;
+
+  state = kStateDone;
+  error = err;
+  doneCond.broadcast();
+}
+
+void CompileJob::cancel() noexcept {
+  ScopedLock guard(lock);
+  if (state == kStateDone)
+    return;
+
+  state = kStateDone;
+  error = kErrorCanceled;
+  doneCond.broadcast();
+}
+
+// ============================================================================
+// [mpsl::CompileQueue - Construction / Destruction]
+// ============================================================================
+
+CompileQueue::CompileQueue(Context::Impl* context, CompileQueueLink* link) noexcept
+  : _context(context),
+    _link(link),
+    _queuedCount(0),
+    _workers(nullptr),
+    _numThreads(0),
+    _numIdle(0),
+    _maxThreads(kDefaultMaxThreads),
+    _tierThreshold(kDefaultTierThreshold),
+    _stopping(false) {
+
+  for (uint32_t i = 0; i < CompileTask::kPriorityCount; i++) {
+    _first[i] = nullptr;
+    _last[i] = nullptr;
+  }
+}
+
+CompileQueue::~CompileQueue() noexcept {
+  stop();
+  mpObjectRelease(_link);
+}
+
+// ============================================================================
+// [mpsl::CompileQueue - Interface]
+// ============================================================================
+
+Error CompileQueue::submit(CompileJob* job) noexcept {
+  ScopedLock lock(_mutex);
+
+  if (_stopping)
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  // Start a new worker if all of them are busy, the job can't be queued if
+  // there is no worker at all.
+  if (_numIdle <= _queuedCount && _numThreads < _maxThreads) {
+    Error err = _startWorker();
+    if (err && _numThreads == 0)
+      return err;
+  }
+
+  uint32_t priority = job->priority;
+  job->next = nullptr;
+
+  if (_last[priority])
+    _last[priority]->next = job;
+  else
+    _first[priority] = job;
+
+  _last[priority] = mpObjectAddRef(job);
+  _queuedCount++;
+  _workCond.signal();
+
+  return kErrorOk;
+}
+
+void CompileQueue::stop() noexcept {
+  // Tiered programs can't queue jobs anymore.
+  {
+    ScopedLock lock(_link->lock);
+    _link->queue = nullptr;
+  }
+
+  CompileWorker* workers;
+  {
+    ScopedLock lock(_mutex);
+    _stopping = true;
+
+    CompileJob* job;
+    while ((job = _pop()) != nullptr) {
+      job->cancel();
+      job->target.reset();
+      mpObjectRelease(job);
+    }
+
+    workers = _workers;
+    _workers = nullptr;
+    _workCond.broadcast();
+  }
+
+  // Workers finish jobs they are compiling before they quit.
+  while (workers) {
+    CompileWorker* next = workers->next;
+
+    workers->thread.join();
+    workers->~CompileWorker();
+    ::free(workers);
+
+    workers = next;
+  }
+}
+
+uint32_t CompileQueue::maxThreads() noexcept {
+  ScopedLock lock(_mutex);
+  return _maxThreads;
+}
+
+void CompileQueue::setMaxThreads(uint32_t maxThreads) noexcept {
+  ScopedLock lock(_mutex);
+  _maxThreads = maxThreads;
+}
+
+uint32_t CompileQueue::tierThreshold() noexcept {
+  ScopedLock lock(_mutex);
+  return _tierThreshold;
+}
+
+void CompileQueue::setTierThreshold(uint32_t tierThreshold) noexcept {
+  ScopedLock lock(_mutex);
+  _tierThreshold = tierThreshold;
+}
+
+// ============================================================================
+// [mpsl::CompileQueue - Internal]
+// ============================================================================
+
+void CompileQueue::_workerMain(void* arg) noexcept {
+  CompileWorker* worker = static_cast<CompileWorker*>(arg);
+  CompileQueue* self = worker->queue;
+
+  ScopedLock lock(self->_mutex);
+  for (;;) {
+    CompileJob* job = nullptr;
+    while (!self->_stopping && (job = self->_pop()) == nullptr) {
+      self->_numIdle++;
+      self->_workCond.wait(self->_mutex);
+      self->_numIdle--;
+    }
+
+    if (self->_stopping)
+      break;
+
+    self->_mutex.unlock();
+    self->_run(job);
+    self->_mutex.lock();
+  }
+}
+
+// Called with `_mutex` locked.
+Error CompileQueue::_startWorker() noexcept {
+  void* p = ::malloc(sizeof(CompileWorker));
+  MPSL_NULLCHECK(p);
+
+  CompileWorker* worker = new(p) CompileWorker();
+  worker->queue = this;
+  worker->next = _workers;
+
+  Error err = worker->thread.start(_workerMain, worker);
+  if (err) {
+    worker->~CompileWorker();
+    ::free(worker);
+    return err;
+  }
+
+  _workers = worker;
+  _numThreads++;
+  return kErrorOk;
+}
+
+// Called with `_mutex` locked.
+CompileJob* CompileQueue::_pop() noexcept {
+  for (uint32_t i = 0; i < CompileTask::kPriorityCount; i++) {
+    CompileJob* job = _first[i];
+    if (job) {
+      _first[i] = job->next;
+      if (_first[i] == nullptr)
+        _last[i] = nullptr;
+
+      job->next = nullptr;
+      _queuedCount--;
+      return job;
+    }
+  }
+
+  return nullptr;
+}
+
+void CompileQueue::_run(CompileJob* job) noexcept {
+  // Canceled jobs stay queued until a worker takes them.
+  if (job->start()) {
+    Context::CompileArgs ca(job->body, job->bodySize, job->options, job->_numArgs);
+    for (uint32_t slot = 0; slot < job->_numArgs; slot++)
+      ca.layout[slot] = &job->layouts[slot];
+
+    // The optimized program of a tiered one reads the same uniforms.
+    ProgramUniforms* uniforms = job->target.isValid()
+      ? static_cast<ProgramUniforms*>(job->target._d->_uniformData)
+      : nullptr;
+
+    Program program;
+    Error err = mpContextCompile(_context, job->builtIns, program, ca, nullptr, uniforms);
+
+    // Tier-up jobs install the program before they are done, which releases
+    // the target as well, so a waiting thread sees the optimized program.
+    if (job->target.isValid()) {
+      if (err == kErrorOk)
+        ProgramTier::install(job->target._d, program);
+      job->target.reset();
+    }
+
+    job->finish(err, program);
+  }
+
+  mpObjectRelease(job);
+}
+
+// ============================================================================
+// [mpsl::ProgramTier - Construction / Destruction]
+// ============================================================================
+
+ProgramTier::ProgramTier(CompileQueueLink* link, CompileJob* job, uint32_t threshold) noexcept
+  : counter(static_cast<intptr_t>(threshold)),
+    requested(0),
+    optimized(0),
+    owner(nullptr),
+    baseline(nullptr),
+    link(mpObjectAddRef(link)),
+    job(job) {}
+
+ProgramTier::~ProgramTier() noexcept {
+  mpObjectRelease(job);
+  mpObjectRelease(link);
+}
+
+Error ProgramTier::create(ProgramTier** out, void* queueData, AstBuiltIns* builtIns, const Context::CompileArgs& ca) noexcept {
+  CompileQueue* queue = static_cast<CompileQueue*>(queueData);
+
+  CompileJob* job;
+  MPSL_PROPAGATE(CompileJob::create(&job, builtIns, ca, CompileTask::kPriorityBulk));
+
+  // The optimized program is compiled without a log and at the default
+  // optimization level.
+  job->options &= ~(kOptionTiered | kOptionOptLevelMask | kOptionVerbose | kOptionDebugAst | kOptionDebugIR | kOptionDebugASM);
+
+  void* p = ::malloc(sizeof(ProgramTier));
+  if (p == nullptr) {
+    job->destroy();
+    return MPSL_TRACE_ERROR(kErrorNoMemory);
+  }
+
+  *out = new(p) ProgramTier(queue->_link, job, queue->tierThreshold());
+  return kErrorOk;
+}
+
+void ProgramTier::destroy(RuntimeData* rt) noexcept {
+  if (baseline)
+    rt->release(baseline);
+
+  this->~ProgramTier();
+  ::free(this);
+}
+
+// ============================================================================
+// [mpsl::ProgramTier - Interface]
+// ============================================================================
+
+void MPSL_CDECL ProgramTier::onHot(void* self) noexcept {
+  ProgramTier* tier = static_cast<ProgramTier*>(self);
+
+  // Stop calling `onHot()`, the baseline code can still run for a while.
+  mpAtomicSet(reinterpret_cast<uintptr_t*>(&tier->counter), ~static_cast<uintptr_t>(0) >> 1);
+  tier->request();
+}
+
+Error ProgramTier::request() noexcept {
+  if (mpAtomicSetXchg(&requested, 1) != 0)
+    return kErrorOk;
+
+  Error err = kErrorCanceled;
+  {
+    ScopedLock lock(link->lock);
+    if (link->queue) {
+      // Keeps the owner alive until the job is done, the owner can't be
+      // destroyed now as the caller uses it.
+      job->target._d = mpObjectAddRef(owner);
+      err = link->queue->submit(job);
+
+      if (err)
+        job->target.reset();
+    }
+  }
+
+  if (err)
+    job->cancel();
+  return err;
+}
+
+void ProgramTier::install(Program::Impl* target, Program& program) noexcept {
+  ProgramTier* self = static_cast<ProgramTier*>(target->_tierData);
+
+  Program::Impl* programD = program._d;
+  program._d = self->optimizedProgram._d;
+  self->optimizedProgram._d = programD;
+
+  mpAtomicSetReleaseT<Program::Impl::BatchFunc>(&target->_batch, programD->_batch);
+  mpAtomicSetReleaseT<void*>(&target->_main, programD->_main);
+  mpAtomicSetRelease(&self->optimized, 1);
+}
+
+// ============================================================================
+// [mpsl::CompileTask - Construction / Destruction]
+// ============================================================================
+
+static const CompileTask::Impl mpCompileTaskNull = { 0, 0 };
+
+CompileTask::CompileTask() noexcept
+  : _d(const_cast<Impl*>(&mpCompileTaskNull)) {}
+
+CompileTask::CompileTask(const CompileTask& other) noexcept
+  : _d(mpObjectAddRef(other._d)) {}
+
+CompileTask::~CompileTask() noexcept {
+  mpObjectRelease(_d);
+}
+
+// ============================================================================
+// [mpsl::CompileTask - Reset]
+// ============================================================================
+
+Error CompileTask::reset() noexcept {
+  mpObjectRelease(mpAtomicSetXchgT<Impl*>(
+    &_d, const_cast<Impl*>(&mpCompileTaskNull)));
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::CompileTask - Accessors]
+// ============================================================================
+
+bool CompileTask::isDone() const noexcept {
+  if (!isValid())
+    return false;
+
+  CompileJob* job = static_cast<CompileJob*>(_d);
+  ScopedLock lock(job->lock);
+  return job->state == CompileJob::kStateDone;
+}
+
+// ============================================================================
+// [mpsl::CompileTask - Interface]
+// ============================================================================
+
+Error CompileTask::wait() noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  return static_cast<CompileJob*>(_d)->wait();
+}
+
+Error CompileTask::cancel() noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  static_cast<CompileJob*>(_d)->cancel();
+  return kErrorOk;
+}
+
+Error CompileTask::_get(Program& program, uint32_t numArgs) const noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  CompileJob* job = static_cast<CompileJob*>(_d);
+  Program compiled;
+  {
+    ScopedLock lock(job->lock);
+
+    if (job->state != CompileJob::kStateDone)
+      return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+    if (job->error != kErrorOk)
+      return job->error;
+
+    if (job->_numArgs != numArgs)
+      return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+    compiled._d = mpObjectAddRef(job->program._d);
+  }
+
+  // The old program is released by `compiled`.
+  compiled._d = mpAtomicSetXchgT<Program::Impl*>(&program._d, compiled._d);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::CompileTask - Operator Overload]
+// ============================================================================
+
+CompileTask& CompileTask::operator=(const CompileTask& other) noexcept {
+  mpObjectRelease(
+    mpAtomicSetXchgT<Impl*>(
+      &_d, mpObjectAddRef(other._d)));
+
+  return *this;
+}
+
+// ============================================================================
+// [mpsl::mpCompileQueue]
+// ============================================================================
+
+Error mpCompileQueueSubmit(void* queueData, CompileTask& task, AstBuiltIns* builtIns, const Context::CompileArgs& ca, uint32_t priority) noexcept {
+  CompileJob* job;
+  MPSL_PROPAGATE(CompileJob::create(&job, builtIns, ca, priority));
+
+  Error err = static_cast<CompileQueue*>(queueData)->submit(job);
+  if (err) {
+    job->destroy();
+    return err;
+  }
+
+  // The queue holds its own reference, this one is passed to `task`.
+  mpObjectRelease(
+    mpAtomicSetXchgT<CompileTask::Impl*>(
+      &task._d, job));
+
+  return kErrorOk;
+}
+
+uint32_t mpCompileQueueGetMaxThreads(void* queueData) noexcept {
+  return static_cast<CompileQueue*>(queueData)->maxThreads();
+}
+
+void mpCompileQueueSetMaxThreads(void* queueData, uint32_t maxThreads) noexcept {
+  static_cast<CompileQueue*>(queueData)->setMaxThreads(maxThreads);
+}
+
+uint32_t mpCompileQueueGetTierThreshold(void* queueData) noexcept {
+  return static_cast<CompileQueue*>(queueData)->tierThreshold();
+}
+
+void mpCompileQueueSetTierThreshold(void* queueData, uint32_t tierThreshold) noexcept {
+  static_cast<CompileQueue*>(queueData)->setTierThreshold(tierThreshold);
+}
+
+void* mpCompileQueueCreate(Context::Impl* context) noexcept {
+  void* p = ::malloc(sizeof(CompileQueue));
+  CompileQueueLink* link = static_cast<CompileQueueLink*>(::malloc(sizeof(CompileQueueLink)));
+
+  if (p == nullptr || link == nullptr) {
+    ::free(p);
+    ::free(link);
+    return nullptr;
+  }
+
+  new(link) CompileQueueLink();
+  link->_refCount = 1;
+
+  CompileQueue* queue = new(p) CompileQueue(context, link);
+  link->queue = queue;
+  return queue;
+}
+
+void mpCompileQueueDestroy(void* queueData) noexcept {
+  if (queueData) {
+    CompileQueue* queue = static_cast<CompileQueue*>(queueData);
+    queue->~CompileQueue();
+    ::free(queue);
+  }
+}
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
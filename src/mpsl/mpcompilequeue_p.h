@@ -0,0 +1,312 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _MPSL_MPCOMPILEQUEUE_P_H
+#define _MPSL_MPCOMPILEQUEUE_P_H
+
+// [Dependencies - MPSL]
+#include "./mpast_p.h"
+#include "./mpatomic_p.h"
+#include "./mpruntime_p.h"
+#include "./mpsl_p.h"
+#include "./mpthread_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::CompileJob]
+// ============================================================================
+
+//! \internal
+//!
+//! A program queued by `Context::compileAsync()`, it's also the `Impl` of
+//! `CompileTask`.
+//!
+//! The job owns copies of everything the compilation needs, so the caller
+//! can release the body and layouts right after queuing it. The job is
+//! referenced by all `CompileTask` handles and by the queue until a worker
+//! finishes it.
+struct CompileJob : public CompileTask::Impl {
+  MPSL_NONCOPYABLE(CompileJob)
+
+  //! Job state.
+  enum State {
+    kStateQueued = 0,                    //!< Waiting for a worker.
+    kStateRunning = 1,                   //!< Being compiled.
+    kStateDone = 2                       //!< Compiled, failed, or canceled.
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  CompileJob(AstBuiltIns* builtIns, uint32_t options, uint32_t numArgs, uint32_t priority) noexcept;
+  ~CompileJob() noexcept;
+
+  //! Create a job that compiles a copy of `ca` by using `builtIns`.
+  static Error create(CompileJob** out, AstBuiltIns* builtIns, const Context::CompileArgs& ca, uint32_t priority) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Mark a queued job as running, returns false if it was canceled.
+  bool start() noexcept;
+  //! Wait until the job is done and return its error.
+  Error wait() noexcept;
+  //! Make the job done with `error` and the compiled `program`, which is
+  //! discarded if the job was canceled in the meantime.
+  void finish(Error error, Program& program) noexcept;
+  //! Make the job done with `kErrorCanceled`, if it's not done already.
+  void cancel() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  CompileJob* next;                      //!< Next job of the same priority.
+
+  Mutex lock;                            //!< Guards `state`, `error`, and `program`.
+  ConditionVariable doneCond;            //!< Signaled when the job is done.
+
+  uint32_t state;                        //!< Job state, see \ref State.
+  Error error;                           //!< Result of the compilation.
+  Program program;                       //!< Compiled program.
+
+  AstBuiltIns* builtIns;                 //!< Built-in scope at the time the job was queued.
+  uint32_t options;                      //!< Program options.
+  uint32_t priority;                     //!< Priority, see \ref CompileTask::Priority.
+
+  char* body;                            //!< Copy of the body.
+  size_t bodySize;                       //!< Size of the body (in bytes).
+  Layout layouts[Globals::kMaxArgumentsCount];
+
+  //! Tiered program the result is installed to (tier-up jobs only), it's only
+  //! referenced while the job is queued or running.
+  Program target;
+};
+
+// ============================================================================
+// [mpsl::CompileQueue]
+// ============================================================================
+
+class CompileQueue;
+
+//! \internal
+struct CompileWorker {
+  CompileQueue* queue;                   //!< Queue the worker belongs to.
+  CompileWorker* next;                   //!< Next worker.
+  Thread thread;                         //!< Worker thread.
+};
+
+//! \internal
+//!
+//! Weak reference to a `CompileQueue`, which is cleared when the queue stops.
+struct CompileQueueLink {
+  MPSL_INLINE void destroy() noexcept {
+    this->~CompileQueueLink();
+    ::free(this);
+  }
+
+  uintptr_t _refCount;                   //!< Reference count.
+  Mutex lock;                            //!< Guards `queue`.
+  CompileQueue* queue;                   //!< Queue, null if stopped.
+};
+
+//! \internal
+//!
+//! Background compilation threads of a `Context`.
+//!
+//! Workers take jobs of the highest priority first. They don't keep the
+//! context alive, instead the queue is destroyed first when the context is,
+//! which cancels all queued jobs and waits for the ones being compiled.
+class CompileQueue {
+public:
+  MPSL_NONCOPYABLE(CompileQueue)
+
+  enum {
+    //! Default maximum number of workers.
+    kDefaultMaxThreads = 1,
+    //! Default count of records a tiered program processes before tier-up.
+    kDefaultTierThreshold = 10000
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  CompileQueue(Context::Impl* context, CompileQueueLink* link) noexcept;
+  ~CompileQueue() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Queue `job`, the queue adds its own reference to it.
+  Error submit(CompileJob* job) noexcept;
+  //! Cancel all queued jobs and join all workers.
+  void stop() noexcept;
+
+  uint32_t maxThreads() noexcept;
+  void setMaxThreads(uint32_t maxThreads) noexcept;
+
+  uint32_t tierThreshold() noexcept;
+  void setTierThreshold(uint32_t tierThreshold) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  static void _workerMain(void* arg) noexcept;
+
+  Error _startWorker() noexcept;
+  CompileJob* _pop() noexcept;
+  void _run(CompileJob* job) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  Context::Impl* _context;               //!< Context that owns the queue.
+  CompileQueueLink* _link;               //!< Weak reference used by tiered programs.
+
+  Mutex _mutex;                          //!< Guards everything below.
+  ConditionVariable _workCond;           //!< Signaled when a job is queued.
+
+  CompileJob* _first[CompileTask::kPriorityCount];
+  CompileJob* _last[CompileTask::kPriorityCount];
+  size_t _queuedCount;                   //!< Count of queued jobs.
+
+  CompileWorker* _workers;               //!< Workers (linked by `next`).
+  uint32_t _numThreads;                  //!< Count of workers.
+  uint32_t _numIdle;                     //!< Count of workers waiting for a job.
+  uint32_t _maxThreads;                  //!< Maximum count of workers.
+  uint32_t _tierThreshold;               //!< Tier-up threshold of new tiered programs.
+  bool _stopping;                        //!< Workers should quit.
+};
+
+// ============================================================================
+// [mpsl::ProgramTier]
+// ============================================================================
+
+//! \internal
+//!
+//! Tiering data of a program compiled with `kOptionTiered`.
+//!
+//! The baseline code decrements `counter` by the count of records it processes
+//! and calls `onHot()` when it gets negative, which queues `job` to recompile
+//! the program. The optimized program is installed by replacing the entry
+//! points of the owning `Program::Impl`, the baseline code is kept until the
+//! program is destroyed as other threads can still run it.
+struct ProgramTier {
+  MPSL_NONCOPYABLE(ProgramTier)
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ProgramTier(CompileQueueLink* link, CompileJob* job, uint32_t threshold) noexcept;
+  ~ProgramTier() noexcept;
+
+  //! Create a tier that recompiles a copy of `ca` by using the queue of the
+  //! context and `builtIns`.
+  static Error create(ProgramTier** out, void* queueData, AstBuiltIns* builtIns, const Context::CompileArgs& ca) noexcept;
+  //! Destroy the tier and release the baseline code to `rt`.
+  void destroy(RuntimeData* rt) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Get whether the optimized program has been installed.
+  MPSL_INLINE bool isOptimized() const noexcept { return mpAtomicGetAcquire(&optimized) != 0; }
+
+  //! Called by the baseline code when `counter` gets negative.
+  static void MPSL_CDECL onHot(void* self) noexcept;
+
+  //! Queue the recompilation, only the first call has an effect.
+  Error request() noexcept;
+  //! Install the `program` compiled by `job` to `target`.
+  static void install(Program::Impl* target, Program& program) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  intptr_t counter;                      //!< Records left, decremented by the baseline code.
+  uintptr_t requested;                   //!< Non-zero if `request()` was called.
+  uintptr_t optimized;                   //!< Non-zero if the optimized program is installed.
+
+  Program::Impl* owner;                  //!< Program that owns the tier (not referenced).
+  void* baseline;                        //!< Baseline code-block.
+
+  CompileQueueLink* link;                //!< Link to the queue of the context.
+  CompileJob* job;                       //!< Recompilation job.
+  Program optimizedProgram;              //!< Optimized program.
+};
+
+//! \internal
+//!
+//! Destroys a tier that wasn't attached to a program when going out of scope.
+class ProgramTierScope {
+public:
+  MPSL_NONCOPYABLE(ProgramTierScope)
+
+  MPSL_INLINE ProgramTierScope(ProgramTier* tier, RuntimeData* rt) noexcept
+    : _tier(tier),
+      _rt(rt) {}
+  MPSL_INLINE ~ProgramTierScope() noexcept {
+    if (_tier) _tier->destroy(_rt);
+  }
+
+  //! Release the tier, it's owned by a program now.
+  MPSL_INLINE void release() noexcept { _tier = nullptr; }
+
+  ProgramTier* _tier;
+  RuntimeData* _rt;
+};
+
+// ============================================================================
+// [mpsl::mpCompileQueue]
+// ============================================================================
+
+//! \internal
+//!
+//! Create a compile queue of `context` stored as `void*` (used by `Context`).
+void* mpCompileQueueCreate(Context::Impl* context) noexcept;
+
+//! \internal
+//!
+//! Destroy a compile queue stored as `void*` (used by `Context`).
+void mpCompileQueueDestroy(void* queueData) noexcept;
+
+//! \internal
+//!
+//! Queue a copy of `ca` to be compiled by using `builtIns` and replace `task`
+//! by a task of it.
+Error mpCompileQueueSubmit(void* queueData, CompileTask& task, AstBuiltIns* builtIns, const Context::CompileArgs& ca, uint32_t priority) noexcept;
+
+//! \internal
+uint32_t mpCompileQueueGetMaxThreads(void* queueData) noexcept;
+//! \internal
+void mpCompileQueueSetMaxThreads(void* queueData, uint32_t maxThreads) noexcept;
+
+//! \internal
+uint32_t mpCompileQueueGetTierThreshold(void* queueData) noexcept;
+//! \internal
+void mpCompileQueueSetTierThreshold(void* queueData, uint32_t tierThreshold) noexcept;
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
+
+// [Guard]
+#endif // _MPSL_MPCOMPILEQUEUE_P_H
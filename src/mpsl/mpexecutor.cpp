@@ -0,0 +1,466 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define MPSL_EXPORTS
+
+// [Dependencies - MPSL]
+#include "./mpatomic_p.h"
+#include "./mpexecutor_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+//! \internal
+//!
+//! Number of bytes (of all arguments) a single chunk should touch when the
+//! grain size is automatic - a chunk should stay in L2 cache of one core.
+static const size_t kExecutorChunkBytes = 256 * 1024;
+
+//! \internal
+//!
+//! Grain size used when records don't advance (strides are all zero).
+static const size_t kExecutorDefaultGrain = 4096;
+
+static MPSL_INLINE size_t mpExecutorAlignToLanes(size_t n) noexcept {
+  return n & ~static_cast<size_t>(Globals::kSPMDLanes - 1);
+}
+
+// ============================================================================
+// [mpsl::ExecutorPool - Construction / Destruction]
+// ============================================================================
+
+ExecutorPool::ExecutorPool(uint32_t numThreads, uint32_t flags) noexcept
+  : _first(nullptr),
+    _last(nullptr),
+    _pendingJobs(0),
+    _error(kErrorOk),
+    _stopping(false),
+    _numThreads(numThreads),
+    _flags(flags),
+    _workers(nullptr) {}
+
+ExecutorPool::~ExecutorPool() noexcept {
+  stop();
+}
+
+// ============================================================================
+// [mpsl::ExecutorPool - Interface]
+// ============================================================================
+
+Error ExecutorPool::start() noexcept {
+  if (_numThreads == 0)
+    return kErrorOk;
+
+  _workers = static_cast<ExecutorWorker*>(::malloc(sizeof(ExecutorWorker) * _numThreads));
+  if (_workers == nullptr)
+    return MPSL_TRACE_ERROR(kErrorNoMemory);
+
+  for (uint32_t i = 0; i < _numThreads; i++) {
+    ExecutorWorker* worker = new(&_workers[i]) ExecutorWorker();
+    worker->pool = this;
+    worker->slot = i;
+  }
+
+  for (uint32_t i = 0; i < _numThreads; i++) {
+    Error err = _workers[i].thread.start(_workerMain, &_workers[i]);
+    if (err) {
+      stop();
+      return err;
+    }
+  }
+
+  return kErrorOk;
+}
+
+void ExecutorPool::stop() noexcept {
+  // Process everything that was submitted, workers quit only when idle.
+  wait();
+
+  if (_workers == nullptr)
+    return;
+
+  _mutex.lock();
+  _stopping = true;
+  _workCond.broadcast();
+  _mutex.unlock();
+
+  for (uint32_t i = 0; i < _numThreads; i++) {
+    _workers[i].thread.join();
+    _workers[i].~ExecutorWorker();
+  }
+
+  ::free(_workers);
+  _workers = nullptr;
+}
+
+Error ExecutorPool::submit(const Program& program, uint32_t numArgs, void* const* args, const intptr_t* strides, size_t count, size_t grainSize) noexcept {
+  uint32_t i;
+  uint32_t numSlots = this->numSlots();
+
+  if (count == 0)
+    return kErrorOk;
+
+  // Automatic grain size - process as many records as fit into the cache.
+  if (grainSize == 0) {
+    size_t recordSize = 0;
+    for (i = 0; i < numArgs; i++)
+      recordSize += static_cast<size_t>(strides[i] < 0 ? -strides[i] : strides[i]);
+
+    grainSize = recordSize ? kExecutorChunkBytes / recordSize : kExecutorDefaultGrain;
+  }
+
+  // Keep chunks aligned to lanes so SPMD programs only run partial gangs at
+  // the end of the batch.
+  grainSize = mpExecutorAlignToLanes(grainSize);
+  if (grainSize < Globals::kSPMDLanes)
+    grainSize = Globals::kSPMDLanes;
+
+  size_t jobSize = sizeof(ExecutorJob) + sizeof(ExecutorRange) * (numSlots - 1);
+  ExecutorJob* job = static_cast<ExecutorJob*>(::malloc(jobSize));
+
+  if (job == nullptr)
+    return MPSL_TRACE_ERROR(kErrorNoMemory);
+
+  new(job) ExecutorJob(program);
+  for (i = 1; i < numSlots; i++)
+    new(&job->ranges[i]) ExecutorRange();
+
+  job->grainSize = grainSize;
+
+  for (i = 0; i < Globals::kMaxArgumentsCount; i++) {
+    job->args[i] = i < numArgs ? args[i] : nullptr;
+    job->strides[i] = i < numArgs ? strides[i] : 0;
+  }
+
+  // Split records evenly, stealing balances the work if it's not even.
+  size_t perSlot = (count + numSlots - 1) / numSlots;
+  perSlot = mpExecutorAlignToLanes(perSlot + Globals::kSPMDLanes - 1);
+
+  size_t index = 0;
+  for (i = 0; i < numSlots; i++) {
+    size_t n = count - index < perSlot ? count - index : perSlot;
+    job->ranges[i].begin = index;
+    job->ranges[i].end = index + n;
+    index += n;
+  }
+
+  ScopedLock lock(_mutex);
+  if (_last)
+    _last->next = job;
+  else
+    _first = job;
+
+  _last = job;
+  _pendingJobs++;
+  _workCond.broadcast();
+
+  return kErrorOk;
+}
+
+Error ExecutorPool::wait() noexcept {
+  ScopedLock lock(_mutex);
+
+  // There is a single range for threads that wait, so only one of them joins
+  // a job, the others sleep until some job finishes.
+  while (_pendingJobs != 0) {
+    ExecutorJob* job = _first;
+    if (job && !job->hasWaiter) {
+      job->hasWaiter = true;
+      _participate(job, _numThreads);
+    }
+    else {
+      _doneCond.wait(_mutex);
+    }
+  }
+
+  Error err = _error;
+  _error = kErrorOk;
+  return err;
+}
+
+// ============================================================================
+// [mpsl::ExecutorPool - Internal]
+// ============================================================================
+
+void ExecutorPool::_workerMain(void* arg) noexcept {
+  ExecutorWorker* worker = static_cast<ExecutorWorker*>(arg);
+  ExecutorPool* pool = worker->pool;
+
+  if (pool->_flags & Executor::kFlagPinThreads)
+    Thread::pinCurrent(worker->slot % Thread::cpuCount());
+
+  ScopedLock lock(pool->_mutex);
+  for (;;) {
+    while (!pool->_stopping && !pool->_first)
+      pool->_workCond.wait(pool->_mutex);
+
+    if (pool->_stopping)
+      break;
+
+    pool->_participate(pool->_first, worker->slot);
+  }
+}
+
+// Called with `_mutex` locked, unlocks it while running the program.
+void ExecutorPool::_participate(ExecutorJob* job, uint32_t slot) noexcept {
+  job->numUsers++;
+  _mutex.unlock();
+
+  Program::Impl::BatchFunc batch = job->program._d->batchFunc();
+  size_t index, count;
+
+  while (_claim(job, slot, index, count)) {
+    Error err = batch(job->args, job->strides, index, count);
+    if (MPSL_UNLIKELY(err)) {
+      ScopedLock lock(_mutex);
+      if (job->error == kErrorOk)
+        job->error = err;
+    }
+  }
+
+  _mutex.lock();
+
+  // There is nothing more to claim, other participants may still be running
+  // their last chunks, but new participants should pick the next job.
+  if (_first == job) {
+    _first = job->next;
+    if (_first == nullptr)
+      _last = nullptr;
+  }
+
+  if (--job->numUsers == 0)
+    _finish(job);
+}
+
+bool ExecutorPool::_claim(ExecutorJob* job, uint32_t slot, size_t& index, size_t& count) noexcept {
+  uint32_t numSlots = this->numSlots();
+  size_t grainSize = job->grainSize;
+
+  ExecutorRange& own = job->ranges[slot];
+  {
+    ScopedLock lock(own.lock);
+    if (own.begin < own.end) {
+      index = own.begin;
+      count = own.end - own.begin < grainSize ? own.end - own.begin : grainSize;
+      own.begin += count;
+      return true;
+    }
+  }
+
+  // Steal - take the upper half of records of the first participant that
+  // has some, continue with the rest of them as with own records.
+  for (uint32_t i = 1; i < numSlots; i++) {
+    ExecutorRange& victim = job->ranges[(slot + i) % numSlots];
+    size_t begin, end, half;
+
+    {
+      ScopedLock lock(victim.lock);
+      size_t remaining = victim.end - victim.begin;
+
+      if (remaining == 0)
+        continue;
+
+      half = mpExecutorAlignToLanes(remaining / 2);
+      if (remaining <= grainSize || half == 0) {
+        index = victim.begin;
+        count = remaining < grainSize ? remaining : grainSize;
+        victim.begin += count;
+        return true;
+      }
+
+      begin = victim.end - half;
+      end = victim.end;
+      victim.end = begin;
+    }
+
+    index = begin;
+    count = half < grainSize ? half : grainSize;
+
+    ScopedLock lock(own.lock);
+    own.begin = begin + count;
+    own.end = end;
+    return true;
+  }
+
+  return false;
+}
+
+// Called with `_mutex` locked.
+void ExecutorPool::_finish(ExecutorJob* job) noexcept {
+  if (job->error != kErrorOk && _error == kErrorOk)
+    _error = job->error;
+
+  for (uint32_t i = 1, numSlots = this->numSlots(); i < numSlots; i++)
+    job->ranges[i].~ExecutorRange();
+
+  job->~ExecutorJob();
+  ::free(job);
+
+  _pendingJobs--;
+  _doneCond.broadcast();
+}
+
+// ============================================================================
+// [mpsl::Executor - Impl]
+// ============================================================================
+
+// Declared in public "mpsl.h" header.
+MPSL_INLINE void Executor::Impl::destroy() noexcept {
+  ExecutorPool* pool = static_cast<ExecutorPool*>(_poolData);
+
+  pool->~ExecutorPool();
+  ::free(pool);
+  ::free(this);
+}
+
+void* mpExecutorAddRef(void* executorData) noexcept {
+  if (executorData)
+    mpObjectAddRef(static_cast<Executor::Impl*>(executorData));
+  return executorData;
+}
+
+void mpExecutorRelease(void* executorData) noexcept {
+  if (executorData)
+    mpObjectRelease(static_cast<Executor::Impl*>(executorData));
+}
+
+//! \internal
+//!
+//! Guards executor slots of all contexts, it's only held to swap a pointer or
+//! to increment a reference count.
+static Mutex mpExecutorSlotLock;
+
+void* mpExecutorLoad(void* const* slot) noexcept {
+  ScopedLock lock(mpExecutorSlotLock);
+  return mpExecutorAddRef(*slot);
+}
+
+void mpExecutorExchange(void** slot, void* executorData) noexcept {
+  void* old;
+  {
+    ScopedLock lock(mpExecutorSlotLock);
+    old = *slot;
+    *slot = executorData;
+  }
+  mpExecutorRelease(old);
+}
+
+// ============================================================================
+// [mpsl::Executor - Construction / Destruction]
+// ============================================================================
+
+static const Executor::Impl mpExecutorNull = { 0, nullptr, 0, 0, 0 };
+
+Executor::Executor() noexcept
+  : _d(const_cast<Impl*>(&mpExecutorNull)) {}
+
+Executor::Executor(const Executor& other) noexcept
+  : _d(mpObjectAddRef(other._d)) {}
+
+Executor::~Executor() noexcept {
+  mpObjectRelease(_d);
+}
+
+Executor Executor::create(uint32_t numThreads, uint32_t flags) noexcept {
+  if (numThreads == kAutoThreads)
+    numThreads = Thread::cpuCount() - 1;
+
+  Impl* d = static_cast<Impl*>(::malloc(sizeof(Impl)));
+  ExecutorPool* pool = static_cast<ExecutorPool*>(::malloc(sizeof(ExecutorPool)));
+
+  if (d == nullptr || pool == nullptr) {
+    // Allocation failure.
+    ::free(pool);
+    ::free(d);
+    return Executor();
+  }
+
+  new(pool) ExecutorPool(numThreads, flags);
+  if (pool->start() != kErrorOk) {
+    pool->~ExecutorPool();
+    ::free(pool);
+    ::free(d);
+    return Executor();
+  }
+
+  d->_refCount = 1;
+  d->_poolData = pool;
+  d->_grainSize = 0;
+  d->_numThreads = numThreads;
+  d->_flags = flags;
+
+  return Executor(d);
+}
+
+// ============================================================================
+// [mpsl::Executor - Reset]
+// ============================================================================
+
+Error Executor::reset() noexcept {
+  mpObjectRelease(mpAtomicSetXchgT<Impl*>(
+    &_d, const_cast<Impl*>(&mpExecutorNull)));
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::Executor - Accessors]
+// ============================================================================
+
+size_t Executor::grainSize() const noexcept {
+  return mpAtomicGetAcquireT<size_t>(&_d->_grainSize);
+}
+
+Error Executor::setGrainSize(size_t grainSize) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  mpAtomicSetReleaseT<size_t>(&_d->_grainSize, grainSize);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::Executor - Interface]
+// ============================================================================
+
+Error Executor::_submit(const Program& program, uint32_t numArgs, void* const* args, const intptr_t* strides, size_t count) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  if (!program.isValid() || numArgs > Globals::kMaxArgumentsCount)
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  ExecutorPool* pool = static_cast<ExecutorPool*>(_d->_poolData);
+  return pool->submit(program, numArgs, args, strides, count, grainSize());
+}
+
+Error Executor::wait() noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  ExecutorPool* pool = static_cast<ExecutorPool*>(_d->_poolData);
+  return pool->wait();
+}
+
+// ============================================================================
+// [mpsl::Executor - Operator Overload]
+// ============================================================================
+
+Executor& Executor::operator=(const Executor& other) noexcept {
+  mpObjectRelease(
+    mpAtomicSetXchgT<Impl*>(
+      &_d, mpObjectAddRef(other._d)));
+
+  return *this;
+}
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
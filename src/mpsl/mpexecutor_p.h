@@ -0,0 +1,165 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _MPSL_MPEXECUTOR_P_H
+#define _MPSL_MPEXECUTOR_P_H
+
+// [Dependencies - MPSL]
+#include "./mpsl_p.h"
+#include "./mpthread_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::ExecutorRange]
+// ============================================================================
+
+//! \internal
+//!
+//! Records `[begin, end)` owned by a single participant of a job. The owner
+//! takes chunks from the beginning, thieves take halves from the end.
+struct ExecutorRange {
+  Mutex lock;
+  size_t begin;
+  size_t end;
+};
+
+// ============================================================================
+// [mpsl::ExecutorJob]
+// ============================================================================
+
+//! \internal
+//!
+//! A batch submitted to the executor.
+struct ExecutorJob {
+  MPSL_INLINE explicit ExecutorJob(const Program& program) noexcept
+    : next(nullptr),
+      program(program),
+      grainSize(0),
+      numUsers(0),
+      hasWaiter(false),
+      error(kErrorOk) {}
+
+  ExecutorJob* next;                     //!< Next job in the queue.
+  Program program;                       //!< Program to run (holds a reference).
+
+  size_t grainSize;                      //!< Number of records of a chunk.
+  uint32_t numUsers;                     //!< Number of participants processing the job.
+  bool hasWaiter;                        //!< A thread in `wait()` has joined the job.
+  Error error;                           //!< First error reported by the program.
+
+  void* args[Globals::kMaxArgumentsCount];
+  intptr_t strides[Globals::kMaxArgumentsCount];
+
+  ExecutorRange ranges[1];               //!< Range per participant (workers + one waiter).
+};
+
+// ============================================================================
+// [mpsl::ExecutorPool]
+// ============================================================================
+
+class ExecutorPool;
+
+//! \internal
+struct ExecutorWorker {
+  ExecutorPool* pool;                    //!< Pool the worker belongs to.
+  uint32_t slot;                         //!< Index of the worker's range.
+  Thread thread;                         //!< Worker thread.
+};
+
+//! \internal
+//!
+//! Thread pool used by `Executor`.
+class ExecutorPool {
+public:
+  MPSL_NONCOPYABLE(ExecutorPool)
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ExecutorPool(uint32_t numThreads, uint32_t flags) noexcept;
+  ~ExecutorPool() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  Error start() noexcept;
+  void stop() noexcept;
+
+  Error submit(const Program& program, uint32_t numArgs, void* const* args, const intptr_t* strides, size_t count, size_t grainSize) noexcept;
+  Error wait() noexcept;
+
+  //! Number of participants - all workers and a thread that waits.
+  MPSL_INLINE uint32_t numSlots() const noexcept { return _numThreads + 1; }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  static void _workerMain(void* arg) noexcept;
+
+  void _participate(ExecutorJob* job, uint32_t slot) noexcept;
+  bool _claim(ExecutorJob* job, uint32_t slot, size_t& index, size_t& count) noexcept;
+  void _finish(ExecutorJob* job) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  Mutex _mutex;                          //!< Guards everything below.
+  ConditionVariable _workCond;           //!< Signaled when a job is queued.
+  ConditionVariable _doneCond;           //!< Signaled when a job finishes.
+
+  ExecutorJob* _first;                   //!< First job that has records to claim.
+  ExecutorJob* _last;                    //!< Last job in the queue.
+  size_t _pendingJobs;                   //!< Number of unfinished jobs.
+  Error _error;                          //!< First error since the last `wait()`.
+  bool _stopping;                        //!< Workers should quit.
+
+  uint32_t _numThreads;                  //!< Number of workers.
+  uint32_t _flags;                       //!< Executor flags.
+  ExecutorWorker* _workers;              //!< Workers.
+};
+
+// ============================================================================
+// [mpsl::mpExecutor]
+// ============================================================================
+
+//! \internal
+//!
+//! Add a reference to executor data stored as `void*` (used by `Context`).
+void* mpExecutorAddRef(void* executorData) noexcept;
+
+//! \internal
+//!
+//! Release executor data stored as `void*` (used by `Context`).
+void mpExecutorRelease(void* executorData) noexcept;
+
+//! \internal
+//!
+//! Add a reference to executor data stored in `slot` and return it. Safe to
+//! call while `mpExecutorExchange()` replaces the data of the same slot.
+void* mpExecutorLoad(void* const* slot) noexcept;
+
+//! \internal
+//!
+//! Store `executorData` (already referenced) to `slot` and release the data
+//! it replaces.
+void mpExecutorExchange(void** slot, void* executorData) noexcept;
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
+
+// [Guard]
+#endif // _MPSL_MPEXECUTOR_P_H
@@ -88,6 +88,12 @@ static MPSL_INLINE uint32_t popcnt_kernel(uint32_t x) noexcept {
 #endif
 }
 
+// Truncates like `cvttsd2si`, values that don't fit (including NaN) become
+// the "integer indefinite" value.
+static MPSL_INLINE int32_t cvtt_kernel(double x) noexcept {
+  return (x > -2147483649.0 && x < 2147483648.0) ? static_cast<int32_t>(x) : -2147483647 - 1;
+}
+
 static MPSL_INLINE uint32_t vmaddwd_kernel(uint32_t x, uint32_t y) noexcept {
   int32_t xLo = static_cast<int32_t>(x & 0xFFFFu);
   int32_t yLo = static_cast<int32_t>(y & 0xFFFFu);
@@ -106,9 +112,9 @@ static MPSL_INLINE void pshufd(void* _pd, const void* _pl, const void* _pr, uint
   const uint32_t* pl = static_cast<const uint32_t*>(_pl);
   uint32_t sel = static_cast<const uint32_t*>(_pr)[0];
 
+  // Each 2-bit selector picks an element within the same 128-bit lane.
   do {
-    pd[i] = pl[sel & 0xF];
-    sel >>= 4;
+    pd[i] = pl[(i & ~3u) + ((sel >> ((i & 3u) * 2u)) & 3u)];
   } while (++i < count);
 }
 
@@ -163,6 +169,32 @@ static MPSL_INLINE void fn(                                                    \
   } while (++i < count);                                                       \
 }
 
+// Conversions count elements of the wider type, which is what the width of
+// the instruction refers to.
+#define FOLD_CVT(fn, dsttype, srctype, ...)                                    \
+static MPSL_INLINE void fn(                                                    \
+  void* _pd, const void* _ps, uint32_t width) noexcept {                       \
+                                                                               \
+  uint32_t i = 0;                                                              \
+  uint32_t count = width / static_cast<uint32_t>(                              \
+    sizeof(dsttype) > sizeof(srctype) ? sizeof(dsttype) : sizeof(srctype));    \
+                                                                               \
+  dsttype* pd = static_cast<dsttype*>(_pd);                                    \
+  const srctype* ps = static_cast<const srctype*>(_ps);                        \
+                                                                               \
+  do {                                                                         \
+    srctype s = ps[i];                                                         \
+    pd[i] = static_cast<dsttype>(__VA_ARGS__);                                 \
+  } while (++i < count);                                                       \
+}
+
+FOLD_CVT(cvtitof   , float   , int32_t , s)
+FOLD_CVT(cvtitod   , double  , int32_t , s)
+FOLD_CVT(cvtftoi   , int32_t , float   , cvtt_kernel(s))
+FOLD_CVT(cvtftod   , double  , float   , s)
+FOLD_CVT(cvtdtoi   , int32_t , double  , cvtt_kernel(s))
+FOLD_CVT(cvtdtof   , float   , double  , s)
+
 FOLD_FN2(pcopy32   , uint32_t, uint32_t, uint32_t, s)
 FOLD_FN2(pcopy64   , uint64_t, uint64_t, uint64_t, s)
 
@@ -170,20 +202,20 @@ FOLD_FN2(pinci     , uint32_t, uint32_t, uint32_t, s + 1u  )
 FOLD_FN2(fincf     , float   , float   , float   , s + 1.0f)
 FOLD_FN2(fincd     , double  , double  , double  , s + 1.0 )
 
-FOLD_FN2(pdeci     , uint32_t, uint32_t, uint32_t, s + 1u  )
-FOLD_FN2(fdecf     , float   , float   , float   , s + 1.0f)
-FOLD_FN2(fdecd     , double  , double  , double  , s + 1.0 )
+FOLD_FN2(pdeci     , uint32_t, uint32_t, uint32_t, s - 1u  )
+FOLD_FN2(fdecf     , float   , float   , float   , s - 1.0f)
+FOLD_FN2(fdecd     , double  , double  , double  , s - 1.0 )
 
 FOLD_FN2(pnotd     , uint32_t, uint32_t, uint32_t, ~s)
 FOLD_FN2(pnotq     , uint64_t, uint64_t, uint64_t, ~s)
 FOLD_FN2(pnegd     , uint32_t, uint32_t, uint32_t, (~s) + static_cast<uint32_t>(1u))
 
-FOLD_FN2(fisnanf   , uint32_t, float   , float   , mpIsNanF(s) ? kB32_0 : kB32_1)
-FOLD_FN2(fisnand   , uint64_t, double  , double  , mpIsNanD(s) ? kB64_0 : kB64_1)
-FOLD_FN2(fisinff   , uint32_t, float   , float   , mpIsInfF(s) ? kB32_0 : kB32_1)
-FOLD_FN2(fisinfd   , uint64_t, double  , double  , mpIsInfD(s) ? kB64_0 : kB64_1)
-FOLD_FN2(fisfinitef, uint32_t, float   , float   , mpIsFiniteF(s) ? kB32_0 : kB32_1)
-FOLD_FN2(fisfinited, uint64_t, double  , double  , mpIsFiniteD(s) ? kB64_0 : kB64_1)
+FOLD_FN2(fisnanf   , uint32_t, float   , float   , mpIsNanF(s) ? kB32_1 : kB32_0)
+FOLD_FN2(fisnand   , uint64_t, double  , double  , mpIsNanD(s) ? kB64_1 : kB64_0)
+FOLD_FN2(fisinff   , uint32_t, float   , float   , mpIsInfF(s) ? kB32_1 : kB32_0)
+FOLD_FN2(fisinfd   , uint64_t, double  , double  , mpIsInfD(s) ? kB64_1 : kB64_0)
+FOLD_FN2(fisfinitef, uint32_t, float   , float   , mpIsFiniteF(s) ? kB32_1 : kB32_0)
+FOLD_FN2(fisfinited, uint64_t, double  , double  , mpIsFiniteD(s) ? kB64_1 : kB64_0)
 
 FOLD_FN2(fsignmaskf, int32_t , int32_t , int32_t , s >> 31)
 FOLD_FN2(fsignmaskd, int64_t , int64_t , int64_t , s >> 63)
@@ -259,18 +291,18 @@ FOLD_FN3(fmind     , double  , double  , double  , l < r ? l : r)
 FOLD_FN3(fmaxf     , float   , float   , float   , l > r ? l : r)
 FOLD_FN3(fmaxd     , double  , double  , double  , l > r ? l : r)
 
-FOLD_FN3(fcmpeqf   , uint32_t, float   , float   , l == r ? kB32_0 : kB32_1)
-FOLD_FN3(fcmpeqd   , uint64_t, double  , double  , l == r ? kB64_0 : kB64_1)
-FOLD_FN3(fcmpnef   , uint32_t, float   , float   , l != r ? kB32_0 : kB32_1)
-FOLD_FN3(fcmpned   , uint64_t, double  , double  , l != r ? kB64_0 : kB64_1)
-FOLD_FN3(fcmpltf   , uint32_t, float   , float   , l <  r ? kB32_0 : kB32_1)
-FOLD_FN3(fcmpltd   , uint64_t, double  , double  , l <  r ? kB64_0 : kB64_1)
-FOLD_FN3(fcmplef   , uint32_t, float   , float   , l <= r ? kB32_0 : kB32_1)
-FOLD_FN3(fcmpled   , uint64_t, double  , double  , l <= r ? kB64_0 : kB64_1)
-FOLD_FN3(fcmpgtf   , uint32_t, float   , float   , l >  r ? kB32_0 : kB32_1)
-FOLD_FN3(fcmpgtd   , uint64_t, double  , double  , l >  r ? kB64_0 : kB64_1)
-FOLD_FN3(fcmpgef   , uint32_t, float   , float   , l >= r ? kB32_0 : kB32_1)
-FOLD_FN3(fcmpged   , uint64_t, double  , double  , l >= r ? kB64_0 : kB64_1)
+FOLD_FN3(fcmpeqf   , uint32_t, float   , float   , l == r ? kB32_1 : kB32_0)
+FOLD_FN3(fcmpeqd   , uint64_t, double  , double  , l == r ? kB64_1 : kB64_0)
+FOLD_FN3(fcmpnef   , uint32_t, float   , float   , l != r ? kB32_1 : kB32_0)
+FOLD_FN3(fcmpned   , uint64_t, double  , double  , l != r ? kB64_1 : kB64_0)
+FOLD_FN3(fcmpltf   , uint32_t, float   , float   , l <  r ? kB32_1 : kB32_0)
+FOLD_FN3(fcmpltd   , uint64_t, double  , double  , l <  r ? kB64_1 : kB64_0)
+FOLD_FN3(fcmplef   , uint32_t, float   , float   , l <= r ? kB32_1 : kB32_0)
+FOLD_FN3(fcmpled   , uint64_t, double  , double  , l <= r ? kB64_1 : kB64_0)
+FOLD_FN3(fcmpgtf   , uint32_t, float   , float   , l >  r ? kB32_1 : kB32_0)
+FOLD_FN3(fcmpgtd   , uint64_t, double  , double  , l >  r ? kB64_1 : kB64_0)
+FOLD_FN3(fcmpgef   , uint32_t, float   , float   , l >= r ? kB32_1 : kB32_0)
+FOLD_FN3(fcmpged   , uint64_t, double  , double  , l >= r ? kB64_1 : kB64_0)
 
 FOLD_FN2(pabsb     , int8_t  , int8_t  , int32_t , mpAbsI(s))
 FOLD_FN2(pabsw     , int16_t , int16_t , int32_t , mpAbsI(s))
@@ -299,7 +331,8 @@ FOLD_FN3(psubusw   , uint16_t, uint16_t, uint32_t, (l >= r) ? l - r : static_cas
 FOLD_FN3(pmulw     , uint16_t, uint16_t, uint32_t, (l * r) & 0xFFFFu)
 FOLD_FN3(pmulhsw   , int16_t , int16_t , int32_t , (l * r) >> 16)
 FOLD_FN3(pmulhuw   , uint16_t, uint16_t, uint32_t, (l * r) >> 16)
-FOLD_FN3(pmuld     , uint16_t, uint16_t, uint32_t, l * r)
+FOLD_FN3(pmulhsd   , int32_t , int32_t , int64_t , (l * r) >> 32)
+FOLD_FN3(pmuld     , uint32_t, uint32_t, uint32_t, l * r)
 FOLD_FN3(pdivsd    , int32_t , int32_t , int32_t , idiv(l, r))
 FOLD_FN3(pmodsd    , int32_t , int32_t , int32_t , imod(l, r))
 FOLD_FN3(pminsb    , int8_t  , int8_t  , int32_t , mpMin<int32_t>(l, r))
@@ -345,23 +378,24 @@ FOLD_FN3(pcmpgew   , int16_t , int16_t , int32_t , l >= r ? -1 : 0)
 FOLD_FN3(pcmpged   , int32_t , int32_t , int32_t , l >= r ? -1 : 0)
 
 #undef FOLD_IMM
+#undef FOLD_CVT
 #undef FOLD_FN3
 #undef FOLD_FN2
 
 static Error foldInternal(uint32_t instCode, uint32_t width, Value& dVal, const Value& sVal) noexcept {
   // Instruction code without SIMD flags.
   switch (instCode) {
-    case kInstCodeMov32:
-    case kInstCodeMov64:
-    case kInstCodeMov128:
-    case kInstCodeMov256:
-
-    case kInstCodeCvtitof   :
-    case kInstCodeCvtitod   :
-    case kInstCodeCvtftoi   :
-    case kInstCodeCvtftod   :
-    case kInstCodeCvtdtoi   :
-    case kInstCodeCvtdtof   :
+    case kInstCodeMov32     :
+    case kInstCodeMov64     :
+    case kInstCodeMov128    :
+    case kInstCodeMov256    : dVal = sVal; break;
+
+    case kInstCodeCvtitof   : cvtitof(&dVal, &sVal, width); break;
+    case kInstCodeCvtitod   : cvtitod(&dVal, &sVal, width); break;
+    case kInstCodeCvtftoi   : cvtftoi(&dVal, &sVal, width); break;
+    case kInstCodeCvtftod   : cvtftod(&dVal, &sVal, width); break;
+    case kInstCodeCvtdtoi   : cvtdtoi(&dVal, &sVal, width); break;
+    case kInstCodeCvtdtof   : cvtdtof(&dVal, &sVal, width); break;
 
     case kInstCodeAbsf      : fabsf(&dVal, &sVal, width); break;
     case kInstCodeAbsd      : fabsd(&dVal, &sVal, width); break;
@@ -390,7 +424,7 @@ static Error foldInternal(uint32_t instCode, uint32_t width, Value& dVal, const
     case kInstCodeFloorf    : ffloorf(&dVal, &sVal, width); break;
     case kInstCodeFloord    : ffloord(&dVal, &sVal, width); break;
     case kInstCodeRoundf    : froundf(&dVal, &sVal, width); break;
-    case kInstCodeRoundd    : froundf(&dVal, &sVal, width); break;
+    case kInstCodeRoundd    : froundd(&dVal, &sVal, width); break;
     case kInstCodeRoundevenf: froundevenf(&dVal, &sVal, width); break;
     case kInstCodeRoundevend: froundevend(&dVal, &sVal, width); break;
     case kInstCodeCeilf     : fceilf(&dVal, &sVal, width); break;
@@ -511,6 +545,7 @@ static Error foldInternal(uint32_t instCode, uint32_t width, Value& dVal, const
     case kInstCodePmulw     : pmulw(&dVal, &lVal, &rVal, width); break;
     case kInstCodePmulhsw   : pmulhsw(&dVal, &lVal, &rVal, width); break;
     case kInstCodePmulhuw   : pmulhuw(&dVal, &lVal, &rVal, width); break;
+    case kInstCodePmulhsd   : pmulhsd(&dVal, &lVal, &rVal, width); break;
     case kInstCodePmuld     : pmuld(&dVal, &lVal, &rVal, width); break;
     case kInstCodePdivsd    : pdivsd(&dVal, &lVal, &rVal, width); break;
     case kInstCodePmodsd    : pmodsd(&dVal, &lVal, &rVal, width); break;
@@ -38,25 +38,59 @@ void IRBlock::_fixupAfterNeutering() noexcept {
   _requiresFixup = false;
 }
 
+Error IRBlock::insertBeforeTerminator(IRInst* inst) noexcept {
+  IRInst* term = terminator();
+  MPSL_PROPAGATE(_body.append(_ir->_allocator, inst));
+
+  if (term) {
+    size_t last = _body.size() - 1;
+    _body[last - 1] = inst;
+    _body[last] = term;
+  }
+
+  return kErrorOk;
+}
+
 // ============================================================================
 // [mpsl::IRBuilder - Construction / Destruction]
 // ============================================================================
 
 IRBuilder::IRBuilder(ZoneAllocator* allocator, uint32_t numSlots) noexcept
   : _allocator(allocator),
+    _isSSA(false),
+    _liveness(nullptr),
+    _liveWords(0),
     _numSlots(numSlots),
+    _laneIndex(nullptr),
+    _numLanes(1),
+    _soaSlots(0),
+    _uniformPtr(nullptr),
+    _uniformData(nullptr),
     _blockIdGen(0),
     _varIdGen(0) {
 
+  // Data pointers are owned by the builder like `_laneIndex`, they must not
+  // be released when the last memory operand that uses them is deleted.
   for (uint32_t i = 0; i < Globals::kMaxArgumentsCount; i++) {
-    if (i < numSlots)
+    if (i < numSlots) {
       _dataSlots[i] = newVar(IRReg::kKindGp, kPointerWidth);
-    else
+      if (_dataSlots[i]) _dataSlots[i]->addRef();
+    }
+    else {
       _dataSlots[i] = nullptr;
+    }
   }
 }
 IRBuilder::~IRBuilder() noexcept {
+  resetLiveness();
+
+  for (IRLoop* loop : _loops)
+    loop->_blocks.release(_allocator);
+
   _blocks.release(_allocator);
+  _exits.release(_allocator);
+  _rpo.release(_allocator);
+  _loops.release(_allocator);
 }
 
 // ============================================================================
@@ -102,6 +136,17 @@ IRMem* IRBuilder::newMem(IRReg* base, IRReg* index, int32_t offset) noexcept {
   return mem;
 }
 
+IRMem* IRBuilder::newLaneMem(IRReg* base, int32_t offset, uint32_t shift, uint32_t firstLane) noexcept {
+  MPSL_ASSERT(isSPMD());
+
+  IRMem* mem = newObject<IRMem>(base, _laneIndex, offset);
+  if (mem == nullptr) return nullptr;
+
+  mem->_memData._shift = static_cast<uint8_t>(shift);
+  mem->_memData._firstLane = static_cast<uint8_t>(firstLane);
+  return mem;
+}
+
 IRImm* IRBuilder::newImm(const Value& value, uint32_t reg, uint32_t width) noexcept {
   return newObject<IRImm>(value, reg, width);
 }
@@ -126,8 +171,10 @@ IRBlock* IRBuilder::newBlock() noexcept {
   if (MPSL_UNLIKELY(block == nullptr))
     return nullptr;
 
-  // Assign block ID.
+  // Assign block ID. Blocks are owned by the builder, jumps that target the
+  // block only add references, so deleting a jump never deletes its target.
   block->_id = ++_blockIdGen;
+  block->addRef();
 
   _blocks.appendUnsafe(block);
   return block;
@@ -147,6 +194,126 @@ Error IRBuilder::connectBlocks(IRBlock* predecessor, IRBlock* successor) noexcep
   return kErrorOk;
 }
 
+static MPSL_INLINE size_t mpIndexOfBlock(const IRBlocks& blocks, const IRBlock* block) noexcept {
+  size_t i = 0;
+  size_t size = blocks.size();
+
+  while (i < size && blocks[i] != block)
+    i++;
+  return i;
+}
+
+static MPSL_INLINE void mpRemoveBlockAt(IRBlocks& blocks, size_t index) noexcept {
+  IRBlock** data = blocks.data();
+  size_t size = blocks.size();
+
+  for (size_t i = index + 1; i < size; i++)
+    data[i - 1] = data[i];
+  blocks.truncate(size - 1);
+}
+
+void IRBuilder::disconnectBlocks(IRBlock* predecessor, IRBlock* successor) noexcept {
+  size_t succIndex = mpIndexOfBlock(predecessor->_successors, successor);
+  size_t predIndex = mpIndexOfBlock(successor->_predecessors, predecessor);
+
+  MPSL_ASSERT(succIndex < predecessor->_successors.size());
+  MPSL_ASSERT(predIndex < successor->_predecessors.size());
+
+  mpRemoveBlockAt(predecessor->_successors, succIndex);
+  mpRemoveBlockAt(successor->_predecessors, predIndex);
+
+  // Phis shrink in place, the memory is returned when they are deleted.
+  for (IRInst* phi : successor->_phis) {
+    uint32_t opIndex = static_cast<uint32_t>(predIndex) + 1;
+    uint32_t opCount = phi->opCount();
+
+    derefObject(phi->_opArray[opIndex]);
+    for (uint32_t i = opIndex + 1; i < opCount; i++)
+      phi->_opArray[i - 1] = phi->_opArray[i];
+    phi->_opCount = opCount - 1;
+  }
+}
+
+Error IRBuilder::splitEdge(IRBlock* predecessor, IRBlock* successor, IRBlock** out) noexcept {
+  size_t succIndex = mpIndexOfBlock(predecessor->_successors, successor);
+  size_t predIndex = mpIndexOfBlock(successor->_predecessors, predecessor);
+
+  MPSL_ASSERT(succIndex < predecessor->_successors.size());
+  MPSL_ASSERT(predIndex < successor->_predecessors.size());
+
+  IRBlock* block = newBlock();
+  MPSL_NULLCHECK(block);
+
+  MPSL_PROPAGATE(block->_predecessors.append(_allocator, predecessor));
+  MPSL_PROPAGATE(block->_successors.append(_allocator, successor));
+  MPSL_PROPAGATE(emitInst(block, kInstCodeJmp, successor));
+
+  predecessor->_successors[succIndex] = block;
+  successor->_predecessors[predIndex] = block;
+
+  // Retarget the jump of `predecessor`, the first operand of `Jnz` and `Jany`
+  // is the condition.
+  IRInst* term = predecessor->terminator();
+  MPSL_ASSERT(term != nullptr);
+
+  for (uint32_t i = 0; i < term->opCount(); i++)
+    if (term->op(i) == successor)
+      replaceOperand(term, i, block);
+
+  *out = block;
+  return kErrorOk;
+}
+
+Error IRBuilder::addExit(IRBlock* block) noexcept {
+  MPSL_PROPAGATE(_exits.append(_allocator, block));
+
+  if (block->_blockData._blockType == IRBlock::kKindBasic)
+    block->_blockData._blockType = IRBlock::kKindExit;
+
+  block->addRef();
+  return kErrorOk;
+}
+
+IRInst* IRBuilder::newPhi(IRReg* var, uint32_t count) noexcept {
+  IRInst* inst = _newInst(kInstCodePhi, count + 1);
+  if (inst == nullptr) return nullptr;
+
+  for (uint32_t i = 0; i <= count; i++) {
+    inst->_opArray[i] = var;
+    var->addRef();
+  }
+
+  return inst;
+}
+
+IRInst* IRBuilder::newMove(IRReg* dst, IRReg* src) noexcept {
+  uint32_t inst;
+  uint32_t width = mpMax<uint32_t>(dst->width(), src->width());
+
+  if (width <= 4)
+    inst = kInstCodeMov32;
+  else if (width <= 8)
+    inst = kInstCodeMov64;
+  else if (width <= 16)
+    inst = kInstCodeMov128;
+  else
+    inst = kInstCodeMov256;
+
+  return newInst(inst, dst, src);
+}
+
+void IRBuilder::replaceOperand(IRInst* inst, uint32_t index, IRObject* obj) noexcept {
+  MPSL_ASSERT(index < inst->opCount());
+
+  IRObject* old = inst->_opArray[index];
+  if (old == obj)
+    return;
+
+  obj->addRef();
+  inst->_opArray[index] = obj;
+  derefObject(old);
+}
+
 void IRBuilder::deleteInst(IRInst* inst) noexcept {
   IRObject** opArray = inst->operands();
   uint32_t count = inst->opCount();
@@ -154,7 +321,7 @@ void IRBuilder::deleteInst(IRInst* inst) noexcept {
   for (uint32_t i = 0; i < count; i++)
     derefObject(opArray[i]);
 
-  _allocator->release(inst, sizeof(IRInst));
+  _allocator->release(inst, IRInst::sizeOf(count));
 }
 
 void IRBuilder::deleteObject(IRObject* obj) noexcept {
@@ -182,13 +349,21 @@ void IRBuilder::deleteObject(IRObject* obj) noexcept {
     }
 
     case IRObject::kTypeBlock: {
+      // The builder holds a reference of each block in `_blocks`, a block
+      // is only deleted after it was removed by `removeUnreachableBlocks()`.
       IRBlock* block = obj->as<IRBlock>();
       for (IRInst* inst : block->body())
         if (inst) deleteInst(inst);
 
-      // TODO: Blocks should not be deleted, just marked as removed.
+      for (IRInst* phi : block->phis())
+        deleteInst(phi);
+
       block->_body.release(_allocator);
-      _blocks[block->id()] = nullptr;
+      block->_phis.release(_allocator);
+      block->_predecessors.release(_allocator);
+      block->_successors.release(_allocator);
+      block->_dominated.release(_allocator);
+      block->_frontier.release(_allocator);
 
       objectSize = sizeof(IRBlock);
       break;
@@ -212,11 +387,511 @@ Error IRBuilder::initEntry() noexcept {
   MPSL_NULLCHECK(entry);
 
   entry->_blockData._blockType = IRBlock::kKindEntry;
-  entry->_refCount = 1;
+  return kErrorOk;
+}
+
+Error IRBuilder::initSPMD(uint32_t numLanes, uint32_t soaSlots) noexcept {
+  MPSL_ASSERT(_laneIndex == nullptr);
+
+  _laneIndex = newVar(IRReg::kKindGp, kPointerWidth);
+  MPSL_NULLCHECK(_laneIndex);
+
+  // Owned by the builder, it must survive even if all lane accesses are gone.
+  _laneIndex->addRef();
+
+  _numLanes = numLanes;
+  _soaSlots = soaSlots;
+
+  return kErrorOk;
+}
+
+Error IRBuilder::initUniforms(void* data) noexcept {
+  MPSL_ASSERT(_uniformPtr == nullptr);
+
+  _uniformPtr = newVar(IRReg::kKindGp, kPointerWidth);
+  MPSL_NULLCHECK(_uniformPtr);
+
+  _uniformPtr->addRef();
+  _uniformData = data;
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::IRBuilder - CFG]
+// ============================================================================
+
+//! \internal
+//!
+//! Marks a block that is on the DFS stack of `mpComputeRPO()`.
+static const uint32_t kRPOVisiting = IRBlock::kInvalidIndex - 1;
+
+//! \internal
+//!
+//! Compute the reverse post-order of blocks reachable from `entry` by an
+//! iterative DFS, `cursor` holds the index of the next successor to visit of
+//! each block on the `stack`.
+static Error mpComputeRPO(IRBuilder* ir, IRBlock* entry, IRBlocks& stack, ZoneVector<uint32_t>& cursor) noexcept {
+  ZoneAllocator* allocator = ir->allocator();
+  IRBlocks& rpo = ir->_rpo;
+
+  MPSL_PROPAGATE(stack.append(allocator, entry));
+  MPSL_PROPAGATE(cursor.append(allocator, 0));
+  entry->_rpoIndex = kRPOVisiting;
+
+  while (!stack.empty()) {
+    size_t top = stack.size() - 1;
+    IRBlock* block = stack[top];
+    uint32_t i = cursor[top];
+
+    if (i < block->successors().size()) {
+      IRBlock* successor = block->successors()[i];
+      cursor[top] = i + 1;
+
+      if (successor->_rpoIndex == IRBlock::kInvalidIndex) {
+        MPSL_PROPAGATE(stack.append(allocator, successor));
+        MPSL_PROPAGATE(cursor.append(allocator, 0));
+        successor->_rpoIndex = kRPOVisiting;
+      }
+    }
+    else {
+      MPSL_PROPAGATE(rpo.append(allocator, block));
+      stack.truncate(top);
+      cursor.truncate(top);
+    }
+  }
+
+  // Blocks were added in post-order.
+  IRBlock** data = rpo.data();
+  uint32_t size = static_cast<uint32_t>(rpo.size());
+
+  for (uint32_t i = 0; i < size / 2; i++) {
+    IRBlock* tmp = data[i];
+    data[i] = data[size - 1 - i];
+    data[size - 1 - i] = tmp;
+  }
+
+  for (uint32_t i = 0; i < size; i++)
+    data[i]->_rpoIndex = i;
+
+  return kErrorOk;
+}
+
+static MPSL_INLINE IRBlock* mpIntersectDominators(IRBlock* a, IRBlock* b) noexcept {
+  while (a != b) {
+    while (a->_rpoIndex > b->_rpoIndex) a = a->_idom;
+    while (b->_rpoIndex > a->_rpoIndex) b = b->_idom;
+  }
+  return a;
+}
+
+//! \internal
+//!
+//! Compute dominators by the iterative algorithm of Cooper, Harvey, and
+//! Kennedy, which converges in a few passes over the reverse post-order.
+static Error mpComputeDominators(IRBuilder* ir) noexcept {
+  ZoneAllocator* allocator = ir->allocator();
+  IRBlocks& rpo = ir->_rpo;
+
+  IRBlock* entry = rpo[0];
+  entry->_idom = entry;
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    for (size_t i = 1; i < rpo.size(); i++) {
+      IRBlock* block = rpo[i];
+      IRBlock* idom = nullptr;
+
+      for (IRBlock* predecessor : block->predecessors()) {
+        if (!predecessor->isReachable() || !predecessor->_idom)
+          continue;
+        idom = idom ? mpIntersectDominators(predecessor, idom) : predecessor;
+      }
+
+      if (block->_idom != idom) {
+        block->_idom = idom;
+        changed = true;
+      }
+    }
+  }
+
+  entry->_idom = nullptr;
+
+  // The immediate dominator precedes the block in reverse post-order.
+  for (size_t i = 1; i < rpo.size(); i++) {
+    IRBlock* block = rpo[i];
+    IRBlock* idom = block->_idom;
+
+    block->_domDepth = idom->_domDepth + 1;
+    MPSL_PROPAGATE(idom->_dominated.append(allocator, block));
+  }
+
+  // Dominance frontiers, only join points can be in a frontier.
+  for (IRBlock* block : rpo) {
+    if (block->predecessors().size() < 2)
+      continue;
+
+    for (IRBlock* predecessor : block->predecessors()) {
+      if (!predecessor->isReachable())
+        continue;
+
+      IRBlock* runner = predecessor;
+      while (runner && runner != block->_idom) {
+        IRBlocks& frontier = runner->_frontier;
+        if (frontier.empty() || frontier[frontier.size() - 1] != block)
+          MPSL_PROPAGATE(frontier.append(allocator, block));
+        runner = runner->_idom;
+      }
+    }
+  }
+
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! Find natural loops. Headers are visited in reverse of reverse post-order,
+//! so loops nested in a loop are found before it. The body of a loop is found
+//! by walking predecessors of its back-edges until the header is reached, an
+//! already found loop is skipped as a whole and becomes nested in this loop.
+static Error mpComputeLoops(IRBuilder* ir, IRBlocks& work) noexcept {
+  ZoneAllocator* allocator = ir->allocator();
+  IRBlocks& rpo = ir->_rpo;
+  IRLoops& loops = ir->_loops;
+
+  size_t i = rpo.size();
+  while (i != 0) {
+    IRBlock* header = rpo[--i];
+    IRLoop* loop = nullptr;
+
+    for (IRBlock* predecessor : header->predecessors()) {
+      if (!header->dominates(predecessor))
+        continue;
+
+      if (!loop) {
+        void* p = allocator->alloc(sizeof(IRLoop));
+        MPSL_NULLCHECK(p);
+
+        loop = new(p) IRLoop(header);
+        MPSL_PROPAGATE(loops.append(allocator, loop));
+        MPSL_PROPAGATE(loop->_blocks.append(allocator, header));
+        header->_loop = loop;
+      }
+
+      MPSL_PROPAGATE(work.append(allocator, predecessor));
+    }
+
+    while (!work.empty()) {
+      IRBlock* block = work[work.size() - 1];
+      work.truncate(work.size() - 1);
+
+      if (!block->_loop) {
+        block->_loop = loop;
+        MPSL_PROPAGATE(loop->_blocks.append(allocator, block));
+
+        for (IRBlock* predecessor : block->predecessors())
+          if (predecessor->isReachable())
+            MPSL_PROPAGATE(work.append(allocator, predecessor));
+        continue;
+      }
+
+      IRLoop* inner = block->_loop;
+      while (inner->_parent)
+        inner = inner->_parent;
+
+      if (inner == loop)
+        continue;
+
+      inner->_parent = loop;
+      for (IRBlock* innerBlock : inner->_blocks)
+        MPSL_PROPAGATE(loop->_blocks.append(allocator, innerBlock));
+
+      for (IRBlock* predecessor : inner->_header->predecessors())
+        if (predecessor->isReachable())
+          MPSL_PROPAGATE(work.append(allocator, predecessor));
+    }
+  }
+
+  // Outer loops first.
+  IRLoop** data = loops.data();
+  size_t size = loops.size();
+
+  for (i = 0; i < size / 2; i++) {
+    IRLoop* tmp = data[i];
+    data[i] = data[size - 1 - i];
+    data[size - 1 - i] = tmp;
+  }
+
+  for (IRLoop* loop : loops)
+    loop->_depth = loop->_parent ? loop->_parent->_depth + 1 : 1;
+
+  return kErrorOk;
+}
+
+Error IRBuilder::updateCFG() noexcept {
+  // Liveness is indexed by `IRBlock::rpoIndex()`, which is recomputed.
+  resetLiveness();
+
+  for (IRBlock* block : _blocks) {
+    block->_rpoIndex = IRBlock::kInvalidIndex;
+    block->_domDepth = 0;
+    block->_idom = nullptr;
+    block->_dominated.truncate(0);
+    block->_frontier.truncate(0);
+    block->_loop = nullptr;
+  }
+
+  for (IRLoop* loop : _loops) {
+    loop->_blocks.release(_allocator);
+    _allocator->release(loop, sizeof(IRLoop));
+  }
 
+  _rpo.truncate(0);
+  _loops.truncate(0);
+
+  if (_blocks.empty())
+    return kErrorOk;
+
+  IRBlocks stack;
+  ZoneVector<uint32_t> cursor;
+
+  Error err = mpComputeRPO(this, entryBlock(), stack, cursor);
+  if (err == kErrorOk)
+    err = mpComputeDominators(this);
+  if (err == kErrorOk)
+    err = mpComputeLoops(this, stack);
+
+  stack.release(_allocator);
+  cursor.release(_allocator);
+  return err;
+}
+
+Error IRBuilder::removeUnreachableBlocks() noexcept {
+  MPSL_PROPAGATE(updateCFG());
+
+  if (_rpo.size() == _blocks.size())
+    return kErrorOk;
+
+  // Predecessors of an unreachable block are unreachable as well, so removing
+  // all outgoing edges of unreachable blocks disconnects them completely.
+  for (IRBlock* block : _blocks) {
+    if (block->isReachable())
+      continue;
+
+    IRBlocks& successors = block->successors();
+    while (!successors.empty())
+      disconnectBlocks(block, successors[successors.size() - 1]);
+  }
+
+  IRBlock** data = _blocks.data();
+  size_t size = _blocks.size();
+  size_t dstIndex = 0;
+
+  for (size_t i = 0; i < size; i++) {
+    IRBlock* block = data[i];
+
+    if (block->isReachable()) {
+      data[dstIndex++] = block;
+      continue;
+    }
+
+    // An exit that is not reachable stays, `IRToX86` never places it.
+    if (block->blockType() == IRBlock::kKindExit) {
+      for (IRInst* inst : block->body())
+        if (inst) deleteInst(inst);
+      for (IRInst* phi : block->phis())
+        deleteInst(phi);
+
+      block->_body.truncate(0);
+      block->_phis.truncate(0);
+
+      data[dstIndex++] = block;
+      continue;
+    }
+
+    derefObject(block);
+  }
+
+  _blocks.truncate(dstIndex);
   return kErrorOk;
 }
 
+// ============================================================================
+// [mpsl::IRBuilder - Liveness]
+// ============================================================================
+
+// Standard backward dataflow over reachable blocks. Blocks are visited in
+// post-order, which reaches the fixed point after a few iterations as only
+// backward edges need more than one. The `use` set of a block contains
+// variables read before they are assigned in its body and `def` contains
+// variables assigned by its body, phis are not part of either.
+Error IRBuilder::updateLiveness() noexcept {
+  resetLiveness();
+
+  size_t numBlocks = _rpo.size();
+  if (numBlocks == 0)
+    return kErrorOk;
+
+  uint32_t words = (_varIdGen >> 5) + 1;
+  size_t setSize = words * sizeof(uint32_t);
+
+  size_t livenessSize = numBlocks * 2 * setSize;
+  size_t scratchSize = (numBlocks * 2 + 1) * setSize;
+
+  uint32_t* liveness = static_cast<uint32_t*>(_allocator->alloc(livenessSize));
+  uint32_t* scratch = static_cast<uint32_t*>(_allocator->alloc(scratchSize));
+
+  if (liveness == nullptr || scratch == nullptr) {
+    if (liveness) _allocator->release(liveness, livenessSize);
+    if (scratch) _allocator->release(scratch, scratchSize);
+    return MPSL_TRACE_ERROR(kErrorNoMemory);
+  }
+
+  ::memset(liveness, 0, livenessSize);
+  ::memset(scratch, 0, scratchSize);
+
+  _liveness = liveness;
+  _liveWords = words;
+
+  // Per-block `use` and `def`, followed by the live-out of the block visited.
+  uint32_t* useSets = scratch;
+  uint32_t* defSets = scratch + numBlocks * words;
+  uint32_t* out = scratch + numBlocks * 2 * words;
+
+  size_t i, w;
+  for (i = 0; i < numBlocks; i++) {
+    uint32_t* use = useSets + i * words;
+    uint32_t* def = defSets + i * words;
+
+    const IRBody& body = _rpo[i]->body();
+    size_t j = body.size();
+
+    while (j != 0) {
+      IRInst* inst = body[--j];
+      if (inst->hasDef()) {
+        uint32_t id = inst->op(0)->id();
+        def[id >> 5] |= 1u << (id & 31);
+      }
+      mpUpdateLiveBits(use, inst);
+    }
+  }
+
+  bool changed;
+  do {
+    changed = false;
+    i = numBlocks;
+
+    while (i != 0) {
+      IRBlock* block = _rpo[--i];
+      ::memset(out, 0, setSize);
+
+      for (IRBlock* successor : block->successors()) {
+        const uint32_t* succIn = liveIn(successor);
+        for (w = 0; w < words; w++)
+          out[w] |= succIn[w];
+
+        // Phis of the successor are assigned on the edge, their operands are
+        // read at the end of the predecessor they flow from.
+        const IRBody& phis = successor->phis();
+        if (phis.empty())
+          continue;
+
+        const IRBlocks& predecessors = successor->predecessors();
+        uint32_t index = 0;
+
+        while (predecessors[index] != block)
+          index++;
+
+        for (IRInst* phi : phis) {
+          uint32_t dstId = phi->op(0)->id();
+          out[dstId >> 5] &= ~(1u << (dstId & 31));
+        }
+
+        for (IRInst* phi : phis) {
+          IRObject* op = phi->op(index + 1);
+          if (op->isReg()) {
+            uint32_t id = op->id();
+            out[id >> 5] |= 1u << (id & 31);
+          }
+        }
+      }
+
+      uint32_t* blockIn = _liveness + i * 2 * words;
+      uint32_t* blockOut = blockIn + words;
+
+      const uint32_t* use = useSets + i * words;
+      const uint32_t* def = defSets + i * words;
+
+      for (w = 0; w < words; w++) {
+        uint32_t in = use[w] | (out[w] & ~def[w]);
+        if (in != blockIn[w] || out[w] != blockOut[w]) {
+          blockIn[w] = in;
+          blockOut[w] = out[w];
+          changed = true;
+        }
+      }
+    }
+  } while (changed);
+
+  _allocator->release(scratch, scratchSize);
+  return kErrorOk;
+}
+
+void IRBuilder::resetLiveness() noexcept {
+  if (_liveness)
+    _allocator->release(_liveness, _rpo.size() * 2 * _liveWords * sizeof(uint32_t));
+
+  _liveness = nullptr;
+  _liveWords = 0;
+}
+
+// ============================================================================
+// [mpsl::IRBuilder - JIT]
+// ============================================================================
+
+static MPSL_INLINE void mpResetJitId(IRObject* obj) noexcept {
+  switch (obj->objectType()) {
+    case IRObject::kTypeReg:
+      obj->as<IRReg>()->setJitId(kInvalidRegId);
+      break;
+
+    case IRObject::kTypeMem: {
+      IRMem* mem = obj->as<IRMem>();
+      if (mem->hasBase()) mem->base()->setJitId(kInvalidRegId);
+      if (mem->hasIndex()) mem->index()->setJitId(kInvalidRegId);
+      break;
+    }
+  }
+}
+
+void IRBuilder::resetJitData() noexcept {
+  for (uint32_t i = 0; i < _numSlots; i++)
+    _dataSlots[i]->setJitId(kInvalidRegId);
+
+  if (_laneIndex)
+    _laneIndex->setJitId(kInvalidRegId);
+
+  if (_uniformPtr)
+    _uniformPtr->setJitId(kInvalidRegId);
+
+  for (IRBlock* block : _blocks) {
+    if (!block) continue;
+
+    block->setJitId(kInvalidRegId);
+    block->resetAssembled();
+
+    for (IRInst* inst : block->body()) {
+      IRObject** opArray = inst->operands();
+      uint32_t count = inst->opCount();
+
+      for (uint32_t i = 0; i < count; i++)
+        mpResetJitId(opArray[i]);
+    }
+  }
+}
+
 // ============================================================================
 // [mpsl::IRBuilder - Emit]
 // ============================================================================
@@ -239,6 +914,12 @@ Error IRBuilder::emitInst(IRBlock* block, uint32_t instCode, IRObject* o0, IRObj
   return block->append(node);
 }
 
+Error IRBuilder::emitInst(IRBlock* block, uint32_t instCode, IRObject* o0, IRObject* o1, IRObject* o2, IRObject* o3) noexcept {
+  IRInst* node = newInst(instCode, o0, o1, o2, o3);
+  MPSL_NULLCHECK(node);
+  return block->append(node);
+}
+
 Error IRBuilder::emitMove(IRBlock* block, IRReg* dst, IRReg* src) noexcept {
   uint32_t inst = kInstCodeNone;
 
@@ -277,9 +958,61 @@ Error IRBuilder::emitFetch(IRBlock* block, IRReg* dst, IRObject* src) noexcept {
 // [mpsl::IRBuilder - Dump]
 // ============================================================================
 
+static void mpDumpOperand(String& sb, IRObject* op) noexcept {
+  switch (op->objectType()) {
+    case IRObject::kTypeReg: {
+      IRReg* var = static_cast<IRReg*>(op);
+      sb.appendFormat("%%%u", var->id());
+      break;
+    }
+
+    case IRObject::kTypeMem: {
+      IRMem* mem = static_cast<IRMem*>(op);
+      if (mem->hasIndex())
+        sb.appendFormat("[%%%u + %%%u * %u + %d]",
+          mem->base()->id(),
+          mem->index()->id(),
+          1u << mem->shift(),
+          static_cast<int>(mem->offset()));
+      else
+        sb.appendFormat("[%%%u + %d]",
+          mem->base()->id(),
+          static_cast<int>(mem->offset()));
+      break;
+    }
+
+    case IRObject::kTypeImm: {
+      IRImm* imm = static_cast<IRImm*>(op);
+      FormatUtils::formatValue(sb, imm->typeInfo(), &imm->_value);
+      break;
+    }
+
+    case IRObject::kTypeBlock: {
+      IRBlock* block = static_cast<IRBlock*>(op);
+      sb.appendFormat("B%u", block->id());
+      break;
+    }
+  }
+}
+
 Error IRBuilder::dump(String& sb) noexcept {
   for (IRBlock* block : blocks()) {
     sb.appendFormat(".B%u\n", block->id());
+
+    // Phi operands are printed with the predecessor they flow from.
+    for (IRInst* phi : block->phis()) {
+      sb.appendString("  phi ");
+      mpDumpOperand(sb, phi->op(0));
+
+      for (uint32_t i = 1; i < phi->opCount(); i++) {
+        sb.appendFormat(i == 1 ? " = [B%u: " : ", [B%u: ", block->predecessors()[i - 1]->id());
+        mpDumpOperand(sb, phi->op(i));
+        sb.appendString("]");
+      }
+
+      sb.appendString("\n");
+    }
+
     for (IRInst* inst : block->body()) {
       uint32_t code = inst->instCode() & kInstCodeMask;
       uint32_t vec = inst->instCode() & kInstVecMask;
@@ -293,40 +1026,11 @@ Error IRBuilder::dump(String& sb) noexcept {
       size_t opIndex, count = inst->opCount();
 
       for (opIndex = 0; opIndex < count; opIndex++) {
-        IRObject* op = opArray[opIndex];
-
         if (opIndex == 0)
           sb.appendString(" ");
         else
           sb.appendString(", ");
-
-        switch (op->objectType()) {
-          case IRObject::kTypeReg: {
-            IRReg* var = static_cast<IRReg*>(op);
-            sb.appendFormat("%%%u", var->id());
-            break;
-          }
-
-          case IRObject::kTypeMem: {
-            IRMem* mem = static_cast<IRMem*>(op);
-            sb.appendFormat("[%%%u + %d]",
-              mem->base()->id(),
-              static_cast<int>(mem->offset()));
-            break;
-          }
-
-          case IRObject::kTypeImm: {
-            IRImm* imm = static_cast<IRImm*>(op);
-            FormatUtils::formatValue(sb, imm->typeInfo(), &imm->_value);
-            break;
-          }
-
-          case IRObject::kTypeBlock: {
-            IRBlock* block = static_cast<IRBlock*>(op);
-            sb.appendFormat("B%u", block->id());
-            break;
-          }
-        }
+        mpDumpOperand(sb, opArray[opIndex]);
       }
 
       sb.appendString("\n");
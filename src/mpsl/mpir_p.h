@@ -29,9 +29,11 @@ class IRReg;
 class IRMem;
 class IRImm;
 class IRInst;
+class IRLoop;
 
 typedef ZoneVector<IRInst*> IRBody;
 typedef ZoneVector<IRBlock*> IRBlocks;
+typedef ZoneVector<IRLoop*> IRLoops;
 
 // ============================================================================
 // [mpsl::IRBuilder]
@@ -65,12 +67,61 @@ public:
     return _blocks[0];
   }
 
+  //! Get blocks reachable from the entry in reverse post-order (see `updateCFG()`).
+  MPSL_INLINE const IRBlocks& rpo() const noexcept { return _rpo; }
+  //! Get all natural loops, outer loops precede loops nested in them.
+  MPSL_INLINE const IRLoops& loops() const noexcept { return _loops; }
+
+  //! Get whether the IR is in SSA form (see `mpIRToSSA()`).
+  MPSL_INLINE bool isSSA() const noexcept { return _isSSA; }
+  MPSL_INLINE void setSSA(bool value) noexcept { _isSSA = value; }
+
+  //! Get whether liveness is computed (see `updateLiveness()`).
+  MPSL_INLINE bool hasLiveness() const noexcept { return _liveness != nullptr; }
+  //! Get the count of 32-bit words of each liveness bit-set.
+  MPSL_INLINE uint32_t liveWords() const noexcept { return _liveWords; }
+
+  //! Get variables live at the beginning of `block` (after its phis), as a
+  //! bit-set indexed by variable ID.
+  MPSL_INLINE const uint32_t* liveIn(const IRBlock* block) const noexcept;
+  //! Get variables live at the end of `block`, including operands of phis of
+  //! its successors, as a bit-set indexed by variable ID.
+  MPSL_INLINE const uint32_t* liveOut(const IRBlock* block) const noexcept;
+
+  //! Get whether `var` is live at the beginning of `block`.
+  MPSL_INLINE bool isLiveIn(const IRBlock* block, const IRReg* var) const noexcept;
+  //! Get whether `var` is live at the end of `block`.
+  MPSL_INLINE bool isLiveOut(const IRBlock* block, const IRReg* var) const noexcept;
+
   MPSL_INLINE IRReg* dataPtr(uint32_t slot) const noexcept {
+    if (slot == kUniformDataSlot) {
+      MPSL_ASSERT(_uniformPtr != nullptr);
+      return _uniformPtr;
+    }
+
     MPSL_ASSERT(slot < _numSlots);
     return _dataSlots[slot];
   }
 
   MPSL_INLINE uint32_t numSlots() const noexcept { return _numSlots; }
+  //! Get the id of the most recently created variable.
+  MPSL_INLINE uint32_t lastVarId() const noexcept { return _varIdGen; }
+
+  //! Get whether the IR is compiled in SPMD mode (see `kOptionSPMD`).
+  MPSL_INLINE bool isSPMD() const noexcept { return _laneIndex != nullptr; }
+  //! Get the number of lanes (records) processed at a time, 1 if not SPMD.
+  MPSL_INLINE uint32_t numLanes() const noexcept { return _numLanes; }
+  //! Get the register that holds the index of the first record (SPMD only).
+  MPSL_INLINE IRReg* laneIndex() const noexcept { return _laneIndex; }
+  //! Get whether the data `slot` is a structure-of-arrays (SPMD only).
+  MPSL_INLINE bool isSoASlot(uint32_t slot) const noexcept { return (_soaSlots & (1u << slot)) != 0; }
+
+  //! Get whether the program reads uniforms (see `initUniforms()`).
+  MPSL_INLINE bool hasUniforms() const noexcept { return _uniformPtr != nullptr; }
+  //! Get the register that holds the address of the uniform block.
+  MPSL_INLINE IRReg* uniformPtr() const noexcept { return _uniformPtr; }
+  //! Get the address of the uniform block.
+  MPSL_INLINE void* uniformData() const noexcept { return _uniformData; }
 
   // --------------------------------------------------------------------------
   // [Factory]
@@ -110,17 +161,40 @@ public:
   IRReg* newVarByTypeInfo(uint32_t typeInfo) noexcept;
 
   IRMem* newMem(IRReg* base, IRReg* index, int32_t offset) noexcept;
+  IRMem* newLaneMem(IRReg* base, int32_t offset, uint32_t shift, uint32_t firstLane) noexcept;
 
   IRImm* newImm(const Value& value, uint32_t reg, uint32_t immSize) noexcept;
   IRImm* newImmByTypeInfo(const Value& value, uint32_t typeInfo) noexcept;
 
   IRBlock* newBlock() noexcept;
   Error connectBlocks(IRBlock* predecessor, IRBlock* successor) noexcept;
+  //! Remove the edge between `predecessor` and `successor`, including the
+  //! operands of `successor` phis that flow through it.
+  void disconnectBlocks(IRBlock* predecessor, IRBlock* successor) noexcept;
+  //! Insert a new block on the edge between `predecessor` and `successor`.
+  //!
+  //! The new block keeps the position of `predecessor` in the predecessors of
+  //! `successor` so operands of its phis don't have to be reordered.
+  Error splitEdge(IRBlock* predecessor, IRBlock* successor, IRBlock** out) noexcept;
+
+  //! Mark `block` as an exit of the program, which falls through to the code
+  //! that follows it.
+  Error addExit(IRBlock* block) noexcept;
 
   MPSL_INLINE IRInst* _newInst(uint32_t instCode, uint32_t opCount) noexcept;
   MPSL_INLINE IRInst* newInst(uint32_t instCode, IRObject* o0) noexcept;
   MPSL_INLINE IRInst* newInst(uint32_t instCode, IRObject* o0, IRObject* o1) noexcept;
   MPSL_INLINE IRInst* newInst(uint32_t instCode, IRObject* o0, IRObject* o1, IRObject* o2) noexcept;
+  MPSL_INLINE IRInst* newInst(uint32_t instCode, IRObject* o0, IRObject* o1, IRObject* o2, IRObject* o3) noexcept;
+
+  //! Create a phi of `var` that merges `count` predecessors, all its operands
+  //! refer to `var` until they are renamed.
+  IRInst* newPhi(IRReg* var, uint32_t count) noexcept;
+  //! Create a move of `src` to `dst`, the whole register is copied.
+  IRInst* newMove(IRReg* dst, IRReg* src) noexcept;
+
+  //! Replace the operand `index` of `inst` by `obj`.
+  void replaceOperand(IRInst* inst, uint32_t index, IRObject* obj) noexcept;
 
   void deleteInst(IRInst* obj) noexcept;
   void deleteObject(IRObject* obj) noexcept;
@@ -131,6 +205,35 @@ public:
   // --------------------------------------------------------------------------
 
   Error initEntry() noexcept;
+  Error initSPMD(uint32_t numLanes, uint32_t soaSlots) noexcept;
+  //! Make `kUniformDataSlot` refer to the uniform block at `data`, which is
+  //! an absolute address the compiled code is bound to.
+  Error initUniforms(void* data) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [CFG]
+  // --------------------------------------------------------------------------
+
+  //! Compute the reverse post-order, dominator tree, dominance frontiers, and
+  //! loop nesting of blocks. Must be called again after the CFG is modified.
+  Error updateCFG() noexcept;
+  //! Delete blocks that can't be reached from the entry and update the CFG.
+  Error removeUnreachableBlocks() noexcept;
+
+  //! Compute variables live at the beginning and at the end of each reachable
+  //! block. The CFG must be up to date. Liveness is released by `updateCFG()`,
+  //! it must be computed again after instructions are added or removed.
+  Error updateLiveness() noexcept;
+  //! Release liveness computed by `updateLiveness()`.
+  void resetLiveness() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [JIT]
+  // --------------------------------------------------------------------------
+
+  //! Reset JIT IDs and assembled flags of all IR objects, required before the
+  //! same IR is compiled again (for example as another function).
+  void resetJitData() noexcept;
 
   // --------------------------------------------------------------------------
   // [Emit]
@@ -139,6 +242,7 @@ public:
   Error emitInst(IRBlock* block, uint32_t instCode, IRObject* o0) noexcept;
   Error emitInst(IRBlock* block, uint32_t instCode, IRObject* o0, IRObject* o1) noexcept;
   Error emitInst(IRBlock* block, uint32_t instCode, IRObject* o0, IRObject* o1, IRObject* o2) noexcept;
+  Error emitInst(IRBlock* block, uint32_t instCode, IRObject* o0, IRObject* o1, IRObject* o2, IRObject* o3) noexcept;
 
   Error emitMove(IRBlock* block, IRReg* dst, IRReg* src) noexcept;
   // TODO: Probably remove.
@@ -157,11 +261,24 @@ public:
   ZoneAllocator* _allocator;             //!< Zone allocator used to allocate IR objects.
   IRBlocks _blocks;                      //!< IR basic blocks.
   IRBlocks _exits;                       //!< IR basic blocks without successors (exits).
+  IRBlocks _rpo;                         //!< Reachable blocks in reverse post-order.
+  IRLoops _loops;                        //!< Natural loops, outer loops first.
+  bool _isSSA;                           //!< The IR is in SSA form.
+
+  uint32_t* _liveness;                   //!< Live-in and live-out bit-sets of each block in `_rpo`.
+  uint32_t _liveWords;                   //!< Count of words of each bit-set.
 
   //! Entry point arguments.
   IRReg* _dataSlots[Globals::kMaxArgumentsCount];
   uint32_t _numSlots;                    //!< Number of entry-point arguments.
 
+  IRReg* _laneIndex;                     //!< Index of the first record (SPMD only).
+  uint32_t _numLanes;                    //!< Number of lanes (1 if not SPMD).
+  uint32_t _soaSlots;                    //!< Mask of structure-of-arrays slots.
+
+  IRReg* _uniformPtr;                    //!< Address of the uniform block, null if none.
+  void* _uniformData;                    //!< Uniform block.
+
   uint32_t _blockIdGen;                  //!< Block ID generator.
   uint32_t _varIdGen;                    //!< Variable ID generator.
 };
@@ -249,6 +366,13 @@ public:
     uint32_t _jitId;                     //!< JIT compiler associated ID.
   };
 
+  struct MemData {
+    uint8_t _objectType;                 //!< Type of the IRObject, see \ref IRObjectType.
+    uint8_t _shift;                      //!< Index shift (scale), only if the memory has index.
+    uint8_t _firstLane;                  //!< First SPMD lane addressed (if indexed by lane).
+    uint8_t _reserved[5];                //!< \internal
+  };
+
   struct ImmData {
     uint8_t _objectType;                 //!< Type of the IRObject, see \ref IRObjectType.
     uint8_t _reg;                        //!< Type of this object, see \ref IRRegType.
@@ -268,6 +392,7 @@ public:
   union {
     AnyData _anyData;
     VarData _varData;
+    MemData _memData;
     ImmData _immData;
     BlockData _blockData;
   };
@@ -343,6 +468,9 @@ public:
       _index(index),
       _offset(offset) {
 
+    _memData._shift = 0;
+    _memData._firstLane = 0;
+
     if (base) base->addRef();
     if (index) index->addRef();
   }
@@ -365,6 +493,11 @@ public:
   //! Get immediate offset.
   MPSL_INLINE int32_t offset() const noexcept { return _offset; }
 
+  //! Get index shift, the index is multiplied by `1 << shift`.
+  MPSL_INLINE uint32_t shift() const noexcept { return _memData._shift; }
+  //! Get the first SPMD lane addressed by this memory operand.
+  MPSL_INLINE uint32_t firstLane() const noexcept { return _memData._firstLane; }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -437,6 +570,12 @@ public:
     : _instCode(instCode),
       _opCount(opCount) {}
 
+  //! Get the size of an instruction that has `opCount` operands, phis can
+  //! have more than `kMaxOperands`.
+  static MPSL_INLINE size_t sizeOf(uint32_t opCount) noexcept {
+    return (sizeof(IRInst) - sizeof(IRObject*)) + sizeof(IRObject*) * opCount;
+  }
+
   // --------------------------------------------------------------------------
   // [Accessors]
   // --------------------------------------------------------------------------
@@ -450,6 +589,16 @@ public:
     return _opArray[index];
   }
 
+  //! Get whether the instruction is a phi (see `IRBlock::phis()`).
+  MPSL_INLINE bool isPhi() const noexcept { return _instCode == kInstCodePhi; }
+
+  //! Get whether the first operand is a register written by the instruction,
+  //! which is true for all instructions except stores and jumps.
+  MPSL_INLINE bool hasDef() const noexcept {
+    const InstInfo& info = mpInstInfo[_instCode & kInstCodeMask];
+    return _opCount != 0 && !info.isStore() && !info.isJxx() && _opArray[0]->isReg();
+  }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -464,8 +613,7 @@ public:
 };
 
 MPSL_INLINE IRInst* IRBuilder::_newInst(uint32_t instCode, uint32_t opCount) noexcept {
-  size_t size = (sizeof(IRInst) - sizeof(IRObject*)) + sizeof(IRObject*) * opCount;
-  void* inst = _allocator->alloc(size);
+  void* inst = _allocator->alloc(IRInst::sizeOf(opCount));
 
   if (inst == nullptr)
     return nullptr;
@@ -511,6 +659,62 @@ MPSL_INLINE IRInst* IRBuilder::newInst(uint32_t instCode, IRObject* o0, IRObject
   return inst;
 }
 
+MPSL_INLINE IRInst* IRBuilder::newInst(uint32_t instCode, IRObject* o0, IRObject* o1, IRObject* o2, IRObject* o3) noexcept {
+  IRInst* inst = _newInst(instCode, 4);
+  if (inst == nullptr) return nullptr;
+
+  inst->_opArray[0] = o0;
+  inst->_opArray[1] = o1;
+  inst->_opArray[2] = o2;
+  inst->_opArray[3] = o3;
+
+  o0->addRef();
+  o1->addRef();
+  o2->addRef();
+  o3->addRef();
+
+  return inst;
+}
+
+//! \internal
+//!
+//! Apply `inst` to the bit-set of variables live after it (indexed by ID), so
+//! it holds variables live before it. Registers that form addresses of memory
+//! operands are uses as well. Must not be used with phis, their operands are
+//! live at the end of predecessors.
+static MPSL_INLINE void mpUpdateLiveBits(uint32_t* bits, const IRInst* inst) noexcept {
+  IRObject** opArray = inst->operands();
+  uint32_t opCount = inst->opCount();
+  uint32_t i = 0;
+
+  MPSL_ASSERT(!inst->isPhi());
+  if (inst->hasDef()) {
+    uint32_t id = opArray[0]->id();
+    bits[id >> 5] &= ~(1u << (id & 31));
+    i = 1;
+  }
+
+  for (; i < opCount; i++) {
+    IRObject* op = opArray[i];
+    IRReg* regs[2] = { nullptr, nullptr };
+
+    if (op->isReg()) {
+      regs[0] = op->as<IRReg>();
+    }
+    else if (op->isMem()) {
+      regs[0] = op->as<IRMem>()->base();
+      regs[1] = op->as<IRMem>()->index();
+    }
+
+    for (uint32_t j = 0; j < 2; j++) {
+      if (regs[j]) {
+        uint32_t id = regs[j]->id();
+        bits[id >> 5] |= 1u << (id & 31);
+      }
+    }
+  }
+}
+
 // ============================================================================
 // [mpsl::IRBlock]
 // ============================================================================
@@ -530,10 +734,20 @@ public:
   // [Construction / Destruction]
   // --------------------------------------------------------------------------
 
+  enum {
+    //! Index of a block that is not reachable from the entry.
+    kInvalidIndex = 0xFFFFFFFFu
+  };
+
   MPSL_INLINE IRBlock(IRBuilder* ir) noexcept
     : IRObject(ir, kTypeBlock),
       _ir(ir),
       _body(),
+      _phis(),
+      _rpoIndex(kInvalidIndex),
+      _domDepth(0),
+      _idom(nullptr),
+      _loop(nullptr),
       _requiresFixup(false) {
     _blockData._blockType = kKindBasic;
     _blockData._isAssembled = false;
@@ -549,6 +763,7 @@ public:
 
   MPSL_INLINE bool isAssembled() const noexcept { return _blockData._isAssembled != 0; }
   MPSL_INLINE void setAssembled() noexcept { _blockData._isAssembled = true; }
+  MPSL_INLINE void resetAssembled() noexcept { _blockData._isAssembled = false; }
 
   MPSL_INLINE uint32_t jitId() const noexcept { return _blockData._jitId; }
   MPSL_INLINE void setJitId(uint32_t id) noexcept { _blockData._jitId = id; }
@@ -570,6 +785,53 @@ public:
   MPSL_INLINE Error append(IRInst* inst) noexcept { return _body.append(_ir->_allocator, inst); }
   MPSL_INLINE Error prepend(IRInst* inst) noexcept { return _body.prepend(_ir->_allocator, inst); }
 
+  //! Get the jump that ends the block, null if the block falls through.
+  MPSL_INLINE IRInst* terminator() const noexcept {
+    if (_body.empty()) return nullptr;
+
+    IRInst* inst = _body[_body.size() - 1];
+    return mpInstInfo[inst->instCode() & kInstCodeMask].isJxx() ? inst : nullptr;
+  }
+
+  //! Insert `inst` before the terminator, or append it if there is none.
+  Error insertBeforeTerminator(IRInst* inst) noexcept;
+
+  MPSL_INLINE bool hasPhis() const noexcept { return !_phis.empty(); }
+  MPSL_INLINE IRBody& phis() noexcept { return _phis; }
+  MPSL_INLINE const IRBody& phis() const noexcept { return _phis; }
+  MPSL_INLINE Error addPhi(IRInst* phi) noexcept { return _phis.append(_ir->_allocator, phi); }
+
+  // --------------------------------------------------------------------------
+  // [CFG]
+  // --------------------------------------------------------------------------
+
+  //! Get whether the block is reachable from the entry (see `IRBuilder::updateCFG()`).
+  MPSL_INLINE bool isReachable() const noexcept { return _rpoIndex != kInvalidIndex; }
+  //! Get the index of the block in `IRBuilder::rpo()`.
+  MPSL_INLINE uint32_t rpoIndex() const noexcept { return _rpoIndex; }
+
+  //! Get the immediate dominator, null for the entry and unreachable blocks.
+  MPSL_INLINE IRBlock* idom() const noexcept { return _idom; }
+  //! Get the depth of the block in the dominator tree, 0 for the entry.
+  MPSL_INLINE uint32_t domDepth() const noexcept { return _domDepth; }
+  //! Get blocks immediately dominated by this block.
+  MPSL_INLINE const IRBlocks& dominated() const noexcept { return _dominated; }
+  //! Get the dominance frontier of the block.
+  MPSL_INLINE const IRBlocks& frontier() const noexcept { return _frontier; }
+
+  //! Get whether this block dominates `other` (a block dominates itself).
+  MPSL_INLINE bool dominates(const IRBlock* other) const noexcept {
+    if (!isReachable() || !other->isReachable())
+      return false;
+
+    while (other->_domDepth > _domDepth)
+      other = other->_idom;
+    return other == this;
+  }
+
+  //! Get the innermost loop that contains this block, null if none.
+  MPSL_INLINE IRLoop* loop() const noexcept { return _loop; }
+
   MPSL_INLINE void neuterAt(size_t i) noexcept {
     MPSL_ASSERT(i < _body.size());
     _body[i] = nullptr;
@@ -591,9 +853,80 @@ public:
   IRBlocks _predecessors;                //!< Block's predecessors.
   IRBlocks _successors;                  //!< Block's successors.
   IRBody _body;                          //!< Block body (instructions).
+  //! Block phis, operand `i + 1` of each phi flows from predecessor `i`.
+  IRBody _phis;
+
+  uint32_t _rpoIndex;                    //!< Index in reverse post-order.
+  uint32_t _domDepth;                    //!< Depth in the dominator tree.
+  IRBlock* _idom;                        //!< Immediate dominator.
+  IRBlocks _dominated;                   //!< Children in the dominator tree.
+  IRBlocks _frontier;                    //!< Dominance frontier.
+  IRLoop* _loop;                         //!< Innermost loop.
+
   bool _requiresFixup;                   //!< Body contains nulls and must be fixed.
 };
 
+MPSL_INLINE const uint32_t* IRBuilder::liveIn(const IRBlock* block) const noexcept {
+  MPSL_ASSERT(hasLiveness() && block->isReachable());
+  return _liveness + static_cast<size_t>(block->rpoIndex()) * 2 * _liveWords;
+}
+
+MPSL_INLINE const uint32_t* IRBuilder::liveOut(const IRBlock* block) const noexcept {
+  return liveIn(block) + _liveWords;
+}
+
+MPSL_INLINE bool IRBuilder::isLiveIn(const IRBlock* block, const IRReg* var) const noexcept {
+  uint32_t id = var->id();
+  return (id >> 5) < _liveWords && (liveIn(block)[id >> 5] & (1u << (id & 31))) != 0;
+}
+
+MPSL_INLINE bool IRBuilder::isLiveOut(const IRBlock* block, const IRReg* var) const noexcept {
+  uint32_t id = var->id();
+  return (id >> 5) < _liveWords && (liveOut(block)[id >> 5] & (1u << (id & 31))) != 0;
+}
+
+// ============================================================================
+// [mpsl::IRLoop]
+// ============================================================================
+
+//! A natural loop.
+//!
+//! The loop is formed by its header and all blocks that reach a back-edge to
+//! the header without passing through it. Loops that share a header are
+//! merged, so each loop has a single header.
+class IRLoop {
+public:
+  MPSL_NONCOPYABLE(IRLoop)
+
+  MPSL_INLINE IRLoop(IRBlock* header) noexcept
+    : _header(header),
+      _parent(nullptr),
+      _depth(1),
+      _blocks() {}
+
+  //! Get the loop header, which dominates all blocks of the loop.
+  MPSL_INLINE IRBlock* header() const noexcept { return _header; }
+  //! Get the loop that contains this loop, null if this is an outermost loop.
+  MPSL_INLINE IRLoop* parent() const noexcept { return _parent; }
+  //! Get the nesting depth, 1 for outermost loops.
+  MPSL_INLINE uint32_t depth() const noexcept { return _depth; }
+  //! Get all blocks of the loop, including blocks of nested loops.
+  MPSL_INLINE const IRBlocks& blocks() const noexcept { return _blocks; }
+
+  //! Get whether `block` is part of this loop or of a loop nested in it.
+  MPSL_INLINE bool contains(const IRBlock* block) const noexcept {
+    for (IRLoop* loop = block->loop(); loop; loop = loop->parent())
+      if (loop == this)
+        return true;
+    return false;
+  }
+
+  IRBlock* _header;                      //!< Loop header.
+  IRLoop* _parent;                       //!< Parent loop.
+  uint32_t _depth;                       //!< Nesting depth.
+  IRBlocks _blocks;                      //!< Loop blocks.
+};
+
 // ============================================================================
 // [mpsl::IRPair]
 // ============================================================================
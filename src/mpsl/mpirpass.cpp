@@ -8,45 +8,2383 @@
 #define MPSL_EXPORTS
 
 // [Dependencies - MPSL]
+#include "./mpfold_p.h"
+#include "./mphash_p.h"
 #include "./mpirpass_p.h"
+#include "./mpmath_p.h"
 
 // [Api-Begin]
 #include "./mpsl_apibegin.h"
 
 namespace mpsl {
 
-static Error mpIRPassBlock(IRBuilder* ir, IRBlock* block) noexcept {
+// ============================================================================
+// [mpsl::IRSCCPState]
+// ============================================================================
+
+//! \internal
+//!
+//! State of the sparse conditional constant propagation (SCCP).
+//!
+//! Each SSA variable starts as unknown and can only be lowered to a constant
+//! and then to varying. Instructions are only evaluated in blocks that are
+//! reached through executable edges, and a branch whose condition is constant
+//! makes only one of its edges executable, so values that flow from code that
+//! never runs don't prevent phis from being constant.
+//!
+//! Variables are indexed by their ID and per-block data by `IRBlock::rpoIndex()`.
+class IRSCCPState {
+public:
+  MPSL_NONCOPYABLE(IRSCCPState)
+
+  //! State of a lattice cell.
+  enum CellState {
+    kCellUnknown = 0,                    //!< Not evaluated yet (optimistic).
+    kCellConst   = 1,                    //!< Always the same constant.
+    kCellVarying = 2                     //!< Not a constant.
+  };
+
+  //! Lattice cell of a variable.
+  struct Cell {
+    uint32_t state;                      //!< Cell state, see \ref CellState.
+    uint32_t typeInfo;                   //!< Type of the constant (only used by dumps).
+    Value value;                         //!< Constant value.
+  };
+
+  //! Instruction that uses a variable.
+  struct Use {
+    IRInst* inst;
+    IRBlock* block;
+  };
+
+  //! CFG edge to be made executable.
+  struct Edge {
+    IRBlock* predecessor;
+    IRBlock* successor;
+  };
+
+  MPSL_INLINE IRSCCPState(IRBuilder* ir) noexcept
+    : _ir(ir),
+      _allocator(ir->allocator()),
+      _numIds(ir->lastVarId() + 1),
+      _numBlocks(static_cast<uint32_t>(ir->rpo().size())),
+      _numUses(0),
+      _numEdges(0),
+      _cells(nullptr),
+      _useIndex(nullptr),
+      _uses(nullptr),
+      _edgeIndex(nullptr),
+      _edgeExecutable(nullptr),
+      _blockExecutable(nullptr) {}
+
+  MPSL_INLINE ~IRSCCPState() noexcept {
+    if (_cells) _allocator->release(_cells, _numIds * sizeof(Cell));
+    if (_useIndex) _allocator->release(_useIndex, (_numIds + 1) * sizeof(uint32_t));
+    if (_uses) _allocator->release(_uses, _numUses * sizeof(Use));
+    if (_edgeIndex) _allocator->release(_edgeIndex, (_numBlocks + 1) * sizeof(uint32_t));
+    if (_edgeExecutable) _allocator->release(_edgeExecutable, _numEdges);
+    if (_blockExecutable) _allocator->release(_blockExecutable, _numBlocks);
+
+    _cfgWork.release(_allocator);
+    _ssaWork.release(_allocator);
+  }
+
+  template<typename T>
+  MPSL_INLINE T* allocZeroed(size_t count) noexcept {
+    T* p = static_cast<T*>(_allocator->alloc(count * sizeof(T)));
+    if (p) ::memset(p, 0, count * sizeof(T));
+    return p;
+  }
+
+  Error init() noexcept;
+  Error solve() noexcept;
+  Error resolveUnknownBranches(bool& resolved) noexcept;
+  Error rewrite() noexcept;
+
+  Error visitBlock(IRBlock* block) noexcept;
+  Error visitPhi(IRBlock* block, IRInst* phi) noexcept;
+  Error visitInst(IRBlock* block, IRInst* inst) noexcept;
+  Error update(IRReg* var, const Cell& cell) noexcept;
+  void evaluate(IRInst* inst, Cell& out) noexcept;
+
+  MPSL_INLINE Error addEdge(IRBlock* predecessor, IRBlock* successor) noexcept {
+    Edge edge;
+    edge.predecessor = predecessor;
+    edge.successor = successor;
+    return _cfgWork.append(_allocator, edge);
+  }
+
+  //! Get the index of the edge in `_edgeExecutable`.
+  MPSL_INLINE uint32_t edgeIndexOf(IRBlock* predecessor, IRBlock* successor) const noexcept {
+    const IRBlocks& predecessors = successor->predecessors();
+    uint32_t i = 0;
+
+    while (predecessors[i] != predecessor)
+      i++;
+    return _edgeIndex[successor->rpoIndex()] + i;
+  }
+
+  MPSL_INLINE bool isExecutable(const IRBlock* block) const noexcept {
+    return block->isReachable() && _blockExecutable[block->rpoIndex()] != 0;
+  }
+
+  //! Get the cell of `op`, `scratch` holds the cell of an immediate.
+  MPSL_INLINE const Cell& cellOf(IRObject* op, Cell& scratch) const noexcept {
+    if (op->isReg() && op->id() < _numIds)
+      return _cells[op->id()];
+
+    scratch.typeInfo = kTypeVoid;
+    if (op->isImm()) {
+      scratch.state = kCellConst;
+      scratch.typeInfo = op->as<IRImm>()->typeInfo();
+      scratch.value = op->as<IRImm>()->value();
+    }
+    else {
+      scratch.state = kCellVarying;
+    }
+    return scratch;
+  }
+
+  IRBuilder* _ir;
+  ZoneAllocator* _allocator;
+
+  uint32_t _numIds;                      //!< Number of variable IDs (including 0).
+  uint32_t _numBlocks;                   //!< Reachable blocks.
+  uint32_t _numUses;                     //!< Number of uses of all variables.
+  uint32_t _numEdges;                    //!< Number of edges into reachable blocks.
+
+  Cell* _cells;                          //!< Lattice cell of each variable.
+  uint32_t* _useIndex;                   //!< Index of the first use of each variable in `_uses`.
+  Use* _uses;                            //!< Uses of all variables, grouped by variable.
+  uint32_t* _edgeIndex;                  //!< Index of the first incoming edge of each block.
+  uint8_t* _edgeExecutable;              //!< Whether an edge is executable.
+  uint8_t* _blockExecutable;             //!< Whether a block is executable.
+
+  ZoneVector<Edge> _cfgWork;             //!< Edges that became executable.
+  ZoneVector<uint32_t> _ssaWork;         //!< Variables whose cell was lowered.
+};
+
+//! \internal
+//!
+//! Get the index of the first operand of `inst` that is read.
+static MPSL_INLINE uint32_t mpFirstUseOf(const IRInst* inst) noexcept {
+  return inst->hasDef() ? 1 : 0;
+}
+
+//! \internal
+//!
+//! Get the type of a constant computed by `instCode` into a `width` wide
+//! register, which is only used to dump it.
+static uint32_t mpTypeInfoOfConst(uint32_t instCode, uint32_t width) noexcept {
+  const InstInfo& info = mpInstInfo[instCode & kInstCodeMask];
+  uint32_t kinds = info.flags() & (kInstInfoI32 | kInstInfoF32 | kInstInfoF64);
+
+  uint32_t typeId = kTypeInt;
+  uint32_t size = 4;
+
+  if (kinds == kInstInfoF32) {
+    typeId = kTypeFloat;
+  }
+  else if (kinds == kInstInfoF64) {
+    typeId = kTypeDouble;
+    size = 8;
+  }
+
+  uint32_t count = mpMax<uint32_t>(width / size, 1);
+  return typeId | (count << kTypeVecShift);
+}
+
+//! \internal
+//!
+//! Get whether `Jnz` or `Jany` that tests the constant `cond` jumps to its
+//! first target.
+static MPSL_INLINE bool mpIsBranchTaken(const IRInst* inst, const Value& cond) noexcept {
+  if (inst->instCode() == kInstCodeJnz)
+    return cond.u[0] != 0;
+
+  // `Jany` tests the sign bit of each 32-bit element of the register.
+  uint32_t count = static_cast<IRReg*>(inst->op(0))->width() / 4;
+  for (uint32_t i = 0; i < count; i++)
+    if (cond.u[i] & 0x80000000u)
+      return true;
+  return false;
+}
+
+Error IRSCCPState::init() noexcept {
+  const IRBlocks& rpo = _ir->rpo();
+
+  _cells = static_cast<Cell*>(_allocator->alloc(_numIds * sizeof(Cell)));
+  _useIndex = allocZeroed<uint32_t>(_numIds + 1);
+  _edgeIndex = allocZeroed<uint32_t>(_numBlocks + 1);
+  _blockExecutable = allocZeroed<uint8_t>(_numBlocks);
+  MPSL_NULLCHECK(_cells && _useIndex && _edgeIndex && _blockExecutable);
+
+  // Variables that are not assigned (like arguments) are never constant.
+  for (uint32_t id = 0; id < _numIds; id++) {
+    _cells[id].state = kCellVarying;
+    _cells[id].typeInfo = kTypeVoid;
+    _cells[id].value.zero();
+  }
+
+  for (uint32_t b = 0; b < _numBlocks; b++) {
+    IRBlock* block = rpo[b];
+
+    _edgeIndex[b] = _numEdges;
+    _numEdges += static_cast<uint32_t>(block->predecessors().size());
+
+    for (int k = 0; k < 2; k++) {
+      for (IRInst* inst : k == 0 ? block->phis() : block->body()) {
+        IRObject** opArray = inst->operands();
+        uint32_t opCount = inst->opCount();
+
+        if (inst->hasDef())
+          _cells[opArray[0]->id()].state = kCellUnknown;
+
+        for (uint32_t i = mpFirstUseOf(inst); i < opCount; i++) {
+          if (opArray[i]->isReg()) {
+            _useIndex[opArray[i]->id() + 1]++;
+            _numUses++;
+          }
+        }
+      }
+    }
+  }
+  _edgeIndex[_numBlocks] = _numEdges;
+
+  _uses = static_cast<Use*>(_allocator->alloc(mpMax<uint32_t>(_numUses, 1) * sizeof(Use)));
+  _edgeExecutable = allocZeroed<uint8_t>(mpMax<uint32_t>(_numEdges, 1));
+  MPSL_NULLCHECK(_uses && _edgeExecutable);
+
+  // `_useIndex[id + 1]` is advanced while uses are stored, which makes it the
+  // start of the uses of `id + 1` once all of them are stored.
+  for (uint32_t id = 1; id <= _numIds; id++)
+    _useIndex[id] += _useIndex[id - 1];
+
+  for (uint32_t b = 0; b < _numBlocks; b++) {
+    IRBlock* block = rpo[b];
+
+    for (int k = 0; k < 2; k++) {
+      for (IRInst* inst : k == 0 ? block->phis() : block->body()) {
+        IRObject** opArray = inst->operands();
+        uint32_t opCount = inst->opCount();
+
+        for (uint32_t i = mpFirstUseOf(inst); i < opCount; i++) {
+          if (opArray[i]->isReg()) {
+            Use& use = _uses[_useIndex[opArray[i]->id()]++];
+            use.inst = inst;
+            use.block = block;
+          }
+        }
+      }
+    }
+  }
+
+  for (uint32_t id = _numIds; id > 0; id--)
+    _useIndex[id] = _useIndex[id - 1];
+  _useIndex[0] = 0;
+
+  return kErrorOk;
+}
+
+Error IRSCCPState::update(IRReg* var, const Cell& cell) noexcept {
+  Cell& cur = _cells[var->id()];
+  if (cur.state == kCellVarying || cell.state == kCellUnknown)
+    return kErrorOk;
+
+  if (cur.state == kCellConst) {
+    if (cell.state == kCellConst && ::memcmp(&cur.value, &cell.value, var->width()) == 0)
+      return kErrorOk;
+    cur.state = kCellVarying;
+  }
+  else {
+    cur = cell;
+  }
+
+  return _ssaWork.append(_allocator, var->id());
+}
+
+void IRSCCPState::evaluate(IRInst* inst, Cell& out) noexcept {
+  uint32_t instCode = inst->instCode();
+  const InstInfo& info = mpInstInfo[instCode & kInstCodeMask];
+
+  IRObject** opArray = inst->operands();
+  uint32_t opCount = inst->opCount();
+  uint32_t width = opArray[0]->as<IRReg>()->width();
+
+  out.state = kCellVarying;
+  out.typeInfo = kTypeVoid;
+  out.value.zero();
+
+  if (info.isFetch()) {
+    // Only a fetch of an immediate is constant, `Insert` merges a memory
+    // operand into the register.
+    if (opCount != 2 || !opArray[1]->isImm())
+      return;
+
+    size_t size;
+    switch (instCode) {
+      case kInstCodeFetch32 : size =  4; break;
+      case kInstCodeFetch64 : size =  8; break;
+      case kInstCodeFetch96 : size = 12; break;
+      case kInstCodeFetch128: size = 16; break;
+      case kInstCodeFetch192: size = 24; break;
+      case kInstCodeFetch256: size = 32; break;
+
+      default:
+        return;
+    }
+
+    IRImm* imm = opArray[1]->as<IRImm>();
+    ::memcpy(&out.value, &imm->value(), size);
+
+    out.state = kCellConst;
+    out.typeInfo = imm->typeInfo();
+    return;
+  }
+
+  if (info.isCall() || (opCount != 2 && opCount != 3))
+    return;
+
+  Cell sScratch, rScratch;
+  const Cell& s = cellOf(opArray[1], sScratch);
+  const Cell& r = opCount == 3 ? cellOf(opArray[2], rScratch) : s;
+
+  if (s.state == kCellVarying || r.state == kCellVarying)
+    return;
+
+  if (s.state == kCellUnknown || r.state == kCellUnknown) {
+    out.state = kCellUnknown;
+    return;
+  }
+
+  // Instructions that can't be folded by `Fold::foldInst()` are varying.
+  Error err = opCount == 2 ? Fold::foldInst(instCode, out.value, s.value)
+                           : Fold::foldInst(instCode, out.value, s.value, r.value);
+  if (err != kErrorOk)
+    return;
+
+  out.state = kCellConst;
+  out.typeInfo = (info.flags() & kInstInfoMov) ? s.typeInfo : mpTypeInfoOfConst(instCode, width);
+}
+
+Error IRSCCPState::visitPhi(IRBlock* block, IRInst* phi) noexcept {
+  IRReg* dst = phi->op(0)->as<IRReg>();
+  uint32_t edgeIndex = _edgeIndex[block->rpoIndex()];
+
+  Cell out;
+  out.state = kCellUnknown;
+  out.typeInfo = kTypeVoid;
+  out.value.zero();
+
+  // Only operands that flow through executable edges are merged.
+  for (uint32_t i = 1; i < phi->opCount() && out.state != kCellVarying; i++) {
+    if (!_edgeExecutable[edgeIndex + i - 1])
+      continue;
+
+    Cell scratch;
+    const Cell& cell = cellOf(phi->op(i), scratch);
+
+    if (cell.state == kCellUnknown)
+      continue;
+
+    if (cell.state == kCellVarying)
+      out.state = kCellVarying;
+    else if (out.state == kCellUnknown)
+      out = cell;
+    else if (::memcmp(&out.value, &cell.value, dst->width()) != 0)
+      out.state = kCellVarying;
+  }
+
+  return update(dst, out);
+}
+
+Error IRSCCPState::visitInst(IRBlock* block, IRInst* inst) noexcept {
+  uint32_t instCode = inst->instCode();
+  const InstInfo& info = mpInstInfo[instCode & kInstCodeMask];
+
+  if (info.isJxx()) {
+    if (instCode == kInstCodeJmp)
+      return addEdge(block, inst->op(0)->as<IRBlock>());
+
+    Cell scratch;
+    const Cell& cond = cellOf(inst->op(0), scratch);
+
+    if (cond.state == kCellUnknown)
+      return kErrorOk;
+
+    IRBlock* thenBlock = inst->op(1)->as<IRBlock>();
+    IRBlock* elseBlock = inst->op(2)->as<IRBlock>();
+
+    if (cond.state == kCellConst)
+      return addEdge(block, mpIsBranchTaken(inst, cond.value) ? thenBlock : elseBlock);
+
+    MPSL_PROPAGATE(addEdge(block, thenBlock));
+    return addEdge(block, elseBlock);
+  }
+
+  if (!inst->hasDef())
+    return kErrorOk;
+
+  Cell out;
+  evaluate(inst, out);
+  return update(inst->op(0)->as<IRReg>(), out);
+}
+
+Error IRSCCPState::visitBlock(IRBlock* block) noexcept {
+  for (IRInst* phi : block->phis())
+    MPSL_PROPAGATE(visitPhi(block, phi));
+
+  for (IRInst* inst : block->body())
+    MPSL_PROPAGATE(visitInst(block, inst));
+
+  // A block without a jump falls through to all its successors.
+  if (!block->terminator()) {
+    for (IRBlock* successor : block->successors())
+      MPSL_PROPAGATE(addEdge(block, successor));
+  }
+
+  return kErrorOk;
+}
+
+Error IRSCCPState::solve() noexcept {
+  for (;;) {
+    if (!_cfgWork.empty()) {
+      Edge edge = _cfgWork[_cfgWork.size() - 1];
+      _cfgWork.truncate(_cfgWork.size() - 1);
+
+      IRBlock* block = edge.successor;
+      uint32_t index = edgeIndexOf(edge.predecessor, block);
+
+      if (_edgeExecutable[index])
+        continue;
+      _edgeExecutable[index] = 1;
+
+      // Phis of a block that was already visited only have a new operand.
+      if (_blockExecutable[block->rpoIndex()]) {
+        for (IRInst* phi : block->phis())
+          MPSL_PROPAGATE(visitPhi(block, phi));
+      }
+      else {
+        _blockExecutable[block->rpoIndex()] = 1;
+        MPSL_PROPAGATE(visitBlock(block));
+      }
+    }
+    else if (!_ssaWork.empty()) {
+      uint32_t id = _ssaWork[_ssaWork.size() - 1];
+      _ssaWork.truncate(_ssaWork.size() - 1);
+
+      for (uint32_t i = _useIndex[id], end = _useIndex[id + 1]; i < end; i++) {
+        const Use& use = _uses[i];
+        if (!_blockExecutable[use.block->rpoIndex()])
+          continue;
+
+        if (use.inst->isPhi())
+          MPSL_PROPAGATE(visitPhi(use.block, use.inst));
+        else
+          MPSL_PROPAGATE(visitInst(use.block, use.inst));
+      }
+    }
+    else {
+      return kErrorOk;
+    }
+  }
+}
+
+// A condition can stay unknown if it depends only on values that are never
+// assigned on any executed path. Such branch would leave both of its targets
+// unvisited, so its condition is made varying and the solver continues.
+Error IRSCCPState::resolveUnknownBranches(bool& resolved) noexcept {
+  resolved = false;
+
+  for (IRBlock* block : _ir->rpo()) {
+    IRInst* term = block->terminator();
+    if (!_blockExecutable[block->rpoIndex()] || !term || term->instCode() == kInstCodeJmp)
+      continue;
+
+    IRObject* cond = term->op(0);
+    if (cond->isReg() && cond->id() < _numIds && _cells[cond->id()].state == kCellUnknown) {
+      _cells[cond->id()].state = kCellVarying;
+      MPSL_PROPAGATE(_ssaWork.append(_allocator, cond->id()));
+      resolved = true;
+    }
+  }
+
+  return kErrorOk;
+}
+
+//! \internal
+//!
+//! Create an instruction that fetches the constant `cell` to `dst`.
+static IRInst* mpNewConstFetch(IRBuilder* ir, IRReg* dst, const IRSCCPState::Cell& cell) noexcept {
+  uint32_t instCode;
+  uint32_t width = dst->width();
+
+  if (width <= 4) {
+    instCode = kInstCodeFetch32;
+    width = 4;
+  }
+  else if (width <= 8) {
+    instCode = kInstCodeFetch64;
+    width = 8;
+  }
+  else if (width <= 16) {
+    instCode = kInstCodeFetch128;
+    width = 16;
+  }
+  else {
+    instCode = kInstCodeFetch256;
+    width = 32;
+  }
+
+  // Bytes that are not part of the register are zeroed so equal constants
+  // share the same constant pool entry.
+  Value value;
+  value.zero();
+  ::memcpy(&value, &cell.value, dst->width());
+
+  IRImm* imm = ir->newImm(value, dst->reg(), width);
+  if (imm == nullptr) return nullptr;
+
+  imm->setTypeInfo(cell.typeInfo);
+  return ir->newInst(instCode, dst, imm);
+}
+
+Error IRSCCPState::rewrite() noexcept {
+  bool cfgChanged = false;
+
+  for (IRBlock* block : _ir->rpo()) {
+    // Blocks that never execute are removed by `removeUnreachableBlocks()`.
+    if (!_blockExecutable[block->rpoIndex()])
+      continue;
+
+    // Constant phis become fetches at the beginning of the block.
+    IRBody& phis = block->phis();
+    size_t phiIndex = 0;
+
+    for (size_t i = 0, size = phis.size(); i < size; i++) {
+      IRInst* phi = phis[i];
+      IRReg* dst = phi->op(0)->as<IRReg>();
+      const Cell& cell = _cells[dst->id()];
+
+      if (cell.state != kCellConst) {
+        phis[phiIndex++] = phi;
+        continue;
+      }
+
+      IRInst* fetch = mpNewConstFetch(_ir, dst, cell);
+      MPSL_NULLCHECK(fetch);
+
+      MPSL_PROPAGATE(block->prepend(fetch));
+      _ir->deleteInst(phi);
+    }
+    phis.truncate(phiIndex);
+
+    IRBody& body = block->body();
+    for (size_t i = 0, size = body.size(); i < size; i++) {
+      IRInst* inst = body[i];
+      if (!inst->hasDef())
+        continue;
+
+      IRReg* dst = inst->op(0)->as<IRReg>();
+      const Cell& cell = _cells[dst->id()];
+
+      if (cell.state != kCellConst)
+        continue;
+
+      if (mpInstInfo[inst->instCode() & kInstCodeMask].isFetch() && inst->op(1)->isImm())
+        continue;
+
+      // The fetch references `dst` before `inst` releases it.
+      IRInst* fetch = mpNewConstFetch(_ir, dst, cell);
+      MPSL_NULLCHECK(fetch);
+
+      body[i] = fetch;
+      _ir->deleteInst(inst);
+    }
+
+    // A branch with a constant condition becomes a jump, the edge that is not
+    // taken is removed together with the phi operands that flow through it.
+    IRInst* term = block->terminator();
+    if (!term || term->instCode() == kInstCodeJmp)
+      continue;
+
+    Cell scratch;
+    const Cell& cond = cellOf(term->op(0), scratch);
+    if (cond.state != kCellConst)
+      continue;
+
+    IRBlock* thenBlock = term->op(1)->as<IRBlock>();
+    IRBlock* elseBlock = term->op(2)->as<IRBlock>();
+
+    bool taken = mpIsBranchTaken(term, cond.value);
+    IRBlock* target = taken ? thenBlock : elseBlock;
+    IRBlock* other = taken ? elseBlock : thenBlock;
+
+    IRInst* jmp = _ir->newInst(kInstCodeJmp, target);
+    MPSL_NULLCHECK(jmp);
+
+    body[body.size() - 1] = jmp;
+    _ir->deleteInst(term);
+
+    if (other != target)
+      _ir->disconnectBlocks(block, other);
+    cfgChanged = true;
+  }
+
+  if (cfgChanged)
+    MPSL_PROPAGATE(_ir->removeUnreachableBlocks());
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::mpIRPropagateConstants]
+// ============================================================================
+
+//! \internal
+//!
+//! Propagate constants through the IR, which must be in SSA form.
+//!
+//! Instructions that always compute the same value are replaced by a fetch of
+//! that value, and branches whose condition is always the same become jumps,
+//! which removes blocks that are never executed.
+static Error mpIRPropagateConstants(IRBuilder* ir) noexcept {
+  MPSL_ASSERT(ir->isSSA());
+  if (ir->rpo().empty())
+    return kErrorOk;
+
+  IRSCCPState state(ir);
+  MPSL_PROPAGATE(state.init());
+
+  IRBlock* entry = ir->entryBlock();
+  state._blockExecutable[entry->rpoIndex()] = 1;
+  MPSL_PROPAGATE(state.visitBlock(entry));
+
+  for (;;) {
+    bool resolved;
+    MPSL_PROPAGATE(state.solve());
+    MPSL_PROPAGATE(state.resolveUnknownBranches(resolved));
+
+    if (!resolved)
+      break;
+  }
+
+  return state.rewrite();
+}
+
+// ============================================================================
+// [mpsl::IRDivState]
+// ============================================================================
+
+//! \internal
+//!
+//! State of the reduction of divisions by constants.
+//!
+//! A signed integer division by a constant `d` is replaced by a signed
+//! multiplication by a magic number that keeps the high 32 bits of the
+//! product (`Pmulhsd`), followed by shifts that correct the result so it is
+//! truncated toward zero (see Hacker's Delight, chapter 10). Division by a
+//! power of two only needs shifts. Modulo is computed from the quotient as
+//! `n - q * d`. There is no x86 instruction that divides packed integers and
+//! `idiv` is slow, so this is both the only and the fastest way to divide.
+//!
+//! A float division by a power of two becomes a multiplication by its
+//! reciprocal, which is exact if the reciprocal is a normal number.
+//!
+//! Vector divisions are only reduced if all elements of the divisor are
+//! equal. The IR must be in SSA form so a variable assigned by a fetch of an
+//! immediate is the same constant wherever it's used.
+class IRDivState {
+public:
+  MPSL_NONCOPYABLE(IRDivState)
+
+  MPSL_INLINE IRDivState(IRBuilder* ir) noexcept
+    : _ir(ir),
+      _allocator(ir->allocator()),
+      _numIds(ir->lastVarId() + 1),
+      _consts(nullptr),
+      _inst(nullptr) {}
+
+  MPSL_INLINE ~IRDivState() noexcept {
+    if (_consts) _allocator->release(_consts, _numIds * sizeof(IRImm*));
+    _body.release(_allocator);
+  }
+
+  Error init() noexcept;
+  Error run() noexcept;
+
+  Error reduceIntDivision(IRInst* inst, int32_t d) noexcept;
+  Error reduceFloatDivision(IRInst* inst, const Value& reciprocal) noexcept;
+
+  IRReg* emit(uint32_t instCode, IRObject* o1, IRObject* o2) noexcept;
+  IRReg* newConst(int32_t value) noexcept;
+  IRObject* newOperand(int32_t value) noexcept;
+  IRImm* newShift(uint32_t count) noexcept;
+
+  //! Get the constant `op` holds, null if it's not known to be a constant.
+  MPSL_INLINE IRImm* constOf(IRObject* op) const noexcept {
+    if (op->isImm())
+      return op->as<IRImm>();
+
+    if (op->isReg() && op->id() < _numIds)
+      return _consts[op->id()];
+
+    return nullptr;
+  }
+
+  IRBuilder* _ir;
+  ZoneAllocator* _allocator;
+
+  uint32_t _numIds;                      //!< Number of variable IDs (including 0).
+  IRImm** _consts;                       //!< Constant fetched to each variable.
+
+  IRInst* _inst;                         //!< Division being reduced.
+  IRBody _body;                          //!< Body of the block being rewritten.
+};
+
+//! \internal
+//!
+//! Get the magic number and the shift that divide a signed 32-bit integer by
+//! `d`, which must not be 0, 1, or -1 (Hacker's Delight, figure 10-1).
+static void mpSignedMagic(int32_t d, int32_t& magic, uint32_t& shift) noexcept {
+  const uint32_t two31 = 0x80000000u;
+
+  uint32_t ad = d < 0 ? 0u - static_cast<uint32_t>(d) : static_cast<uint32_t>(d);
+  uint32_t t = two31 + (static_cast<uint32_t>(d) >> 31);
+  uint32_t anc = t - 1 - t % ad;
+
+  uint32_t p = 31;
+  uint32_t q1 = two31 / anc;
+  uint32_t r1 = two31 - q1 * anc;
+  uint32_t q2 = two31 / ad;
+  uint32_t r2 = two31 - q2 * ad;
+  uint32_t delta;
+
+  do {
+    p++;
+
+    q1 *= 2;
+    r1 *= 2;
+    if (r1 >= anc) {
+      q1++;
+      r1 -= anc;
+    }
+
+    q2 *= 2;
+    r2 *= 2;
+    if (r2 >= ad) {
+      q2++;
+      r2 -= ad;
+    }
+
+    delta = ad - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+
+  uint32_t m = q2 + 1;
+  magic = static_cast<int32_t>(d < 0 ? 0u - m : m);
+  shift = p - 32;
+}
+
+//! \internal
+//!
+//! Get the divisor all `count` elements of `value` are equal to, false if
+//! they differ.
+static bool mpSplatI32(const Value& value, uint32_t count, int32_t& d) noexcept {
+  d = value.i[0];
+  for (uint32_t i = 1; i < count; i++)
+    if (value.i[i] != d)
+      return false;
+  return true;
+}
+
+//! \internal
+//!
+//! Get the reciprocals of `count` floats or doubles of `value`, false if any
+//! of them is not a power of two that has a normal reciprocal.
+static bool mpExactReciprocal(const Value& value, uint32_t count, bool isF64, Value& out) noexcept {
+  out.zero();
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (isF64) {
+      uint64_t bits = value.q[i];
+      uint32_t exp = static_cast<uint32_t>(bits >> 52) & 0x7FFu;
+
+      if ((bits & 0x000FFFFFFFFFFFFFu) != 0 || exp < 1 || exp > 2045)
+        return false;
+      out.q[i] = (bits & 0x8000000000000000u) | (static_cast<uint64_t>(2046 - exp) << 52);
+    }
+    else {
+      uint32_t bits = value.u[i];
+      uint32_t exp = (bits >> 23) & 0xFFu;
+
+      if ((bits & 0x007FFFFFu) != 0 || exp < 1 || exp > 253)
+        return false;
+      out.u[i] = (bits & 0x80000000u) | ((254 - exp) << 23);
+    }
+  }
+
+  return true;
+}
+
+Error IRDivState::init() noexcept {
+  _consts = static_cast<IRImm**>(_allocator->allocZeroed(_numIds * sizeof(IRImm*)));
+  MPSL_NULLCHECK(_consts);
+
+  for (IRBlock* block : _ir->rpo()) {
+    for (IRInst* inst : block->body()) {
+      const InstInfo& info = mpInstInfo[inst->instCode() & kInstCodeMask];
+      if (info.isFetch() && inst->hasDef() && inst->op(1)->isImm())
+        _consts[inst->op(0)->id()] = inst->op(1)->as<IRImm>();
+    }
+  }
+
+  return kErrorOk;
+}
+
+IRReg* IRDivState::emit(uint32_t instCode, IRObject* o1, IRObject* o2) noexcept {
+  IRReg* like = _inst->op(0)->as<IRReg>();
+  IRReg* dst = _ir->newVar(like->reg(), like->width());
+  if (dst == nullptr) return nullptr;
+
+  IRInst* inst = _ir->newInst(instCode | (_inst->instCode() & kInstVecMask), dst, o1, o2);
+  if (inst == nullptr) return nullptr;
+
+  if (_body.append(_allocator, inst) != kErrorOk)
+    return nullptr;
+  return dst;
+}
+
+IRReg* IRDivState::newConst(int32_t value) noexcept {
+  IRReg* like = _inst->op(0)->as<IRReg>();
+  IRReg* dst = _ir->newVar(like->reg(), like->width());
+  if (dst == nullptr) return nullptr;
+
+  IRSCCPState::Cell cell;
+  cell.state = IRSCCPState::kCellConst;
+  cell.typeInfo = mpTypeInfoOfConst(_inst->instCode(), like->width());
+  cell.value.zero();
+  cell.value.i.set(value);
+
+  IRInst* inst = mpNewConstFetch(_ir, dst, cell);
+  if (inst == nullptr) return nullptr;
+
+  if (_body.append(_allocator, inst) != kErrorOk)
+    return nullptr;
+  return dst;
+}
+
+IRObject* IRDivState::newOperand(int32_t value) noexcept {
+  // Scalar integer instructions accept an immediate as their last operand.
+  if (_inst->op(0)->as<IRReg>()->reg() == IRReg::kKindGp) {
+    Value v;
+    v.zero();
+    v.i[0] = value;
+    return _ir->newImmByTypeInfo(v, kTypeInt);
+  }
+
+  return newConst(value);
+}
+
+IRImm* IRDivState::newShift(uint32_t count) noexcept {
+  Value v;
+  v.zero();
+  v.i[0] = static_cast<int32_t>(count);
+  return _ir->newImmByTypeInfo(v, kTypeInt);
+}
+
+Error IRDivState::reduceIntDivision(IRInst* inst, int32_t d) noexcept {
+  _inst = inst;
+
+  bool isMod = (inst->instCode() & kInstCodeMask) == kInstCodePmodsd;
+  IRReg* n = inst->op(1)->as<IRReg>();
+  IRReg* q = n;
+  IRImm* count;
+
+  uint32_t ad = d < 0 ? 0u - static_cast<uint32_t>(d) : static_cast<uint32_t>(d);
+  if ((ad & (ad - 1)) == 0) {
+    uint32_t k = 0;
+    while ((ad >> k) != 1)
+      k++;
+
+    if (k != 0) {
+      // Negative dividends are biased by `2^k - 1` so the arithmetic shift
+      // rounds toward zero.
+      IRReg* bias = n;
+      if (k != 1) {
+        count = newShift(31);
+        MPSL_NULLCHECK(count);
+
+        bias = emit(kInstCodePsrad, n, count);
+        MPSL_NULLCHECK(bias);
+      }
+
+      count = newShift(32 - k);
+      MPSL_NULLCHECK(count);
+
+      bias = emit(kInstCodePsrld, bias, count);
+      MPSL_NULLCHECK(bias);
+
+      q = emit(kInstCodePaddd, n, bias);
+      MPSL_NULLCHECK(q);
+
+      if (isMod) {
+        // The remainder has the sign of the dividend, the sign of the divisor
+        // doesn't matter: `n - ((n + bias) & -2^k)`.
+        IRObject* mask = newOperand(static_cast<int32_t>(0u - ad));
+        MPSL_NULLCHECK(mask);
+
+        q = emit(kInstCodeAndi, q, mask);
+        MPSL_NULLCHECK(q);
+      }
+      else {
+        count = newShift(k);
+        MPSL_NULLCHECK(count);
+
+        q = emit(kInstCodePsrad, q, count);
+        MPSL_NULLCHECK(q);
+      }
+    }
+
+    if (isMod) {
+      q = emit(kInstCodePsubd, n, q);
+      MPSL_NULLCHECK(q);
+    }
+    else if (d < 0) {
+      IRReg* zero = newConst(0);
+      MPSL_NULLCHECK(zero);
+
+      q = emit(kInstCodePsubd, zero, q);
+      MPSL_NULLCHECK(q);
+    }
+  }
+  else {
+    int32_t magic;
+    uint32_t shift;
+    mpSignedMagic(d, magic, shift);
+
+    IRObject* m = newOperand(magic);
+    MPSL_NULLCHECK(m);
+
+    q = emit(kInstCodePmulhsd, n, m);
+    MPSL_NULLCHECK(q);
+
+    // The magic number doesn't fit into a signed integer if its sign differs
+    // from the sign of the divisor, which is compensated by adding `n * 2^32`.
+    if (d > 0 && magic < 0) {
+      q = emit(kInstCodePaddd, q, n);
+      MPSL_NULLCHECK(q);
+    }
+    else if (d < 0 && magic > 0) {
+      q = emit(kInstCodePsubd, q, n);
+      MPSL_NULLCHECK(q);
+    }
+
+    if (shift != 0) {
+      count = newShift(shift);
+      MPSL_NULLCHECK(count);
+
+      q = emit(kInstCodePsrad, q, count);
+      MPSL_NULLCHECK(q);
+    }
+
+    // Add one to negative quotients to round toward zero.
+    count = newShift(31);
+    MPSL_NULLCHECK(count);
+
+    IRReg* sign = emit(kInstCodePsrld, q, count);
+    MPSL_NULLCHECK(sign);
+
+    q = emit(kInstCodePaddd, q, sign);
+    MPSL_NULLCHECK(q);
+
+    if (isMod) {
+      q = emit(kInstCodePmuld, q, inst->op(2));
+      MPSL_NULLCHECK(q);
+
+      q = emit(kInstCodePsubd, n, q);
+      MPSL_NULLCHECK(q);
+    }
+  }
+
+  // The copy is removed by value numbering.
+  IRInst* move = _ir->newMove(inst->op(0)->as<IRReg>(), q);
+  MPSL_NULLCHECK(move);
+  return _body.append(_allocator, move);
+}
+
+Error IRDivState::reduceFloatDivision(IRInst* inst, const Value& reciprocal) noexcept {
+  _inst = inst;
+
+  IRReg* dst = inst->op(0)->as<IRReg>();
+  IRReg* r = _ir->newVar(dst->reg(), dst->width());
+  MPSL_NULLCHECK(r);
+
+  IRSCCPState::Cell cell;
+  cell.state = IRSCCPState::kCellConst;
+  cell.typeInfo = mpTypeInfoOfConst(inst->instCode(), dst->width());
+  cell.value = reciprocal;
+
+  IRInst* fetch = mpNewConstFetch(_ir, r, cell);
+  MPSL_NULLCHECK(fetch);
+  MPSL_PROPAGATE(_body.append(_allocator, fetch));
+
+  uint32_t instCode = (inst->instCode() & kInstCodeMask) == kInstCodeDivf ? kInstCodeMulf : kInstCodeMuld;
+  IRInst* mul = _ir->newInst(instCode | (inst->instCode() & kInstVecMask), dst, inst->op(1), r);
+  MPSL_NULLCHECK(mul);
+  return _body.append(_allocator, mul);
+}
+
+Error IRDivState::run() noexcept {
+  for (IRBlock* block : _ir->rpo()) {
+    IRBody& body = block->body();
+    bool changed = false;
+
+    _body.reset();
+    for (IRInst* inst : body) {
+      uint32_t instCode = inst->instCode() & kInstCodeMask;
+      IRImm* divisor = nullptr;
+
+      if (instCode == kInstCodePdivsd || instCode == kInstCodePmodsd ||
+          instCode == kInstCodeDivf   || instCode == kInstCodeDivd)
+        divisor = constOf(inst->op(2));
+
+      if (divisor) {
+        uint32_t width = inst->op(0)->as<IRReg>()->width();
+
+        if (instCode == kInstCodeDivf || instCode == kInstCodeDivd) {
+          bool isF64 = instCode == kInstCodeDivd;
+          Value reciprocal;
+
+          if (mpExactReciprocal(divisor->value(), width / (isF64 ? 8 : 4), isF64, reciprocal)) {
+            MPSL_PROPAGATE(reduceFloatDivision(inst, reciprocal));
+            _ir->deleteInst(inst);
+
+            changed = true;
+            continue;
+          }
+        }
+        else {
+          int32_t d;
+
+          // Division by zero is left to fault at runtime.
+          if (inst->op(1)->isReg() && mpSplatI32(divisor->value(), width / 4, d) && d != 0) {
+            MPSL_PROPAGATE(reduceIntDivision(inst, d));
+            _ir->deleteInst(inst);
+
+            changed = true;
+            continue;
+          }
+        }
+      }
+
+      MPSL_PROPAGATE(_body.append(_allocator, inst));
+    }
+
+    if (changed) {
+      body.reset();
+      for (IRInst* inst : _body)
+        MPSL_PROPAGATE(body.append(_allocator, inst));
+    }
+  }
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::mpIRReduceDivisions]
+// ============================================================================
+
+//! \internal
+//!
+//! Replace divisions and modulo by constants with cheaper instructions, see
+//! `IRDivState`. The IR must be in SSA form.
+static Error mpIRReduceDivisions(IRBuilder* ir) noexcept {
+  MPSL_ASSERT(ir->isSSA());
+
+  IRDivState state(ir);
+  MPSL_PROPAGATE(state.init());
+  return state.run();
+}
+
+// ============================================================================
+// [mpsl::IRGVNState]
+// ============================================================================
+
+//! \internal
+//!
+//! State of the global value numbering (GVN).
+//!
+//! Instructions are hashed by their code (which includes the vector width),
+//! the kind and width of the register they assign, and the identity of their
+//! operands. The sources of commutative instructions are hashed in a way that
+//! doesn't depend on their order and are compared in both orders.
+//!
+//! The dominator tree is walked from the entry and the hash table is scoped:
+//! values computed in a block are visible to the rest of that block and to
+//! all blocks it dominates, and are removed when the walk leaves the block.
+//! An instruction that computes a value that is already available is removed
+//! and its result is replaced by the existing one. The IR must be in SSA form
+//! so both are guaranteed to hold the same value wherever the result is used.
+class IRGVNState {
+public:
+  MPSL_NONCOPYABLE(IRGVNState)
+
+  //! Instruction being looked up.
+  struct Key {
+    IRInst* inst;
+    IRBlock* block;
+    uint32_t memVersion;
+  };
+
+  //! Instruction that computes an available value.
+  struct Node : public HashNode {
+    MPSL_INLINE Node(const Key& key, uint32_t hashCode) noexcept
+      : HashNode(hashCode),
+        _key(key) {}
+
+    bool eq(const Key& key) const noexcept;
+
+    Key _key;
+  };
+
+  MPSL_INLINE IRGVNState(IRBuilder* ir) noexcept
+    : _ir(ir),
+      _allocator(ir->allocator()),
+      _numIds(ir->lastVarId() + 1),
+      _memVersion(0),
+      _memVersionGen(0),
+      _uniformsStored(false),
+      _hasStores(false),
+      _leaders(nullptr),
+      _hash(ir->allocator()) {}
+
+  MPSL_INLINE ~IRGVNState() noexcept {
+    if (_leaders) _allocator->release(_leaders, _numIds * sizeof(IRReg*));
+
+    for (Node* node : _scope)
+      _allocator->release(node, sizeof(Node));
+    _scope.release(_allocator);
+  }
+
+  Error init() noexcept;
+  Error visitBlock(IRBlock* block) noexcept;
+  Error numberInst(IRBlock* block, IRInst* inst, bool& redundant) noexcept;
+  void renamePhis() noexcept;
+
+  //! Get the value that replaces `op`, `op` itself if it's not replaced.
+  MPSL_INLINE IRObject* leaderOf(IRObject* op) const noexcept {
+    while (op->isReg() && op->id() < _numIds && _leaders[op->id()])
+      op = _leaders[op->id()];
+    return op;
+  }
+
+  //! Get whether a fetch from `mem` can't be changed by any store.
+  MPSL_INLINE bool isInvariantMem(const IRMem* mem) const noexcept {
+    if (!_hasStores)
+      return true;
+    return mem->base() == _ir->uniformPtr() && !_uniformsStored;
+  }
+
+  IRBuilder* _ir;
+  ZoneAllocator* _allocator;
+
+  uint32_t _numIds;                      //!< Number of variable IDs (including 0).
+  uint32_t _memVersion;                  //!< Version of memory in the current block.
+  uint32_t _memVersionGen;               //!< Memory version generator.
+  bool _uniformsStored;                  //!< Whether the uniform block is stored to.
+  bool _hasStores;                       //!< Whether the program stores to memory.
+
+  IRReg** _leaders;                      //!< Value that replaces each variable.
+  Hash<Key, Node> _hash;                 //!< Values available in the current block.
+  ZoneVector<Node*> _scope;              //!< Nodes in `_hash`, in insertion order.
+};
+
+//! \internal
+//!
+//! Combine `hash` with the identity of the operand `op`.
+static uint32_t mpHashOperand(uint32_t hash, const IRObject* op) noexcept {
+  hash = HashUtils::hashChar(hash, op->objectType());
+
+  switch (op->objectType()) {
+    case IRObject::kTypeReg:
+      return HashUtils::hashChar(hash, op->id());
+
+    case IRObject::kTypeImm: {
+      const IRImm* imm = op->as<IRImm>();
+      const uint8_t* data = reinterpret_cast<const uint8_t*>(&imm->value());
+
+      hash = HashUtils::hashChar(hash, imm->reg());
+      for (uint32_t i = 0, width = imm->width(); i < width; i++)
+        hash = HashUtils::hashChar(hash, data[i]);
+      return hash;
+    }
+
+    case IRObject::kTypeMem: {
+      const IRMem* mem = op->as<IRMem>();
+
+      hash = HashUtils::hashChar(hash, mem->hasBase() ? mem->base()->id() : 0);
+      hash = HashUtils::hashChar(hash, mem->hasIndex() ? mem->index()->id() : 0);
+      hash = HashUtils::hashChar(hash, static_cast<uint32_t>(mem->offset()));
+      hash = HashUtils::hashChar(hash, mem->shift());
+      return HashUtils::hashChar(hash, mem->firstLane());
+    }
+
+    default:
+      return HashUtils::hashChar(hash, HashUtils::hashPointer(op));
+  }
+}
+
+//! \internal
+//!
+//! Get whether the operands `a` and `b` always hold the same value.
+static bool mpIsSameOperand(const IRObject* a, const IRObject* b) noexcept {
+  if (a == b)
+    return true;
+
+  if (a->objectType() != b->objectType())
+    return false;
+
+  switch (a->objectType()) {
+    case IRObject::kTypeImm: {
+      const IRImm* aImm = a->as<IRImm>();
+      const IRImm* bImm = b->as<IRImm>();
+
+      return aImm->reg() == bImm->reg() &&
+             aImm->width() == bImm->width() &&
+             ::memcmp(&aImm->value(), &bImm->value(), aImm->width()) == 0;
+    }
+
+    case IRObject::kTypeMem: {
+      const IRMem* aMem = a->as<IRMem>();
+      const IRMem* bMem = b->as<IRMem>();
+
+      return aMem->base() == bMem->base() &&
+             aMem->index() == bMem->index() &&
+             aMem->offset() == bMem->offset() &&
+             aMem->shift() == bMem->shift() &&
+             aMem->firstLane() == bMem->firstLane();
+    }
+
+    default:
+      // Registers and blocks are only the same if they are the same object.
+      return false;
+  }
+}
+
+//! \internal
+//!
+//! Get whether `inst` computes a value that only depends on its operands.
+static MPSL_INLINE bool mpIsValueInst(const IRInst* inst) noexcept {
+  return inst->hasDef() && !mpInstInfo[inst->instCode() & kInstCodeMask].isCall();
+}
+
+//! \internal
+//!
+//! Get the hash code of `inst`, see `IRGVNState`.
+static uint32_t mpHashInst(const IRInst* inst, const IRBlock* block, uint32_t memVersion) noexcept {
+  const IRReg* dst = inst->op(0)->as<IRReg>();
+  uint32_t opCount = inst->opCount();
+
+  uint32_t hash = inst->instCode();
+  hash = HashUtils::hashChar(hash, dst->reg());
+  hash = HashUtils::hashChar(hash, dst->width());
+  hash = HashUtils::hashChar(hash, memVersion);
+
+  // Phis are only the same if they merge the same predecessors.
+  if (inst->isPhi())
+    hash = HashUtils::hashChar(hash, HashUtils::hashPointer(block));
+
+  uint32_t i = 1;
+  if (mpInstInfo[inst->instCode() & kInstCodeMask].isCommutative() && opCount >= 3) {
+    uint32_t a = mpHashOperand(0, inst->op(1));
+    uint32_t b = mpHashOperand(0, inst->op(2));
+    hash = HashUtils::hashChar(hash, mpMin(a, b));
+    hash = HashUtils::hashChar(hash, mpMax(a, b));
+    i = 3;
+  }
+
+  while (i < opCount)
+    hash = mpHashOperand(hash, inst->op(i++));
+  return hash;
+}
+
+bool IRGVNState::Node::eq(const Key& key) const noexcept {
+  const IRInst* a = _key.inst;
+  const IRInst* b = key.inst;
+
+  if (a->instCode() != b->instCode() || a->opCount() != b->opCount() || _key.memVersion != key.memVersion)
+    return false;
+
+  if (a->isPhi() && _key.block != key.block)
+    return false;
+
+  const IRReg* aDst = a->op(0)->as<IRReg>();
+  const IRReg* bDst = b->op(0)->as<IRReg>();
+
+  if (aDst->reg() != bDst->reg() || aDst->width() != bDst->width())
+    return false;
+
+  uint32_t opCount = a->opCount();
+  uint32_t i = 1;
+
+  if (mpInstInfo[a->instCode() & kInstCodeMask].isCommutative() && opCount >= 3) {
+    bool same = mpIsSameOperand(a->op(1), b->op(1)) && mpIsSameOperand(a->op(2), b->op(2));
+    bool swapped = mpIsSameOperand(a->op(1), b->op(2)) && mpIsSameOperand(a->op(2), b->op(1));
+
+    if (!same && !swapped)
+      return false;
+    i = 3;
+  }
+
+  for (; i < opCount; i++)
+    if (!mpIsSameOperand(a->op(i), b->op(i)))
+      return false;
+
+  return true;
+}
+
+Error IRGVNState::init() noexcept {
+  _leaders = static_cast<IRReg**>(_allocator->alloc(_numIds * sizeof(IRReg*)));
+  MPSL_NULLCHECK(_leaders);
+  ::memset(_leaders, 0, _numIds * sizeof(IRReg*));
+
+  // Fetches from memory that is never stored to are available everywhere,
+  // other fetches only until the next store in the same block. The uniform
+  // block is owned by the program so it can't alias memory of arguments.
+  for (IRBlock* block : _ir->rpo()) {
+    for (IRInst* inst : block->body()) {
+      if (!mpInstInfo[inst->instCode() & kInstCodeMask].isStore())
+        continue;
+
+      _hasStores = true;
+      for (uint32_t i = 0, opCount = inst->opCount(); i < opCount; i++) {
+        IRObject* op = inst->op(i);
+        if (op->isMem() && op->as<IRMem>()->base() == _ir->uniformPtr())
+          _uniformsStored = true;
+      }
+    }
+  }
+
+  return kErrorOk;
+}
+
+Error IRGVNState::numberInst(IRBlock* block, IRInst* inst, bool& redundant) noexcept {
+  redundant = false;
+
+  const InstInfo& info = mpInstInfo[inst->instCode() & kInstCodeMask];
+  IRReg* dst = inst->op(0)->as<IRReg>();
+
+  // A copy to a register of the same kind and width is the value it copies.
+  if ((info.flags() & kInstInfoMov) != 0 && inst->op(1)->isReg()) {
+    IRReg* src = inst->op(1)->as<IRReg>();
+    if (src->reg() == dst->reg() && src->width() == dst->width()) {
+      _leaders[dst->id()] = src;
+      redundant = true;
+      return kErrorOk;
+    }
+  }
+
+  Key key;
+  key.inst = inst;
+  key.block = block;
+  key.memVersion = 0;
+
+  for (uint32_t i = 1, opCount = inst->opCount(); i < opCount; i++) {
+    IRObject* op = inst->op(i);
+    if (op->isMem() && !isInvariantMem(op->as<IRMem>()))
+      key.memVersion = _memVersion;
+  }
+
+  uint32_t hashCode = mpHashInst(inst, block, key.memVersion);
+  Node* node = _hash.get(key, hashCode);
+
+  if (node) {
+    _leaders[dst->id()] = node->_key.inst->op(0)->as<IRReg>();
+    redundant = true;
+    return kErrorOk;
+  }
+
+  node = static_cast<Node*>(_allocator->alloc(sizeof(Node)));
+  MPSL_NULLCHECK(node);
+
+  node = new(node) Node(key, hashCode);
+  Error err = _scope.append(_allocator, node);
+
+  if (err) {
+    _allocator->release(node, sizeof(Node));
+    return err;
+  }
+
+  _hash.put(node);
+  return kErrorOk;
+}
+
+Error IRGVNState::visitBlock(IRBlock* block) noexcept {
+  size_t scopeMark = _scope.size();
+  _memVersion = ++_memVersionGen;
+
+  // Phi operands flow from predecessors that may not be visited yet, they are
+  // renamed by `renamePhis()` when the walk is done.
+  IRBody& phis = block->phis();
+  size_t phiIndex = 0;
+
+  for (size_t i = 0, size = phis.size(); i < size; i++) {
+    IRInst* phi = phis[i];
+    bool redundant;
+
+    MPSL_PROPAGATE(numberInst(block, phi, redundant));
+    if (redundant)
+      _ir->deleteInst(phi);
+    else
+      phis[phiIndex++] = phi;
+  }
+  phis.truncate(phiIndex);
+
+  IRBody& body = block->body();
+  for (size_t i = 0, size = body.size(); i < size; i++) {
+    IRInst* inst = body[i];
+    uint32_t opCount = inst->opCount();
+    bool hasDef = inst->hasDef();
+
+    // Definitions dominate their uses, so all operands are already numbered.
+    for (uint32_t j = hasDef ? 1 : 0; j < opCount; j++) {
+      IRObject* op = inst->op(j);
+      IRObject* leader = leaderOf(op);
+
+      if (leader != op)
+        _ir->replaceOperand(inst, j, leader);
+    }
+
+    if (mpInstInfo[inst->instCode() & kInstCodeMask].isStore()) {
+      _memVersion = ++_memVersionGen;
+      continue;
+    }
+
+    if (!mpIsValueInst(inst))
+      continue;
+
+    bool redundant;
+    MPSL_PROPAGATE(numberInst(block, inst, redundant));
+
+    if (redundant) {
+      block->neuterAt(i);
+      _ir->deleteInst(inst);
+    }
+  }
+  block->fixupAfterNeutering();
+
+  for (IRBlock* child : block->dominated())
+    MPSL_PROPAGATE(visitBlock(child));
+
+  while (_scope.size() > scopeMark) {
+    Node* node = _scope[_scope.size() - 1];
+    _scope.truncate(_scope.size() - 1);
+
+    _hash.del(node);
+    _allocator->release(node, sizeof(Node));
+  }
+
+  return kErrorOk;
+}
+
+void IRGVNState::renamePhis() noexcept {
+  for (IRBlock* block : _ir->rpo()) {
+    for (IRInst* phi : block->phis()) {
+      for (uint32_t i = 1, opCount = phi->opCount(); i < opCount; i++) {
+        IRObject* op = phi->op(i);
+        IRObject* leader = leaderOf(op);
+
+        if (leader != op)
+          _ir->replaceOperand(phi, i, leader);
+      }
+    }
+  }
+}
+
+// ============================================================================
+// [mpsl::mpIRNumberValues]
+// ============================================================================
+
+//! \internal
+//!
+//! Remove instructions that compute a value that is already available, the
+//! IR must be in SSA form.
+//!
+//! Values are first reused within a block and then across the blocks that it
+//! dominates. Copies are removed as well, their results are replaced by the
+//! copied value.
+static Error mpIRNumberValues(IRBuilder* ir) noexcept {
+  MPSL_ASSERT(ir->isSSA());
+  if (ir->rpo().empty())
+    return kErrorOk;
+
+  IRGVNState state(ir);
+  MPSL_PROPAGATE(state.init());
+  MPSL_PROPAGATE(state.visitBlock(ir->entryBlock()));
+
+  state.renamePhis();
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::mpIRRemoveDeadCode]
+// ============================================================================
+
+//! \internal
+//!
+//! Get whether `inst` can be removed if the variable it assigns is not used.
+static MPSL_INLINE bool mpIsRemovableInst(const IRInst* inst) noexcept {
+  return inst->hasDef() && !mpInstInfo[inst->instCode() & kInstCodeMask].isCall();
+}
+
+//! \internal
+//!
+//! Remove instructions that assign variables that are never read.
+//!
+//! Each block is walked backwards from the variables live at its end, so a
+//! chain of instructions that only feed each other is removed in one walk.
+//! Removing instructions makes variables dead in other blocks, the liveness
+//! is computed again until nothing is removed. The CFG must be up to date.
+static Error mpIRRemoveDeadCode(IRBuilder* ir) noexcept {
+  ZoneAllocator* allocator = ir->allocator();
+
+  for (;;) {
+    MPSL_PROPAGATE(ir->updateLiveness());
+    if (!ir->hasLiveness())
+      return kErrorOk;
+
+    uint32_t words = ir->liveWords();
+    size_t setSize = words * sizeof(uint32_t);
+
+    uint32_t* live = static_cast<uint32_t*>(allocator->alloc(setSize));
+    MPSL_NULLCHECK(live);
+
+    bool removed = false;
+    for (IRBlock* block : ir->rpo()) {
+      ::memcpy(live, ir->liveOut(block), setSize);
+
+      IRBody& body = block->body();
+      size_t i = body.size();
+
+      while (i != 0) {
+        IRInst* inst = body[--i];
+
+        if (mpIsRemovableInst(inst)) {
+          uint32_t id = inst->op(0)->id();
+          if ((live[id >> 5] & (1u << (id & 31))) == 0) {
+            block->neuterAt(i);
+            ir->deleteInst(inst);
+
+            removed = true;
+            continue;
+          }
+        }
+
+        mpUpdateLiveBits(live, inst);
+      }
+      block->fixupAfterNeutering();
+
+      // `live` now holds variables live after phis.
+      IRBody& phis = block->phis();
+      size_t phiIndex = 0;
+
+      for (i = 0; i < phis.size(); i++) {
+        IRInst* phi = phis[i];
+        uint32_t id = phi->op(0)->id();
+
+        if ((live[id >> 5] & (1u << (id & 31))) == 0) {
+          ir->deleteInst(phi);
+          removed = true;
+        }
+        else {
+          phis[phiIndex++] = phi;
+        }
+      }
+      phis.truncate(phiIndex);
+    }
+
+    allocator->release(live, setSize);
+    if (!removed)
+      return kErrorOk;
+  }
+}
+
+// ============================================================================
+// [mpsl::IRDSEState]
+// ============================================================================
+
+//! \internal
+//!
+//! State of the dead store elimination (DSE).
+//!
+//! A store is dead if the memory it writes is overwritten on all paths to the
+//! exit before anything reads it, which is common for write-only (`kTypeWO`)
+//! members like `@ret` that are assigned more than once. Each distinct memory
+//! operand stored to is a location, and a backward dataflow computes which
+//! locations are overwritten before they are read on every path from the end
+//! of each block. Memory of all data slots can alias, only the uniform block
+//! is known to be separate, so a fetch of a location that may overlap a store
+//! makes the store live.
+class IRDSEState {
+public:
+  MPSL_NONCOPYABLE(IRDSEState)
+
+  //! Index of a memory operand that is not a location.
+  enum { kNoLocation = 0xFFFFFFFFu };
+
+  //! Memory written by a store, the address is copied as stores that refer
+  //! to it can be removed.
+  struct Location {
+    IRReg* base;
+    IRReg* index;
+    int32_t offset;
+    uint32_t shift;
+    uint32_t firstLane;
+    uint32_t size;
+  };
+
+  MPSL_INLINE IRDSEState(IRBuilder* ir) noexcept
+    : _ir(ir),
+      _allocator(ir->allocator()),
+      _numBlocks(static_cast<uint32_t>(ir->rpo().size())),
+      _words(0),
+      _overwritten(nullptr) {}
+
+  MPSL_INLINE ~IRDSEState() noexcept {
+    if (_overwritten) _allocator->release(_overwritten, (_numBlocks + 2) * _words * sizeof(uint32_t));
+    _locations.release(_allocator);
+  }
+
+  Error init() noexcept;
+  void solve() noexcept;
+  void rewrite() noexcept;
+
+  void transfer(IRBlock* block, uint32_t* cur, bool remove) noexcept;
+  uint32_t locationOf(const IRMem* mem, uint32_t size) const noexcept;
+
+  //! Get locations overwritten on all paths from the end of `block`.
+  MPSL_INLINE uint32_t* overwrittenOf(const IRBlock* block) const noexcept {
+    return _overwritten + static_cast<size_t>(block->rpoIndex()) * _words;
+  }
+
+  //! Get the two scratch bit-sets used by `solve()` and `rewrite()`.
+  MPSL_INLINE uint32_t* scratch() const noexcept {
+    return _overwritten + static_cast<size_t>(_numBlocks) * _words;
+  }
+
+  IRBuilder* _ir;
+  ZoneAllocator* _allocator;
+
+  uint32_t _numBlocks;                   //!< Reachable blocks.
+  uint32_t _words;                       //!< Count of words of each bit-set.
+  uint32_t* _overwritten;                //!< Locations overwritten after each block, and scratch.
+  ZoneVector<Location> _locations;       //!< All locations stored to.
+};
+
+//! \internal
+//!
+//! Get the size of memory accessed by a fetch or a store, 0 if it doesn't
+//! access memory.
+static uint32_t mpMemSizeOf(uint32_t instCode) noexcept {
+  switch (instCode & kInstCodeMask) {
+    case kInstCodeFetch32  : return 4;
+    case kInstCodeFetch64  : return 8;
+    case kInstCodeFetch96  : return 12;
+    case kInstCodeFetch128 : return 16;
+    case kInstCodeFetch192 : return 24;
+    case kInstCodeFetch256 : return 32;
+    case kInstCodeInsert32 : return 4;
+    case kInstCodeInsert64 : return 8;
+    case kInstCodeStore32  : return 4;
+    case kInstCodeStore64  : return 8;
+    case kInstCodeStore96  : return 12;
+    case kInstCodeStore128 : return 16;
+    case kInstCodeStore192 : return 24;
+    case kInstCodeStore256 : return 32;
+    case kInstCodeExtract32: return 4;
+    case kInstCodeExtract64: return 8;
+
+    default:
+      return 0;
+  }
+}
+
+//! \internal
+//!
+//! Get whether the address of `location` only differs from `mem` in offset.
+static MPSL_INLINE bool mpIsSameAddressBase(const IRDSEState::Location& location, const IRMem* mem) noexcept {
+  return location.base == mem->base() &&
+         location.index == mem->index() &&
+         location.shift == mem->shift() &&
+         location.firstLane == mem->firstLane();
+}
+
+//! \internal
+//!
+//! Get the memory operand of `inst`, null if it has none.
+static MPSL_INLINE IRMem* mpMemOperandOf(const IRInst* inst) noexcept {
+  for (uint32_t i = 0, opCount = inst->opCount(); i < opCount; i++)
+    if (inst->op(i)->isMem())
+      return inst->op(i)->as<IRMem>();
+  return nullptr;
+}
+
+uint32_t IRDSEState::locationOf(const IRMem* mem, uint32_t size) const noexcept {
+  for (size_t i = 0, count = _locations.size(); i < count; i++) {
+    const Location& location = _locations[i];
+    if (location.size == size && location.offset == mem->offset() && mpIsSameAddressBase(location, mem))
+      return static_cast<uint32_t>(i);
+  }
+  return kNoLocation;
+}
+
+Error IRDSEState::init() noexcept {
+  for (IRBlock* block : _ir->rpo()) {
+    for (IRInst* inst : block->body()) {
+      if (!mpInstInfo[inst->instCode() & kInstCodeMask].isStore())
+        continue;
+
+      IRMem* mem = mpMemOperandOf(inst);
+      uint32_t size = mpMemSizeOf(inst->instCode());
+
+      if (mem == nullptr || size == 0 || locationOf(mem, size) != kNoLocation)
+        continue;
+
+      Location location;
+      location.base = mem->base();
+      location.index = mem->index();
+      location.offset = mem->offset();
+      location.shift = mem->shift();
+      location.firstLane = mem->firstLane();
+      location.size = size;
+      MPSL_PROPAGATE(_locations.append(_allocator, location));
+    }
+  }
+
+  if (_locations.empty())
+    return kErrorOk;
+
+  _words = static_cast<uint32_t>((_locations.size() + 31) / 32);
+  size_t size = (_numBlocks + 2) * _words * sizeof(uint32_t);
+
+  _overwritten = static_cast<uint32_t*>(_allocator->alloc(size));
+  MPSL_NULLCHECK(_overwritten);
+
+  // Locations are overwritten after all blocks until proven otherwise, except
+  // exits, where all memory is observable.
+  for (IRBlock* block : _ir->rpo())
+    ::memset(overwrittenOf(block), block->hasSuccessors() ? 0xFF : 0x00, _words * sizeof(uint32_t));
+
+  return kErrorOk;
+}
+
+void IRDSEState::transfer(IRBlock* block, uint32_t* cur, bool remove) noexcept {
   IRBody& body = block->body();
   size_t i = body.size();
 
+  uint32_t count = static_cast<uint32_t>(_locations.size());
+  IRReg* uniformPtr = _ir->uniformPtr();
+
   while (i != 0) {
     IRInst* inst = body[--i];
-    if (inst) {
-      // TODO: Just testing some concepts.
-      const InstInfo& info = mpInstInfo[inst->instCode() & kInstCodeMask];
-      if (!info.isStore() && !info.isCall() && !info.isRet()) {
-        IRObject** opArray = inst->operands();
-        uint32_t opCount = inst->opCount();
+    const InstInfo& info = mpInstInfo[inst->instCode() & kInstCodeMask];
+
+    if (info.isCall() || info.isRet()) {
+      ::memset(cur, 0, _words * sizeof(uint32_t));
+      continue;
+    }
+
+    IRMem* mem = mpMemOperandOf(inst);
+    uint32_t size = mpMemSizeOf(inst->instCode());
+
+    if (mem == nullptr || size == 0)
+      continue;
+
+    int32_t begin = mem->offset();
+    int32_t end = begin + static_cast<int32_t>(size);
 
-        IRObject* dst = opArray[0];
-        if (dst->isReg() && dst->refCount() == 1) {
+    if (info.isStore()) {
+      uint32_t index = locationOf(mem, size);
+      if ((cur[index >> 5] & (1u << (index & 31))) != 0) {
+        if (remove) {
           block->neuterAt(i);
-          ir->deleteInst(inst);
+          _ir->deleteInst(inst);
         }
+        continue;
+      }
+
+      // All locations within the stored memory are overwritten.
+      for (uint32_t j = 0; j < count; j++) {
+        const Location& location = _locations[j];
+        int32_t lBegin = location.offset;
+        int32_t lEnd = lBegin + static_cast<int32_t>(location.size);
+
+        if (mpIsSameAddressBase(location, mem) && lBegin >= begin && lEnd <= end)
+          cur[j >> 5] |= 1u << (j & 31);
+      }
+    }
+    else {
+      // All locations that may overlap the fetched memory are read.
+      for (uint32_t j = 0; j < count; j++) {
+        const Location& location = _locations[j];
+        int32_t lBegin = location.offset;
+        int32_t lEnd = lBegin + static_cast<int32_t>(location.size);
+
+        bool mayAlias;
+        if (location.base != mem->base())
+          mayAlias = location.base != uniformPtr && mem->base() != uniformPtr;
+        else if (!mpIsSameAddressBase(location, mem))
+          mayAlias = true;
+        else
+          mayAlias = lBegin < end && begin < lEnd;
+
+        if (mayAlias)
+          cur[j >> 5] &= ~(1u << (j & 31));
       }
     }
   }
 
-  block->fixupAfterNeutering();
+  if (remove)
+    block->fixupAfterNeutering();
+}
+
+void IRDSEState::solve() noexcept {
+  const IRBlocks& rpo = _ir->rpo();
+  uint32_t* cur = scratch();
+
+  bool changed;
+  do {
+    changed = false;
+    size_t i = rpo.size();
+
+    while (i != 0) {
+      IRBlock* block = rpo[--i];
+      const IRBlocks& successors = block->successors();
+
+      if (successors.empty())
+        continue;
+
+      // Overwritten after the block if overwritten at the start of all its
+      // successors.
+      uint32_t w;
+      for (w = 0; w < _words; w++)
+        cur[w] = 0xFFFFFFFFu;
+
+      for (IRBlock* successor : successors) {
+        uint32_t* succIn = scratch() + _words;
+        ::memcpy(succIn, overwrittenOf(successor), _words * sizeof(uint32_t));
+        transfer(successor, succIn, false);
+
+        for (w = 0; w < _words; w++)
+          cur[w] &= succIn[w];
+      }
+
+      uint32_t* out = overwrittenOf(block);
+      for (w = 0; w < _words; w++) {
+        if (out[w] != cur[w]) {
+          out[w] = cur[w];
+          changed = true;
+        }
+      }
+    }
+  } while (changed);
+}
+
+void IRDSEState::rewrite() noexcept {
+  uint32_t* cur = scratch();
+
+  for (IRBlock* block : _ir->rpo()) {
+    ::memcpy(cur, overwrittenOf(block), _words * sizeof(uint32_t));
+    transfer(block, cur, true);
+  }
+}
+
+// ============================================================================
+// [mpsl::mpIRRemoveDeadStores]
+// ============================================================================
+
+//! \internal
+//!
+//! Remove stores to memory that is always overwritten before it's read or the
+//! program exits. The CFG must be up to date.
+static Error mpIRRemoveDeadStores(IRBuilder* ir) noexcept {
+  if (ir->rpo().empty())
+    return kErrorOk;
+
+  IRDSEState state(ir);
+  MPSL_PROPAGATE(state.init());
+
+  if (state._locations.empty())
+    return kErrorOk;
+
+  state.solve();
+  state.rewrite();
   return kErrorOk;
 }
 
-Error mpIRPass(IRBuilder* ir) noexcept {
-  for (IRBlock* block : ir->blocks())
-    MPSL_PROPAGATE(mpIRPassBlock(ir, block));
+// ============================================================================
+// [mpsl::IRLoopOptState]
+// ============================================================================
+
+//! \internal
+//!
+//! State of the loop optimizer, which works on a single loop at a time.
+//!
+//! Loop invariant code motion moves instructions that don't depend on any
+//! variable assigned in the loop to its preheader, so they are computed once
+//! before the loop is entered. A fetch is moved only if no store in the loop
+//! may alias it, which is always true for read-only (`kTypeRO`) members and
+//! the uniform block.
+//!
+//! Strength reduction replaces a multiplication of a basic induction variable
+//! `i = phi(init, i + step)` by an invariant `k` with a new induction variable
+//! `j = phi(init * k, j + step * k)`. Integer arithmetic wraps, so both hold
+//! the same value in every iteration.
+class IRLoopOptState {
+public:
+  MPSL_NONCOPYABLE(IRLoopOptState)
+
+  MPSL_INLINE IRLoopOptState(IRBuilder* ir) noexcept
+    : _ir(ir),
+      _allocator(ir->allocator()),
+      _loop(nullptr),
+      _words(0),
+      _defined(nullptr) {}
+
+  MPSL_INLINE ~IRLoopOptState() noexcept {
+    if (_defined) _allocator->release(_defined, _words * sizeof(uint32_t));
+    _blocks.release(_allocator);
+    _stores.release(_allocator);
+  }
+
+  Error initLoop(IRLoop* loop) noexcept;
+  Error hoistInvariants(IRBlock* preheader) noexcept;
+  Error reduceStrength(IRBlock* preheader) noexcept;
+
+  bool isInvariant(const IRObject* op) const noexcept;
+  bool isHoistable(const IRInst* inst) const noexcept;
+
+  IRInst* defOf(const IRObject* var, IRBlock** block) const noexcept;
+  bool isUsedOutside(const IRReg* var) const noexcept;
+  void replaceUses(IRReg* var, IRReg* by) noexcept;
+
+  //! Get whether the variable `id` is assigned in the current loop.
+  MPSL_INLINE bool isDefined(uint32_t id) const noexcept {
+    // Variables created after `initLoop()` are conservatively variant.
+    return (id >> 5) >= _words || (_defined[id >> 5] & (1u << (id & 31))) != 0;
+  }
+
+  IRBuilder* _ir;
+  ZoneAllocator* _allocator;
+
+  IRLoop* _loop;                         //!< Current loop.
+  uint32_t _words;                       //!< Count of words of `_defined`.
+  uint32_t* _defined;                    //!< Variables assigned in the loop.
+  IRBlocks _blocks;                      //!< Loop blocks in reverse post-order.
+  ZoneVector<IRInst*> _stores;           //!< Stores in the loop.
+};
+
+//! \internal
+//!
+//! Get whether memory accessed by two instructions may overlap, see
+//! `IRDSEState` for the aliasing rules.
+static bool mpMayAlias(const IRMem* a, uint32_t aSize, const IRMem* b, uint32_t bSize, const IRReg* uniformPtr) noexcept {
+  if (a->base() != b->base())
+    return a->base() != uniformPtr && b->base() != uniformPtr;
+
+  if (a->index() != b->index() || a->shift() != b->shift() || a->firstLane() != b->firstLane())
+    return true;
+
+  return a->offset() < b->offset() + static_cast<int32_t>(bSize) &&
+         b->offset() < a->offset() + static_cast<int32_t>(aSize);
+}
+
+//! \internal
+//!
+//! Get the preheader of `loop`, which is the only block outside of the loop
+//! that jumps to its header, and doesn't jump anywhere else. Null if the loop
+//! doesn't have one.
+static IRBlock* mpPreheaderOf(const IRLoop* loop) noexcept {
+  IRBlock* preheader = nullptr;
+
+  for (IRBlock* predecessor : loop->header()->predecessors()) {
+    if (loop->contains(predecessor))
+      continue;
+
+    if (preheader)
+      return nullptr;
+    preheader = predecessor;
+  }
+
+  if (!preheader || preheader->successors().size() != 1)
+    return nullptr;
+  return preheader;
+}
+
+Error IRLoopOptState::initLoop(IRLoop* loop) noexcept {
+  uint32_t words = (_ir->lastVarId() + 32) / 32;
+  if (words != _words) {
+    if (_defined) _allocator->release(_defined, _words * sizeof(uint32_t));
+    _words = 0;
+
+    _defined = static_cast<uint32_t*>(_allocator->alloc(words * sizeof(uint32_t)));
+    MPSL_NULLCHECK(_defined);
+    _words = words;
+  }
+
+  _loop = loop;
+  ::memset(_defined, 0, _words * sizeof(uint32_t));
+
+  _blocks.reset();
+  _stores.reset();
+
+  // Sort blocks by their position in reverse post-order, so variables are
+  // assigned before they are used (except by phis).
+  for (IRBlock* block : loop->blocks()) {
+    size_t i = _blocks.size();
+    MPSL_PROPAGATE(_blocks.append(_allocator, block));
+
+    while (i != 0 && _blocks[i - 1]->rpoIndex() > block->rpoIndex()) {
+      _blocks[i] = _blocks[i - 1];
+      i--;
+    }
+    _blocks[i] = block;
+  }
+
+  for (IRBlock* block : _blocks) {
+    for (IRInst* phi : block->phis()) {
+      uint32_t id = phi->op(0)->id();
+      _defined[id >> 5] |= 1u << (id & 31);
+    }
+
+    for (IRInst* inst : block->body()) {
+      if (inst->hasDef()) {
+        uint32_t id = inst->op(0)->id();
+        _defined[id >> 5] |= 1u << (id & 31);
+      }
+      else if (mpInstInfo[inst->instCode() & kInstCodeMask].isStore()) {
+        MPSL_PROPAGATE(_stores.append(_allocator, inst));
+      }
+    }
+  }
+
+  return kErrorOk;
+}
+
+bool IRLoopOptState::isInvariant(const IRObject* op) const noexcept {
+  if (op->isReg())
+    return !isDefined(op->id());
+
+  if (op->isMem()) {
+    const IRMem* mem = op->as<IRMem>();
+    return (!mem->base() || isInvariant(mem->base())) &&
+           (!mem->index() || isInvariant(mem->index()));
+  }
+
+  return true;
+}
+
+bool IRLoopOptState::isHoistable(const IRInst* inst) const noexcept {
+  uint32_t instCode = inst->instCode() & kInstCodeMask;
+
+  // Division and modulo can fault, they are not moved out of a condition
+  // that guards them.
+  if (!mpIsValueInst(inst) || inst->isPhi() || instCode == kInstCodePdivsd || instCode == kInstCodePmodsd)
+    return false;
+
+  for (uint32_t i = 1, opCount = inst->opCount(); i < opCount; i++) {
+    const IRObject* op = inst->op(i);
+    if (!isInvariant(op))
+      return false;
+
+    if (op->isMem()) {
+      const IRMem* mem = op->as<IRMem>();
+      uint32_t size = mpMemSizeOf(instCode);
+
+      for (IRInst* store : _stores) {
+        const IRMem* storeMem = store->op(0)->as<IRMem>();
+        if (mpMayAlias(mem, size, storeMem, mpMemSizeOf(store->instCode()), _ir->uniformPtr()))
+          return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+Error IRLoopOptState::hoistInvariants(IRBlock* preheader) noexcept {
+  for (IRBlock* block : _blocks) {
+    IRBody& body = block->body();
+
+    for (size_t i = 0; i < body.size(); i++) {
+      IRInst* inst = body[i];
+      if (!isHoistable(inst))
+        continue;
+
+      MPSL_PROPAGATE(preheader->insertBeforeTerminator(inst));
+      block->neuterAt(i);
+
+      // Instructions that use the result can be moved as well.
+      uint32_t id = inst->op(0)->id();
+      _defined[id >> 5] &= ~(1u << (id & 31));
+    }
+
+    block->fixupAfterNeutering();
+  }
+
+  return kErrorOk;
+}
+
+IRInst* IRLoopOptState::defOf(const IRObject* var, IRBlock** block) const noexcept {
+  for (IRBlock* candidate : _blocks) {
+    for (IRInst* inst : candidate->body()) {
+      if (inst->hasDef() && inst->op(0) == var) {
+        *block = candidate;
+        return inst;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+bool IRLoopOptState::isUsedOutside(const IRReg* var) const noexcept {
+  for (IRBlock* block : _ir->rpo()) {
+    if (_loop->contains(block))
+      continue;
+
+    for (IRInst* phi : block->phis())
+      for (uint32_t i = 1, opCount = phi->opCount(); i < opCount; i++)
+        if (phi->op(i) == var)
+          return true;
+
+    for (IRInst* inst : block->body())
+      for (uint32_t i = 0, opCount = inst->opCount(); i < opCount; i++)
+        if (inst->op(i) == var)
+          return true;
+  }
+
+  return false;
+}
+
+void IRLoopOptState::replaceUses(IRReg* var, IRReg* by) noexcept {
+  for (IRBlock* block : _blocks) {
+    for (IRInst* phi : block->phis())
+      for (uint32_t i = 1, opCount = phi->opCount(); i < opCount; i++)
+        if (phi->op(i) == var)
+          _ir->replaceOperand(phi, i, by);
+
+    for (IRInst* inst : block->body())
+      for (uint32_t i = inst->hasDef() ? 1 : 0, opCount = inst->opCount(); i < opCount; i++)
+        if (inst->op(i) == var)
+          _ir->replaceOperand(inst, i, by);
+  }
+}
+
+Error IRLoopOptState::reduceStrength(IRBlock* preheader) noexcept {
+  IRBuilder* ir = _ir;
+  IRBlock* header = _loop->header();
+
+  const IRBlocks& predecessors = header->predecessors();
+  uint32_t predCount = static_cast<uint32_t>(predecessors.size());
+  uint32_t preIndex = 0;
+
+  while (predecessors[preIndex] != preheader)
+    preIndex++;
+
+  // Phis created below are appended, they are not induction variables this
+  // loop knows how to reduce.
+  size_t phiCount = header->phis().size();
+  for (size_t phiIndex = 0; phiIndex < phiCount; phiIndex++) {
+    IRInst* phi = header->phis()[phiIndex];
+    IRReg* iv = phi->op(0)->as<IRReg>();
+    IRObject* init = phi->op(preIndex + 1);
+
+    // All back-edges must bring the same `next = iv +/- step`.
+    IRObject* next = nullptr;
+    uint32_t i;
+
+    for (i = 0; i < predCount; i++) {
+      if (i == preIndex)
+        continue;
+
+      IRObject* op = phi->op(i + 1);
+      if (next && next != op)
+        break;
+      next = op;
+    }
+
+    if (i != predCount || !next || !next->isReg())
+      continue;
+
+    IRBlock* nextBlock;
+    IRInst* nextInst = defOf(next, &nextBlock);
+    if (!nextInst)
+      continue;
+
+    uint32_t nextCode = nextInst->instCode() & kInstCodeMask;
+    IRObject* step = nullptr;
+
+    if (nextCode == kInstCodePaddd || nextCode == kInstCodePsubd) {
+      if (nextInst->op(1) == iv && isInvariant(nextInst->op(2)))
+        step = nextInst->op(2);
+      else if (nextCode == kInstCodePaddd && nextInst->op(2) == iv && isInvariant(nextInst->op(1)))
+        step = nextInst->op(1);
+    }
+
+    if (!step)
+      continue;
+
+    for (IRBlock* block : _blocks) {
+      IRBody& body = block->body();
+
+      for (size_t j = 0; j < body.size(); j++) {
+        IRInst* inst = body[j];
+
+        if ((inst->instCode() & kInstCodeMask) != kInstCodePmuld ||
+            (inst->instCode() & kInstVecMask) != (nextInst->instCode() & kInstVecMask))
+          continue;
+
+        IRReg* dst = inst->op(0)->as<IRReg>();
+        IRObject* k;
+
+        if (inst->op(1) == iv)
+          k = inst->op(2);
+        else if (inst->op(2) == iv)
+          k = inst->op(1);
+        else
+          continue;
+
+        // An unused product is left to DCE, the new induction variable would
+        // keep itself alive through its phi. The new variable also holds the
+        // product of the latest iteration, which differs from `dst` after the
+        // loop if `dst` was not computed in it.
+        if (!isInvariant(k) || dst->reg() != iv->reg() || dst->width() != iv->width() ||
+            dst->refCount() <= 1 || isUsedOutside(dst))
+          continue;
+
+        IRReg* start = ir->newVar(iv->reg(), iv->width());
+        IRReg* stride = ir->newVar(iv->reg(), iv->width());
+        IRReg* var = ir->newVar(iv->reg(), iv->width());
+        IRReg* varNext = ir->newVar(iv->reg(), iv->width());
+
+        MPSL_NULLCHECK(start);
+        MPSL_NULLCHECK(stride);
+        MPSL_NULLCHECK(var);
+        MPSL_NULLCHECK(varNext);
+
+        IRInst* startInst = ir->newInst(inst->instCode(), start, init, k);
+        MPSL_NULLCHECK(startInst);
+        MPSL_PROPAGATE(preheader->insertBeforeTerminator(startInst));
+
+        IRInst* strideInst = ir->newInst(inst->instCode(), stride, step, k);
+        MPSL_NULLCHECK(strideInst);
+        MPSL_PROPAGATE(preheader->insertBeforeTerminator(strideInst));
+
+        // The block that computes `next` dominates all back-edges.
+        IRInst* varNextInst = ir->newInst(nextInst->instCode(), varNext, var, stride);
+        MPSL_NULLCHECK(varNextInst);
+        MPSL_PROPAGATE(nextBlock->insertBeforeTerminator(varNextInst));
+
+        IRInst* varPhi = ir->newPhi(var, predCount);
+        MPSL_NULLCHECK(varPhi);
+
+        for (i = 0; i < predCount; i++)
+          ir->replaceOperand(varPhi, i + 1, i == preIndex ? start : varNext);
+        MPSL_PROPAGATE(header->addPhi(varPhi));
+
+        replaceUses(dst, var);
+        block->neuterAt(j);
+        ir->deleteInst(inst);
+      }
+
+      block->fixupAfterNeutering();
+    }
+  }
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::mpIROptimizeLoops]
+// ============================================================================
+
+//! \internal
+//!
+//! Move loop invariant code to preheaders and reduce multiplications of
+//! induction variables to additions. The IR must be in SSA form.
+//!
+//! A preheader is created by splitting the edge to the header if the loop is
+//! entered from a single block that also jumps elsewhere. Loops are processed
+//! from the innermost, so code moved to the preheader of an inner loop can be
+//! moved again to the preheader of the loop that contains it.
+static Error mpIROptimizeLoops(IRBuilder* ir) noexcept {
+  const IRLoops& loops = ir->loops();
+  if (loops.empty())
+    return kErrorOk;
+
+  bool split = false;
+  for (IRLoop* loop : loops) {
+    IRBlock* header = loop->header();
+    IRBlock* entry = nullptr;
+    size_t count = 0;
+
+    for (IRBlock* predecessor : header->predecessors()) {
+      if (!loop->contains(predecessor)) {
+        entry = predecessor;
+        count++;
+      }
+    }
+
+    if (count == 1 && entry->successors().size() > 1) {
+      IRBlock* preheader;
+      MPSL_PROPAGATE(ir->splitEdge(entry, header, &preheader));
+      split = true;
+    }
+  }
+
+  if (split)
+    MPSL_PROPAGATE(ir->updateCFG());
+
+  IRLoopOptState state(ir);
+  size_t i = loops.size();
+
+  while (i != 0) {
+    IRLoop* loop = loops[--i];
+    IRBlock* preheader = mpPreheaderOf(loop);
+
+    if (!preheader)
+      continue;
+
+    MPSL_PROPAGATE(state.initLoop(loop));
+    MPSL_PROPAGATE(state.hoistInvariants(preheader));
+    MPSL_PROPAGATE(state.reduceStrength(preheader));
+  }
+
   return kErrorOk;
 }
 
+// ============================================================================
+// [mpsl::mpIRPass]
+// ============================================================================
+
+Error mpIRPass(IRBuilder* ir) noexcept {
+  // Constants are propagated first so equal constants are numbered the same,
+  // the code made dead by both passes is removed below.
+  if (ir->isSSA()) {
+    MPSL_PROPAGATE(mpIRPropagateConstants(ir));
+    MPSL_PROPAGATE(mpIRReduceDivisions(ir));
+    MPSL_PROPAGATE(mpIRNumberValues(ir));
+    MPSL_PROPAGATE(mpIROptimizeLoops(ir));
+  }
+  else {
+    MPSL_PROPAGATE(ir->updateCFG());
+  }
+
+  MPSL_PROPAGATE(mpIRRemoveDeadStores(ir));
+  return mpIRRemoveDeadCode(ir);
+}
+
 } // mpsl namespace
 
 // [Api-End]
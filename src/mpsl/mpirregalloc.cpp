@@ -0,0 +1,319 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define MPSL_EXPORTS
+
+// [Dependencies - MPSL]
+#include "./mpirregalloc_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::IRRegAlloc - Construction / Destruction]
+// ============================================================================
+
+IRRegAlloc::IRRegAlloc(ZoneAllocator* allocator) noexcept
+  : _allocator(allocator),
+    _intervals(nullptr),
+    _order(nullptr),
+    _count(0),
+    _orderCount(0),
+    _numSlots(0) {
+
+  for (uint32_t kind = 0; kind < IRReg::kKindCount; kind++)
+    _usedRegs[kind] = 0;
+}
+
+IRRegAlloc::~IRRegAlloc() noexcept {
+  reset();
+}
+
+// ============================================================================
+// [mpsl::IRRegAlloc - Interface]
+// ============================================================================
+
+Error IRRegAlloc::run(IRBuilder* ir, const IRBlocks& layout, const uint32_t available[IRReg::kKindCount]) noexcept {
+  reset();
+
+  _count = ir->lastVarId() + 1;
+  _intervals = static_cast<Interval*>(_allocator->alloc(_count * sizeof(Interval)));
+  _order = static_cast<uint32_t*>(_allocator->alloc(_count * sizeof(uint32_t)));
+
+  if (_intervals == nullptr || _order == nullptr) {
+    reset();
+    return MPSL_TRACE_ERROR(kErrorNoMemory);
+  }
+
+  for (uint32_t i = 0; i < _count; i++) {
+    Interval& interval = _intervals[i];
+    interval.reg = nullptr;
+    interval.start = kNoPosition;
+    interval.end = 0;
+    interval.physId = kInvalidRegId;
+    interval.slot = kNoSlot;
+  }
+
+  MPSL_PROPAGATE(_buildIntervals(ir, layout));
+  _assignRegs(available);
+  MPSL_PROPAGATE(_assignSlots());
+
+  for (uint32_t i = 0; i < _orderCount; i++) {
+    Interval& interval = _intervals[_order[i]];
+    if (interval.physId != kInvalidRegId) {
+      interval.reg->setJitId(interval.physId);
+      _usedRegs[interval.reg->reg()] |= 1u << interval.physId;
+    }
+  }
+
+  return kErrorOk;
+}
+
+void IRRegAlloc::reset() noexcept {
+  if (_intervals) _allocator->release(_intervals, _count * sizeof(Interval));
+  if (_order) _allocator->release(_order, _count * sizeof(uint32_t));
+
+  _intervals = nullptr;
+  _order = nullptr;
+  _count = 0;
+  _orderCount = 0;
+  _numSlots = 0;
+
+  for (uint32_t kind = 0; kind < IRReg::kKindCount; kind++)
+    _usedRegs[kind] = 0;
+}
+
+// ============================================================================
+// [mpsl::IRRegAlloc - Internal]
+// ============================================================================
+
+void IRRegAlloc::_addUse(IRReg* reg, uint32_t position) noexcept {
+  uint32_t id = reg->id();
+  MPSL_ASSERT(id < _count);
+
+  Interval& interval = _intervals[id];
+  if (interval.reg == nullptr) {
+    // Pinned by the code generator.
+    if (reg->jitId() != kInvalidRegId)
+      return;
+
+    interval.reg = reg;
+    interval.start = position;
+    _order[_orderCount++] = id;
+  }
+
+  interval.end = position;
+}
+
+Error IRRegAlloc::_buildIntervals(IRBuilder* ir, const IRBlocks& layout) noexcept {
+  MPSL_ASSERT(ir->hasLiveness());
+
+  uint32_t maxBlockId = 0;
+  for (IRBlock* block : layout)
+    if (block->id() > maxBlockId)
+      maxBlockId = block->id();
+
+  // First and last positions of blocks, indexed by `IRBlock::id()`.
+  size_t rangesSize = (maxBlockId + 1) * 2 * sizeof(uint32_t);
+  uint32_t* blockStart = static_cast<uint32_t*>(_allocator->alloc(rangesSize));
+  MPSL_NULLCHECK(blockStart);
+
+  uint32_t* blockEnd = blockStart + maxBlockId + 1;
+  for (uint32_t i = 0; i <= maxBlockId; i++) {
+    blockStart[i] = kNoPosition;
+    blockEnd[i] = kNoPosition;
+  }
+
+  uint32_t position = 0;
+  for (IRBlock* block : layout) {
+    const IRBody& body = block->body();
+    if (body.empty())
+      continue;
+
+    blockStart[block->id()] = position;
+    for (IRInst* inst : body) {
+      IRObject** opArray = inst->operands();
+      uint32_t opCount = inst->opCount();
+
+      for (uint32_t i = 0; i < opCount; i++) {
+        IRObject* op = opArray[i];
+        if (op->isReg()) {
+          _addUse(op->as<IRReg>(), position);
+        }
+        else if (op->isMem()) {
+          IRMem* mem = op->as<IRMem>();
+          if (mem->hasBase()) _addUse(mem->base(), position);
+          if (mem->hasIndex()) _addUse(mem->index(), position);
+        }
+      }
+      position++;
+    }
+    blockEnd[block->id()] = position - 1;
+  }
+
+  // A register live at the beginning of a block is live from its start, and
+  // a register live at its end is live until its last position, which covers
+  // values that are live across backward edges and through blocks that don't
+  // use them.
+  uint32_t liveWords = ir->liveWords();
+  for (IRBlock* block : layout) {
+    uint32_t start = blockStart[block->id()];
+    uint32_t end = blockEnd[block->id()];
+
+    if (start == kNoPosition || !block->isReachable())
+      continue;
+
+    const uint32_t* liveIn = ir->liveIn(block);
+    const uint32_t* liveOut = ir->liveOut(block);
+
+    for (uint32_t w = 0; w < liveWords; w++) {
+      uint32_t bits = liveIn[w] | liveOut[w];
+
+      while (bits) {
+        uint32_t bit = asmjit::Support::ctz(bits);
+        uint32_t id = w * 32 + bit;
+        bits &= bits - 1;
+
+        // Pinned, or not used by any block of `layout`.
+        if (id >= _count || _intervals[id].reg == nullptr)
+          continue;
+
+        Interval& interval = _intervals[id];
+        if ((liveIn[w] & (1u << bit)) && interval.start > start) interval.start = start;
+        if ((liveOut[w] & (1u << bit)) && interval.end < end) interval.end = end;
+      }
+    }
+  }
+
+  _allocator->release(blockStart, rangesSize);
+  return _sortIntervals(position);
+}
+
+Error IRRegAlloc::_sortIntervals(uint32_t numPositions) noexcept {
+  // Counting sort by the start position, linear in the count of positions.
+  size_t countsSize = (numPositions + 1) * sizeof(uint32_t);
+  size_t sortedSize = _orderCount * sizeof(uint32_t);
+
+  uint32_t* counts = static_cast<uint32_t*>(_allocator->alloc(countsSize));
+  uint32_t* sorted = static_cast<uint32_t*>(_allocator->alloc(sortedSize + 1));
+
+  if (counts == nullptr || sorted == nullptr) {
+    if (counts) _allocator->release(counts, countsSize);
+    if (sorted) _allocator->release(sorted, sortedSize + 1);
+    return MPSL_TRACE_ERROR(kErrorNoMemory);
+  }
+
+  uint32_t i;
+  for (i = 0; i <= numPositions; i++)
+    counts[i] = 0;
+
+  for (i = 0; i < _orderCount; i++)
+    counts[_intervals[_order[i]].start + 1]++;
+
+  for (i = 1; i <= numPositions; i++)
+    counts[i] += counts[i - 1];
+
+  for (i = 0; i < _orderCount; i++)
+    sorted[counts[_intervals[_order[i]].start]++] = _order[i];
+
+  ::memcpy(_order, sorted, sortedSize);
+
+  _allocator->release(sorted, sortedSize + 1);
+  _allocator->release(counts, countsSize);
+  return kErrorOk;
+}
+
+void IRRegAlloc::_assignRegs(const uint32_t available[IRReg::kKindCount]) noexcept {
+  uint32_t freeRegs[IRReg::kKindCount];
+  uint32_t active[IRReg::kKindCount][32];
+  uint32_t numActive[IRReg::kKindCount];
+
+  for (uint32_t kind = 0; kind < IRReg::kKindCount; kind++) {
+    freeRegs[kind] = available[kind];
+    numActive[kind] = 0;
+  }
+
+  for (uint32_t i = 0; i < _orderCount; i++) {
+    uint32_t id = _order[i];
+    Interval& cur = _intervals[id];
+
+    uint32_t kind = cur.reg->reg();
+    uint32_t* kindActive = active[kind];
+    uint32_t n = numActive[kind];
+
+    // Expire intervals that end before `cur` starts. An interval that ends
+    // where `cur` starts is still active, so the destination of an instruction
+    // never shares a physical register with its sources.
+    uint32_t j = 0;
+    while (j < n) {
+      Interval& other = _intervals[kindActive[j]];
+      if (other.end < cur.start) {
+        freeRegs[kind] |= 1u << other.physId;
+        kindActive[j] = kindActive[--n];
+      }
+      else {
+        j++;
+      }
+    }
+
+    if (freeRegs[kind]) {
+      cur.physId = asmjit::Support::ctz(freeRegs[kind]);
+      freeRegs[kind] &= ~(1u << cur.physId);
+      kindActive[n++] = id;
+    }
+    else if (n != 0) {
+      // Spill the interval that ends last, either an active one or `cur`.
+      uint32_t last = 0;
+      for (j = 1; j < n; j++)
+        if (_intervals[kindActive[j]].end > _intervals[kindActive[last]].end)
+          last = j;
+
+      Interval& other = _intervals[kindActive[last]];
+      if (other.end > cur.end) {
+        cur.physId = other.physId;
+        other.physId = kInvalidRegId;
+        kindActive[last] = id;
+      }
+    }
+
+    numActive[kind] = n;
+  }
+}
+
+Error IRRegAlloc::_assignSlots() noexcept {
+  // Spilled intervals are processed in the order of their start, a slot is
+  // reused when the interval that had it ended before.
+  size_t slotEndSize = _orderCount * sizeof(uint32_t) + 1;
+  uint32_t* slotEnd = static_cast<uint32_t*>(_allocator->alloc(slotEndSize));
+  MPSL_NULLCHECK(slotEnd);
+
+  for (uint32_t i = 0; i < _orderCount; i++) {
+    Interval& cur = _intervals[_order[i]];
+    if (cur.physId != kInvalidRegId)
+      continue;
+
+    uint32_t slot = 0;
+    while (slot < _numSlots && slotEnd[slot] >= cur.start)
+      slot++;
+
+    if (slot == _numSlots)
+      _numSlots++;
+
+    slotEnd[slot] = cur.end;
+    cur.slot = slot;
+  }
+
+  _allocator->release(slotEnd, slotEndSize);
+  return kErrorOk;
+}
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
@@ -0,0 +1,128 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _MPSL_MPIRREGALLOC_P_H
+#define _MPSL_MPIRREGALLOC_P_H
+
+// [Dependencies - MPSL]
+#include "./mpir_p.h"
+#include "./mplang_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::IRRegAlloc]
+// ============================================================================
+
+//! \internal
+//!
+//! Linear-scan register allocator used by code assembled at `kOptionO0`.
+//!
+//! Instructions are numbered in the order of the block layout and each
+//! `IRReg` gets a single interval that covers all its occurrences and all
+//! positions where it's live (see `IRBuilder::updateLiveness()`), so values
+//! live across loop iterations are never clobbered. Intervals that
+//! don't fit physical registers are spilled as a whole - the code generator
+//! loads them to scratch registers before each instruction that uses them
+//! and stores them back after it.
+//!
+//! Registers that already have a JIT id (like data pointers) are considered
+//! pinned and are not allocated.
+class IRRegAlloc {
+public:
+  MPSL_NONCOPYABLE(IRRegAlloc)
+
+  enum {
+    //! Position that wasn't assigned.
+    kNoPosition = 0xFFFFFFFFu,
+    //! Spill slot of a register that is not spilled.
+    kNoSlot = 0xFFFFFFFFu,
+    //! Size of a spill slot (in bytes), each slot can hold any register.
+    kSlotSize = 16
+  };
+
+  //! Live interval of a single `IRReg`.
+  struct Interval {
+    IRReg* reg;                          //!< Register, null if not allocated.
+    uint32_t start;                      //!< First position.
+    uint32_t end;                        //!< Last position (inclusive).
+    uint32_t physId;                     //!< Physical register, `kInvalidRegId` if spilled.
+    uint32_t slot;                       //!< Spill slot, `kNoSlot` if not spilled.
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  IRRegAlloc(ZoneAllocator* allocator) noexcept;
+  ~IRRegAlloc() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Allocate all registers used by blocks of `layout`, `available` contains a
+  //! mask of physical registers of each `IRReg::Kind` that can be assigned.
+  //! The liveness of `ir` must be up to date.
+  //!
+  //! Registers that got a physical register have it as their JIT id.
+  Error run(IRBuilder* ir, const IRBlocks& layout, const uint32_t available[IRReg::kKindCount]) noexcept;
+
+  //! Release all data of the last `run()`.
+  void reset() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  //! Get the spill slot of `reg`, or `kNoSlot` if it's not spilled.
+  MPSL_INLINE uint32_t slotOf(const IRReg* reg) const noexcept {
+    uint32_t id = reg->id();
+    return id < _count ? _intervals[id].slot : static_cast<uint32_t>(kNoSlot);
+  }
+
+  //! Get a mask of physical registers of `kind` assigned by `run()`.
+  MPSL_INLINE uint32_t usedRegs(uint32_t kind) const noexcept { return _usedRegs[kind]; }
+  //! Get the count of spill slots required.
+  MPSL_INLINE uint32_t numSlots() const noexcept { return _numSlots; }
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  void _addUse(IRReg* reg, uint32_t position) noexcept;
+
+  Error _buildIntervals(IRBuilder* ir, const IRBlocks& layout) noexcept;
+  Error _sortIntervals(uint32_t numPositions) noexcept;
+  void _assignRegs(const uint32_t available[IRReg::kKindCount]) noexcept;
+  Error _assignSlots() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  ZoneAllocator* _allocator;             //!< Allocator.
+
+  Interval* _intervals;                  //!< Intervals indexed by `IRReg::id()`.
+  uint32_t* _order;                      //!< Ids of allocated registers, sorted by start.
+  uint32_t _count;                       //!< Count of `_intervals`.
+  uint32_t _orderCount;                  //!< Count of `_order`.
+
+  uint32_t _usedRegs[IRReg::kKindCount]; //!< Physical registers assigned.
+  uint32_t _numSlots;                    //!< Count of spill slots.
+};
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
+
+// [Guard]
+#endif // _MPSL_MPIRREGALLOC_P_H
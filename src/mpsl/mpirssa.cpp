@@ -0,0 +1,542 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define MPSL_EXPORTS
+
+// [Dependencies - MPSL]
+#include "./mpirssa_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::IRSSAState]
+// ============================================================================
+
+//! \internal
+//!
+//! State of the SSA construction.
+//!
+//! Variables are indexed by their ID, only variables that existed before the
+//! construction are renamed. Per-block data is indexed by `IRBlock::rpoIndex()`.
+class IRSSAState {
+public:
+  MPSL_NONCOPYABLE(IRSSAState)
+
+  //! Entry of the log that restores `current` after a subtree of the dominator
+  //! tree was renamed.
+  struct Undo {
+    uint32_t id;
+    IRReg* reg;
+  };
+
+  MPSL_INLINE IRSSAState(IRBuilder* ir) noexcept
+    : _ir(ir),
+      _allocator(ir->allocator()),
+      _numVars(ir->lastVarId()),
+      _numBlocks(static_cast<uint32_t>(ir->rpo().size())),
+      _vars(nullptr),
+      _current(nullptr),
+      _defBlocks(nullptr),
+      _phiVars(nullptr) {}
+
+  MPSL_INLINE ~IRSSAState() noexcept {
+    if (_defBlocks) {
+      for (uint32_t i = 0; i <= _numVars; i++)
+        _defBlocks[i].release(_allocator);
+      _allocator->release(_defBlocks, (_numVars + 1) * sizeof(IRBlocks));
+    }
+
+    if (_phiVars) {
+      for (uint32_t i = 0; i < _numBlocks; i++)
+        _phiVars[i].release(_allocator);
+      _allocator->release(_phiVars, _numBlocks * sizeof(ZoneVector<uint32_t>));
+    }
+
+    if (_vars) {
+      // Release the references that kept the original variables alive while
+      // their uses were renamed.
+      for (uint32_t i = 0; i <= _numVars; i++)
+        if (_vars[i])
+          _ir->derefObject(_vars[i]);
+      _allocator->release(_vars, (_numVars + 1) * sizeof(IRReg*));
+    }
+
+    if (_current)
+      _allocator->release(_current, (_numVars + 1) * sizeof(IRReg*));
+
+    _undo.release(_allocator);
+  }
+
+  template<typename T>
+  MPSL_INLINE T* allocZeroed(size_t count) noexcept {
+    T* p = static_cast<T*>(_allocator->alloc(count * sizeof(T)));
+    if (p) ::memset(p, 0, count * sizeof(T));
+    return p;
+  }
+
+  Error init() noexcept;
+  Error collectDefs() noexcept;
+  Error placePhis() noexcept;
+  Error renameBlock(IRBlock* block) noexcept;
+  Error define(IRInst* inst, uint32_t id) noexcept;
+  Error removeDeadPhis() noexcept;
+
+  //! Get the original variable of `op`, null if `op` is not renamed.
+  MPSL_INLINE IRReg* varOf(IRObject* op) const noexcept {
+    if (!op->isReg() || op->id() > _numVars)
+      return nullptr;
+    return _vars[op->id()];
+  }
+
+  IRBuilder* _ir;
+  ZoneAllocator* _allocator;
+
+  uint32_t _numVars;                     //!< Variables that existed before the construction.
+  uint32_t _numBlocks;                   //!< Reachable blocks.
+
+  IRReg** _vars;                         //!< Variables that are assigned, by ID.
+  IRReg** _current;                      //!< Current version of each variable.
+  IRBlocks* _defBlocks;                  //!< Blocks that assign each variable.
+  ZoneVector<uint32_t>* _phiVars;        //!< Variable of each phi of a block.
+  ZoneVector<Undo> _undo;                //!< Versions replaced during renaming.
+};
+
+Error IRSSAState::init() noexcept {
+  size_t numVars = static_cast<size_t>(_numVars) + 1;
+
+  _vars = allocZeroed<IRReg*>(numVars);
+  _current = allocZeroed<IRReg*>(numVars);
+  MPSL_NULLCHECK(_vars && _current);
+
+  _defBlocks = static_cast<IRBlocks*>(_allocator->alloc(numVars * sizeof(IRBlocks)));
+  MPSL_NULLCHECK(_defBlocks);
+
+  for (size_t i = 0; i < numVars; i++)
+    new(&_defBlocks[i]) IRBlocks();
+
+  _phiVars = static_cast<ZoneVector<uint32_t>*>(_allocator->alloc(_numBlocks * sizeof(ZoneVector<uint32_t>)));
+  MPSL_NULLCHECK(_phiVars);
+
+  for (uint32_t i = 0; i < _numBlocks; i++)
+    new(&_phiVars[i]) ZoneVector<uint32_t>();
+
+  return kErrorOk;
+}
+
+// Variables that are only used in the block that assigns them, after the
+// assignment, never need a phi (semi-pruned SSA). `killed` remembers the last
+// block that assigned each variable.
+Error IRSSAState::collectDefs() noexcept {
+  size_t numVars = static_cast<size_t>(_numVars) + 1;
+
+  uint32_t* killed = allocZeroed<uint32_t>(numVars);
+  uint8_t* global = allocZeroed<uint8_t>(numVars);
+
+  Error err = (killed && global) ? static_cast<Error>(kErrorOk) : MPSL_TRACE_ERROR(kErrorNoMemory);
+  for (uint32_t b = 0; b < _numBlocks && err == kErrorOk; b++) {
+    IRBlock* block = _ir->rpo()[b];
+    uint32_t stamp = b + 1;
+
+    for (IRInst* inst : block->body()) {
+      IRObject** opArray = inst->operands();
+      uint32_t opCount = inst->opCount();
+      bool hasDef = inst->hasDef();
+
+      for (uint32_t i = hasDef ? 1 : 0; i < opCount; i++) {
+        IRObject* op = opArray[i];
+        if (op->isReg() && op->id() <= _numVars && killed[op->id()] != stamp)
+          global[op->id()] = 1;
+      }
+
+      if (!hasDef)
+        continue;
+
+      uint32_t id = opArray[0]->id();
+      if (id > _numVars)
+        continue;
+
+      if (!_vars[id]) {
+        _vars[id] = opArray[0]->as<IRReg>();
+        _vars[id]->addRef();
+      }
+
+      if (killed[id] != stamp) {
+        killed[id] = stamp;
+        err = _defBlocks[id].append(_allocator, block);
+        if (err) break;
+      }
+    }
+  }
+
+  // Variables that are not global don't need their definition blocks.
+  if (err == kErrorOk) {
+    for (size_t id = 1; id < numVars; id++)
+      if (!global[id])
+        _defBlocks[id].release(_allocator);
+  }
+
+  if (killed) _allocator->release(killed, numVars * sizeof(uint32_t));
+  if (global) _allocator->release(global, numVars * sizeof(uint8_t));
+  return err;
+}
+
+// Phis of a variable are placed at the iterated dominance frontier of blocks
+// that assign it, a block that gets a phi assigns the variable as well.
+Error IRSSAState::placePhis() noexcept {
+  uint32_t* hasPhi = allocZeroed<uint32_t>(_numBlocks);
+  uint32_t* inWork = allocZeroed<uint32_t>(_numBlocks);
+  IRBlocks work;
+
+  Error err = (hasPhi && inWork) ? static_cast<Error>(kErrorOk) : MPSL_TRACE_ERROR(kErrorNoMemory);
+  for (uint32_t id = 1; id <= _numVars && err == kErrorOk; id++) {
+    IRBlocks& defBlocks = _defBlocks[id];
+    if (defBlocks.empty())
+      continue;
+
+    for (IRBlock* block : defBlocks) {
+      inWork[block->rpoIndex()] = id;
+      err = work.append(_allocator, block);
+      if (err) break;
+    }
+
+    while (!work.empty() && err == kErrorOk) {
+      IRBlock* block = work[work.size() - 1];
+      work.truncate(work.size() - 1);
+
+      for (IRBlock* frontier : block->frontier()) {
+        uint32_t index = frontier->rpoIndex();
+        if (hasPhi[index] == id)
+          continue;
+
+        IRInst* phi = _ir->newPhi(_vars[id], static_cast<uint32_t>(frontier->predecessors().size()));
+        if (!phi) {
+          err = MPSL_TRACE_ERROR(kErrorNoMemory);
+          break;
+        }
+
+        hasPhi[index] = id;
+        err = frontier->addPhi(phi);
+        if (err) {
+          _ir->deleteInst(phi);
+          break;
+        }
+
+        err = _phiVars[index].append(_allocator, id);
+        if (err) break;
+
+        if (inWork[index] != id) {
+          inWork[index] = id;
+          err = work.append(_allocator, frontier);
+          if (err) break;
+        }
+      }
+    }
+
+    work.truncate(0);
+  }
+
+  work.release(_allocator);
+  if (hasPhi) _allocator->release(hasPhi, _numBlocks * sizeof(uint32_t));
+  if (inWork) _allocator->release(inWork, _numBlocks * sizeof(uint32_t));
+  return err;
+}
+
+Error IRSSAState::define(IRInst* inst, uint32_t id) noexcept {
+  IRReg* var = _vars[id];
+  IRReg* version = _ir->newVar(var->reg(), var->width());
+  MPSL_NULLCHECK(version);
+
+  Undo undo;
+  undo.id = id;
+  undo.reg = _current[id];
+  MPSL_PROPAGATE(_undo.append(_allocator, undo));
+
+  _current[id] = version;
+  _ir->replaceOperand(inst, 0, version);
+  return kErrorOk;
+}
+
+// Blocks are renamed in pre-order of the dominator tree, the current version
+// of a variable at a block is the version assigned last in its dominators. A
+// use that isn't dominated by any assignment keeps the original variable.
+Error IRSSAState::renameBlock(IRBlock* block) noexcept {
+  size_t undoMark = _undo.size();
+
+  IRBody& phis = block->phis();
+  ZoneVector<uint32_t>& phiVars = _phiVars[block->rpoIndex()];
+
+  for (size_t i = 0, size = phis.size(); i < size; i++)
+    MPSL_PROPAGATE(define(phis[i], phiVars[i]));
+
+  for (IRInst* inst : block->body()) {
+    IRObject** opArray = inst->operands();
+    uint32_t opCount = inst->opCount();
+    bool hasDef = inst->hasDef();
+
+    // Uses are renamed first, `Blend` reads the variable it assigns.
+    for (uint32_t i = hasDef ? 1 : 0; i < opCount; i++) {
+      IRReg* var = varOf(opArray[i]);
+      if (var)
+        _ir->replaceOperand(inst, i, _current[var->id()]);
+    }
+
+    if (hasDef) {
+      IRReg* var = varOf(opArray[0]);
+      if (var)
+        MPSL_PROPAGATE(define(inst, var->id()));
+    }
+  }
+
+  for (IRBlock* successor : block->successors()) {
+    IRBody& succPhis = successor->phis();
+    if (succPhis.empty())
+      continue;
+
+    const IRBlocks& predecessors = successor->predecessors();
+    uint32_t opIndex = 1;
+
+    while (predecessors[opIndex - 1] != block)
+      opIndex++;
+
+    ZoneVector<uint32_t>& succPhiVars = _phiVars[successor->rpoIndex()];
+    for (size_t i = 0, size = succPhis.size(); i < size; i++)
+      _ir->replaceOperand(succPhis[i], opIndex, _current[succPhiVars[i]]);
+  }
+
+  for (IRBlock* child : block->dominated())
+    MPSL_PROPAGATE(renameBlock(child));
+
+  while (_undo.size() > undoMark) {
+    const Undo& undo = _undo[_undo.size() - 1];
+    _current[undo.id] = undo.reg;
+    _undo.truncate(_undo.size() - 1);
+  }
+
+  return kErrorOk;
+}
+
+// A phi is live if its result is used by an instruction other than a phi, or
+// by a live phi. Phis of a loop-carried variable that is never read form a
+// cycle that keeps them referenced, so reference counts alone aren't enough.
+Error IRSSAState::removeDeadPhis() noexcept {
+  size_t numIds = static_cast<size_t>(_ir->lastVarId()) + 1;
+
+  IRInst** phiOf = allocZeroed<IRInst*>(numIds);
+  uint32_t* phiUses = allocZeroed<uint32_t>(numIds);
+  uint8_t* live = allocZeroed<uint8_t>(numIds);
+  ZoneVector<IRInst*> work;
+
+  Error err = (phiOf && phiUses && live) ? static_cast<Error>(kErrorOk) : MPSL_TRACE_ERROR(kErrorNoMemory);
+  if (err == kErrorOk) {
+    for (IRBlock* block : _ir->rpo())
+      for (IRInst* phi : block->phis())
+        phiOf[phi->op(0)->id()] = phi;
+
+    for (IRBlock* block : _ir->rpo())
+      for (IRInst* phi : block->phis())
+        for (uint32_t i = 1; i < phi->opCount(); i++)
+          if (phiOf[phi->op(i)->id()])
+            phiUses[phi->op(i)->id()]++;
+
+    for (IRBlock* block : _ir->rpo()) {
+      for (IRInst* phi : block->phis()) {
+        IRObject* dst = phi->op(0);
+        if (dst->refCount() - 1 > phiUses[dst->id()]) {
+          live[dst->id()] = 1;
+          err = work.append(_allocator, phi);
+          if (err) break;
+        }
+      }
+      if (err) break;
+    }
+
+    while (!work.empty() && err == kErrorOk) {
+      IRInst* phi = work[work.size() - 1];
+      work.truncate(work.size() - 1);
+
+      for (uint32_t i = 1; i < phi->opCount(); i++) {
+        uint32_t id = phi->op(i)->id();
+        if (phiOf[id] && !live[id]) {
+          live[id] = 1;
+          err = work.append(_allocator, phiOf[id]);
+          if (err) break;
+        }
+      }
+    }
+  }
+
+  if (err == kErrorOk) {
+    for (IRBlock* block : _ir->rpo()) {
+      IRBody& phis = block->phis();
+      size_t dstIndex = 0;
+
+      for (size_t i = 0, size = phis.size(); i < size; i++) {
+        IRInst* phi = phis[i];
+        if (live[phi->op(0)->id()])
+          phis[dstIndex++] = phi;
+        else
+          _ir->deleteInst(phi);
+      }
+
+      phis.truncate(dstIndex);
+    }
+  }
+
+  work.release(_allocator);
+  if (phiOf) _allocator->release(phiOf, numIds * sizeof(IRInst*));
+  if (phiUses) _allocator->release(phiUses, numIds * sizeof(uint32_t));
+  if (live) _allocator->release(live, numIds * sizeof(uint8_t));
+  return err;
+}
+
+// ============================================================================
+// [mpsl::mpIRToSSA]
+// ============================================================================
+
+Error mpIRToSSA(IRBuilder* ir) noexcept {
+  MPSL_ASSERT(!ir->isSSA());
+  MPSL_PROPAGATE(ir->removeUnreachableBlocks());
+
+  IRSSAState state(ir);
+  MPSL_PROPAGATE(state.init());
+  MPSL_PROPAGATE(state.collectDefs());
+  MPSL_PROPAGATE(state.placePhis());
+
+  for (uint32_t id = 1; id <= state._numVars; id++)
+    state._current[id] = state._vars[id];
+
+  MPSL_PROPAGATE(state.renameBlock(ir->entryBlock()));
+  MPSL_PROPAGATE(state.removeDeadPhis());
+
+  ir->setSSA(true);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::mpIRFromSSA]
+// ============================================================================
+
+//! \internal
+struct IRCopy {
+  IRReg* dst;
+  IRReg* src;
+};
+
+//! \internal
+//!
+//! Emit parallel `copies` into `block`. A copy is emitted when no other copy
+//! reads its destination, if there is no such copy the remaining ones form
+//! cycles and a destination is saved to a temporary to break one.
+static Error mpEmitParallelCopies(IRBuilder* ir, IRBlock* block, ZoneVector<IRCopy>& copies) noexcept {
+  while (!copies.empty()) {
+    size_t size = copies.size();
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+      IRReg* dst = copies[i].dst;
+      size_t j;
+
+      for (j = 0; j < size; j++)
+        if (j != i && copies[j].src == dst)
+          break;
+
+      if (j == size)
+        break;
+    }
+
+    if (i < size) {
+      IRInst* inst = ir->newMove(copies[i].dst, copies[i].src);
+      MPSL_NULLCHECK(inst);
+      MPSL_PROPAGATE(block->insertBeforeTerminator(inst));
+
+      copies[i] = copies[size - 1];
+      copies.truncate(size - 1);
+    }
+    else {
+      IRReg* dst = copies[0].dst;
+      IRReg* tmp = ir->newVar(dst->reg(), dst->width());
+      MPSL_NULLCHECK(tmp);
+
+      IRInst* inst = ir->newMove(tmp, dst);
+      MPSL_NULLCHECK(inst);
+      MPSL_PROPAGATE(block->insertBeforeTerminator(inst));
+
+      for (i = 0; i < size; i++)
+        if (copies[i].src == dst)
+          copies[i].src = tmp;
+    }
+  }
+
+  return kErrorOk;
+}
+
+static Error mpIRFromSSABlock(IRBuilder* ir, IRBlock* block, ZoneVector<IRCopy>& copies) noexcept {
+  IRBody& phis = block->phis();
+
+  for (size_t i = 0; i < block->predecessors().size(); i++) {
+    IRBlock* predecessor = block->predecessors()[i];
+    uint32_t opIndex = static_cast<uint32_t>(i) + 1;
+
+    copies.truncate(0);
+    for (IRInst* phi : phis) {
+      IRCopy copy;
+      copy.dst = phi->op(0)->as<IRReg>();
+      copy.src = phi->op(opIndex)->as<IRReg>();
+
+      MPSL_ASSERT(phi->op(opIndex)->isReg());
+      if (copy.dst != copy.src)
+        MPSL_PROPAGATE(copies.append(ir->allocator(), copy));
+    }
+
+    if (copies.empty())
+      continue;
+
+    // Copies on a critical edge need their own block. The new block replaces
+    // `predecessor` at the same index, so operands of phis don't move.
+    if (predecessor->successors().size() > 1)
+      MPSL_PROPAGATE(ir->splitEdge(predecessor, block, &predecessor));
+
+    MPSL_PROPAGATE(mpEmitParallelCopies(ir, predecessor, copies));
+  }
+
+  for (IRInst* phi : phis)
+    ir->deleteInst(phi);
+
+  phis.release(ir->allocator());
+  return kErrorOk;
+}
+
+Error mpIRFromSSA(IRBuilder* ir) noexcept {
+  MPSL_ASSERT(ir->isSSA());
+
+  // Blocks created by splitting edges are appended, they never have phis.
+  ZoneVector<IRCopy> copies;
+  Error err = kErrorOk;
+
+  for (size_t i = 0, size = ir->blocks().size(); i < size; i++) {
+    IRBlock* block = ir->blocks()[i];
+    if (!block->hasPhis())
+      continue;
+
+    err = mpIRFromSSABlock(ir, block, copies);
+    if (err) break;
+  }
+
+  copies.release(ir->allocator());
+  MPSL_PROPAGATE(err);
+
+  ir->setSSA(false);
+  return ir->updateCFG();
+}
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
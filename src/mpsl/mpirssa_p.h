@@ -0,0 +1,42 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _MPSL_MPIRSSA_P_H
+#define _MPSL_MPIRSSA_P_H
+
+// [Dependencies - MPSL]
+#include "./mpir_p.h"
+#include "./mplang_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+//! Translate the IR into SSA form.
+//!
+//! Unreachable blocks are removed and the CFG is analyzed first. Phis are
+//! placed at the iterated dominance frontier of blocks that assign variables
+//! which are live across blocks, then each assignment gets a new variable by
+//! a walk of the dominator tree. Phis that end up unused are removed.
+Error mpIRToSSA(IRBuilder* ir) noexcept;
+
+//! Translate the IR out of SSA form.
+//!
+//! Each phi is replaced by copies at the end of its predecessors, critical
+//! edges are split so the copies only execute on the edge they belong to.
+//! Copies of a single edge are parallel and are sequentialized with a
+//! temporary when they form a cycle.
+Error mpIRFromSSA(IRBuilder* ir) noexcept;
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
+
+// [Guard]
+#endif // _MPSL_MPIRSSA_P_H
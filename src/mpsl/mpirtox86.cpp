@@ -10,6 +10,7 @@
 // [Dependencies - MPSL]
 #include "./mpirtox86_p.h"
 #include "./mpmath_p.h"
+#include "./mpuniforms_p.h"
 
 // [Api-Begin]
 #include "./mpsl_apibegin.h"
@@ -22,20 +23,223 @@ using namespace asmjit;
 // [mpsl::IRToX86 - Construction / Destruction]
 // ============================================================================
 
-IRToX86::IRToX86(ZoneAllocator* allocator, x86::Compiler* cc)
+// Physical registers used by assembled code (X64 only). Scratch registers
+// hold spilled registers during a single instruction and temporaries are
+// used by instruction sequences, neither is ever allocated. Registers of the
+// pools are allocated in order, pinned registers (data pointers and loop
+// variables) are taken from the beginning of the GP pool.
+static const uint32_t mpAsmScratchGp[] = { x86::Gp::kIdAx, x86::Gp::kIdCx, x86::Gp::kIdDx };
+static const uint32_t mpAsmScratchVec[] = { 0, 1, 2, 3 };
+
+static const uint32_t mpAsmTmpGp = x86::Gp::kIdR11;
+static const uint32_t mpAsmTmpVec0 = 4;
+static const uint32_t mpAsmTmpVec1 = 5;
+
+static const uint32_t mpAsmPoolGp[] = {
+  x86::Gp::kIdR8 , x86::Gp::kIdR9 , x86::Gp::kIdR10, x86::Gp::kIdSi ,
+  x86::Gp::kIdDi , x86::Gp::kIdBx , x86::Gp::kIdR12, x86::Gp::kIdR13,
+  x86::Gp::kIdR14, x86::Gp::kIdR15, x86::Gp::kIdBp
+};
+static const uint32_t mpAsmPoolVec[] = { 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+IRToX86::IRToX86(ZoneAllocator* allocator, BaseEmitter* emitter)
   : _allocator(allocator),
-    _cc(cc),
+    _cc(emitter->as<x86::Emitter>()),
+    _compiler(emitter->isCompiler() ? emitter->as<x86::Compiler>() : nullptr),
+    _funcNode(nullptr),
     _functionBody(nullptr),
-    _constPool(&cc->_codeZone) {
+    _constPool(_compiler ? &_compiler->_codeZone : allocator->zone()),
+    _uniformReg(nullptr),
+    _uniformData(nullptr),
+    _uniformCursor(nullptr),
+    _regAlloc(allocator),
+    _spillOffset(0),
+    _tierCounter(nullptr),
+    _tierOnHot(nullptr),
+    _tierArg(nullptr),
+    _numLanes(1),
+    _activeLanes(1),
+    _usesV256(false),
+    _fastMath(false) {
+
+  if (_compiler) {
+    _tmpXmm0 = _compiler->newXmm("tmpXmm0");
+    _tmpXmm1 = _compiler->newXmm("tmpXmm1");
+  }
+  else {
+    _tmpXmm0 = x86::xmm(mpAsmTmpVec0);
+    _tmpXmm1 = x86::xmm(mpAsmTmpVec1);
+    _tmpGp = x86::gpq(mpAsmTmpGp);
+  }
+
+  uint32_t features = usedFeatures(0);
+  _enableSSE4_1 = (features & kFeatureSSE4_1) != 0;
+  _enableAVX = (features & kFeatureAVX) != 0;
+  _enableAVX2 = (features & kFeatureAVX2) != 0;
+}
+
+IRToX86::~IRToX86() {
+  _uniformLoads.release(_allocator);
+}
+
+// ============================================================================
+// [mpsl::IRToX86 - Features]
+// ============================================================================
 
-  _tmpXmm0 = _cc->newXmm("tmpXmm0");
-  _tmpXmm1 = _cc->newXmm("tmpXmm1");
+// Each option disables the feature and all features that depend on it.
+static const uint32_t kDisableSSE4_1Mask = kOptionDisableSSE3 | kOptionDisableSSSE3 | kOptionDisableSSE4_1;
+static const uint32_t kDisableAVXMask = kDisableSSE4_1Mask | kOptionDisableSSE4_2 | kOptionDisableAVX;
+static const uint32_t kDisableAVX2Mask = kDisableAVXMask | kOptionDisableAVX2;
 
+uint32_t IRToX86::usedFeatures(uint32_t options) {
   const x86::Features& features = CpuInfo::host().features().as<x86::Features>();
-  _enableSSE4_1 = features.hasSSE4_1();
+  uint32_t result = 0;
+
+  if (features.hasSSE4_1() && !(options & kDisableSSE4_1Mask)) result |= kFeatureSSE4_1;
+  if (features.hasAVX() && !(options & kDisableAVXMask)) result |= kFeatureAVX;
+  if (features.hasAVX2() && !(options & kDisableAVX2Mask)) result |= kFeatureAVX2;
+
+  return result;
+}
+
+bool IRToX86::hasV256(uint32_t options) {
+  // Integer vectors are 256-bit as well, so AVX alone is not enough.
+  return (usedFeatures(options) & kFeatureAVX2) != 0;
+}
+
+bool IRToX86::canAssemble(IRBuilder* ir, uint32_t options, const char** reason) {
+  // Assembled code relies on 16 GP registers and RIP-relative constants. It
+  // doesn't implement math function calls, 256-bit registers, SPMD partial
+  // gangs, and uniforms, which are left to `x86::Compiler`.
+#if MPSL_ARCH_X64
+  if (ir->isSPMD()) {
+    *reason = "is compiled in SPMD mode";
+    return false;
+  }
+
+  if (ir->hasUniforms()) {
+    *reason = "reads uniform members";
+    return false;
+  }
+
+  for (IRBlock* block : ir->blocks()) {
+    if (!block)
+      continue;
+
+    for (IRInst* inst : block->body()) {
+      const InstInfo& info = mpInstInfo[inst->instCode() & kInstCodeMask];
+      if (info.isComplex() || info.isCall()) {
+        *reason = "calls math functions";
+        return false;
+      }
+
+      IRObject** opArray = inst->operands();
+      uint32_t opCount = inst->opCount();
+
+      for (uint32_t i = 0; i < opCount; i++) {
+        if (opArray[i]->isReg() && opArray[i]->as<IRReg>()->width() > 16) {
+          *reason = "uses 256-bit vectors";
+          return false;
+        }
+      }
+    }
+  }
+
+  *reason = nullptr;
+  return true;
+#else
+  *reason = "targets X86";
+  return false;
+#endif
+}
+
+void IRToX86::applyOptions(uint32_t options) {
+  uint32_t features = usedFeatures(options);
+  _enableSSE4_1 = (features & kFeatureSSE4_1) != 0;
+  _enableAVX = (features & kFeatureAVX) != 0;
+  _enableAVX2 = (features & kFeatureAVX2) != 0;
+  _fastMath = (options & kOptionFastMath) != 0;
+}
+
+// ============================================================================
+// [mpsl::IRToX86 - Tiering]
+// ============================================================================
+
+void IRToX86::setTierCounter(intptr_t* counter, void (MPSL_CDECL* onHot)(void*), void* arg) {
+  _tierCounter = counter;
+  _tierOnHot = onHot;
+  _tierArg = arg;
 }
 
-IRToX86::~IRToX86() {}
+Error IRToX86::emitTierCounter(const Operand& numRecords) {
+  if (!_tierCounter)
+    return kErrorOk;
+
+  // The counter is not decremented atomically, it only has to get negative
+  // eventually, `onHot()` makes it positive again. Assembled code holds the
+  // counter address in the temporary register and preserves GP registers the
+  // callee may clobber, it's emitted before any vector register is used.
+  Label L_Done = _cc->newLabel();
+
+  if (_compiler) {
+    x86::Gp counterPtr = _compiler->newIntPtr("tierCounter");
+    x86::Mem counter = x86::ptr(counterPtr, 0, sizeof(intptr_t));
+
+    _cc->mov(counterPtr, reinterpret_cast<intptr_t>(_tierCounter));
+    _cc->emit(x86::Inst::kIdSub, counter, numRecords);
+    _cc->jns(L_Done);
+
+    x86::Gp arg = _compiler->newIntPtr("tierArg");
+    _cc->mov(arg, reinterpret_cast<intptr_t>(_tierArg));
+
+    InvokeNode* invokeNode;
+    _compiler->invoke(&invokeNode,
+      static_cast<uint64_t>(reinterpret_cast<uintptr_t>(_tierOnHot)),
+      FuncSignatureT<void, void*>(CallConv::kIdHost));
+    invokeNode->setArg(0, arg);
+  }
+  else {
+    FuncDetail callee;
+    if (callee.init(FuncSignatureT<void, void*>(CallConv::kIdHost)) != asmjit::kErrorOk)
+      return MPSL_TRACE_ERROR(kErrorJITFailed);
+
+    _cc->mov(_tmpGp, reinterpret_cast<intptr_t>(_tierCounter));
+    _cc->emit(x86::Inst::kIdSub, x86::ptr(_tmpGp, 0, sizeof(intptr_t)), numRecords);
+    _cc->jns(L_Done);
+
+    uint32_t saved[16];
+    uint32_t numSaved = 0;
+    uint32_t preserved = callee.callConv().preservedRegs(x86::Reg::kGroupGp);
+
+    for (uint32_t id = 0; id < 16; id++) {
+      if (id != x86::Gp::kIdSp && id != mpAsmTmpGp && !(preserved & (1u << id)))
+        saved[numSaved++] = id;
+    }
+
+    // The stack is aligned here as the frame doesn't know about the call, the
+    // original stack pointer is kept above the callee's argument area.
+    int32_t spOffset = static_cast<int32_t>(callee.argStackSize());
+
+    for (uint32_t i = 0; i < numSaved; i++)
+      _cc->push(x86::gpq(saved[i]));
+
+    _cc->mov(_tmpGp, x86::rsp);
+    _cc->and_(x86::rsp, -16);
+    _cc->sub(x86::rsp, spOffset + 16);
+    _cc->mov(x86::ptr(x86::rsp, spOffset), _tmpGp);
+
+    _cc->mov(x86::gpq(callee.arg(0).regId()), reinterpret_cast<intptr_t>(_tierArg));
+    _cc->mov(x86::rax, reinterpret_cast<intptr_t>(_tierOnHot));
+    _cc->call(x86::rax);
+
+    _cc->mov(x86::rsp, x86::ptr(x86::rsp, spOffset));
+    for (uint32_t i = numSaved; i != 0; i--)
+      _cc->pop(x86::gpq(saved[i - 1]));
+  }
+
+  _cc->bind(L_Done);
+  return kErrorOk;
+}
 
 // ============================================================================
 // [mpsl::IRToX86 - Const Pool]
@@ -44,14 +248,27 @@ IRToX86::~IRToX86() {}
 void IRToX86::prepareConstPool() {
   if (!_constLabel.isValid()) {
     _constLabel = _cc->newLabel();
-    _constPtr = _cc->newIntPtr("constPool");
 
-    BaseNode* prev = _cc->setCursor(_functionBody);
-    _cc->lea(_constPtr, x86::ptr(_constLabel));
-    if (prev != _functionBody) _cc->setCursor(prev);
+    // Assembled code can't insert code before the current position, it
+    // addresses constants relative to RIP instead.
+    if (!_compiler)
+      return;
+
+    _constPtr = _compiler->newIntPtr("constPool");
+
+    BaseNode* prev = _compiler->setCursor(_functionBody);
+    _compiler->lea(_constPtr, x86::ptr(_constLabel));
+    if (prev != _functionBody) _compiler->setCursor(prev);
   }
 }
 
+x86::Mem IRToX86::getConstantAt(size_t offset) {
+  if (!_compiler)
+    return x86::ptr(_constLabel, static_cast<int>(offset));
+
+  return x86::ptr(_constPtr, static_cast<int>(offset));
+}
+
 x86::Mem IRToX86::getConstantU64(uint64_t value) {
   prepareConstPool();
 
@@ -59,7 +276,7 @@ x86::Mem IRToX86::getConstantU64(uint64_t value) {
   if (_constPool.add(&value, sizeof(uint64_t), offset) != kErrorOk)
     return x86::Mem();
 
-  return x86::ptr(_constPtr, static_cast<int>(offset));
+  return getConstantAt(offset);
 }
 
 x86::Mem IRToX86::getConstantU64AsPD(uint64_t value) {
@@ -70,7 +287,7 @@ x86::Mem IRToX86::getConstantU64AsPD(uint64_t value) {
   if (_constPool.add(&vec, sizeof(Data128), offset) != kErrorOk)
     return x86::Mem();
 
-  return x86::ptr(_constPtr, static_cast<int>(offset));
+  return getConstantAt(offset);
 }
 
 x86::Mem IRToX86::getConstantD64(double value) {
@@ -92,7 +309,137 @@ x86::Mem IRToX86::getConstantByValue(const Value& value, uint32_t width) {
   if (_constPool.add(&value, width, offset) != kErrorOk)
     return x86::Mem();
 
-  return x86::ptr(_constPtr, static_cast<int>(offset));
+  return getConstantAt(offset);
+}
+
+// ============================================================================
+// [mpsl::IRToX86 - Uniforms]
+// ============================================================================
+
+void IRToX86::prepareUniforms() {
+  MPSL_ASSERT(_compiler != nullptr);
+
+  // The address of the uniform block is loaded at `_functionBody` and every
+  // uniform loaded by `emitUniformFetch()` is placed after it, in order.
+  //
+  // The loads are enclosed by two reads of the sequence counter and repeated
+  // if `ProgramUniforms::set()` wrote a value meanwhile. X86 doesn't reorder
+  // loads with other loads, so no fence is needed.
+  if (_uniformCursor == nullptr) {
+    _uniformPtr = _compiler->newIntPtr("uniforms");
+
+    x86::Gp seq = _compiler->newIntPtr("uniformSeq");
+    x86::Mem seqMem = x86::ptr(_uniformPtr, ProgramUniforms::kSequenceOffset);
+    Label L_Retry = _compiler->newLabel();
+
+    BaseNode* prev = _compiler->setCursor(_functionBody);
+    _compiler->mov(_uniformPtr, imm(reinterpret_cast<intptr_t>(_uniformData)));
+
+    _compiler->bind(L_Retry);
+    _compiler->mov(seq, seqMem);
+    _compiler->test(seq, 1);
+    _compiler->jnz(L_Retry);
+    _uniformCursor = _compiler->cursor();
+
+    _compiler->cmp(seq, seqMem);
+    _compiler->jne(L_Retry);
+    if (prev != _functionBody) _compiler->setCursor(prev);
+  }
+
+  // Also required after `IRBuilder::resetJitData()`.
+  _uniformReg->setJitId(_uniformPtr.id());
+}
+
+bool IRToX86::isUniformFetch(IRInst* inst) const {
+  switch (inst->instCode()) {
+    case kInstCodeFetch32:
+    case kInstCodeFetch64:
+    case kInstCodeFetch96:
+    case kInstCodeFetch128:
+    case kInstCodeFetch256:
+      break;
+
+    default:
+      return false;
+  }
+
+  IRObject* src = inst->operands()[1];
+  return src->isMem() && src->as<IRMem>()->base() == _uniformReg;
+}
+
+Error IRToX86::emitUniformFetch(IRInst* inst, const Operand& dst) {
+  // Uniforms can't change while the function runs, so each of them is loaded
+  // only once before the function body, which is before the loop of a batch
+  // function, and copied where it's fetched.
+  uint32_t instCode = inst->instCode();
+  IRReg* irDst = inst->operands()[0]->as<IRReg>();
+  int32_t offset = inst->operands()[1]->as<IRMem>()->offset();
+
+  bool isGp = irDst->reg() == IRReg::kKindGp;
+  bool found = false;
+
+  x86::Reg reg;
+  for (const UniformLoad& load : _uniformLoads) {
+    if (load.instCode == instCode && load.offset == offset && load.isGp == isGp) {
+      reg = load.reg;
+      found = true;
+      break;
+    }
+  }
+
+  if (!found) {
+    if (isGp)
+      reg = _compiler->newInt32("u%d", offset);
+    else if (irDst->width() > 16)
+      reg = _compiler->newYmm("u%d", offset);
+    else
+      reg = _compiler->newXmm("u%d", offset);
+
+    UniformLoad load;
+    load.instCode = instCode;
+    load.offset = offset;
+    load.isGp = isGp;
+    load.reg = reg;
+    MPSL_PROPAGATE(_uniformLoads.append(_allocator, load));
+
+    x86::Mem mem = x86::ptr(_uniformPtr, offset);
+    BaseNode* at = _uniformCursor;
+    BaseNode* prev = _compiler->setCursor(at);
+
+    switch (instCode) {
+      case kInstCodeFetch32:
+        if (isGp)
+          _cc->emit(x86::Inst::kIdMov, reg, mem);
+        else
+          emit2x(x86::Inst::kIdMovd, reg, mem);
+        break;
+
+      case kInstCodeFetch64:
+        emit2x(x86::Inst::kIdMovq, reg, mem);
+        break;
+
+      case kInstCodeFetch96:
+        emit2x(x86::Inst::kIdMovq, reg, mem);
+        mem.addOffsetLo32(8);
+        emit2x(x86::Inst::kIdMovd, _tmpXmm0, mem);
+        emit3i(x86::Inst::kIdPunpcklqdq, reg, reg, _tmpXmm0);
+        break;
+
+      default:
+        emit2x(x86::Inst::kIdMovups, reg, mem);
+        break;
+    }
+
+    _uniformCursor = _compiler->cursor();
+    if (prev != at) _compiler->setCursor(prev);
+  }
+
+  if (isGp)
+    _cc->emit(x86::Inst::kIdMov, dst, reg);
+  else
+    emit2x(x86::Inst::kIdMovaps, dst, reg);
+
+  return kErrorOk;
 }
 
 // ============================================================================
@@ -100,6 +447,10 @@ x86::Mem IRToX86::getConstantByValue(const Value& value, uint32_t width) {
 // ============================================================================
 
 Error IRToX86::compileIRAsFunc(IRBuilder* ir) {
+  if (!_compiler)
+    return assembleIRAsFunc(ir);
+
+  x86::Compiler* cc = _compiler;
   uint32_t i;
   uint32_t numSlots = ir->numSlots();
 
@@ -107,66 +458,210 @@ Error IRToX86::compileIRAsFunc(IRBuilder* ir) {
   proto.setRetT<unsigned int>();
 
   for (i = 0; i < numSlots; i++) {
-    _data[i] = _cc->newIntPtr("ptr%u", i);
+    _data[i] = cc->newIntPtr("ptr%u", i);
     ir->dataPtr(i)->setJitId(_data[i].id());
     proto.addArgT<void*>();
   }
 
-  _cc->addFunc(proto);
-  _functionBody = _cc->cursor();
+  _funcNode = cc->addFunc(proto);
+  _funcLabel = _funcNode->label();
+  _functionBody = cc->cursor();
+
+  if (_enableAVX)
+    _funcNode->frame().setAvxEnabled();
 
   for (i = 0; i < numSlots; i++) {
-    _cc->setArg(i, _data[i]);
+    cc->setArg(i, _data[i]);
+  }
+
+  _uniformReg = ir->uniformPtr();
+  _uniformData = ir->uniformData();
+
+  _numLanes = ir->numLanes();
+  _activeLanes = _numLanes;
+
+  if (ir->isSPMD()) {
+    x86::Gp lane = cc->newIntPtr("lane");
+    ir->laneIndex()->setJitId(lane.id());
+    cc->xor_(lane, lane);
   }
 
-  compileIRAsPart(ir);
+  MPSL_PROPAGATE(emitTierCounter(imm(_numLanes)));
+  MPSL_PROPAGATE(compileIRAsPart(ir));
+
+  x86::Gp errCode = cc->newInt32("err");
+  cc->xor_(errCode, errCode);
+  cc->ret(errCode);
 
-  x86::Gp errCode = _cc->newInt32("err");
-  _cc->xor_(errCode, errCode);
-  _cc->ret(errCode);
+  // Clear upper halves of YMM registers before returning to avoid AVX to SSE
+  // transition penalty in the caller.
+  if (_usesV256)
+    _funcNode->frame().setAvxCleanup();
 
-  _cc->endFunc();
+  cc->endFunc();
 
   if (_constLabel.isValid())
-    _cc->embedConstPool(_constLabel, _constPool);
+    cc->embedConstPool(_constLabel, _constPool);
 
   return kErrorOk;
 }
 
-Error IRToX86::compileIRAsPart(IRBuilder* ir) {
-  // Compile the entry block and all other reacheable blocks.
-  MPSL_PROPAGATE(compileConsecutiveBlocks(ir->entryBlock()));
+Error IRToX86::compileIRAsBatchFunc(IRBuilder* ir) {
+  if (!_compiler)
+    return assembleIRAsBatchFunc(ir);
+
+  x86::Compiler* cc = _compiler;
+  uint32_t i;
+  uint32_t numSlots = ir->numSlots();
+
+  FuncSignatureBuilder proto;
+  proto.setRetT<unsigned int>();
+  proto.addArgT<void**>();
+  proto.addArgT<const intptr_t*>();
+  proto.addArgT<size_t>();
+  proto.addArgT<size_t>();
+
+  x86::Gp argsPtr = cc->newIntPtr("args");
+  x86::Gp stridesPtr = cc->newIntPtr("strides");
+  x86::Gp index = cc->newIntPtr("index");
+  x86::Gp count = cc->newIntPtr("count");
+  x86::Gp strides[Globals::kMaxArgumentsCount];
+
+  _funcNode = cc->addFunc(proto);
+  _funcLabel = _funcNode->label();
+
+  if (_enableAVX)
+    _funcNode->frame().setAvxEnabled();
+
+  cc->setArg(0, argsPtr);
+  cc->setArg(1, stridesPtr);
+  cc->setArg(2, index);
+  cc->setArg(3, count);
+  MPSL_PROPAGATE(emitTierCounter(count));
+
+  for (i = 0; i < numSlots; i++) {
+    _data[i] = cc->newIntPtr("ptr%u", i);
+    strides[i] = cc->newIntPtr("stride%u", i);
+    ir->dataPtr(i)->setJitId(_data[i].id());
+
+    cc->mov(_data[i], x86::ptr(argsPtr, static_cast<int>(i * sizeof(void*))));
+    cc->mov(strides[i], x86::ptr(stridesPtr, static_cast<int>(i * sizeof(intptr_t))));
+  }
+
+  Label L_Loop = cc->newLabel();
+  Label L_Done = cc->newLabel();
+
+  _numLanes = ir->numLanes();
+  _activeLanes = _numLanes;
+
+  _uniformReg = ir->uniformPtr();
+  _uniformData = ir->uniformData();
+
+  if (!ir->isSPMD()) {
+    cc->test(count, count);
+    cc->jz(L_Done);
 
-  // Compile all remaining, reacheable, and non-assembled blocks.
-  for (IRBlock* block : ir->blocks())
-    if (!block->isAssembled())
-      compileConsecutiveBlocks(block);
+    // Advance all data pointers to the first record to process.
+    x86::Gp offset = cc->newIntPtr("offset");
+    for (i = 0; i < numSlots; i++) {
+      cc->mov(offset, strides[i]);
+      cc->imul(offset, index);
+      cc->add(_data[i], offset);
+    }
+
+    // Everything `prepareConstPool()` and `prepareUniforms()` insert at
+    // `_functionBody` is placed here, before the loop, so it's executed only
+    // once per batch.
+    _functionBody = cc->cursor();
+
+    cc->bind(L_Loop);
+    MPSL_PROPAGATE(compileIRAsPart(ir));
+
+    for (i = 0; i < numSlots; i++)
+      cc->add(_data[i], strides[i]);
+
+    cc->sub(count, 1);
+    cc->jnz(L_Loop);
+  }
+  else {
+    // SPMD - data pointers stay and only the lane index advances, starting
+    // at the first record to process. The main loop processes `_numLanes`
+    // records at a time and the remaining records are processed by power-of-
+    // two partial gangs, each compiled separately so it only accesses records
+    // that exist.
+    x86::Gp lane = cc->newIntPtr("lane");
+    ir->laneIndex()->setJitId(lane.id());
+    cc->mov(lane, index);
+
+    _functionBody = cc->cursor();
+
+    Label L_Tail = cc->newLabel();
+    cc->cmp(count, _numLanes);
+    cc->jb(L_Tail);
+
+    cc->bind(L_Loop);
+    MPSL_PROPAGATE(compileIRAsPart(ir));
+
+    cc->add(lane, _numLanes);
+    cc->sub(count, _numLanes);
+    cc->cmp(count, _numLanes);
+    cc->jae(L_Loop);
+    cc->bind(L_Tail);
+
+    for (uint32_t n = _numLanes / 2; n != 0; n >>= 1) {
+      Label L_Skip = cc->newLabel();
+      cc->test(count, n);
+      cc->jz(L_Skip);
+
+      ir->resetJitData();
+      for (i = 0; i < numSlots; i++)
+        ir->dataPtr(i)->setJitId(_data[i].id());
+      ir->laneIndex()->setJitId(lane.id());
+
+      _activeLanes = n;
+      MPSL_PROPAGATE(compileIRAsPart(ir));
+
+      cc->add(lane, n);
+      cc->bind(L_Skip);
+    }
+
+    _activeLanes = _numLanes;
+  }
+
+  cc->bind(L_Done);
+
+  x86::Gp errCode = cc->newInt32("err");
+  cc->xor_(errCode, errCode);
+  cc->ret(errCode);
+
+  // Clear upper halves of YMM registers before returning to avoid AVX to SSE
+  // transition penalty in the caller.
+  if (_usesV256)
+    _funcNode->frame().setAvxCleanup();
+
+  cc->endFunc();
+
+  if (_constLabel.isValid())
+    cc->embedConstPool(_constLabel, _constPool);
 
   return kErrorOk;
 }
 
-Error IRToX86::compileConsecutiveBlocks(IRBlock* block) {
-  while (block) {
-    const IRBody& body = block->body();
-    IRBlock* next = nullptr;
+Error IRToX86::compileIRAsPart(IRBuilder* ir) {
+  IRBlocks layout;
+  Error err = layoutBlocks(ir, layout);
 
-    if (!body.empty()) {
-      IRInst* inst = body[body.size() - 1];
-      if (inst->instCode() == kInstCodeJmp) {
-        next = static_cast<IRBlock*>(inst->op(0));
-        if (next->isAssembled()) next = nullptr;
-      }
-      else if (inst->instCode() == kInstCodeJnz) {
-        next = static_cast<IRBlock*>(inst->op(1));
-        if (next->isAssembled()) {
-          next = static_cast<IRBlock*>(inst->op(2));
-          if (next->isAssembled()) next = nullptr;
-        }
-      }
-    }
+  if (err == kErrorOk)
+    err = compileLayout(layout);
 
-    compileBasicBlock(block, next);
-    block = next;
+  layout.release(_allocator);
+  return err;
+}
+
+Error IRToX86::compileLayout(const IRBlocks& layout) {
+  for (size_t i = 0, size = layout.size(); i < size; i++) {
+    IRBlock* next = i + 1 < size ? layout[i + 1] : nullptr;
+    MPSL_PROPAGATE(compileBasicBlock(layout[i], next));
   }
 
   return kErrorOk;
@@ -174,7 +669,10 @@ Error IRToX86::compileConsecutiveBlocks(IRBlock* block) {
 
 Error IRToX86::compileBasicBlock(IRBlock* block, IRBlock* next) {
   IRBody& body = block->body();
-  Operand asmOp[3];
+  Operand asmOp[IRInst::kMaxOperands];
+
+  if (block->hasPredecessors())
+    _cc->bind(blockLabel(block));
 
   for (size_t i = 0, size = body.size(); i < size; i++) {
     IRInst* inst = body[i];
@@ -184,6 +682,9 @@ Error IRToX86::compileBasicBlock(IRBlock* block, IRBlock* next) {
 
     const InstInfo& info = mpInstInfo[inst->instCode() & kInstCodeMask];
 
+    if (!_compiler)
+      emitSpillLoads(inst);
+
     for (uint32_t opIndex = 0; opIndex < opCount; opIndex++) {
       IRObject* irOp = irOpArray[opIndex];
 
@@ -191,7 +692,7 @@ Error IRToX86::compileBasicBlock(IRBlock* block, IRBlock* next) {
         case IRObject::kTypeReg: {
           IRReg* var = static_cast<IRReg*>(irOp);
           if (var->reg() == IRReg::kKindGp ) asmOp[opIndex] = varAsI32(var);
-          if (var->reg() == IRReg::kKindVec) asmOp[opIndex] = varAsXmm(var);
+          if (var->reg() == IRReg::kKindVec) asmOp[opIndex] = varAsVec(var);
           break;
         }
 
@@ -200,8 +701,13 @@ Error IRToX86::compileBasicBlock(IRBlock* block, IRBlock* next) {
           IRReg* base = mem->base();
           IRReg* index = mem->index();
 
-          // TODO: index.
-          asmOp[opIndex] = x86::ptr(varAsPtr(base), mem->offset());
+          if (base == _uniformReg)
+            prepareUniforms();
+
+          if (index)
+            asmOp[opIndex] = x86::ptr(varAsPtr(base), varAsPtr(index), mem->shift(), mem->offset());
+          else
+            asmOp[opIndex] = x86::ptr(varAsPtr(base), mem->offset());
           break;
         }
 
@@ -209,7 +715,7 @@ Error IRToX86::compileBasicBlock(IRBlock* block, IRBlock* next) {
           // TODO:
           IRImm* immValue = static_cast<IRImm*>(irOp);
 
-          if ((info.hasImm() && i == opCount - 1) || (info.isI32() && !info.isCvt()))
+          if ((info.hasImm() && opIndex == opCount - 1) || (info.isI32() && !info.isCvt()))
             asmOp[opIndex] = imm(immValue->value().i[0]);
           else
             asmOp[opIndex] = getConstantByValue(immValue->value(), immValue->width());
@@ -218,12 +724,17 @@ Error IRToX86::compileBasicBlock(IRBlock* block, IRBlock* next) {
         }
 
         case IRObject::kTypeBlock: {
-          // TODO:
+          // Jump targets are handled by `Jmp` and `Jnz` directly.
           break;
         }
       }
     }
 
+    if (_uniformReg && isUniformFetch(inst)) {
+      MPSL_PROPAGATE(emitUniformFetch(inst, asmOp[0]));
+      continue;
+    }
+
 #define OP_1(id) (kInstCode##id | kInstVec0)
 #define OP_X(id) (kInstCode##id | kInstVec128)
 #define OP_Y(id) (kInstCode##id | kInstVec256)
@@ -234,138 +745,211 @@ Error IRToX86::compileBasicBlock(IRBlock* block, IRBlock* next) {
             (x86::Reg::isGp(asmOp[1]) && (asmOp[0].isMem())))
           _cc->emit(x86::Inst::kIdMov, asmOp[0], asmOp[1]);
         else
-          _cc->emit(x86::Inst::kIdMovd, asmOp[0], asmOp[1]);
+          emit2x(x86::Inst::kIdMovd, asmOp[0], asmOp[1]);
         break;
 
       case OP_1(Fetch64):
       case OP_1(Store64):
-        _cc->emit(x86::Inst::kIdMovq, asmOp[0], asmOp[1]);
+        emit2x(x86::Inst::kIdMovq, asmOp[0], asmOp[1]);
         break;
 
       case OP_1(Fetch96): {
         x86::Mem mem = asmOp[1].as<x86::Mem>();
-        _cc->emit(x86::Inst::kIdMovq, asmOp[0], mem);
+        emit2x(x86::Inst::kIdMovq, asmOp[0], mem);
         mem.addOffsetLo32(8);
-        _cc->emit(x86::Inst::kIdMovd, _tmpXmm0, mem);
-        _cc->emit(x86::Inst::kIdPunpcklqdq, asmOp[0], _tmpXmm0);
+        emit2x(x86::Inst::kIdMovd, _tmpXmm0, mem);
+        emit3i(x86::Inst::kIdPunpcklqdq, asmOp[0], asmOp[0], _tmpXmm0);
         break;
       }
 
       case OP_1(Store96): {
         x86::Mem mem = asmOp[0].as<x86::Mem>();
-        _cc->emit(x86::Inst::kIdMovq, mem, asmOp[1]);
-        _cc->emit(x86::Inst::kIdPshufd, _tmpXmm0, asmOp[1], x86::Predicate::shuf(1, 0, 3, 2));
+        emit2x(x86::Inst::kIdMovq, mem, asmOp[1]);
+        emit2x(x86::Inst::kIdPshufd, _tmpXmm0, asmOp[1], imm(x86::Predicate::shuf(1, 0, 3, 2)));
         mem.addOffsetLo32(8);
-        _cc->emit(x86::Inst::kIdMovd, mem, _tmpXmm0);
+        emit2x(x86::Inst::kIdMovd, mem, _tmpXmm0);
         break;
       }
 
       case OP_1(Fetch128):
-      case OP_1(Store128):
-        _cc->emit(x86::Inst::kIdMovups, asmOp[0], asmOp[1]);
+      case OP_1(Store128): {
+        // SPMD tail - only access elements of lanes that are active.
+        IRObject* irMem = irOpArray[inst->instCode() == OP_1(Fetch128) ? 1 : 0];
+        if (_activeLanes < _numLanes && irMem->as<IRMem>()->hasIndex()) {
+          IRMem* mem = irMem->as<IRMem>();
+
+          uint32_t firstLane = mem->firstLane();
+          uint32_t size = _activeLanes > firstLane ? (_activeLanes - firstLane) << mem->shift() : 0;
+
+          if (size > 16) size = 16;
+          if (inst->instCode() == OP_1(Fetch128))
+            emitLaneFetch(asmOp[0], asmOp[1], size);
+          else
+            emitLaneStore(asmOp[0], asmOp[1], size);
+          break;
+        }
+
+        emit2x(x86::Inst::kIdMovups, asmOp[0], asmOp[1]);
+        break;
+      }
+
+      // 256-bit operands are only used if AVX2 is enabled (see `hasV256()`).
+      case OP_1(Fetch256):
+      case OP_1(Store256):
+        emit2x(x86::Inst::kIdMovups, asmOp[0], asmOp[1]);
+        break;
+
+      case OP_1(Mov32):
+        if (x86::Reg::isGp(asmOp[0]) && x86::Reg::isGp(asmOp[1]))
+          _cc->emit(x86::Inst::kIdMov, asmOp[0], asmOp[1]);
+        else
+          emit2x(x86::Inst::kIdMovd, asmOp[0], asmOp[1]);
         break;
 
-      case OP_1(Mov32): emit2x(x86::Inst::kIdMovd, asmOp[0], asmOp[1]); break;
       case OP_1(Mov64): emit2x(x86::Inst::kIdMovq, asmOp[0], asmOp[1]); break;
-      case OP_1(Mov128): emit2x(x86::Inst::kIdMovaps, asmOp[0], asmOp[1]); break;
+      case OP_1(Mov128):
+      case OP_1(Mov256): emit2x(x86::Inst::kIdMovaps, asmOp[0], asmOp[1]); break;
 
       case OP_1(Cvtitof): emit2x(x86::Inst::kIdCvtsi2ss, asmOp[0], asmOp[1]); break;
+      case OP_X(Cvtitof):
+      case OP_Y(Cvtitof): emit2x(x86::Inst::kIdCvtdq2ps, asmOp[0], asmOp[1]); break;
       case OP_1(Cvtitod): emit2x(x86::Inst::kIdCvtsi2sd, asmOp[0], asmOp[1]); break;
 
       case OP_1(Cvtftoi): emit2x(x86::Inst::kIdCvttss2si, asmOp[0], asmOp[1]); break;
+      case OP_X(Cvtftoi):
+      case OP_Y(Cvtftoi): emit2x(x86::Inst::kIdCvttps2dq, asmOp[0], asmOp[1]); break;
       case OP_1(Cvtftod): emit2x(x86::Inst::kIdCvtss2sd, asmOp[0], asmOp[1]); break;
 
       case OP_1(Cvtdtoi): emit2x(x86::Inst::kIdCvttsd2si, asmOp[0], asmOp[1]); break;
       case OP_1(Cvtdtof): emit2x(x86::Inst::kIdCvtsd2ss, asmOp[0], asmOp[1]); break;
 
       case OP_1(Addf): emit3f(x86::Inst::kIdAddss, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Addf): emit3f(x86::Inst::kIdAddps, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Addf):
+      case OP_Y(Addf): emit3f(x86::Inst::kIdAddps, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Addd): emit3d(x86::Inst::kIdAddsd, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Addd): emit3d(x86::Inst::kIdAddpd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Addd):
+      case OP_Y(Addd): emit3d(x86::Inst::kIdAddpd, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Subf): emit3f(x86::Inst::kIdSubss, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Subf): emit3f(x86::Inst::kIdSubps, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Subf):
+      case OP_Y(Subf): emit3f(x86::Inst::kIdSubps, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Subd): emit3d(x86::Inst::kIdSubsd, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Subd): emit3d(x86::Inst::kIdSubpd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Subd):
+      case OP_Y(Subd): emit3d(x86::Inst::kIdSubpd, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Mulf): emit3f(x86::Inst::kIdMulss, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Mulf): emit3f(x86::Inst::kIdMulps, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Mulf):
+      case OP_Y(Mulf): emit3f(x86::Inst::kIdMulps, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Muld): emit3d(x86::Inst::kIdMulsd, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Muld): emit3d(x86::Inst::kIdMulpd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Muld):
+      case OP_Y(Muld): emit3d(x86::Inst::kIdMulpd, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Divf): emit3f(x86::Inst::kIdDivss, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Divf): emit3f(x86::Inst::kIdDivps, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Divf):
+      case OP_Y(Divf): emit3f(x86::Inst::kIdDivps, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Divd): emit3d(x86::Inst::kIdDivsd, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Divd): emit3d(x86::Inst::kIdDivpd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Divd):
+      case OP_Y(Divd): emit3d(x86::Inst::kIdDivpd, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Andi): emit3i(x86::Inst::kIdAnd, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Andi): emit3i(x86::Inst::kIdPand, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Andi):
+      case OP_Y(Andi): emit3i(x86::Inst::kIdPand, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Andf):
-      case OP_X(Andf): emit3f(x86::Inst::kIdAndps, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Andf):
+      case OP_Y(Andf): emit3f(x86::Inst::kIdAndps, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Andd):
-      case OP_X(Andd): emit3d(x86::Inst::kIdAndpd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Andd):
+      case OP_Y(Andd): emit3d(x86::Inst::kIdAndpd, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Ori): emit3i(x86::Inst::kIdOr, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Ori): emit3i(x86::Inst::kIdPor, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Ori):
+      case OP_Y(Ori): emit3i(x86::Inst::kIdPor, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Orf):
-      case OP_X(Orf): emit3f(x86::Inst::kIdOrps, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Orf):
+      case OP_Y(Orf): emit3f(x86::Inst::kIdOrps, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Ord):
-      case OP_X(Ord): emit3d(x86::Inst::kIdOrpd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Ord):
+      case OP_Y(Ord): emit3d(x86::Inst::kIdOrpd, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Xori): emit3i(x86::Inst::kIdXor, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Xori): emit3i(x86::Inst::kIdPxor, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Xori):
+      case OP_Y(Xori): emit3i(x86::Inst::kIdPxor, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Xorf):
-      case OP_X(Xorf): emit3f(x86::Inst::kIdXorps, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Xorf):
+      case OP_Y(Xorf): emit3f(x86::Inst::kIdXorps, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Xord):
-      case OP_X(Xord): emit3d(x86::Inst::kIdXorpd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Xord):
+      case OP_Y(Xord): emit3d(x86::Inst::kIdXorpd, asmOp[0], asmOp[1], asmOp[2]); break;
+
+      case OP_X(Blend):
+      case OP_Y(Blend): emitBlend(asmOp[0], asmOp[1], asmOp[2], asmOp[3]); break;
 
       case OP_1(Minf): emit3f(x86::Inst::kIdMinss, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Minf): emit3f(x86::Inst::kIdMinps, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Minf):
+      case OP_Y(Minf): emit3f(x86::Inst::kIdMinps, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Mind): emit3d(x86::Inst::kIdMinsd, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Mind): emit3d(x86::Inst::kIdMinpd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Mind):
+      case OP_Y(Mind): emit3d(x86::Inst::kIdMinpd, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Maxf): emit3f(x86::Inst::kIdMaxss, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Maxf): emit3f(x86::Inst::kIdMaxps, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Maxf):
+      case OP_Y(Maxf): emit3f(x86::Inst::kIdMaxps, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Maxd): emit3d(x86::Inst::kIdMaxsd, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Maxd): emit3d(x86::Inst::kIdMaxpd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Maxd):
+      case OP_Y(Maxd): emit3d(x86::Inst::kIdMaxpd, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Sqrtf): emit2x(x86::Inst::kIdSqrtss, asmOp[0], asmOp[1]); break;
-      case OP_X(Sqrtf): emit2x(x86::Inst::kIdSqrtps, asmOp[0], asmOp[1]); break;
+      case OP_X(Sqrtf):
+      case OP_Y(Sqrtf): emit2x(x86::Inst::kIdSqrtps, asmOp[0], asmOp[1]); break;
       case OP_1(Sqrtd): emit2x(x86::Inst::kIdSqrtsd, asmOp[0], asmOp[1]); break;
-      case OP_X(Sqrtd): emit2x(x86::Inst::kIdSqrtpd, asmOp[0], asmOp[1]); break;
+      case OP_X(Sqrtd):
+      case OP_Y(Sqrtd): emit2x(x86::Inst::kIdSqrtpd, asmOp[0], asmOp[1]); break;
 
       case OP_1(Cmpeqf): emit3f(x86::Inst::kIdCmpss, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpEQ); break;
-      case OP_X(Cmpeqf): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpEQ); break;
+      case OP_X(Cmpeqf):
+      case OP_Y(Cmpeqf): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpEQ); break;
       case OP_1(Cmpeqd): emit3d(x86::Inst::kIdCmpsd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpEQ); break;
-      case OP_X(Cmpeqd): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpEQ); break;
+      case OP_X(Cmpeqd):
+      case OP_Y(Cmpeqd): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpEQ); break;
 
       case OP_1(Cmpnef): emit3f(x86::Inst::kIdCmpss, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpNEQ); break;
-      case OP_X(Cmpnef): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpNEQ); break;
+      case OP_X(Cmpnef):
+      case OP_Y(Cmpnef): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpNEQ); break;
       case OP_1(Cmpned): emit3d(x86::Inst::kIdCmpsd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpNEQ); break;
-      case OP_X(Cmpned): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpNEQ); break;
+      case OP_X(Cmpned):
+      case OP_Y(Cmpned): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpNEQ); break;
 
       case OP_1(Cmpltf): emit3f(x86::Inst::kIdCmpss, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLT); break;
-      case OP_X(Cmpltf): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLT); break;
+      case OP_X(Cmpltf):
+      case OP_Y(Cmpltf): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLT); break;
       case OP_1(Cmpltd): emit3d(x86::Inst::kIdCmpsd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLT); break;
-      case OP_X(Cmpltd): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLT); break;
+      case OP_X(Cmpltd):
+      case OP_Y(Cmpltd): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLT); break;
 
       case OP_1(Cmplef): emit3f(x86::Inst::kIdCmpss, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLE); break;
-      case OP_X(Cmplef): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLE); break;
+      case OP_X(Cmplef):
+      case OP_Y(Cmplef): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLE); break;
       case OP_1(Cmpled): emit3d(x86::Inst::kIdCmpsd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLE); break;
-      case OP_X(Cmpled): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLE); break;
+      case OP_X(Cmpled):
+      case OP_Y(Cmpled): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[1], asmOp[2], x86::Predicate::kCmpLE); break;
 
       case OP_1(Cmpgtf): emit3f(x86::Inst::kIdCmpss, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLE); break;
-      case OP_X(Cmpgtf): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLE); break;
+      case OP_X(Cmpgtf):
+      case OP_Y(Cmpgtf): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLE); break;
       case OP_1(Cmpgtd): emit3d(x86::Inst::kIdCmpsd, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLE); break;
-      case OP_X(Cmpgtd): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLE); break;
+      case OP_X(Cmpgtd):
+      case OP_Y(Cmpgtd): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLE); break;
 
       case OP_1(Cmpgef): emit3f(x86::Inst::kIdCmpss, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLT); break;
-      case OP_X(Cmpgef): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLT); break;
+      case OP_X(Cmpgef):
+      case OP_Y(Cmpgef): emit3f(x86::Inst::kIdCmpps, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLT); break;
       case OP_1(Cmpged): emit3d(x86::Inst::kIdCmpsd, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLT); break;
-      case OP_X(Cmpged): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLT); break;
+      case OP_X(Cmpged):
+      case OP_Y(Cmpged): emit3d(x86::Inst::kIdCmppd, asmOp[0], asmOp[2], asmOp[1], x86::Predicate::kCmpLT); break;
 
       case OP_1(Pshufd):
-      case OP_X(Pshufd): emit3d(x86::Inst::kIdPshufd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pshufd):
+      case OP_Y(Pshufd): emit2x(x86::Inst::kIdPshufd, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Pmovsxbw):
       case OP_X(Pmovsxbw): emit3i(x86::Inst::kIdPmovsxbw, asmOp[0], asmOp[1], asmOp[2]); break;
@@ -388,112 +972,209 @@ Error IRToX86::compileBasicBlock(IRBlock* block, IRBlock* next) {
       case OP_X(Packusdw): emit3i(x86::Inst::kIdPackusdw, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Paddb):
-      case OP_X(Paddb): emit3i(x86::Inst::kIdPaddb, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Paddb):
+      case OP_Y(Paddb): emit3i(x86::Inst::kIdPaddb, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Paddw):
-      case OP_X(Paddw): emit3i(x86::Inst::kIdPaddw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Paddw):
+      case OP_Y(Paddw): emit3i(x86::Inst::kIdPaddw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Paddd): emit3i(x86::Inst::kIdAdd, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Paddd): emit3i(x86::Inst::kIdPaddd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Paddd):
+      case OP_Y(Paddd): emit3i(x86::Inst::kIdPaddd, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Paddq):
-      case OP_X(Paddq): emit3i(x86::Inst::kIdPaddq, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Paddq):
+      case OP_Y(Paddq): emit3i(x86::Inst::kIdPaddq, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Paddssb):
-      case OP_X(Paddssb): emit3i(x86::Inst::kIdPaddsb, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Paddssb):
+      case OP_Y(Paddssb): emit3i(x86::Inst::kIdPaddsb, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Paddusb):
-      case OP_X(Paddusb): emit3i(x86::Inst::kIdPaddusb, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Paddusb):
+      case OP_Y(Paddusb): emit3i(x86::Inst::kIdPaddusb, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Paddssw):
-      case OP_X(Paddssw): emit3i(x86::Inst::kIdPaddsw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Paddssw):
+      case OP_Y(Paddssw): emit3i(x86::Inst::kIdPaddsw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Paddusw):
-      case OP_X(Paddusw): emit3i(x86::Inst::kIdPaddusw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Paddusw):
+      case OP_Y(Paddusw): emit3i(x86::Inst::kIdPaddusw, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Psubb):
-      case OP_X(Psubb): emit3i(x86::Inst::kIdPsubb, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psubb):
+      case OP_Y(Psubb): emit3i(x86::Inst::kIdPsubb, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Psubw):
-      case OP_X(Psubw): emit3i(x86::Inst::kIdPsubw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psubw):
+      case OP_Y(Psubw): emit3i(x86::Inst::kIdPsubw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Psubd): emit3i(x86::Inst::kIdSub, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Psubd): emit3i(x86::Inst::kIdPsubd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psubd):
+      case OP_Y(Psubd): emit3i(x86::Inst::kIdPsubd, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Psubq):
-      case OP_X(Psubq): emit3i(x86::Inst::kIdPsubq, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psubq):
+      case OP_Y(Psubq): emit3i(x86::Inst::kIdPsubq, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Psubssb):
-      case OP_X(Psubssb): emit3i(x86::Inst::kIdPsubsb, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psubssb):
+      case OP_Y(Psubssb): emit3i(x86::Inst::kIdPsubsb, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Psubusb):
-      case OP_X(Psubusb): emit3i(x86::Inst::kIdPsubusb, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psubusb):
+      case OP_Y(Psubusb): emit3i(x86::Inst::kIdPsubusb, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Psubssw):
-      case OP_X(Psubssw): emit3i(x86::Inst::kIdPsubsw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psubssw):
+      case OP_Y(Psubssw): emit3i(x86::Inst::kIdPsubsw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Psubusw):
-      case OP_X(Psubusw): emit3i(x86::Inst::kIdPsubusw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psubusw):
+      case OP_Y(Psubusw): emit3i(x86::Inst::kIdPsubusw, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Pmulw):
-      case OP_X(Pmulw): emit3i(x86::Inst::kIdPmullw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pmulw):
+      case OP_Y(Pmulw): emit3i(x86::Inst::kIdPmullw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pmulhsw):
-      case OP_X(Pmulhsw): emit3i(x86::Inst::kIdPmulhw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pmulhsw):
+      case OP_Y(Pmulhsw): emit3i(x86::Inst::kIdPmulhw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pmulhuw):
-      case OP_X(Pmulhuw): emit3i(x86::Inst::kIdPmulhuw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pmulhuw):
+      case OP_Y(Pmulhuw): emit3i(x86::Inst::kIdPmulhuw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_1(Pmulhsd):
+      case OP_X(Pmulhsd):
+      case OP_Y(Pmulhsd): emitMulhi(asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pmuld): emit3i(x86::Inst::kIdImul, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_X(Pmuld): emit3i(x86::Inst::kIdPmulld, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pmuld):
+      case OP_Y(Pmuld): emit3i(x86::Inst::kIdPmulld, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Pminsb):
-      case OP_X(Pminsb): emit3i(x86::Inst::kIdPminsb, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pminsb):
+      case OP_Y(Pminsb): emit3i(x86::Inst::kIdPminsb, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pminub):
-      case OP_X(Pminub): emit3i(x86::Inst::kIdPminub, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pminub):
+      case OP_Y(Pminub): emit3i(x86::Inst::kIdPminub, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pminsw):
-      case OP_X(Pminsw): emit3i(x86::Inst::kIdPminsw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pminsw):
+      case OP_Y(Pminsw): emit3i(x86::Inst::kIdPminsw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pminuw):
-      case OP_X(Pminuw): emit3i(x86::Inst::kIdPminuw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pminuw):
+      case OP_Y(Pminuw): emit3i(x86::Inst::kIdPminuw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pminsd):
-      case OP_X(Pminsd): emit3i(x86::Inst::kIdPminsd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pminsd):
+      case OP_Y(Pminsd): emit3i(x86::Inst::kIdPminsd, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pminud):
-      case OP_X(Pminud): emit3i(x86::Inst::kIdPminud, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pminud):
+      case OP_Y(Pminud): emit3i(x86::Inst::kIdPminud, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Pmaxsb):
-      case OP_X(Pmaxsb): emit3i(x86::Inst::kIdPmaxsb, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pmaxsb):
+      case OP_Y(Pmaxsb): emit3i(x86::Inst::kIdPmaxsb, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pmaxub):
-      case OP_X(Pmaxub): emit3i(x86::Inst::kIdPmaxub, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pmaxub):
+      case OP_Y(Pmaxub): emit3i(x86::Inst::kIdPmaxub, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pmaxsw):
-      case OP_X(Pmaxsw): emit3i(x86::Inst::kIdPmaxsw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pmaxsw):
+      case OP_Y(Pmaxsw): emit3i(x86::Inst::kIdPmaxsw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pmaxuw):
-      case OP_X(Pmaxuw): emit3i(x86::Inst::kIdPmaxuw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pmaxuw):
+      case OP_Y(Pmaxuw): emit3i(x86::Inst::kIdPmaxuw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pmaxsd):
-      case OP_X(Pmaxsd): emit3i(x86::Inst::kIdPmaxsd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pmaxsd):
+      case OP_Y(Pmaxsd): emit3i(x86::Inst::kIdPmaxsd, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pmaxud):
-      case OP_X(Pmaxud): emit3i(x86::Inst::kIdPmaxud, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pmaxud):
+      case OP_Y(Pmaxud): emit3i(x86::Inst::kIdPmaxud, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Psllw):
-      case OP_X(Psllw): emit3i(x86::Inst::kIdPsllw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psllw):
+      case OP_Y(Psllw): emit3i(x86::Inst::kIdPsllw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Psrlw):
-      case OP_X(Psrlw): emit3i(x86::Inst::kIdPsrlw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psrlw):
+      case OP_Y(Psrlw): emit3i(x86::Inst::kIdPsrlw, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Psraw):
-      case OP_X(Psraw): emit3i(x86::Inst::kIdPsraw, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_1(Pslld):
-      case OP_X(Pslld): emit3i(x86::Inst::kIdPslld, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_1(Psrld):
-      case OP_X(Psrld): emit3i(x86::Inst::kIdPsrld, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_1(Psrad):
-      case OP_X(Psrad): emit3i(x86::Inst::kIdPsrad, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psraw):
+      case OP_Y(Psraw): emit3i(x86::Inst::kIdPsraw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_1(Pslld): emit3i(x86::Inst::kIdShl, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pslld):
+      case OP_Y(Pslld): emit3i(x86::Inst::kIdPslld, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_1(Psrld): emit3i(x86::Inst::kIdShr, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psrld):
+      case OP_Y(Psrld): emit3i(x86::Inst::kIdPsrld, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_1(Psrad): emit3i(x86::Inst::kIdSar, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psrad):
+      case OP_Y(Psrad): emit3i(x86::Inst::kIdPsrad, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Psllq):
-      case OP_X(Psllq): emit3i(x86::Inst::kIdPsllq, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psllq):
+      case OP_Y(Psllq): emit3i(x86::Inst::kIdPsllq, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Psrlq):
-      case OP_X(Psrlq): emit3i(x86::Inst::kIdPsrlq, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Psrlq):
+      case OP_Y(Psrlq): emit3i(x86::Inst::kIdPsrlq, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Pmaddwd):
-      case OP_X(Pmaddwd): emit3i(x86::Inst::kIdPmaddwd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pmaddwd):
+      case OP_Y(Pmaddwd): emit3i(x86::Inst::kIdPmaddwd, asmOp[0], asmOp[1], asmOp[2]); break;
 
       case OP_1(Pcmpeqb):
-      case OP_X(Pcmpeqb): emit3i(x86::Inst::kIdPcmpeqb, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pcmpeqb):
+      case OP_Y(Pcmpeqb): emit3i(x86::Inst::kIdPcmpeqb, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pcmpeqw):
-      case OP_X(Pcmpeqw): emit3i(x86::Inst::kIdPcmpeqw, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_1(Pcmpeqd):
-      case OP_X(Pcmpeqd): emit3i(x86::Inst::kIdPcmpeqd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pcmpeqw):
+      case OP_Y(Pcmpeqw): emit3i(x86::Inst::kIdPcmpeqw, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_1(Pcmpeqd): case OP_X(Pcmpeqd): case OP_Y(Pcmpeqd):
+      case OP_1(Pcmpned): case OP_X(Pcmpned): case OP_Y(Pcmpned):
+      case OP_1(Pcmpltd): case OP_X(Pcmpltd): case OP_Y(Pcmpltd):
+      case OP_1(Pcmpled): case OP_X(Pcmpled): case OP_Y(Pcmpled):
+      case OP_1(Pcmpgtd): case OP_X(Pcmpgtd): case OP_Y(Pcmpgtd):
+      case OP_1(Pcmpged): case OP_X(Pcmpged): case OP_Y(Pcmpged):
+        emitCmpi(inst->instCode(), asmOp[0], asmOp[1], asmOp[2]);
+        break;
 
       case OP_1(Pcmpgtb):
-      case OP_X(Pcmpgtb): emit3i(x86::Inst::kIdPcmpgtb, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pcmpgtb):
+      case OP_Y(Pcmpgtb): emit3i(x86::Inst::kIdPcmpgtb, asmOp[0], asmOp[1], asmOp[2]); break;
       case OP_1(Pcmpgtw):
-      case OP_X(Pcmpgtw): emit3i(x86::Inst::kIdPcmpgtw, asmOp[0], asmOp[1], asmOp[2]); break;
-      case OP_1(Pcmpgtd):
-      case OP_X(Pcmpgtd): emit3i(x86::Inst::kIdPcmpgtd, asmOp[0], asmOp[1], asmOp[2]); break;
+      case OP_X(Pcmpgtw):
+      case OP_Y(Pcmpgtw): emit3i(x86::Inst::kIdPcmpgtw, asmOp[0], asmOp[1], asmOp[2]); break;
+
+      case OP_1(Expf):    case OP_X(Expf):    case OP_Y(Expf):
+      case OP_1(Expd):    case OP_X(Expd):    case OP_Y(Expd):
+      case OP_1(Logf):    case OP_X(Logf):    case OP_Y(Logf):
+      case OP_1(Logd):    case OP_X(Logd):    case OP_Y(Logd):
+      case OP_1(Log2f):   case OP_X(Log2f):   case OP_Y(Log2f):
+      case OP_1(Log2d):   case OP_X(Log2d):   case OP_Y(Log2d):
+      case OP_1(Log10f):  case OP_X(Log10f):  case OP_Y(Log10f):
+      case OP_1(Log10d):  case OP_X(Log10d):  case OP_Y(Log10d):
+      case OP_1(Sinf):    case OP_X(Sinf):    case OP_Y(Sinf):
+      case OP_1(Sind):    case OP_X(Sind):    case OP_Y(Sind):
+      case OP_1(Cosf):    case OP_X(Cosf):    case OP_Y(Cosf):
+      case OP_1(Cosd):    case OP_X(Cosd):    case OP_Y(Cosd):
+      case OP_1(Tanf):    case OP_X(Tanf):    case OP_Y(Tanf):
+      case OP_1(Tand):    case OP_X(Tand):    case OP_Y(Tand):
+      case OP_1(Asinf):   case OP_X(Asinf):   case OP_Y(Asinf):
+      case OP_1(Asind):   case OP_X(Asind):   case OP_Y(Asind):
+      case OP_1(Acosf):   case OP_X(Acosf):   case OP_Y(Acosf):
+      case OP_1(Acosd):   case OP_X(Acosd):   case OP_Y(Acosd):
+      case OP_1(Atanf):   case OP_X(Atanf):   case OP_Y(Atanf):
+      case OP_1(Atand):   case OP_X(Atand):   case OP_Y(Atand):
+      case OP_1(Powf):    case OP_X(Powf):    case OP_Y(Powf):
+      case OP_1(Powd):    case OP_X(Powd):    case OP_Y(Powd):
+      case OP_1(Atan2f):  case OP_X(Atan2f):  case OP_Y(Atan2f):
+      case OP_1(Atan2d):  case OP_X(Atan2d):  case OP_Y(Atan2d):
+        emitMath(inst->instCode(), asmOp[0], asmOp[1], asmOp[2]);
+        break;
+
+      case OP_1(Jmp): {
+        IRBlock* target = static_cast<IRBlock*>(inst->op(0));
+        if (target != next)
+          _cc->jmp(blockLabel(target));
+        break;
+      }
+
+      case OP_1(Jnz):
+        emitJnz(asmOp[0], static_cast<IRBlock*>(inst->op(1)), static_cast<IRBlock*>(inst->op(2)), next);
+        break;
+
+      case OP_1(Jany):
+        emitJany(asmOp[0], static_cast<IRReg*>(inst->op(0))->width(), static_cast<IRBlock*>(inst->op(1)), static_cast<IRBlock*>(inst->op(2)), next);
+        break;
 
       default:
         // TODO:
         MPSL_ASSERT(!"Implemented");
     }
+
+    if (!_compiler)
+      emitSpillStores(inst);
 #undef OP_Y
 #undef OP_X
 #undef OP_1
@@ -503,6 +1184,245 @@ Error IRToX86::compileBasicBlock(IRBlock* block, IRBlock* next) {
   return kErrorOk;
 }
 
+// Blocks reachable from the entry are laid out as chains of fall-through
+// edges - a block is followed by the target of its `Jmp`, or by one of the
+// targets of its `Jnz` or `Jany`, unless that block was already placed. The exit block
+// has no terminator, it's always placed last as it falls through to the code
+// that follows the compiled part. Blocks that are not reachable are dropped.
+Error IRToX86::layoutBlocks(IRBuilder* ir, IRBlocks& layout) {
+  IRBlock* entry = ir->entryBlock();
+  IRBlock* exit = ir->exits().empty() ? nullptr : ir->exits()[0];
+  bool exitReached = false;
+
+  MPSL_PROPAGATE(layoutConsecutiveBlocks(layout, entry, exit));
+
+  // `layout` grows while it's iterated, successors of newly placed blocks are
+  // visited as well.
+  for (size_t i = 0; i < layout.size(); i++) {
+    for (IRBlock* successor : layout[i]->successors()) {
+      if (successor == exit)
+        exitReached = true;
+      else if (!successor->isAssembled())
+        MPSL_PROPAGATE(layoutConsecutiveBlocks(layout, successor, exit));
+    }
+  }
+
+  if (exitReached && exit != entry)
+    MPSL_PROPAGATE(layout.append(_allocator, exit));
+
+  return kErrorOk;
+}
+
+Error IRToX86::layoutConsecutiveBlocks(IRBlocks& layout, IRBlock* block, IRBlock* exit) {
+  while (block) {
+    MPSL_PROPAGATE(layout.append(_allocator, block));
+    block->setAssembled();
+
+    const IRBody& body = block->body();
+    IRBlock* next = nullptr;
+
+    if (!body.empty()) {
+      IRInst* inst = body[body.size() - 1];
+      if (inst->instCode() == kInstCodeJmp) {
+        next = static_cast<IRBlock*>(inst->op(0));
+      }
+      else if (inst->instCode() == kInstCodeJnz || inst->instCode() == kInstCodeJany) {
+        next = static_cast<IRBlock*>(inst->op(1));
+        if (next->isAssembled() || next == exit)
+          next = static_cast<IRBlock*>(inst->op(2));
+      }
+
+      if (next && (next->isAssembled() || next == exit))
+        next = nullptr;
+    }
+
+    block = next;
+  }
+
+  return kErrorOk;
+}
+
+Label IRToX86::blockLabel(IRBlock* block) {
+  uint32_t id = block->jitId();
+
+  if (id == kInvalidRegId) {
+    Label label = _cc->newLabel();
+    block->setJitId(label.id());
+    return label;
+  }
+  else {
+    return Label(id);
+  }
+}
+
+void IRToX86::emitLaneFetch(const Operand& o0, const Operand& o1, uint32_t size) {
+  x86::Mem mem = o1.as<x86::Mem>();
+
+  switch (size) {
+    case 0:
+      emit3f(x86::Inst::kIdXorps, o0, o0, o0);
+      break;
+
+    case 4:
+      emit2x(x86::Inst::kIdMovd, o0, mem);
+      break;
+
+    case 8:
+      emit2x(x86::Inst::kIdMovq, o0, mem);
+      break;
+
+    case 12:
+      emit2x(x86::Inst::kIdMovq, o0, mem);
+      mem.addOffsetLo32(8);
+      emit2x(x86::Inst::kIdMovd, _tmpXmm0, mem);
+      emit3i(x86::Inst::kIdPunpcklqdq, o0, o0, _tmpXmm0);
+      break;
+
+    default:
+      emit2x(x86::Inst::kIdMovups, o0, mem);
+      break;
+  }
+}
+
+void IRToX86::emitLaneStore(const Operand& o0, const Operand& o1, uint32_t size) {
+  x86::Mem mem = o0.as<x86::Mem>();
+
+  switch (size) {
+    case 0:
+      break;
+
+    case 4:
+      emit2x(x86::Inst::kIdMovd, mem, o1);
+      break;
+
+    case 8:
+      emit2x(x86::Inst::kIdMovq, mem, o1);
+      break;
+
+    case 12:
+      emit2x(x86::Inst::kIdMovq, mem, o1);
+      emit2x(x86::Inst::kIdPshufd, _tmpXmm0, o1, imm(x86::Predicate::shuf(1, 0, 3, 2)));
+      mem.addOffsetLo32(8);
+      emit2x(x86::Inst::kIdMovd, mem, _tmpXmm0);
+      break;
+
+    default:
+      emit2x(x86::Inst::kIdMovups, mem, o1);
+      break;
+  }
+}
+
+// Translate a legacy SSE instruction to its VEX encoded form, all SSE
+// instructions used by `IRToX86` must be listed here.
+static uint32_t mpVexInstId(uint32_t instId) noexcept {
+#define VEX(sse, vex) case x86::Inst::kId##sse: return x86::Inst::kIdV##vex
+  switch (instId) {
+    VEX(Movd      , movd      ); VEX(Movq      , movq      );
+    VEX(Movss     , movss     ); VEX(Movsd     , movsd     );
+    VEX(Movaps    , movaps    ); VEX(Movapd    , movapd    );
+    VEX(Movups    , movups    ); VEX(Pshufd    , pshufd    );
+    VEX(Punpcklqdq, punpcklqdq); VEX(Shufps    , shufps    );
+    VEX(Movmskps  , movmskps  );
+
+    VEX(Cvtsi2ss  , cvtsi2ss  ); VEX(Cvtsi2sd  , cvtsi2sd  );
+    VEX(Cvttss2si , cvttss2si ); VEX(Cvttsd2si , cvttsd2si );
+    VEX(Cvtss2sd  , cvtss2sd  ); VEX(Cvtsd2ss  , cvtsd2ss  );
+    VEX(Cvtdq2ps  , cvtdq2ps  ); VEX(Cvttps2dq , cvttps2dq );
+
+    VEX(Addss     , addss     ); VEX(Addps     , addps     );
+    VEX(Addsd     , addsd     ); VEX(Addpd     , addpd     );
+    VEX(Subss     , subss     ); VEX(Subps     , subps     );
+    VEX(Subsd     , subsd     ); VEX(Subpd     , subpd     );
+    VEX(Mulss     , mulss     ); VEX(Mulps     , mulps     );
+    VEX(Mulsd     , mulsd     ); VEX(Mulpd     , mulpd     );
+    VEX(Divss     , divss     ); VEX(Divps     , divps     );
+    VEX(Divsd     , divsd     ); VEX(Divpd     , divpd     );
+    VEX(Minss     , minss     ); VEX(Minps     , minps     );
+    VEX(Minsd     , minsd     ); VEX(Minpd     , minpd     );
+    VEX(Maxss     , maxss     ); VEX(Maxps     , maxps     );
+    VEX(Maxsd     , maxsd     ); VEX(Maxpd     , maxpd     );
+    VEX(Sqrtss    , sqrtss    ); VEX(Sqrtps    , sqrtps    );
+    VEX(Sqrtsd    , sqrtsd    ); VEX(Sqrtpd    , sqrtpd    );
+    VEX(Cmpss     , cmpss     ); VEX(Cmpps     , cmpps     );
+    VEX(Cmpsd     , cmpsd     ); VEX(Cmppd     , cmppd     );
+
+    VEX(Andps     , andps     ); VEX(Andpd     , andpd     );
+    VEX(Andnps    , andnps    ); VEX(Andnpd    , andnpd    );
+    VEX(Orps      , orps      ); VEX(Orpd      , orpd      );
+    VEX(Xorps     , xorps     ); VEX(Xorpd     , xorpd     );
+    VEX(Pand      , pand      ); VEX(Por       , por       );
+    VEX(Pxor      , pxor      );
+
+    VEX(Pmovsxbw  , pmovsxbw  ); VEX(Pmovzxbw  , pmovzxbw  );
+    VEX(Pmovsxwd  , pmovsxwd  ); VEX(Pmovzxwd  , pmovzxwd  );
+    VEX(Packsswb  , packsswb  ); VEX(Packuswb  , packuswb  );
+    VEX(Packssdw  , packssdw  ); VEX(Packusdw  , packusdw  );
+
+    VEX(Paddb     , paddb     ); VEX(Paddw     , paddw     );
+    VEX(Paddd     , paddd     ); VEX(Paddq     , paddq     );
+    VEX(Paddsb    , paddsb    ); VEX(Paddusb   , paddusb   );
+    VEX(Paddsw    , paddsw    ); VEX(Paddusw   , paddusw   );
+    VEX(Psubb     , psubb     ); VEX(Psubw     , psubw     );
+    VEX(Psubd     , psubd     ); VEX(Psubq     , psubq     );
+    VEX(Psubsb    , psubsb    ); VEX(Psubusb   , psubusb   );
+    VEX(Psubsw    , psubsw    ); VEX(Psubusw   , psubusw   );
+
+    VEX(Pmullw    , pmullw    ); VEX(Pmulhw    , pmulhw    );
+    VEX(Pmulhuw   , pmulhuw   ); VEX(Pmulld    , pmulld    );
+    VEX(Pmuludq   , pmuludq   ); VEX(Pmaddwd   , pmaddwd   );
+    VEX(Pmuldq    , pmuldq    );
+
+    VEX(Pminsb    , pminsb    ); VEX(Pminub    , pminub    );
+    VEX(Pminsw    , pminsw    ); VEX(Pminuw    , pminuw    );
+    VEX(Pminsd    , pminsd    ); VEX(Pminud    , pminud    );
+    VEX(Pmaxsb    , pmaxsb    ); VEX(Pmaxub    , pmaxub    );
+    VEX(Pmaxsw    , pmaxsw    ); VEX(Pmaxuw    , pmaxuw    );
+    VEX(Pmaxsd    , pmaxsd    ); VEX(Pmaxud    , pmaxud    );
+
+    VEX(Psllw     , psllw     ); VEX(Psrlw     , psrlw     );
+    VEX(Psraw     , psraw     ); VEX(Pslld     , pslld     );
+    VEX(Psrld     , psrld     ); VEX(Psrad     , psrad     );
+    VEX(Psllq     , psllq     ); VEX(Psrlq     , psrlq     );
+
+    VEX(Pcmpeqb   , pcmpeqb   ); VEX(Pcmpeqw   , pcmpeqw   );
+    VEX(Pcmpeqd   , pcmpeqd   ); VEX(Pcmpgtb   , pcmpgtb   );
+    VEX(Pcmpgtw   , pcmpgtw   ); VEX(Pcmpgtd   , pcmpgtd   );
+
+    default:
+      MPSL_ASSERT(!"Implemented");
+      return instId;
+  }
+#undef VEX
+}
+
+void IRToX86::emit2x(uint32_t instId, const Operand& o0, const Operand& o1) {
+  if (!_enableAVX) {
+    _cc->emit(instId, o0, o1);
+    return;
+  }
+
+  switch (instId) {
+    // Scalar instructions that merge the upper elements of the destination
+    // have an additional source operand in VEX form, keep the destination.
+    case x86::Inst::kIdCvtsi2ss:
+    case x86::Inst::kIdCvtsi2sd:
+    case x86::Inst::kIdCvtss2sd:
+    case x86::Inst::kIdCvtsd2ss:
+    case x86::Inst::kIdSqrtss:
+    case x86::Inst::kIdSqrtsd:
+      _cc->emit(mpVexInstId(instId), o0, o0, o1);
+      break;
+
+    default:
+      _cc->emit(mpVexInstId(instId), o0, o1);
+      break;
+  }
+}
+
+void IRToX86::emit2x(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2) {
+  _cc->emit(_enableAVX ? mpVexInstId(instId) : instId, o0, o1, o2);
+}
+
 void IRToX86::emit3i(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2) {
   // Intercept instructions that are disabled for the current target and
   // substitute them with a sequential code that is compatible. It's easier
@@ -529,6 +1449,36 @@ void IRToX86::emit3i(uint32_t instId, const Operand& o0, const Operand& o1, cons
     }
   }
 
+  if (_enableAVX && !x86::Reg::isGp(o0)) {
+    switch (instId) {
+      // Extensions read only the source operand.
+      case x86::Inst::kIdPmovsxbw:
+      case x86::Inst::kIdPmovzxbw:
+      case x86::Inst::kIdPmovsxwd:
+      case x86::Inst::kIdPmovzxwd:
+        _cc->emit(mpVexInstId(instId), o0, o2);
+        return;
+
+      // Shift count is always in XMM register, even if the shift is 256-bit.
+      case x86::Inst::kIdPsllw:
+      case x86::Inst::kIdPsrlw:
+      case x86::Inst::kIdPsraw:
+      case x86::Inst::kIdPslld:
+      case x86::Inst::kIdPsrld:
+      case x86::Inst::kIdPsrad:
+      case x86::Inst::kIdPsllq:
+      case x86::Inst::kIdPsrlq:
+        if (x86::Reg::isYmm(o2)) {
+          emit3v(instId, x86::Inst::kIdMovaps, o0, o1, x86::xmm(o2.id()), Operand());
+          return;
+        }
+        break;
+    }
+
+    emit3v(instId, x86::Inst::kIdMovaps, o0, o1, o2, Operand());
+    return;
+  }
+
   // Instruction `instId` is emitted as is.
   if (o0.id() != o1.id()) {
     if (x86::Reg::isGp(o0) && x86::Reg::isGp(o1))
@@ -540,29 +1490,254 @@ void IRToX86::emit3i(uint32_t instId, const Operand& o0, const Operand& o1, cons
 }
 
 void IRToX86::emit3f(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2) {
+  uint32_t loadId = o1.isReg() ? x86::Inst::kIdMovaps : x86::Inst::kIdMovss;
+  if (_enableAVX) {
+    emit3v(instId, loadId, o0, o1, o2, Operand());
+    return;
+  }
+
   if (o0.id() != o1.id())
-    _cc->emit(o1.isReg() ? x86::Inst::kIdMovaps : x86::Inst::kIdMovss, o0, o1);
+    _cc->emit(loadId, o0, o1);
   _cc->emit(instId, o0, o2);
 }
 
 void IRToX86::emit3f(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2, int imm) {
+  uint32_t loadId = o1.isReg() ? x86::Inst::kIdMovaps : x86::Inst::kIdMovss;
+  if (_enableAVX) {
+    emit3v(instId, loadId, o0, o1, o2, asmjit::imm(imm));
+    return;
+  }
+
   if (o0.id() != o1.id())
-    _cc->emit(o1.isReg() ? x86::Inst::kIdMovaps : x86::Inst::kIdMovss, o0, o1);
+    _cc->emit(loadId, o0, o1);
   _cc->emit(instId, o0, o2, imm);
 }
 
 void IRToX86::emit3d(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2) {
+  uint32_t loadId = o1.isReg() ? x86::Inst::kIdMovapd : x86::Inst::kIdMovsd;
+  if (_enableAVX) {
+    emit3v(instId, loadId, o0, o1, o2, Operand());
+    return;
+  }
+
   if (o0.id() != o1.id())
-    _cc->emit(o1.isReg() ? x86::Inst::kIdMovapd : x86::Inst::kIdMovsd, o0, o1);
+    _cc->emit(loadId, o0, o1);
   _cc->emit(instId, o0, o2);
 }
 
 void IRToX86::emit3d(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2, int imm) {
+  uint32_t loadId = o1.isReg() ? x86::Inst::kIdMovapd : x86::Inst::kIdMovsd;
+  if (_enableAVX) {
+    emit3v(instId, loadId, o0, o1, o2, asmjit::imm(imm));
+    return;
+  }
+
   if (o0.id() != o1.id())
-    _cc->emit(o1.isReg() ? x86::Inst::kIdMovapd : x86::Inst::kIdMovsd, o0, o1);
+    _cc->emit(loadId, o0, o1);
   _cc->emit(instId, o0, o2, imm);
 }
 
+// Emit `instId` in its non-destructive VEX form `o0 = o1 op o2 [, o3]`. Only
+// `o2` can be a memory operand, `o1` is loaded by `loadId` if it's not a reg.
+void IRToX86::emit3v(uint32_t instId, uint32_t loadId, const Operand& o0, const Operand& o1, const Operand& o2, const Operand& o3) {
+  if (o1.isReg()) {
+    _cc->emit(mpVexInstId(instId), o0, o1, o2, o3);
+  }
+  else {
+    emit2x(loadId, o0, o1);
+    _cc->emit(mpVexInstId(instId), o0, o0, o2, o3);
+  }
+}
+
+void IRToX86::emitCmpi(uint32_t instCode, const Operand& o0, const Operand& o1, const Operand& o2) {
+  uint32_t code = instCode & kInstCodeMask;
+
+  // Scalar integers are in GP registers, compare them by `cmp` and expand the
+  // resulting flag into a mask.
+  if (x86::Reg::isGp(o1)) {
+    x86::Gp mask = newTmpI32("mask");
+
+    _cc->xor_(mask, mask);
+    _cc->emit(x86::Inst::kIdCmp, o1, o2);
+
+    switch (code) {
+      case kInstCodePcmpeqd: _cc->sete (mask.r8()); break;
+      case kInstCodePcmpned: _cc->setne(mask.r8()); break;
+      case kInstCodePcmpltd: _cc->setl (mask.r8()); break;
+      case kInstCodePcmpled: _cc->setle(mask.r8()); break;
+      case kInstCodePcmpgtd: _cc->setg (mask.r8()); break;
+      case kInstCodePcmpged: _cc->setge(mask.r8()); break;
+    }
+
+    _cc->neg(mask);
+    emit2x(x86::Inst::kIdMovd, o0, mask);
+    return;
+  }
+
+  // SSE only compares for equality and greater-than, other predicates swap
+  // the operands and/or complement the mask.
+  switch (code) {
+    case kInstCodePcmpeqd: emit3i(x86::Inst::kIdPcmpeqd, o0, o1, o2); return;
+    case kInstCodePcmpgtd: emit3i(x86::Inst::kIdPcmpgtd, o0, o1, o2); return;
+    case kInstCodePcmpltd: emit3i(x86::Inst::kIdPcmpgtd, o0, o2, o1); return;
+
+    case kInstCodePcmpned: emit3i(x86::Inst::kIdPcmpeqd, o0, o1, o2); break;
+    case kInstCodePcmpled: emit3i(x86::Inst::kIdPcmpgtd, o0, o1, o2); break;
+    case kInstCodePcmpged: emit3i(x86::Inst::kIdPcmpgtd, o0, o2, o1); break;
+  }
+
+  Value ones;
+  ones.i.set(-1);
+  emit3i(x86::Inst::kIdPxor, o0, o0, getConstantByValue(ones, x86::Reg::isYmm(o0) ? 32 : 16));
+}
+
+void IRToX86::emitBlend(const Operand& o0, const Operand& o1, const Operand& o2, const Operand& o3) {
+  // `o0 = o3 ? o2 : o1`, the mask `o3` has all bits of each element equal.
+  if (_enableAVX) {
+    _cc->emit(x86::Inst::kIdVblendvps, o0, o1, o2, o3);
+    return;
+  }
+
+  // SSE4.1 `blendvps` requires the mask in `xmm0`, bitwise select is used
+  // instead as it doesn't constrain the register allocator.
+  emit3f(x86::Inst::kIdAndnps, _tmpXmm0, o3, o1);
+  emit3f(x86::Inst::kIdAndps, _tmpXmm1, o3, o2);
+  emit3f(x86::Inst::kIdOrps, o0, _tmpXmm0, _tmpXmm1);
+}
+
+void IRToX86::emitMulhi(const Operand& o0, const Operand& o1, const Operand& o2) {
+  // High 32 bits of a signed 32x32 multiplication.
+  if (x86::Reg::isGp(o0)) {
+    // Scalar integers are multiplied as 64-bit, an immediate is sign extended.
+    x86::Gp dst = o0.as<x86::Gp>().r64();
+
+    if (o2.isImm()) {
+      _cc->emit(x86::Inst::kIdMovsxd, dst, o1);
+      _cc->emit(x86::Inst::kIdImul, dst, dst, o2);
+    }
+    else {
+      x86::Gp tmp = _compiler ? _compiler->newI64("mulhi") : _tmpGp;
+      _cc->emit(x86::Inst::kIdMovsxd, tmp, o2);
+      _cc->emit(x86::Inst::kIdMovsxd, dst, o1);
+      _cc->emit(x86::Inst::kIdImul, dst, tmp);
+    }
+
+    _cc->emit(x86::Inst::kIdSar, dst, 32);
+    return;
+  }
+
+  // `pmuldq` and `pblendw` are SSE4.1, without it the high halves of unsigned
+  // products are merged by shuffles and the signed result is corrected by
+  // subtracting `(a < 0 ? b : 0) + (b < 0 ? a : 0)`.
+  if (!_enableSSE4_1) {
+    // Multiply-high is only created by IR passes, which don't run at O0.
+    MPSL_ASSERT(_compiler != nullptr);
+    x86::Xmm fixup = _compiler->newXmm("mulhiFixup");
+
+    _cc->emit(x86::Inst::kIdPshufd, _tmpXmm0, o1, x86::Predicate::shuf(3, 3, 1, 1));
+    _cc->emit(x86::Inst::kIdPshufd, _tmpXmm1, o2, x86::Predicate::shuf(3, 3, 1, 1));
+    _cc->emit(x86::Inst::kIdPmuludq, _tmpXmm0, _tmpXmm1);
+
+    _cc->emit(x86::Inst::kIdMovaps, fixup, o1);
+    _cc->emit(x86::Inst::kIdPsrad, fixup, 31);
+    _cc->emit(x86::Inst::kIdPand, fixup, o2);
+    _cc->emit(x86::Inst::kIdMovaps, _tmpXmm1, o2);
+    _cc->emit(x86::Inst::kIdPsrad, _tmpXmm1, 31);
+    _cc->emit(x86::Inst::kIdPand, _tmpXmm1, o1);
+    _cc->emit(x86::Inst::kIdPaddd, fixup, _tmpXmm1);
+
+    if (o2.isReg() && o0.id() == o2.id()) {
+      _cc->emit(x86::Inst::kIdPmuludq, o0, o1);
+    }
+    else {
+      if (!o1.isReg() || o0.id() != o1.id())
+        _cc->emit(x86::Inst::kIdMovaps, o0, o1);
+      _cc->emit(x86::Inst::kIdPmuludq, o0, o2);
+    }
+
+    _cc->emit(x86::Inst::kIdShufps, o0, _tmpXmm0, x86::Predicate::shuf(3, 1, 3, 1));
+    _cc->emit(x86::Inst::kIdPshufd, o0, o0, x86::Predicate::shuf(3, 1, 2, 0));
+    _cc->emit(x86::Inst::kIdPsubd, o0, fixup);
+    return;
+  }
+
+  // `pmuldq` multiplies even elements into 64-bit products, odd elements are
+  // shuffled to even positions and multiplied separately. The high halves of
+  // both are merged by `pblendw`.
+  x86::Vec tmp0 = _tmpXmm0;
+  x86::Vec tmp1 = _tmpXmm1;
+
+  if (x86::Reg::isYmm(o0)) {
+    tmp0 = x86::ymm(_tmpXmm0.id());
+    tmp1 = x86::ymm(_tmpXmm1.id());
+  }
+
+  emit2x(x86::Inst::kIdPshufd, tmp0, o1, imm(x86::Predicate::shuf(3, 3, 1, 1)));
+  emit2x(x86::Inst::kIdPshufd, tmp1, o2, imm(x86::Predicate::shuf(3, 3, 1, 1)));
+  emit3i(x86::Inst::kIdPmuldq, tmp0, tmp0, tmp1);
+
+  // `emit3i()` copies the first source to the destination, which must not
+  // be the second source.
+  if (o2.isReg() && o0.id() == o2.id())
+    emit3i(x86::Inst::kIdPmuldq, o0, o2, o1);
+  else
+    emit3i(x86::Inst::kIdPmuldq, o0, o1, o2);
+
+  emit3i(x86::Inst::kIdPsrlq, o0, o0, imm(32));
+
+  if (_enableAVX)
+    _cc->emit(x86::Inst::kIdVpblendw, o0, o0, tmp0, imm(0xCC));
+  else
+    _cc->emit(x86::Inst::kIdPblendw, o0, tmp0, imm(0xCC));
+}
+
+void IRToX86::emitJnz(const Operand& cond, IRBlock* thenBlock, IRBlock* elseBlock, IRBlock* next) {
+  // The condition is a scalar mask, which has either all or no bits set.
+  x86::Gp mask;
+
+  if (x86::Reg::isGp(cond)) {
+    mask = cond.as<x86::Gp>();
+  }
+  else {
+    mask = newTmpI32("mask");
+    emit2x(x86::Inst::kIdMovd, mask, cond);
+  }
+
+  _cc->test(mask, mask);
+  emitJxx(thenBlock, elseBlock, next);
+}
+
+void IRToX86::emitJany(const Operand& cond, uint32_t width, IRBlock* thenBlock, IRBlock* elseBlock, IRBlock* next) {
+  // The condition is a vector mask, `movmskps` gathers a bit of each 32-bit
+  // element (64-bit elements have both bits equal). Bits of elements that are
+  // not part of the vector (like the last element of `bool3`) are ignored.
+  x86::Gp mask = newTmpI32("mask");
+  emit2x(x86::Inst::kIdMovmskps, mask, cond);
+
+  _cc->test(mask, asmjit::imm((1u << (width / 4)) - 1));
+  emitJxx(thenBlock, elseBlock, next);
+}
+
+void IRToX86::emitJxx(IRBlock* thenBlock, IRBlock* elseBlock, IRBlock* next) {
+  if (thenBlock == next) {
+    _cc->jz(blockLabel(elseBlock));
+  }
+  else {
+    _cc->jnz(blockLabel(thenBlock));
+    if (elseBlock != next)
+      _cc->jmp(blockLabel(elseBlock));
+  }
+}
+
+x86::Gp IRToX86::newTmpI32(const char* name) {
+  // Assembled code has a single temporary, instruction sequences that need
+  // more than one can't be assembled.
+  if (!_compiler)
+    return _tmpGp.r32();
+
+  return _compiler->newI32(name);
+}
+
 x86::Gp IRToX86::varAsPtr(IRReg* irVar) {
   uint32_t id = irVar->jitId();
   MPSL_ASSERT(id != kInvalidRegId);
@@ -574,7 +1749,7 @@ x86::Gp IRToX86::varAsI32(IRReg* irVar) {
   uint32_t id = irVar->jitId();
 
   if (id == kInvalidRegId) {
-    x86::Gp gp = _cc->newI32("%%%u", irVar->id());
+    x86::Gp gp = _compiler->newI32("%%%u", irVar->id());
     irVar->setJitId(gp.id());
     return gp;
   }
@@ -583,11 +1758,25 @@ x86::Gp IRToX86::varAsI32(IRReg* irVar) {
   }
 }
 
-x86::Xmm IRToX86::varAsXmm(IRReg* irVar) {
+x86::Vec IRToX86::varAsVec(IRReg* irVar) {
   uint32_t id = irVar->jitId();
 
+  // 256-bit variables are only created if `hasV256()` is true.
+  if (irVar->width() == 32) {
+    _usesV256 = true;
+
+    if (id == kInvalidRegId) {
+      x86::Ymm ymm = _compiler->newYmm("%%%u", irVar->id());
+      irVar->setJitId(ymm.id());
+      return ymm;
+    }
+    else {
+      return x86::ymm(id);
+    }
+  }
+
   if (id == kInvalidRegId) {
-    x86::Xmm xmm = _cc->newXmm("%%%u", irVar->id());
+    x86::Xmm xmm = _compiler->newXmm("%%%u", irVar->id());
     irVar->setJitId(xmm.id());
     return xmm;
   }
@@ -596,6 +1785,719 @@ x86::Xmm IRToX86::varAsXmm(IRReg* irVar) {
   }
 }
 
+// ============================================================================
+// [mpsl::IRToX86 - Assemble]
+// ============================================================================
+
+// Functions emitted by `x86::Assembler` have the same signatures as the ones
+// emitted by `x86::Compiler`. Registers are allocated by `IRRegAlloc` before
+// the prolog is emitted, as the frame depends on registers used and on the
+// count of spill slots.
+Error IRToX86::assembleIRAsFunc(IRBuilder* ir) {
+  uint32_t i;
+  uint32_t numSlots = ir->numSlots();
+
+  FuncSignatureBuilder proto;
+  proto.setRetT<unsigned int>();
+
+  for (i = 0; i < numSlots; i++)
+    proto.addArgT<void*>();
+
+  FuncDetail func;
+  FuncFrame frame;
+
+  if (func.init(proto) != asmjit::kErrorOk || frame.init(func) != asmjit::kErrorOk)
+    return MPSL_TRACE_ERROR(kErrorJITFailed);
+
+  FuncArgsAssignment args(&func);
+  for (i = 0; i < numSlots; i++) {
+    _data[i] = x86::gpq(mpAsmPoolGp[i]);
+    ir->dataPtr(i)->setJitId(_data[i].id());
+    args.assignReg(i, _data[i]);
+  }
+
+  _numLanes = ir->numLanes();
+  _activeLanes = _numLanes;
+
+  _funcLabel = _cc->newLabel();
+  _cc->bind(_funcLabel);
+
+  IRBlocks layout;
+  Error err = layoutBlocks(ir, layout);
+
+  if (err == kErrorOk) err = allocRegs(ir, layout, numSlots);
+  if (err == kErrorOk) err = emitProlog(frame, args, numSlots);
+  if (err == kErrorOk) err = emitTierCounter(imm(_numLanes));
+  if (err == kErrorOk) err = compileLayout(layout);
+
+  layout.release(_allocator);
+  MPSL_PROPAGATE(err);
+
+  _cc->xor_(x86::eax, x86::eax);
+  _cc->emitEpilog(frame);
+
+  if (_constLabel.isValid())
+    _cc->embedConstPool(_constLabel, _constPool);
+
+  return kErrorOk;
+}
+
+Error IRToX86::assembleIRAsBatchFunc(IRBuilder* ir) {
+  uint32_t i;
+  uint32_t numSlots = ir->numSlots();
+
+  FuncSignatureBuilder proto;
+  proto.setRetT<unsigned int>();
+  proto.addArgT<void**>();
+  proto.addArgT<const intptr_t*>();
+  proto.addArgT<size_t>();
+  proto.addArgT<size_t>();
+
+  FuncDetail func;
+  FuncFrame frame;
+
+  if (func.init(proto) != asmjit::kErrorOk || frame.init(func) != asmjit::kErrorOk)
+    return MPSL_TRACE_ERROR(kErrorJITFailed);
+
+  // Data pointers, strides pointer, and count are pinned. Arguments that are
+  // only used before the loop are passed in scratch registers.
+  x86::Gp argsPtr = x86::gpq(mpAsmScratchGp[0]);
+  x86::Gp index = x86::gpq(mpAsmScratchGp[1]);
+  x86::Gp stridesPtr = x86::gpq(mpAsmPoolGp[numSlots]);
+  x86::Gp count = x86::gpq(mpAsmPoolGp[numSlots + 1]);
+  uint32_t numPinned = numSlots + 2;
+
+  for (i = 0; i < numSlots; i++) {
+    _data[i] = x86::gpq(mpAsmPoolGp[i]);
+    ir->dataPtr(i)->setJitId(_data[i].id());
+  }
+
+  FuncArgsAssignment args(&func);
+  args.assignReg(0, argsPtr);
+  args.assignReg(1, stridesPtr);
+  args.assignReg(2, index);
+  args.assignReg(3, count);
+
+  _numLanes = ir->numLanes();
+  _activeLanes = _numLanes;
+
+  _funcLabel = _cc->newLabel();
+  _cc->bind(_funcLabel);
+
+  Label L_Loop = _cc->newLabel();
+  Label L_Done = _cc->newLabel();
+
+  IRBlocks layout;
+  Error err = layoutBlocks(ir, layout);
+
+  if (err == kErrorOk) err = allocRegs(ir, layout, numPinned);
+  if (err == kErrorOk) err = emitProlog(frame, args, numPinned);
+  if (err == kErrorOk) err = emitTierCounter(count);
+
+  if (err == kErrorOk) {
+    for (i = 0; i < numSlots; i++)
+      _cc->mov(_data[i], x86::ptr(argsPtr, static_cast<int>(i * sizeof(void*))));
+
+    _cc->test(count, count);
+    _cc->jz(L_Done);
+
+    // Advance all data pointers to the first record to process.
+    for (i = 0; i < numSlots; i++) {
+      _cc->mov(_tmpGp, x86::ptr(stridesPtr, static_cast<int>(i * sizeof(intptr_t))));
+      _cc->imul(_tmpGp, index);
+      _cc->add(_data[i], _tmpGp);
+    }
+
+    _cc->bind(L_Loop);
+    err = compileLayout(layout);
+  }
+
+  layout.release(_allocator);
+  MPSL_PROPAGATE(err);
+
+  // Strides are not pinned, they are added from memory.
+  for (i = 0; i < numSlots; i++)
+    _cc->add(_data[i], x86::ptr(stridesPtr, static_cast<int>(i * sizeof(intptr_t))));
+
+  _cc->sub(count, 1);
+  _cc->jnz(L_Loop);
+  _cc->bind(L_Done);
+
+  _cc->xor_(x86::eax, x86::eax);
+  _cc->emitEpilog(frame);
+
+  if (_constLabel.isValid())
+    _cc->embedConstPool(_constLabel, _constPool);
+
+  return kErrorOk;
+}
+
+Error IRToX86::allocRegs(IRBuilder* ir, const IRBlocks& layout, uint32_t numPinned) {
+  uint32_t available[IRReg::kKindCount] = { 0 };
+  uint32_t i;
+
+  for (i = numPinned; i < MPSL_ARRAY_SIZE(mpAsmPoolGp); i++)
+    available[IRReg::kKindGp] |= 1u << mpAsmPoolGp[i];
+
+  for (i = 0; i < MPSL_ARRAY_SIZE(mpAsmPoolVec); i++)
+    available[IRReg::kKindVec] |= 1u << mpAsmPoolVec[i];
+
+  // The assembler is only used at `kOptionO0`, where no IR pass computes the CFG.
+  MPSL_PROPAGATE(ir->updateCFG());
+  MPSL_PROPAGATE(ir->updateLiveness());
+
+  return _regAlloc.run(ir, layout, available);
+}
+
+Error IRToX86::emitProlog(FuncFrame& frame, FuncArgsAssignment& args, uint32_t numPinned) {
+  uint32_t i;
+  uint32_t gpRegs = _regAlloc.usedRegs(IRReg::kKindGp) | (1u << mpAsmTmpGp);
+  uint32_t vecRegs = _regAlloc.usedRegs(IRReg::kKindVec) | (1u << mpAsmTmpVec0) | (1u << mpAsmTmpVec1);
+
+  for (i = 0; i < numPinned; i++)
+    gpRegs |= 1u << mpAsmPoolGp[i];
+
+  for (i = 0; i < MPSL_ARRAY_SIZE(mpAsmScratchGp); i++)
+    gpRegs |= 1u << mpAsmScratchGp[i];
+
+  for (i = 0; i < MPSL_ARRAY_SIZE(mpAsmScratchVec); i++)
+    vecRegs |= 1u << mpAsmScratchVec[i];
+
+  // Callee-saved registers that are dirty are preserved by the prolog.
+  frame.addDirtyRegs(x86::Reg::kGroupGp, gpRegs);
+  frame.addDirtyRegs(x86::Reg::kGroupVec, vecRegs);
+  frame.setLocalStackSize(_regAlloc.numSlots() * IRRegAlloc::kSlotSize);
+  frame.setLocalStackAlignment(16);
+
+  if (_enableAVX)
+    frame.setAvxEnabled();
+
+  if (args.updateFuncFrame(frame) != asmjit::kErrorOk || frame.finalize() != asmjit::kErrorOk)
+    return MPSL_TRACE_ERROR(kErrorJITFailed);
+
+  _spillOffset = static_cast<int32_t>(frame.localStackOffset());
+  _cc->emitProlog(frame);
+  _cc->emitArgsAssignment(frame, args);
+
+  return kErrorOk;
+}
+
+x86::Mem IRToX86::spillSlot(uint32_t slot) {
+  return x86::ptr(x86::rsp, _spillOffset + static_cast<int32_t>(slot * IRRegAlloc::kSlotSize));
+}
+
+void IRToX86::emitSpillLoads(IRInst* inst) {
+  IRObject** opArray = inst->operands();
+  uint32_t opCount = inst->opCount();
+
+  // Each spilled register gets its own scratch register, even if it's used
+  // by more operands of `inst`.
+  IRReg* loaded[IRInst::kMaxOperands * 2];
+  uint32_t numLoaded = 0;
+  uint32_t numGp = 0;
+  uint32_t numVec = 0;
+
+  for (uint32_t i = 0; i < opCount; i++) {
+    IRObject* op = opArray[i];
+    IRReg* regs[2] = { nullptr, nullptr };
+
+    if (op->isReg()) {
+      regs[0] = op->as<IRReg>();
+    }
+    else if (op->isMem()) {
+      regs[0] = op->as<IRMem>()->base();
+      regs[1] = op->as<IRMem>()->index();
+    }
+
+    for (uint32_t j = 0; j < 2; j++) {
+      IRReg* reg = regs[j];
+      if (!reg)
+        continue;
+
+      uint32_t slot = _regAlloc.slotOf(reg);
+      if (slot == IRRegAlloc::kNoSlot)
+        continue;
+
+      uint32_t k = 0;
+      while (k < numLoaded && loaded[k] != reg)
+        k++;
+
+      if (k < numLoaded)
+        continue;
+      loaded[numLoaded++] = reg;
+
+      // Destinations are loaded as well, it's cheaper than finding out which
+      // instructions read them.
+      if (reg->reg() == IRReg::kKindGp) {
+        MPSL_ASSERT(numGp < MPSL_ARRAY_SIZE(mpAsmScratchGp));
+        x86::Gp gp = x86::gpq(mpAsmScratchGp[numGp++]);
+
+        _cc->mov(gp, spillSlot(slot));
+        reg->setJitId(gp.id());
+      }
+      else {
+        MPSL_ASSERT(numVec < MPSL_ARRAY_SIZE(mpAsmScratchVec));
+        x86::Xmm xmm = x86::xmm(mpAsmScratchVec[numVec++]);
+
+        emit2x(x86::Inst::kIdMovups, xmm, spillSlot(slot));
+        reg->setJitId(xmm.id());
+      }
+    }
+  }
+}
+
+void IRToX86::emitSpillStores(IRInst* inst) {
+  const InstInfo& info = mpInstInfo[inst->instCode() & kInstCodeMask];
+  if (inst->opCount() == 0 || info.isStore() || info.isJxx() || info.isRet() || info.isCall())
+    return;
+
+  IRObject* dst = inst->operands()[0];
+  if (!dst->isReg())
+    return;
+
+  IRReg* reg = dst->as<IRReg>();
+  uint32_t slot = _regAlloc.slotOf(reg);
+
+  if (slot == IRRegAlloc::kNoSlot)
+    return;
+
+  if (reg->reg() == IRReg::kKindGp)
+    _cc->mov(spillSlot(slot), x86::gpq(reg->jitId()));
+  else
+    emit2x(x86::Inst::kIdMovups, spillSlot(slot), x86::xmm(reg->jitId()));
+}
+
+// ============================================================================
+// [mpsl::IRToX86 - Math]
+// ============================================================================
+
+// Math functions are lowered inline as branch-free SIMD kernels that work on
+// all elements of a register at once, scalars use the same packed sequences.
+// Every kernel reduces its argument to a small interval and evaluates a
+// truncated series there, the number of terms depends on the element type
+// and on `kOptionFastMath`. Special inputs (NaN, infinities, zeros) are fixed
+// up by blending at the end.
+//
+// Known limitations:
+//   - `sin`, `cos` and `tan` reduce arguments by `pi/2` in 3 parts, which is
+//     accurate up to |x| ~ 1e5 (float) and |x| ~ 1e9 (double).
+//   - `pow` is `exp(y * log(x))`, negative `x` yields NaN and the error grows
+//     with the magnitude of `y * log(x)`.
+//   - `atan2(+-inf, +-inf)` yields NaN.
+//   - Inverse trigonometric functions are within about 3 ULPs.
+
+// Coefficients of `exp(r) = sum(r^i / i!)`.
+static const double mpExpCoeff[] = {
+  1.0                 , 1.0                 , 1.0 / 2.0           , 1.0 / 6.0           ,
+  1.0 / 24.0          , 1.0 / 120.0         , 1.0 / 720.0         , 1.0 / 5040.0        ,
+  1.0 / 40320.0       , 1.0 / 362880.0      , 1.0 / 3628800.0     , 1.0 / 39916800.0    ,
+  1.0 / 479001600.0   , 1.0 / 6227020800.0
+};
+
+// Coefficients of `log(m) = 2s * sum(z^i / (2i + 1))`, where `s = (m-1)/(m+1)`
+// and `z = s^2`.
+static const double mpLogCoeff[] = {
+  1.0                 , 1.0 / 3.0           , 1.0 / 5.0           , 1.0 / 7.0           ,
+  1.0 / 9.0           , 1.0 / 11.0          , 1.0 / 13.0          , 1.0 / 15.0          ,
+  1.0 / 17.0          , 1.0 / 19.0          , 1.0 / 21.0
+};
+
+// Coefficients of `sin(r) = r * sum((-1)^i * z^i / (2i + 1)!)`, `z = r^2`.
+static const double mpSinCoeff[] = {
+  1.0                 ,-1.0 / 6.0           , 1.0 / 120.0         ,-1.0 / 5040.0        ,
+  1.0 / 362880.0      ,-1.0 / 39916800.0    , 1.0 / 6227020800.0  ,-1.0 / 1307674368000.0,
+  1.0 / 355687428096000.0
+};
+
+// Coefficients of `cos(r) = sum((-1)^i * z^i / (2i)!)`, `z = r^2`.
+static const double mpCosCoeff[] = {
+  1.0                 ,-1.0 / 2.0           , 1.0 / 24.0          ,-1.0 / 720.0         ,
+  1.0 / 40320.0       ,-1.0 / 3628800.0     , 1.0 / 479001600.0   ,-1.0 / 87178291200.0 ,
+  1.0 / 20922789888000.0
+};
+
+// Coefficients of `atan(h) = h * sum((-1)^i * z^i / (2i + 1))`, `z = h^2`.
+static const double mpAtanCoeff[] = {
+  1.0                 ,-1.0 / 3.0           , 1.0 / 5.0           ,-1.0 / 7.0           ,
+  1.0 / 9.0           ,-1.0 / 11.0          , 1.0 / 13.0          ,-1.0 / 15.0          ,
+  1.0 / 17.0          ,-1.0 / 19.0          , 1.0 / 21.0          ,-1.0 / 23.0          ,
+  1.0 / 25.0          ,-1.0 / 27.0          , 1.0 / 29.0          ,-1.0 / 31.0          ,
+  1.0 / 33.0          ,-1.0 / 35.0          , 1.0 / 37.0          ,-1.0 / 39.0          ,
+  1.0 / 41.0
+};
+
+enum MathSeries {
+  kMathSeriesExp = 0,
+  kMathSeriesLog,
+  kMathSeriesSin,
+  kMathSeriesCos,
+  kMathSeriesAtan,
+  kMathSeriesCount
+};
+
+// Number of terms used, indexed as `[series][isDouble][isFast]`.
+static const uint8_t mpMathTerms[kMathSeriesCount][2][2] = {
+  { {  8,  7 }, { 14, 13 } }, // Exp.
+  { {  5,  4 }, { 10,  9 } }, // Log.
+  { {  6,  5 }, {  9,  9 } }, // Sin.
+  { {  6,  5 }, {  9,  9 } }, // Cos.
+  { {  9,  8 }, { 21, 19 } }  // Atan.
+};
+
+//! \internal
+//!
+//! Emits math kernels of a single element type and register width. Every
+//! operation returns a new virtual register, inputs are never modified.
+class IRToX86Math {
+public:
+  MPSL_NONCOPYABLE(IRToX86Math)
+
+  MPSL_INLINE IRToX86Math(IRToX86* x, bool isDouble, bool isScalar, bool isYmm) noexcept
+    : _x(x),
+      _cc(x->_compiler),
+      _isDouble(isDouble),
+      _isScalar(isScalar),
+      _isYmm(isYmm) {}
+
+  // --------------------------------------------------------------------------
+  // [Helpers]
+  // --------------------------------------------------------------------------
+
+  MPSL_INLINE uint32_t fp(uint32_t psId, uint32_t pdId) const noexcept { return _isDouble ? pdId : psId; }
+  MPSL_INLINE uint32_t terms(uint32_t series) const noexcept { return mpMathTerms[series][_isDouble][_x->_fastMath]; }
+
+  MPSL_INLINE uint32_t mantBits() const noexcept { return _isDouble ? 52 : 23; }
+  MPSL_INLINE uint32_t signPos() const noexcept { return _isDouble ? 63 : 31; }
+
+  MPSL_INLINE uint64_t signBit() const noexcept { return _isDouble ? 0x8000000000000000u : 0x80000000u; }
+  MPSL_INLINE uint64_t absMask() const noexcept { return _isDouble ? 0x7FFFFFFFFFFFFFFFu : 0x7FFFFFFFu; }
+  MPSL_INLINE uint64_t infBits() const noexcept { return _isDouble ? 0x7FF0000000000000u : 0x7F800000u; }
+
+  // `1.5 * 2^mantBits`, adding it rounds to integer and keeps the integer in
+  // the low bits of the result.
+  MPSL_INLINE double roundMagic() const noexcept { return _isDouble ? 6755399441055744.0 : 12582912.0; }
+
+  x86::Vec newVec() {
+    if (_isYmm)
+      return _cc->newYmm();
+    else
+      return _cc->newXmm();
+  }
+
+  // Constant having all elements set to `value`.
+  x86::Mem f(double value) {
+    Value v;
+    if (_isDouble)
+      v.d.set(value);
+    else
+      v.f.set(static_cast<float>(value));
+    return _x->getConstantByValue(v, _isYmm ? 32 : 16);
+  }
+
+  // Constant having all elements set to `bits`.
+  x86::Mem bits(uint64_t value) {
+    Value v;
+    if (_isDouble)
+      v.q.set(value);
+    else
+      v.i.set(static_cast<int32_t>(static_cast<uint32_t>(value)));
+    return _x->getConstantByValue(v, _isYmm ? 32 : 16);
+  }
+
+  x86::Vec load(const Operand& src) {
+    if (src.isReg())
+      return src.as<x86::Vec>();
+
+    x86::Vec dst = newVec();
+    uint32_t loadId = !_isScalar ? x86::Inst::kIdMovups : fp(x86::Inst::kIdMovss, x86::Inst::kIdMovsd);
+    _x->emit2x(loadId, dst, src);
+    return dst;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Operations]
+  // --------------------------------------------------------------------------
+
+  x86::Vec op(uint32_t psId, uint32_t pdId, const x86::Vec& a, const Operand& b) {
+    x86::Vec dst = newVec();
+    if (_isDouble)
+      _x->emit3d(pdId, dst, a, b);
+    else
+      _x->emit3f(psId, dst, a, b);
+    return dst;
+  }
+
+  x86::Vec add(const x86::Vec& a, const Operand& b) { return op(x86::Inst::kIdAddps, x86::Inst::kIdAddpd, a, b); }
+  x86::Vec sub(const x86::Vec& a, const Operand& b) { return op(x86::Inst::kIdSubps, x86::Inst::kIdSubpd, a, b); }
+  x86::Vec mul(const x86::Vec& a, const Operand& b) { return op(x86::Inst::kIdMulps, x86::Inst::kIdMulpd, a, b); }
+  x86::Vec div(const x86::Vec& a, const Operand& b) { return op(x86::Inst::kIdDivps, x86::Inst::kIdDivpd, a, b); }
+  x86::Vec min_(const x86::Vec& a, const Operand& b) { return op(x86::Inst::kIdMinps, x86::Inst::kIdMinpd, a, b); }
+  x86::Vec max_(const x86::Vec& a, const Operand& b) { return op(x86::Inst::kIdMaxps, x86::Inst::kIdMaxpd, a, b); }
+  x86::Vec and_(const x86::Vec& a, const Operand& b) { return op(x86::Inst::kIdAndps, x86::Inst::kIdAndpd, a, b); }
+  x86::Vec andn(const x86::Vec& a, const Operand& b) { return op(x86::Inst::kIdAndnps, x86::Inst::kIdAndnpd, a, b); }
+  x86::Vec or_(const x86::Vec& a, const Operand& b) { return op(x86::Inst::kIdOrps, x86::Inst::kIdOrpd, a, b); }
+  x86::Vec xor_(const x86::Vec& a, const Operand& b) { return op(x86::Inst::kIdXorps, x86::Inst::kIdXorpd, a, b); }
+
+  x86::Vec cmp(const x86::Vec& a, const Operand& b, int predicate) {
+    x86::Vec dst = newVec();
+    if (_isDouble)
+      _x->emit3d(x86::Inst::kIdCmppd, dst, a, b, predicate);
+    else
+      _x->emit3f(x86::Inst::kIdCmpps, dst, a, b, predicate);
+    return dst;
+  }
+
+  x86::Vec sqrt(const x86::Vec& a) {
+    x86::Vec dst = newVec();
+    _x->emit2x(fp(x86::Inst::kIdSqrtps, x86::Inst::kIdSqrtpd), dst, a);
+    return dst;
+  }
+
+  // Integer operations on the bits of elements.
+  x86::Vec iop(uint32_t instId, const x86::Vec& a, const Operand& b) {
+    x86::Vec dst = newVec();
+    _x->emit3i(instId, dst, a, b);
+    return dst;
+  }
+
+  x86::Vec iadd(const x86::Vec& a, const Operand& b) { return iop(fp(x86::Inst::kIdPaddd, x86::Inst::kIdPaddq), a, b); }
+  x86::Vec shl(const x86::Vec& a, uint32_t n) { return iop(fp(x86::Inst::kIdPslld, x86::Inst::kIdPsllq), a, asmjit::imm(n)); }
+  x86::Vec shr(const x86::Vec& a, uint32_t n) { return iop(fp(x86::Inst::kIdPsrld, x86::Inst::kIdPsrlq), a, asmjit::imm(n)); }
+
+  // Returns `mask ? a : b`, `mask` must have all bits of an element equal.
+  x86::Vec blend(const x86::Vec& mask, const Operand& a, const x86::Vec& b) {
+    if (_x->_enableAVX) {
+      x86::Vec dst = newVec();
+      _cc->emit(fp(x86::Inst::kIdVblendvps, x86::Inst::kIdVblendvpd), dst, b, a, mask);
+      return dst;
+    }
+
+    return or_(and_(mask, a), andn(mask, b));
+  }
+
+  // Returns a mask of elements that have `bit` of their integer bits set.
+  x86::Vec bitMask(const x86::Vec& a, uint32_t bit) {
+    x86::Vec dst = iop(x86::Inst::kIdPsrad, shl(a, signPos() - bit), asmjit::imm(31));
+    if (!_isDouble)
+      return dst;
+
+    // There is no 64-bit arithmetic shift, copy the high DWORD to the low one.
+    x86::Vec tmp = newVec();
+    _x->emit2x(x86::Inst::kIdPshufd, tmp, dst, asmjit::imm(x86::Predicate::shuf(3, 3, 1, 1)));
+    return tmp;
+  }
+
+  // Evaluates `sum(coeff[i] * x^i)` of `n` terms by Horner's scheme.
+  x86::Vec poly(const x86::Vec& x, const double* coeff, uint32_t n) {
+    MPSL_ASSERT(n >= 2);
+
+    x86::Vec p = add(mul(x, f(coeff[n - 1])), f(coeff[n - 2]));
+    for (uint32_t i = n - 2; i != 0; i--)
+      p = add(mul(p, x), f(coeff[i - 1]));
+    return p;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Kernels]
+  // --------------------------------------------------------------------------
+
+  x86::Vec exp(const x86::Vec& x) {
+    // Results above `hi` overflow to infinity, results below `lo` are smaller
+    // than a half of the smallest denormal and round to zero.
+    double lo = _isDouble ? -7.45133219101941108420e+02 : -103.972084;
+    double hi = _isDouble ?  7.09782712893383973096e+02 :  88.72283935546875;
+
+    // Cody-Waite split of `ln(2)`, `n * ln2Hi` is exact.
+    double ln2Hi = _isDouble ? 6.93147180369123816490e-01 :  0.693359375;
+    double ln2Lo = _isDouble ? 1.90821492927058770002e-10 : -2.12194440e-4;
+
+    // exp(x) = 2^n * exp(r), where `n = round(x / ln(2))` and |r| <= ln(2)/2.
+    x86::Vec xc = min_(max_(x, f(lo)), f(hi));
+    x86::Vec t = add(mul(xc, f(1.44269504088896340736)), f(roundMagic()));
+    x86::Vec n = sub(t, f(roundMagic()));
+    x86::Vec r = sub(sub(xc, mul(n, f(ln2Hi))), mul(n, f(ln2Lo)));
+    x86::Vec p = poly(r, mpExpCoeff, terms(kMathSeriesExp));
+
+    // `2^n` is not representable at both ends of the range, scale by `2^n1`
+    // and `2^n2`, where `n1 = round(n / 2)` and `n2 = n - n1`, which are both
+    // normal, so only the last multiplication rounds a denormal result. Each
+    // of them is in the low bits of `t1` and `t2`, moved to the exponent.
+    x86::Vec t1 = add(mul(n, f(0.5)), f(roundMagic()));
+    x86::Vec t2 = add(sub(n, sub(t1, f(roundMagic()))), f(roundMagic()));
+
+    uint32_t bias = _isDouble ? 1023 : 127;
+    x86::Vec e1 = shl(iadd(t1, bits(bias)), mantBits());
+    x86::Vec e2 = shl(iadd(t2, bits(bias)), mantBits());
+    x86::Vec result = mul(mul(p, e1), e2);
+
+    result = blend(cmp(x, f(hi), x86::Predicate::kCmpNLE), bits(infBits()), result);
+    result = andn(cmp(x, f(lo), x86::Predicate::kCmpLT), result);
+    return or_(result, cmp(x, x, x86::Predicate::kCmpUNORD));
+  }
+
+  // Returns `e * ce + log(m) * cm`, where `x = 2^e * m`, which is the logarithm
+  // of any base if `ce` and `cm` are chosen accordingly.
+  x86::Vec log(const x86::Vec& x, double ce, double cm) {
+    double minNormal = _isDouble ? 2.2250738585072014e-308 : 1.17549435e-38;
+    double scale = _isDouble ? 54.0 : 24.0;
+
+    // Scale denormals to normals, compensated when `e` is calculated.
+    x86::Vec denorm = cmp(x, f(minNormal), x86::Predicate::kCmpLT);
+    x86::Vec xs = blend(denorm, mul(x, f(_isDouble ? 18014398509481984.0 : 16777216.0)), x);
+
+    // Convert the biased exponent to floating point by inserting its bits to
+    // the mantissa of `2^mantBits`.
+    double magic = _isDouble ? 4503599627370496.0 : 8388608.0;
+    uint64_t magicBits = _isDouble ? 0x4330000000000000u : 0x4B000000u;
+    uint64_t mantMask = _isDouble ? 0x000FFFFFFFFFFFFFu : 0x007FFFFFu;
+
+    x86::Vec e = sub(or_(shr(xs, mantBits()), bits(magicBits)), f(magic + (_isDouble ? 1023.0 : 127.0)));
+    e = sub(e, and_(denorm, f(scale)));
+
+    // Mantissa `m` in [sqrt(2)/2, sqrt(2)).
+    x86::Vec m = or_(and_(xs, bits(mantMask)), f(1.0));
+    x86::Vec big = cmp(m, f(1.41421356237309504880), x86::Predicate::kCmpNLT);
+    m = blend(big, mul(m, f(0.5)), m);
+    e = add(e, and_(big, f(1.0)));
+
+    x86::Vec fr = sub(m, f(1.0));
+    x86::Vec s = div(fr, add(fr, f(2.0)));
+    x86::Vec lm = mul(add(s, s), poly(mul(s, s), mpLogCoeff, terms(kMathSeriesLog)));
+
+    if (cm != 1.0)
+      lm = mul(lm, f(cm));
+
+    x86::Vec result = add(ce != 1.0 ? mul(e, f(ce)) : e, lm);
+    result = or_(result, or_(cmp(x, f(0.0), x86::Predicate::kCmpLT), cmp(x, x, x86::Predicate::kCmpUNORD)));
+    result = blend(cmp(x, f(0.0), x86::Predicate::kCmpEQ), bits(infBits() | signBit()), result);
+    return blend(cmp(x, bits(infBits()), x86::Predicate::kCmpEQ), bits(infBits()), result);
+  }
+
+  x86::Vec pow(const x86::Vec& x, const x86::Vec& y) {
+    x86::Vec result = exp(mul(y, log(x, 0.69314718055994530942, 1.0)));
+    x86::Vec one = or_(cmp(y, f(0.0), x86::Predicate::kCmpEQ), cmp(x, f(1.0), x86::Predicate::kCmpEQ));
+    return blend(one, f(1.0), result);
+  }
+
+  // Calculates `sin(x)` (kind 0), `cos(x)` (kind 1) or `tan(x)` (kind 2).
+  x86::Vec trig(const x86::Vec& x, uint32_t kind) {
+    // Three-part split of `pi/2`, products of `n` and the first two parts are
+    // exact in the primary domain.
+    double p1 = _isDouble ? 1.57079632673412561417e+00 : 1.5703125;
+    double p2 = _isDouble ? 6.07710050630396597660e-11 : 4.837512969970703125e-4;
+    double p3 = _isDouble ? 2.02226624879595063154e-21 : 7.54978995489188216e-8;
+
+    // x = n * pi/2 + r, where |r| <= pi/4.
+    x86::Vec t = add(mul(x, f(0.63661977236758134308)), f(roundMagic()));
+    x86::Vec n = sub(t, f(roundMagic()));
+    x86::Vec r = sub(sub(sub(x, mul(n, f(p1))), mul(n, f(p2))), mul(n, f(p3)));
+
+    x86::Vec z = mul(r, r);
+    x86::Vec s = mul(r, poly(z, mpSinCoeff, terms(kMathSeriesSin)));
+    x86::Vec c = poly(z, mpCosCoeff, terms(kMathSeriesCos));
+
+    // cos(x) == sin(x + pi/2), advance the quadrant.
+    if (kind == 1)
+      t = iadd(t, bits(1));
+
+    // Odd quadrants swap `sin(r)` and `cos(r)`.
+    x86::Vec odd = bitMask(t, 0);
+    if (kind == 2) {
+      x86::Vec result = div(blend(odd, c, s), blend(odd, s, c));
+      return xor_(result, and_(odd, bits(signBit())));
+    }
+
+    // Quadrants 2 and 3 negate the result.
+    x86::Vec sign = and_(shl(t, signPos() - 1), bits(signBit()));
+    return xor_(blend(odd, c, s), sign);
+  }
+
+  // Calculates `atan(a)` of non-negative `a`.
+  x86::Vec atanAbs(const x86::Vec& a) {
+    // Reduce to |h| <= tan(pi/8):
+    //   a > tan(3pi/8) : atan(a) = pi/2 + atan(-1 / a).
+    //   a > tan(pi/8)  : atan(a) = pi/4 + atan((a - 1) / (a + 1)).
+    x86::Vec inv = cmp(a, f(2.41421356237309504880), x86::Predicate::kCmpNLE);
+    x86::Vec mid = cmp(a, f(0.41421356237309504880), x86::Predicate::kCmpNLE);
+
+    x86::Vec num = blend(inv, f(-1.0), blend(mid, sub(a, f(1.0)), a));
+    x86::Vec den = blend(inv, a, blend(mid, add(a, f(1.0)), load(f(1.0))));
+    x86::Vec base = blend(inv, f(1.57079632679489661923), and_(mid, f(0.78539816339744830962)));
+
+    x86::Vec h = div(num, den);
+    return add(base, mul(h, poly(mul(h, h), mpAtanCoeff, terms(kMathSeriesAtan))));
+  }
+
+  x86::Vec atan(const x86::Vec& x) {
+    return xor_(atanAbs(and_(x, bits(absMask()))), and_(x, bits(signBit())));
+  }
+
+  x86::Vec asin(const x86::Vec& x) {
+    // asin(x) = atan(x / sqrt(1 - x^2)).
+    x86::Vec u = mul(sub(load(f(1.0)), x), add(x, f(1.0)));
+    return atan(div(x, sqrt(u)));
+  }
+
+  x86::Vec acos(const x86::Vec& x) {
+    // acos(x) = 2 * atan(sqrt((1 - x) / (1 + x))).
+    x86::Vec q = sqrt(div(sub(load(f(1.0)), x), add(x, f(1.0))));
+    return mul(atanAbs(q), f(2.0));
+  }
+
+  x86::Vec atan2(const x86::Vec& y, const x86::Vec& x) {
+    x86::Vec ay = and_(y, bits(absMask()));
+    x86::Vec ax = and_(x, bits(absMask()));
+
+    // Force `0 / 0` to zero.
+    x86::Vec q = andn(cmp(ay, f(0.0), x86::Predicate::kCmpEQ), div(ay, ax));
+    x86::Vec t = atanAbs(q);
+
+    t = blend(cmp(x, f(0.0), x86::Predicate::kCmpLT), sub(load(f(3.14159265358979323846)), t), t);
+    return xor_(t, and_(y, bits(signBit())));
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  IRToX86* _x;
+  x86::Compiler* _cc;
+
+  bool _isDouble;
+  bool _isScalar;
+  bool _isYmm;
+};
+
+void IRToX86::emitMath(uint32_t instCode, const Operand& o0, const Operand& o1, const Operand& o2) {
+  uint32_t code = instCode & kInstCodeMask;
+  const InstInfo& info = mpInstInfo[code];
+
+  IRToX86Math m(this, info.isF64(), (instCode & kInstVecMask) == kInstVec0, x86::Reg::isYmm(o0));
+  x86::Vec x = m.load(o1);
+  x86::Vec result;
+
+  switch (code) {
+    case kInstCodeExpf  : case kInstCodeExpd  : result = m.exp(x); break;
+    case kInstCodeLogf  : case kInstCodeLogd  : result = m.log(x, 0.69314718055994530942, 1.0); break;
+    case kInstCodeLog2f : case kInstCodeLog2d : result = m.log(x, 1.0, 1.44269504088896340736); break;
+    case kInstCodeLog10f: case kInstCodeLog10d: result = m.log(x, 0.30102999566398119521, 0.43429448190325182765); break;
+    case kInstCodeSinf  : case kInstCodeSind  : result = m.trig(x, 0); break;
+    case kInstCodeCosf  : case kInstCodeCosd  : result = m.trig(x, 1); break;
+    case kInstCodeTanf  : case kInstCodeTand  : result = m.trig(x, 2); break;
+    case kInstCodeAsinf : case kInstCodeAsind : result = m.asin(x); break;
+    case kInstCodeAcosf : case kInstCodeAcosd : result = m.acos(x); break;
+    case kInstCodeAtanf : case kInstCodeAtand : result = m.atan(x); break;
+    case kInstCodePowf  : case kInstCodePowd  : result = m.pow(x, m.load(o2)); break;
+    case kInstCodeAtan2f: case kInstCodeAtan2d: result = m.atan2(x, m.load(o2)); break;
+
+    default:
+      MPSL_ASSERT(!"Implemented");
+      return;
+  }
+
+  emit2x(x86::Inst::kIdMovaps, o0, result);
+}
+
 } // mpsl namespace
 
 // [Api-End]
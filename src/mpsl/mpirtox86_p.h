@@ -12,6 +12,7 @@
 #include "./mpast_p.h"
 #include "./mphash_p.h"
 #include "./mpir_p.h"
+#include "./mpirregalloc_p.h"
 
 // [Api-Begin]
 #include "./mpsl_apibegin.h"
@@ -20,8 +21,12 @@ namespace mpsl {
 
 namespace x86 = asmjit::x86;
 
+using asmjit::BaseEmitter;
 using asmjit::BaseNode;
 using asmjit::ConstPool;
+using asmjit::FuncArgsAssignment;
+using asmjit::FuncFrame;
+using asmjit::FuncNode;
 using asmjit::Label;
 using asmjit::Operand;
 
@@ -37,9 +42,44 @@ public:
   // [Construction / Destruction]
   // --------------------------------------------------------------------------
 
-  IRToX86(ZoneAllocator* allocator, x86::Compiler* cc);
+  //! Create a code generator that emits to `emitter`, which is either
+  //! `x86::Compiler` or `x86::Assembler` (see `canAssemble()`).
+  IRToX86(ZoneAllocator* allocator, BaseEmitter* emitter);
   ~IRToX86();
 
+  // --------------------------------------------------------------------------
+  // [Features]
+  // --------------------------------------------------------------------------
+
+  //! Host features the generated code depends on, see `usedFeatures()`.
+  enum Feature {
+    kFeatureSSE4_1 = 0x01,
+    kFeatureAVX    = 0x02,
+    kFeatureAVX2   = 0x04
+  };
+
+  //! Get host features used by code compiled with `options`.
+  static uint32_t usedFeatures(uint32_t options);
+
+  //! Get whether 256-bit vectors can be used by code compiled with `options`.
+  static bool hasV256(uint32_t options);
+
+  //! Get whether `ir` compiled with `options` can be emitted by `x86::Assembler`,
+  //! `reason` is set to what prevents it otherwise (like "uses 256-bit vectors").
+  static bool canAssemble(IRBuilder* ir, uint32_t options, const char** reason);
+
+  //! Disable features that are disabled by compile `options`.
+  void applyOptions(uint32_t options);
+
+  // --------------------------------------------------------------------------
+  // [Tiering]
+  // --------------------------------------------------------------------------
+
+  //! Make the compiled function subtract the count of records it processes
+  //! from `counter` and call `onHot(arg)` when it gets negative.
+  void setTierCounter(intptr_t* counter, void (MPSL_CDECL* onHot)(void*), void* arg);
+  Error emitTierCounter(const Operand& numRecords);
+
   // --------------------------------------------------------------------------
   // [Const Pool]
   // --------------------------------------------------------------------------
@@ -51,46 +91,122 @@ public:
   x86::Mem getConstantD64(double value);
   x86::Mem getConstantD64AsPD(double value);
   x86::Mem getConstantByValue(const Value& value, uint32_t width);
+  x86::Mem getConstantAt(size_t offset);
+
+  // --------------------------------------------------------------------------
+  // [Uniforms]
+  // --------------------------------------------------------------------------
+
+  //! Uniform loaded before the function body.
+  struct UniformLoad {
+    uint32_t instCode;                   //!< Fetch instruction.
+    int32_t offset;                      //!< Offset in the uniform block.
+    bool isGp;                           //!< Loaded to a general purpose register.
+    x86::Reg reg;                        //!< Loaded register.
+  };
+
+  void prepareUniforms();
+  bool isUniformFetch(IRInst* inst) const;
+  Error emitUniformFetch(IRInst* inst, const Operand& dst);
 
   // --------------------------------------------------------------------------
   // [Compile]
   // --------------------------------------------------------------------------
 
   Error compileIRAsFunc(IRBuilder* ir);
+  Error compileIRAsBatchFunc(IRBuilder* ir);
   Error compileIRAsPart(IRBuilder* ir);
-  Error compileConsecutiveBlocks(IRBlock* block);
+  Error compileLayout(const IRBlocks& layout);
   Error compileBasicBlock(IRBlock* block, IRBlock* next);
 
-  MPSL_INLINE void emit2x(uint32_t instId, const Operand& o0, const Operand& o1) { _cc->emit(instId, o0, o1); }
+  Error layoutBlocks(IRBuilder* ir, IRBlocks& layout);
+  Error layoutConsecutiveBlocks(IRBlocks& layout, IRBlock* block, IRBlock* exit);
+  Label blockLabel(IRBlock* block);
+
+  void emitLaneFetch(const Operand& o0, const Operand& o1, uint32_t size);
+  void emitLaneStore(const Operand& o0, const Operand& o1, uint32_t size);
+
+  void emit2x(uint32_t instId, const Operand& o0, const Operand& o1);
+  void emit2x(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2);
   void emit3i(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2);
   void emit3f(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2);
   void emit3f(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2, int imm);
   void emit3d(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2);
   void emit3d(uint32_t instId, const Operand& o0, const Operand& o1, const Operand& o2, int imm);
+  void emit3v(uint32_t instId, uint32_t loadId, const Operand& o0, const Operand& o1, const Operand& o2, const Operand& o3);
+  void emitCmpi(uint32_t instCode, const Operand& o0, const Operand& o1, const Operand& o2);
+  void emitJnz(const Operand& cond, IRBlock* thenBlock, IRBlock* elseBlock, IRBlock* next);
+  void emitJany(const Operand& cond, uint32_t width, IRBlock* thenBlock, IRBlock* elseBlock, IRBlock* next);
+  void emitJxx(IRBlock* thenBlock, IRBlock* elseBlock, IRBlock* next);
+  void emitBlend(const Operand& o0, const Operand& o1, const Operand& o2, const Operand& o3);
+  void emitMulhi(const Operand& o0, const Operand& o1, const Operand& o2);
+  void emitMath(uint32_t instCode, const Operand& o0, const Operand& o1, const Operand& o2);
+
+  x86::Gp newTmpI32(const char* name);
 
   x86::Gp varAsPtr(IRReg* irVar);
   x86::Gp varAsI32(IRReg* irVar);
-  x86::Xmm varAsXmm(IRReg* irVar);
+  x86::Vec varAsVec(IRReg* irVar);
+
+  // --------------------------------------------------------------------------
+  // [Assemble]
+  // --------------------------------------------------------------------------
+
+  Error assembleIRAsFunc(IRBuilder* ir);
+  Error assembleIRAsBatchFunc(IRBuilder* ir);
+
+  //! Allocate registers of `layout`, the first `numPinned` registers of the
+  //! pool are reserved by the function.
+  Error allocRegs(IRBuilder* ir, const IRBlocks& layout, uint32_t numPinned);
+  Error emitProlog(FuncFrame& frame, FuncArgsAssignment& args, uint32_t numPinned);
+
+  x86::Mem spillSlot(uint32_t slot);
+  void emitSpillLoads(IRInst* inst);
+  void emitSpillStores(IRInst* inst);
 
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
 
   ZoneAllocator* _allocator;
-  x86::Compiler* _cc;
+  x86::Emitter* _cc;                     //!< Emitter (`_compiler` or an assembler).
+  x86::Compiler* _compiler;              //!< Compiler, null if assembling.
 
   x86::Gp _data[Globals::kMaxArgumentsCount];
   x86::Gp _ret;
 
+  FuncNode* _funcNode;
+  Label _funcLabel;                      //!< Start of the function.
   BaseNode* _functionBody;
   ConstPool _constPool;
   Label _constLabel;
   x86::Gp _constPtr;
 
+  IRReg* _uniformReg;                    //!< Address of the uniform block in IR, null if none.
+  void* _uniformData;                    //!< Uniform block.
+  x86::Gp _uniformPtr;                   //!< Address of the uniform block.
+  BaseNode* _uniformCursor;              //!< Where uniforms are loaded.
+  ZoneVector<UniformLoad> _uniformLoads; //!< Uniforms loaded before the function body.
+
   x86::Xmm _tmpXmm0;
   x86::Xmm _tmpXmm1;
+  x86::Gp _tmpGp;                        //!< Temporary register (assembling only).
+
+  IRRegAlloc _regAlloc;                  //!< Register allocator (assembling only).
+  int32_t _spillOffset;                  //!< Offset of spill slots relative to the stack pointer.
+
+  intptr_t* _tierCounter;                //!< Tier-up counter, null if not tiered.
+  void (MPSL_CDECL* _tierOnHot)(void*);  //!< Called when the counter gets negative.
+  void* _tierArg;                        //!< Argument passed to `_tierOnHot`.
+
+  uint32_t _numLanes;
+  uint32_t _activeLanes;
 
   bool _enableSSE4_1;
+  bool _enableAVX;                       //!< Use VEX encoded instructions.
+  bool _enableAVX2;                      //!< Use 256-bit integer instructions.
+  bool _usesV256;                        //!< 256-bit registers used, needs `vzeroupper`.
+  bool _fastMath;                        //!< Use less accurate math kernels.
 };
 
 } // mpsl namespace
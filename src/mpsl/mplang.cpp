@@ -281,9 +281,11 @@ const InstInfo mpInstInfo[kInstCodeCount] = {
   // +----------+---------------+-----------------------------------------+
   ROW(None      , "<none>"      , 0, 0                                    ),
   ROW(Jmp       , "jmp"         , 1, I(Jxx)                               ),
-  ROW(Jnz       , "jnz"         , 2, I(Jxx)                               ),
+  ROW(Jnz       , "jnz"         , 3, I(Jxx)                               ),
+  ROW(Jany      , "jany"        , 3, I(Jxx)                               ),
   ROW(Call      , "call"        , 0, I(Call)                              ),
   ROW(Ret       , "ret"         , 0, I(Ret)                               ),
+  ROW(Phi       , "phi"         , 0, I(Phi)                               ),
 
   ROW(Fetch32   , "fetch32"     , 2, I(Fetch)                             ),
   ROW(Fetch64   , "fetch64"     , 2, I(Fetch)                             ),
@@ -378,25 +380,26 @@ const InstInfo mpInstInfo[kInstCodeCount] = {
   ROW(Lzcnti    , "lzcnti"      , 2, I(I32)                               ),
   ROW(Popcnti   , "popcnti"     , 2, I(I32)                               ),
 
-  ROW(Addf      , "addf"        , 3, I(F32)                               ),
-  ROW(Addd      , "addd"        , 3, I(F64)                               ),
+  ROW(Addf      , "addf"        , 3, I(F32) | I(Commutative)              ),
+  ROW(Addd      , "addd"        , 3, I(F64) | I(Commutative)              ),
   ROW(Subf      , "subf"        , 3, I(F32)                               ),
   ROW(Subd      , "subd"        , 3, I(F64)                               ),
-  ROW(Mulf      , "mulf"        , 3, I(F32)                               ),
-  ROW(Muld      , "muld"        , 3, I(F64)                               ),
+  ROW(Mulf      , "mulf"        , 3, I(F32) | I(Commutative)              ),
+  ROW(Muld      , "muld"        , 3, I(F64) | I(Commutative)              ),
   ROW(Divf      , "divf"        , 3, I(F32)                               ),
   ROW(Divd      , "divd"        , 3, I(F64)                               ),
   ROW(Modf      , "modf"        , 3, I(F32) | I(Complex)                  ),
   ROW(Modd      , "modd"        , 3, I(F64) | I(Complex)                  ),
-  ROW(Andi      , "andi"        , 3, I(I32)                               ),
-  ROW(Andf      , "andf"        , 3, I(F32)                               ),
-  ROW(Andd      , "andd"        , 3, I(F64)                               ),
-  ROW(Ori       , "ori"         , 3, I(I32)                               ),
-  ROW(Orf       , "orf"         , 3, I(F32)                               ),
-  ROW(Ord       , "ord"         , 3, I(F64)                               ),
-  ROW(Xori      , "xori"        , 3, I(I32)                               ),
-  ROW(Xorf      , "xorf"        , 3, I(F32)                               ),
-  ROW(Xord      , "xord"        , 3, I(F64)                               ),
+  ROW(Andi      , "andi"        , 3, I(I32) | I(Commutative)              ),
+  ROW(Andf      , "andf"        , 3, I(F32) | I(Commutative)              ),
+  ROW(Andd      , "andd"        , 3, I(F64) | I(Commutative)              ),
+  ROW(Ori       , "ori"         , 3, I(I32) | I(Commutative)              ),
+  ROW(Orf       , "orf"         , 3, I(F32) | I(Commutative)              ),
+  ROW(Ord       , "ord"         , 3, I(F64) | I(Commutative)              ),
+  ROW(Xori      , "xori"        , 3, I(I32) | I(Commutative)              ),
+  ROW(Xorf      , "xorf"        , 3, I(F32) | I(Commutative)              ),
+  ROW(Xord      , "xord"        , 3, I(F64) | I(Commutative)              ),
+  ROW(Blend     , "blend"       , 4, I(I32) | I(F32) | I(F64) | I(SIMD)   ),
   ROW(Minf      , "minf"        , 3, I(F32)                               ),
   ROW(Mind      , "mind"        , 3, I(F64)                               ),
   ROW(Maxf      , "maxf"        , 3, I(F32)                               ),
@@ -405,10 +408,10 @@ const InstInfo mpInstInfo[kInstCodeCount] = {
   ROW(Roli      , "roli"        , 3, I(I32)                       | I(Imm)),
   ROW(Rori      , "rori"        , 3, I(I32)                       | I(Imm)),
 
-  ROW(Cmpeqf    , "cmpeqf"      , 3, I(F32)                               ),
-  ROW(Cmpeqd    , "cmpeqd"      , 3, I(F64)                               ),
-  ROW(Cmpnef    , "cmpnef"      , 3, I(F32)                               ),
-  ROW(Cmpned    , "cmpned"      , 3, I(F64)                               ),
+  ROW(Cmpeqf    , "cmpeqf"      , 3, I(F32) | I(Commutative)              ),
+  ROW(Cmpeqd    , "cmpeqd"      , 3, I(F64) | I(Commutative)              ),
+  ROW(Cmpnef    , "cmpnef"      , 3, I(F32) | I(Commutative)              ),
+  ROW(Cmpned    , "cmpned"      , 3, I(F64) | I(Commutative)              ),
   ROW(Cmpltf    , "cmpltf"      , 3, I(F32)                               ),
   ROW(Cmpltd    , "cmpltd"      , 3, I(F64)                               ),
   ROW(Cmplef    , "cmplef"      , 3, I(F32)                               ),
@@ -435,14 +438,14 @@ const InstInfo mpInstInfo[kInstCodeCount] = {
   ROW(Packuswb  , "ppackuswb"   , 3, I(I32)                               ),
   ROW(Packssdw  , "ppackssdw"   , 3, I(I32)                               ),
   ROW(Packusdw  , "ppackusdw"   , 3, I(I32)                               ),
-  ROW(Paddb     , "paddb"       , 3, I(I32)                               ),
-  ROW(Paddw     , "paddw"       , 3, I(I32)                               ),
-  ROW(Paddd     , "paddd"       , 3, I(I32)                               ),
-  ROW(Paddq     , "paddq"       , 3, I(I32)                               ),
-  ROW(Paddssb   , "paddssb"     , 3, I(I32)                               ),
-  ROW(Paddusb   , "paddusb"     , 3, I(I32)                               ),
-  ROW(Paddssw   , "paddssw"     , 3, I(I32)                               ),
-  ROW(Paddusw   , "paddusw"     , 3, I(I32)                               ),
+  ROW(Paddb     , "paddb"       , 3, I(I32) | I(Commutative)              ),
+  ROW(Paddw     , "paddw"       , 3, I(I32) | I(Commutative)              ),
+  ROW(Paddd     , "paddd"       , 3, I(I32) | I(Commutative)              ),
+  ROW(Paddq     , "paddq"       , 3, I(I32) | I(Commutative)              ),
+  ROW(Paddssb   , "paddssb"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Paddusb   , "paddusb"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Paddssw   , "paddssw"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Paddusw   , "paddusw"     , 3, I(I32) | I(Commutative)              ),
   ROW(Psubb     , "psubb"       , 3, I(I32)                               ),
   ROW(Psubw     , "psubw"       , 3, I(I32)                               ),
   ROW(Psubd     , "psubd"       , 3, I(I32)                               ),
@@ -451,24 +454,25 @@ const InstInfo mpInstInfo[kInstCodeCount] = {
   ROW(Psubusb   , "psubusb"     , 3, I(I32)                               ),
   ROW(Psubssw   , "psubssw"     , 3, I(I32)                               ),
   ROW(Psubusw   , "psubusw"     , 3, I(I32)                               ),
-  ROW(Pmulw     , "pmuld"       , 3, I(I32)                               ),
-  ROW(Pmulhsw   , "pmulhsw"     , 3, I(I32)                               ),
-  ROW(Pmulhuw   , "pmulhuw"     , 3, I(I32)                               ),
-  ROW(Pmuld     , "pmuld"       , 3, I(I32)                               ),
+  ROW(Pmulw     , "pmuld"       , 3, I(I32) | I(Commutative)              ),
+  ROW(Pmulhsw   , "pmulhsw"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Pmulhuw   , "pmulhuw"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Pmulhsd   , "pmulhsd"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Pmuld     , "pmuld"       , 3, I(I32) | I(Commutative)              ),
   ROW(Pdivsd    , "pdivsd"      , 3, I(I32)                               ),
   ROW(Pmodsd    , "pmodsd"      , 3, I(I32)                               ),
-  ROW(Pminsb    , "pminsb"      , 3, I(I32)                               ),
-  ROW(Pminub    , "pminub"      , 3, I(I32)                               ),
-  ROW(Pminsw    , "pminsw"      , 3, I(I32)                               ),
-  ROW(Pminuw    , "pminuw"      , 3, I(I32)                               ),
-  ROW(Pminsd    , "pminsd"      , 3, I(I32)                               ),
-  ROW(Pminud    , "pminud"      , 3, I(I32)                               ),
-  ROW(Pmaxsb    , "pmaxsb"      , 3, I(I32)                               ),
-  ROW(Pmaxub    , "pmaxub"      , 3, I(I32)                               ),
-  ROW(Pmaxsw    , "pmaxsw"      , 3, I(I32)                               ),
-  ROW(Pmaxuw    , "pmaxuw"      , 3, I(I32)                               ),
-  ROW(Pmaxsd    , "pmaxsd"      , 3, I(I32)                               ),
-  ROW(Pmaxud    , "pmaxud"      , 3, I(I32)                               ),
+  ROW(Pminsb    , "pminsb"      , 3, I(I32) | I(Commutative)              ),
+  ROW(Pminub    , "pminub"      , 3, I(I32) | I(Commutative)              ),
+  ROW(Pminsw    , "pminsw"      , 3, I(I32) | I(Commutative)              ),
+  ROW(Pminuw    , "pminuw"      , 3, I(I32) | I(Commutative)              ),
+  ROW(Pminsd    , "pminsd"      , 3, I(I32) | I(Commutative)              ),
+  ROW(Pminud    , "pminud"      , 3, I(I32) | I(Commutative)              ),
+  ROW(Pmaxsb    , "pmaxsb"      , 3, I(I32) | I(Commutative)              ),
+  ROW(Pmaxub    , "pmaxub"      , 3, I(I32) | I(Commutative)              ),
+  ROW(Pmaxsw    , "pmaxsw"      , 3, I(I32) | I(Commutative)              ),
+  ROW(Pmaxuw    , "pmaxuw"      , 3, I(I32) | I(Commutative)              ),
+  ROW(Pmaxsd    , "pmaxsd"      , 3, I(I32) | I(Commutative)              ),
+  ROW(Pmaxud    , "pmaxud"      , 3, I(I32) | I(Commutative)              ),
   ROW(Psllw     , "psllw"       , 3, I(I32)                       | I(Imm)),
   ROW(Psrlw     , "psrlw"       , 3, I(I32)                       | I(Imm)),
   ROW(Psraw     , "psraw"       , 3, I(I32)                       | I(Imm)),
@@ -477,13 +481,25 @@ const InstInfo mpInstInfo[kInstCodeCount] = {
   ROW(Psrad     , "psrad"       , 3, I(I32)                       | I(Imm)),
   ROW(Psllq     , "psllq"       , 3, I(I32)                       | I(Imm)),
   ROW(Psrlq     , "psrlq"       , 3, I(I32)                       | I(Imm)),
-  ROW(Pmaddwd   , "pmaddwd"     , 3, I(I32)                               ),
-  ROW(Pcmpeqb   , "pcmpeqb"     , 3, I(I32)                               ),
-  ROW(Pcmpeqw   , "pcmpeqw"     , 3, I(I32)                               ),
-  ROW(Pcmpeqd   , "pcmpeqd"     , 3, I(I32)                               ),
+  ROW(Pmaddwd   , "pmaddwd"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Pcmpeqb   , "pcmpeqb"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Pcmpeqw   , "pcmpeqw"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Pcmpeqd   , "pcmpeqd"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Pcmpneb   , "pcmpneb"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Pcmpnew   , "pcmpnew"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Pcmpned   , "pcmpned"     , 3, I(I32) | I(Commutative)              ),
+  ROW(Pcmpltb   , "pcmpltb"     , 3, I(I32)                               ),
+  ROW(Pcmpltw   , "pcmpltw"     , 3, I(I32)                               ),
+  ROW(Pcmpltd   , "pcmpltd"     , 3, I(I32)                               ),
+  ROW(Pcmpleb   , "pcmpleb"     , 3, I(I32)                               ),
+  ROW(Pcmplew   , "pcmplew"     , 3, I(I32)                               ),
+  ROW(Pcmpled   , "pcmpled"     , 3, I(I32)                               ),
   ROW(Pcmpgtb   , "pcmpgtb"     , 3, I(I32)                               ),
   ROW(Pcmpgtw   , "pcmpgtw"     , 3, I(I32)                               ),
-  ROW(Pcmpgtd   , "pcmpgtd"     , 3, I(I32)                               )
+  ROW(Pcmpgtd   , "pcmpgtd"     , 3, I(I32)                               ),
+  ROW(Pcmpgeb   , "pcmpgeb"     , 3, I(I32)                               ),
+  ROW(Pcmpgew   , "pcmpgew"     , 3, I(I32)                               ),
+  ROW(Pcmpged   , "pcmpged"     , 3, I(I32)                               )
 };
 #undef I
 #undef ROW
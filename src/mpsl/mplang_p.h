@@ -290,8 +290,10 @@ enum InstCode {
 
   kInstCodeJmp,
   kInstCodeJnz,
+  kInstCodeJany,
   kInstCodeCall,
   kInstCodeRet,
+  kInstCodePhi,
 
   kInstCodeFetch32,
   kInstCodeFetch64,
@@ -407,6 +409,7 @@ enum InstCode {
   kInstCodeXori,
   kInstCodeXorf,
   kInstCodeXord,
+  kInstCodeBlend,
   kInstCodeMinf,
   kInstCodeMind,
   kInstCodeMaxf,
@@ -464,6 +467,7 @@ enum InstCode {
   kInstCodePmulw,
   kInstCodePmulhsw,
   kInstCodePmulhuw,
+  kInstCodePmulhsd,
   kInstCodePmuld,
   kInstCodePdivsd,
   kInstCodePmodsd,
@@ -530,19 +534,21 @@ enum InstCode {
 //!
 //! Instruction flags.
 enum InstFlags {
-  kInstInfoI32     = 0x0001, //!< Works with I32 operand(s).
-  kInstInfoF32     = 0x0002, //!< Works with F32 operand(s).
-  kInstInfoF64     = 0x0004, //!< Works with F64 operand(s).
-  kInstInfoSIMD    = 0x0008, //!< Requires SIMD registers, doesn't work on GP.
-  kInstInfoFetch   = 0x0010,
-  kInstInfoStore   = 0x0020,
-  kInstInfoMov     = 0x0040,
-  kInstInfoCvt     = 0x0080,
-  kInstInfoJxx     = 0x0100,
-  kInstInfoRet     = 0x0200,
-  kInstInfoCall    = 0x0400,
-  kInstInfoImm     = 0x0800,
-  kInstInfoComplex = 0x8000
+  kInstInfoI32         = 0x0001, //!< Works with I32 operand(s).
+  kInstInfoF32         = 0x0002, //!< Works with F32 operand(s).
+  kInstInfoF64         = 0x0004, //!< Works with F64 operand(s).
+  kInstInfoSIMD        = 0x0008, //!< Requires SIMD registers, doesn't work on GP.
+  kInstInfoFetch       = 0x0010,
+  kInstInfoStore       = 0x0020,
+  kInstInfoMov         = 0x0040,
+  kInstInfoCvt         = 0x0080,
+  kInstInfoJxx         = 0x0100,
+  kInstInfoRet         = 0x0200,
+  kInstInfoCall        = 0x0400,
+  kInstInfoImm         = 0x0800,
+  kInstInfoPhi         = 0x1000, //!< SSA phi, only exists between SSA construction and destruction.
+  kInstInfoCommutative = 0x2000, //!< Both sources can be swapped without changing the result.
+  kInstInfoComplex     = 0x8000
 };
 
 // ============================================================================
@@ -580,6 +586,13 @@ struct TypeInfo {
     return sizeOf(typeInfo & kTypeIdMask) * elementsOf(typeInfo);
   }
 
+  //! Get whether types `a` and `b` have the same count and size of lanes, so
+  //! a mask of one of them can select lanes of the other.
+  static MPSL_INLINE bool isSameLaneShape(uint32_t a, uint32_t b) noexcept {
+    return (a & kTypeVecMask) == (b & kTypeVecMask) &&
+           sizeOf(a & kTypeIdMask) == sizeOf(b & kTypeIdMask);
+  }
+
   static MPSL_INLINE bool isBoolId(uint32_t typeId) noexcept { return (get(typeId)._flags & kTypeFlagBool) != 0; }
   static MPSL_INLINE bool isBoolType(uint32_t ti) noexcept { return isBoolId(ti & kTypeIdMask); }
 
@@ -764,7 +777,9 @@ struct InstInfo {
   MPSL_INLINE bool isJxx() const noexcept { return (_flags & kInstInfoJxx) != 0; }
   MPSL_INLINE bool isRet() const noexcept { return (_flags & kInstInfoRet) != 0; }
   MPSL_INLINE bool isCall() const noexcept { return (_flags & kInstInfoCall) != 0; }
+  MPSL_INLINE bool isPhi() const noexcept { return (_flags & kInstInfoPhi) != 0; }
   MPSL_INLINE bool isComplex() const noexcept { return (_flags & kInstInfoComplex) != 0; }
+  MPSL_INLINE bool isCommutative() const noexcept { return (_flags & kInstInfoCommutative) != 0; }
 
   MPSL_INLINE bool hasImm() const noexcept { return (_flags & kInstInfoImm) != 0; }
 
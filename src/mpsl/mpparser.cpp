@@ -458,7 +458,11 @@ Error Parser::parseVarDecl(AstBlock* block) noexcept {
 
     str.set(_tokenizer._start + token.position(), token.size());
     if ((vSym = scope->resolveSymbol(str, token.hashCode(), &vScope)) != nullptr) {
-      if (!vSym->isVariable() || scope == vScope)
+      // Global variables can't shadow built-ins, which are in a parent scope.
+      bool isRedefinition = scope == vScope ||
+        (scope->scopeType() == AstScope::kTypeGlobal && vScope->scopeType() == AstScope::kTypeGlobal);
+
+      if (!vSym->isVariable() || isRedefinition)
         MPSL_PARSER_ERROR(token, "Attempt to redefine %{SymbolType} '%s'.", vSym->symbolType(), vSym->name());
 
       if (vSym->node()) {
@@ -573,8 +577,10 @@ Error Parser::parseIfElse(AstBlock* block) noexcept {
       position = token.positionAsUInt();
       if (_tokenizer.consumeAndPeek(&token) == kTokenIf) {
         // Parse "else if ...".
-        MPSL_NULLCHECK_(branch = _ast->newNode<AstBranch>(), { _ast->deleteNode(first); });
-        branch->setElseBody(branch);
+        AstBranch* elseIf;
+        MPSL_NULLCHECK_(elseIf = _ast->newNode<AstBranch>(), { _ast->deleteNode(first); });
+        branch->setElseBody(elseIf);
+        branch = elseIf;
 
         // Parse the '(' token.
         if (_tokenizer.consumeAndNext(&token) != kTokenLParen) {
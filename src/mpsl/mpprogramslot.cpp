@@ -0,0 +1,305 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define MPSL_EXPORTS
+
+// [Dependencies - MPSL]
+#include "./mpatomic_p.h"
+#include "./mpprogramslot_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// Declared in public "mpsl.h" header.
+MPSL_INLINE void ProgramSlot::Impl::destroy() noexcept {
+  ProgramSlotData* data = static_cast<ProgramSlotData*>(_slotData);
+
+  data->~ProgramSlotData();
+  ::free(data);
+  ::free(this);
+}
+
+// ============================================================================
+// [mpsl::ProgramSlotData - Construction / Destruction]
+// ============================================================================
+
+ProgramSlotData::ProgramSlotData() noexcept
+  : _current(nullptr),
+    _epoch(1),
+    _readers(nullptr),
+    _retired(nullptr),
+    _retiredCount(0) {}
+
+ProgramSlotData::~ProgramSlotData() noexcept {
+  // Readers keep the slot alive, there is nobody that could run a version.
+  ProgramSlotVersion* version = _retired;
+  while (version) {
+    ProgramSlotVersion* next = version->next;
+    version->~ProgramSlotVersion();
+    ::free(version);
+    version = next;
+  }
+
+  if (_current) {
+    _current->~ProgramSlotVersion();
+    ::free(_current);
+  }
+}
+
+// ============================================================================
+// [mpsl::ProgramSlotData - Interface]
+// ============================================================================
+
+ProgramSlotRecord* ProgramSlotData::addReader() noexcept {
+  ProgramSlotRecord* record = static_cast<ProgramSlotRecord*>(::malloc(sizeof(ProgramSlotRecord)));
+  if (record == nullptr)
+    return nullptr;
+
+  record->epoch = 0;
+  record->prev = nullptr;
+
+  ScopedLock lock(_mutex);
+  record->next = _readers;
+
+  if (_readers)
+    _readers->prev = record;
+  _readers = record;
+
+  return record;
+}
+
+void ProgramSlotData::removeReader(ProgramSlotRecord* record) noexcept {
+  {
+    ScopedLock lock(_mutex);
+
+    if (record->prev)
+      record->prev->next = record->next;
+    else
+      _readers = record->next;
+
+    if (record->next)
+      record->next->prev = record->prev;
+  }
+
+  ::free(record);
+}
+
+Error ProgramSlotData::publish(const Program& program) noexcept {
+  void* p = ::malloc(sizeof(ProgramSlotVersion));
+  MPSL_NULLCHECK(p);
+
+  ProgramSlotVersion* version = new(p) ProgramSlotVersion(program);
+  ScopedLock lock(_mutex);
+
+  ProgramSlotVersion* old = _current;
+  mpAtomicSetReleaseT<ProgramSlotVersion*>(&_current, version);
+
+  // Readers that announce the new epoch load the new version.
+  uintptr_t epoch = _epoch + 1;
+  mpAtomicSetRelease(&_epoch, epoch);
+
+  if (old) {
+    old->retireEpoch = epoch;
+    old->next = _retired;
+
+    _retired = old;
+    _retiredCount++;
+  }
+
+  _reclaim();
+  return kErrorOk;
+}
+
+void ProgramSlotData::reclaim() noexcept {
+  ScopedLock lock(_mutex);
+  _reclaim();
+}
+
+size_t ProgramSlotData::retiredCount() noexcept {
+  ScopedLock lock(_mutex);
+  return _retiredCount;
+}
+
+// ============================================================================
+// [mpsl::ProgramSlotData - Internal]
+// ============================================================================
+
+void ProgramSlotData::_reclaim() noexcept {
+  if (_retired == nullptr)
+    return;
+
+  // Pairs with the barrier in `enter()`, a reader that isn't seen here loads
+  // the current version.
+  mpAtomicFence();
+
+  // The oldest epoch that is announced by a reader, versions retired in that
+  // epoch or before can't be run anymore.
+  uintptr_t minEpoch = ~static_cast<uintptr_t>(0);
+  for (ProgramSlotRecord* record = _readers; record; record = record->next) {
+    uintptr_t epoch = mpAtomicGetAcquire(&record->epoch);
+    if (epoch != 0 && epoch < minEpoch)
+      minEpoch = epoch;
+  }
+
+  ProgramSlotVersion** pPrev = &_retired;
+  ProgramSlotVersion* version = _retired;
+
+  while (version) {
+    ProgramSlotVersion* next = version->next;
+    if (version->retireEpoch <= minEpoch) {
+      *pPrev = next;
+      _retiredCount--;
+
+      version->~ProgramSlotVersion();
+      ::free(version);
+    }
+    else {
+      pPrev = &version->next;
+    }
+    version = next;
+  }
+}
+
+// ============================================================================
+// [mpsl::ProgramSlot - Construction / Destruction]
+// ============================================================================
+
+static const ProgramSlot::Impl mpProgramSlotNull = { 0, nullptr };
+
+ProgramSlot::ProgramSlot() noexcept
+  : _d(const_cast<Impl*>(&mpProgramSlotNull)) {}
+
+ProgramSlot::ProgramSlot(const ProgramSlot& other) noexcept
+  : _d(mpObjectAddRef(other._d)) {}
+
+ProgramSlot::~ProgramSlot() noexcept {
+  mpObjectRelease(_d);
+}
+
+ProgramSlot ProgramSlot::create() noexcept {
+  Impl* d = static_cast<Impl*>(::malloc(sizeof(Impl)));
+  void* p = ::malloc(sizeof(ProgramSlotData));
+
+  if (d == nullptr || p == nullptr) {
+    ::free(d);
+    ::free(p);
+    return ProgramSlot();
+  }
+
+  d->_refCount = 1;
+  d->_slotData = new(p) ProgramSlotData();
+  return ProgramSlot(d);
+}
+
+// ============================================================================
+// [mpsl::ProgramSlot - Reset]
+// ============================================================================
+
+Error ProgramSlot::reset() noexcept {
+  mpObjectRelease(mpAtomicSetXchgT<Impl*>(
+    &_d, const_cast<Impl*>(&mpProgramSlotNull)));
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::ProgramSlot - Accessors]
+// ============================================================================
+
+size_t ProgramSlot::retiredCount() const noexcept {
+  if (!isValid())
+    return 0;
+
+  return static_cast<ProgramSlotData*>(_d->_slotData)->retiredCount();
+}
+
+// ============================================================================
+// [mpsl::ProgramSlot - Interface]
+// ============================================================================
+
+Error ProgramSlot::publish(const Program& program) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  if (!program.isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  return static_cast<ProgramSlotData*>(_d->_slotData)->publish(program);
+}
+
+Error ProgramSlot::reclaim() noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  static_cast<ProgramSlotData*>(_d->_slotData)->reclaim();
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::ProgramSlot - Operator Overload]
+// ============================================================================
+
+ProgramSlot& ProgramSlot::operator=(const ProgramSlot& other) noexcept {
+  mpObjectRelease(
+    mpAtomicSetXchgT<Impl*>(
+      &_d, mpObjectAddRef(other._d)));
+
+  return *this;
+}
+
+// ============================================================================
+// [mpsl::ProgramSlotReaderBase - Construction / Destruction]
+// ============================================================================
+
+ProgramSlotReaderBase::ProgramSlotReaderBase(const ProgramSlot& slot) noexcept
+  : _slot(slot),
+    _readerData(nullptr) {
+
+  if (slot.isValid())
+    _readerData = static_cast<ProgramSlotData*>(slot._d->_slotData)->addReader();
+}
+
+ProgramSlotReaderBase::~ProgramSlotReaderBase() noexcept {
+  if (_readerData)
+    static_cast<ProgramSlotData*>(_slot._d->_slotData)->removeReader(
+      static_cast<ProgramSlotRecord*>(_readerData));
+}
+
+// ============================================================================
+// [mpsl::ProgramSlotReaderBase - Interface]
+// ============================================================================
+
+void ProgramSlotReaderBase::_enter(Program& program) noexcept {
+  if (_readerData == nullptr)
+    return;
+
+  ProgramSlotData* data = static_cast<ProgramSlotData*>(_slot._d->_slotData);
+  ProgramSlotVersion* version = data->enter(static_cast<ProgramSlotRecord*>(_readerData));
+
+  // Borrowed, the version holds the reference until it's reclaimed.
+  if (version)
+    program._d = version->program._d;
+}
+
+void ProgramSlotReaderBase::_leave(Program& program) noexcept {
+  if (_readerData == nullptr)
+    return;
+
+  ProgramSlotData* data = static_cast<ProgramSlotData*>(_slot._d->_slotData);
+  data->leave(static_cast<ProgramSlotRecord*>(_readerData));
+
+  // Swap the borrowed program with a null one, which has no reference count.
+  Program null;
+  program._d = null._d;
+}
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
@@ -0,0 +1,144 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _MPSL_MPPROGRAMSLOT_P_H
+#define _MPSL_MPPROGRAMSLOT_P_H
+
+// [Dependencies - MPSL]
+#include "./mpatomic_p.h"
+#include "./mpsl_p.h"
+#include "./mpthread_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::ProgramSlotVersion]
+// ============================================================================
+
+//! \internal
+//!
+//! A program published to a `ProgramSlot`.
+struct ProgramSlotVersion {
+  MPSL_INLINE explicit ProgramSlotVersion(const Program& program) noexcept
+    : next(nullptr),
+      retireEpoch(0),
+      program(program) {}
+
+  ProgramSlotVersion* next;              //!< Next retired version.
+  uintptr_t retireEpoch;                 //!< First epoch that can't see this version.
+  Program program;                       //!< Program (holds a reference).
+};
+
+// ============================================================================
+// [mpsl::ProgramSlotRecord]
+// ============================================================================
+
+//! \internal
+//!
+//! Epoch announced by a single reader.
+//!
+//! The epoch is only written by its reader and only read by writers, it's
+//! padded so readers of the same slot don't share a cache line.
+struct ProgramSlotRecord {
+  enum { kCacheLineSize = 64 };
+
+  uint8_t _padding0[kCacheLineSize];
+  uintptr_t epoch;                       //!< Epoch seen by `enter()`, zero if quiescent.
+  ProgramSlotRecord* prev;               //!< Previous record.
+  ProgramSlotRecord* next;               //!< Next record.
+  uint8_t _padding1[kCacheLineSize];
+};
+
+// ============================================================================
+// [mpsl::ProgramSlotData]
+// ============================================================================
+
+//! \internal
+//!
+//! Versions and readers of a `ProgramSlot`.
+//!
+//! A reader announces the current epoch before it loads the current version
+//! and a writer advances the epoch after it replaces the current version, so
+//! a reader that announced an epoch newer than the one a version was retired
+//! in can't run it. Both sides use a full barrier between the store and the
+//! load, which guarantees that either the reader sees the new version, or
+//! the writer sees the epoch of the reader.
+class ProgramSlotData {
+public:
+  MPSL_NONCOPYABLE(ProgramSlotData)
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ProgramSlotData() noexcept;
+  ~ProgramSlotData() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Register a new reader, returns null if out of memory.
+  ProgramSlotRecord* addReader() noexcept;
+  //! Unregister `record`, which must be quiescent.
+  void removeReader(ProgramSlotRecord* record) noexcept;
+
+  //! Announce `record` and get the current version (can be null).
+  MPSL_INLINE ProgramSlotVersion* enter(ProgramSlotRecord* record) noexcept;
+  //! Make `record` quiescent.
+  MPSL_INLINE void leave(ProgramSlotRecord* record) noexcept;
+
+  Error publish(const Program& program) noexcept;
+  void reclaim() noexcept;
+  size_t retiredCount() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  //! Called with `_mutex` locked.
+  void _reclaim() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  ProgramSlotVersion* _current;          //!< Current version, loaded by readers.
+  uintptr_t _epoch;                      //!< Current epoch, loaded by readers.
+
+  Mutex _mutex;                          //!< Guards everything below (writers only).
+  ProgramSlotRecord* _readers;           //!< Registered readers.
+  ProgramSlotVersion* _retired;          //!< Retired versions (newest first).
+  size_t _retiredCount;                  //!< Count of retired versions.
+};
+
+// ============================================================================
+// [mpsl::ProgramSlotData - Read-Side]
+// ============================================================================
+
+MPSL_INLINE ProgramSlotVersion* ProgramSlotData::enter(ProgramSlotRecord* record) noexcept {
+  // Only the reader writes its record, a plain store followed by a barrier is
+  // enough, there is no read-modify-write on the read-side.
+  mpAtomicSet(&record->epoch, mpAtomicGetAcquire(&_epoch));
+  mpAtomicFence();
+  return mpAtomicGetAcquireT<ProgramSlotVersion*>(&_current);
+}
+
+MPSL_INLINE void ProgramSlotData::leave(ProgramSlotRecord* record) noexcept {
+  mpAtomicSetRelease(&record->epoch, 0);
+}
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
+
+// [Guard]
+#endif // _MPSL_MPPROGRAMSLOT_P_H
@@ -0,0 +1,99 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _MPSL_MPRUNTIME_P_H
+#define _MPSL_MPRUNTIME_P_H
+
+// [Dependencies - MPSL]
+#include "./mpsl_p.h"
+#include "./mpthread_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::RuntimeData]
+// ============================================================================
+
+//! \internal
+//!
+//! JIT runtime shared by a `Context`, its clones, and all programs compiled
+//! by them.
+//!
+//! Compilations that use the same runtime run concurrently, only operations
+//! on its executable memory (adding and releasing code) are serialized by
+//! `_lock`, which is held for a memcpy of the code at most.
+class RuntimeData {
+public:
+  MPSL_NONCOPYABLE(RuntimeData)
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  MPSL_INLINE RuntimeData() noexcept
+    : _refCount(1),
+      _runtime() {}
+  MPSL_INLINE ~RuntimeData() noexcept {}
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  MPSL_INLINE void destroy() noexcept {
+    this->~RuntimeData();
+    ::free(this);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  MPSL_INLINE asmjit::JitRuntime* runtime() const noexcept {
+    return const_cast<asmjit::JitRuntime*>(&_runtime);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Code]
+  // --------------------------------------------------------------------------
+
+  //! Relocate and copy the finalized `code` into executable memory.
+  MPSL_INLINE asmjit::Error add(void** func, asmjit::CodeHolder* code) noexcept {
+    ScopedLock lock(_lock);
+    return _runtime.add(func, code);
+  }
+
+  //! Allocate executable memory of `size` bytes, `rw` is its writable view.
+  MPSL_INLINE asmjit::Error alloc(void** rx, void** rw, size_t size) noexcept {
+    ScopedLock lock(_lock);
+    return _runtime.allocator()->alloc(rx, rw, size);
+  }
+
+  //! Release code returned by `add()` or `alloc()`.
+  MPSL_INLINE void release(void* func) noexcept {
+    ScopedLock lock(_lock);
+    _runtime.release(func);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uintptr_t _refCount;                   //!< Reference count.
+  Mutex _lock;                           //!< Serializes `add()`, `alloc()`, and `release()`.
+  asmjit::JitRuntime _runtime;           //!< JIT runtime.
+};
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
+
+// [Guard]
+#endif // _MPSL_MPRUNTIME_P_H
@@ -10,14 +10,21 @@
 // [Dependencies - MPSL]
 #include "./mpast_p.h"
 #include "./mpastoptimizer_p.h"
+#include "./mpcache_p.h"
 #include "./mpcodegen_p.h"
+#include "./mpcompilequeue_p.h"
 #include "./mpatomic_p.h"
+#include "./mpexecutor_p.h"
 #include "./mpformatutils_p.h"
 #include "./mpir_p.h"
 #include "./mpirpass_p.h"
+#include "./mpirssa_p.h"
 #include "./mpirtox86_p.h"
 #include "./mplang_p.h"
 #include "./mpparser_p.h"
+#include "./mpruntime_p.h"
+#include "./mpuniforms_p.h"
+#include "./mpworkspace_p.h"
 
 // [Api-Begin]
 #include "./mpsl_apibegin.h"
@@ -41,36 +48,31 @@ Error mpTraceError(Error error) noexcept {
   return error;
 }
 
-// ============================================================================
-// [mpsl::Helpers]
-// ============================================================================
-
-template<typename T>
-MPSL_INLINE T* mpObjectAddRef(T* self) noexcept {
-  if (self->_refCount == 0)
-    return self;
-
-  mpAtomicInc(&self->_refCount);
-  return self;
-}
-
-template<typename T>
-MPSL_INLINE void mpObjectRelease(T* self) noexcept {
-  if (self->_refCount != 0 && !mpAtomicDec(&self->_refCount))
-    self->destroy();
-}
-
 // Declared in public "mpsl.h" header.
 MPSL_INLINE void Context::Impl::destroy() noexcept {
   RuntimeData* rt = static_cast<RuntimeData*>(_runtimeData);
 
+  // Has to be first, background compilations use everything else.
+  mpCompileQueueDestroy(_queueData);
+  mpProgramCacheDestroy(_cacheData);
+  mpCompileWorkspacePoolDestroy(_workspaceData);
+  mpExecutorRelease(_executorData);
+  mpObjectRelease(static_cast<AstBuiltIns*>(_builtInsData));
   mpObjectRelease(rt);
   ::free(this);
 }
 
 MPSL_INLINE void Program::Impl::destroy() noexcept {
   RuntimeData* rt = static_cast<RuntimeData*>(_runtimeData);
-  rt->_runtime.release(_main);
+
+  // `_main` of a tiered program can point to its optimized program.
+  if (_tierData)
+    static_cast<ProgramTier*>(_tierData)->destroy(rt);
+  else
+    rt->release(_main);
+
+  if (_uniformData)
+    mpObjectRelease(static_cast<ProgramUniforms*>(_uniformData));
 
   mpObjectRelease(rt);
   ::free(this);
@@ -88,19 +90,28 @@ static MPSL_INLINE uint32_t mpLayoutGetRemainingSize(const Layout* self) noexcep
   return self->_dataIndex - static_cast<uint32_t>(self->_membersCount * sizeof(Layout::Member));
 }
 
-static MPSL_INLINE Layout::Member* mpLayoutFind(
-  const Layout* self, const char* name, size_t size) noexcept {
-
-  Layout::Member* m = self->_members;
-  uint32_t count = self->_membersCount;
+const Layout::Member* mpLayoutFind(const Layout* self, const char* name, size_t size, uint32_t hashCode) noexcept {
+  const Layout::Member* members = self->_members;
+  uint32_t index = self->_buckets[hashCode % Layout::kBucketsCount];
 
-  for (uint32_t i = 0; i < count; i++)
-    if (m[i].nameSize == size && (size == 0 || ::memcmp(m[i].name, name, size) == 0))
-      return &m[i];
+  while (index != 0) {
+    const Layout::Member* m = &members[index - 1];
+    if (m->hashCode == hashCode && m->nameSize == size && (size == 0 || ::memcmp(m->name, name, size) == 0))
+      return m;
+    index = m->hashNext;
+  }
 
   return nullptr;
 }
 
+//! \internal
+//!
+//! Get an index of a `Value` that ends at `dataIndex`, aligned to 8 bytes.
+static MPSL_INLINE uint32_t mpLayoutValueIndex(const uint8_t* data, uint32_t dataIndex) noexcept {
+  uintptr_t p = reinterpret_cast<uintptr_t>(data + dataIndex - sizeof(Value));
+  return dataIndex - static_cast<uint32_t>(sizeof(Value)) - static_cast<uint32_t>(p & 7);
+}
+
 static MPSL_NOINLINE Error mpLayoutResize(Layout* self, uint32_t dataSize) noexcept {
   uint8_t* oldData = self->_data;
   uint8_t* newData = static_cast<uint8_t*>(::malloc(dataSize));
@@ -134,6 +145,17 @@ static MPSL_NOINLINE Error mpLayoutResize(Layout* self, uint32_t dataSize) noexc
     newMember->name = reinterpret_cast<char*>(newData + dataIndex);
     newMember->typeInfo = oldMember->typeInfo;
     newMember->offset = oldMember->offset;
+    newMember->hashCode = oldMember->hashCode;
+    newMember->hashNext = oldMember->hashNext;
+    newMember->value = nullptr;
+
+    if (oldMember->value) {
+      dataIndex = mpLayoutValueIndex(newData, dataIndex);
+      MPSL_ASSERT(dataIndex >= (i + 1) * sizeof(Layout::Member));
+
+      ::memcpy(newData + dataIndex, oldMember->value, sizeof(Value));
+      newMember->value = reinterpret_cast<Value*>(newData + dataIndex);
+    }
   }
 
   self->_data = newData;
@@ -160,6 +182,40 @@ static MPSL_INLINE Error mpLayoutPrepareAdd(Layout* self, size_t n) noexcept {
   return kErrorOk;
 }
 
+Error mpLayoutCopy(Layout* dst, const Layout* src) noexcept {
+  if (src->hasName())
+    MPSL_PROPAGATE(dst->_configure(src->name(), src->nameSize()));
+
+  const Layout::Member* members = src->membersArray();
+  uint32_t count = src->membersCount();
+
+  // Members are added in the same order, so the copy has the same cache key.
+  for (uint32_t i = 0; i < count; i++) {
+    const Layout::Member& m = members[i];
+    if (m.isUniform())
+      MPSL_PROPAGATE(dst->_addUniform(m.name, m.nameSize, m.typeInfo & ~kTypeUniform, *m.value));
+    else if (m.value)
+      MPSL_PROPAGATE(dst->_addConst(m.name, m.nameSize, m.typeInfo, *m.value));
+    else
+      MPSL_PROPAGATE(dst->_add(m.name, m.nameSize, m.typeInfo, m.offset));
+  }
+
+  dst->_flags = src->_flags;
+  return kErrorOk;
+}
+
+uint32_t mpLayoutUniformsSize(const Layout* layout) noexcept {
+  const Layout::Member* members = layout->membersArray();
+  uint32_t count = layout->membersCount();
+  uint32_t size = 0;
+
+  for (uint32_t i = 0; i < count; i++)
+    if (members[i].isUniform())
+      size += static_cast<uint32_t>(sizeof(Value));
+
+  return size;
+}
+
 // ============================================================================
 // [mpsl::Layout - Construction / Destruction]
 // ============================================================================
@@ -169,16 +225,22 @@ Layout::Layout() noexcept
     _name(nullptr),
     _nameSize(0),
     _membersCount(0),
+    _flags(0),
     _dataSize(0),
-    _dataIndex(0) {}
+    _dataIndex(0) {
+  ::memset(_buckets, 0, sizeof(_buckets));
+}
 
 Layout::Layout(uint8_t* data, uint32_t dataSize) noexcept
   : _data(data),
     _name(nullptr),
     _nameSize(0),
     _membersCount(0),
+    _flags(0),
     _dataSize(dataSize),
-    _dataIndex(dataSize) {}
+    _dataIndex(dataSize) {
+  ::memset(_buckets, 0, sizeof(_buckets));
+}
 
 Layout::~Layout() noexcept {
   uint8_t* data = _data;
@@ -223,10 +285,10 @@ const Layout::Member* Layout::_get(const char* name, size_t size) const noexcept
   if (size == Globals::kInvalidIndex)
     size = ::strlen(name);
 
-  return mpLayoutFind(this, name, size);
+  return mpLayoutFind(this, name, size, HashUtils::hashString(name, size));
 }
 
-Error Layout::_add(const char* name, size_t size, uint32_t typeInfo, int32_t offset) noexcept {
+static Error mpLayoutAdd(Layout* self, const char* name, size_t size, uint32_t typeInfo, int32_t offset, const Value* value) noexcept {
   if (name == nullptr)
     return MPSL_TRACE_ERROR(kErrorInvalidArgument);
 
@@ -236,34 +298,92 @@ Error Layout::_add(const char* name, size_t size, uint32_t typeInfo, int32_t off
   if (size > Globals::kMaxIdentifierLength)
     return MPSL_TRACE_ERROR(kErrorInvalidArgument);
 
-  uint32_t count = _membersCount;
+  uint32_t count = self->_membersCount;
   if (count >= Globals::kMaxMembersCount)
     return MPSL_TRACE_ERROR(kErrorTooManyMembers);
 
-  Member* member = mpLayoutFind(this, name, size);
-  if (member)
+  uint32_t hashCode = HashUtils::hashString(name, size);
+  if (mpLayoutFind(self, name, size, hashCode))
     return MPSL_TRACE_ERROR(kErrorAlreadyExists);
 
-  MPSL_PROPAGATE(mpLayoutPrepareAdd(this, size + 1 + static_cast<uint32_t>(sizeof(Member))));
-  member = _members + count;
-  uint32_t dataIndex = _dataIndex - (static_cast<uint32_t>(size) + 1);
+  // The value requires up to 7 more bytes to be aligned.
+  size_t valueSize = value ? sizeof(Value) + 7 : size_t(0);
+  MPSL_PROPAGATE(mpLayoutPrepareAdd(self, size + 1 + valueSize + static_cast<uint32_t>(sizeof(Layout::Member))));
+
+  Layout::Member* member = self->_members + count;
+  uint16_t& bucket = self->_buckets[hashCode % Layout::kBucketsCount];
+  uint32_t dataIndex = self->_dataIndex - (static_cast<uint32_t>(size) + 1);
 
-  ::memcpy(_data + dataIndex, name, size + 1);
-  member->name = reinterpret_cast<char*>(_data + dataIndex);
+  ::memcpy(self->_data + dataIndex, name, size + 1);
+  member->name = reinterpret_cast<char*>(self->_data + dataIndex);
   member->nameSize = static_cast<uint32_t>(size);
   member->typeInfo = typeInfo;
   member->offset = offset;
+  member->hashCode = hashCode;
+  member->hashNext = bucket;
+  member->value = nullptr;
+
+  if (value) {
+    dataIndex = mpLayoutValueIndex(self->_data, dataIndex);
+    ::memcpy(self->_data + dataIndex, value, sizeof(Value));
+    member->value = reinterpret_cast<Value*>(self->_data + dataIndex);
+  }
 
-  _membersCount++;
-  _dataIndex = dataIndex;
+  // Members are never removed, so the index of the member is stable.
+  bucket = static_cast<uint16_t>(count + 1);
+  self->_membersCount++;
+  self->_dataIndex = dataIndex;
   return kErrorOk;
 }
 
+Error Layout::_add(const char* name, size_t size, uint32_t typeInfo, int32_t offset) noexcept {
+  if ((typeInfo & kTypeUniform) != 0)
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  return mpLayoutAdd(this, name, size, typeInfo, offset, nullptr);
+}
+
+//! \internal
+//!
+//! Check whether a member of `typeInfo` and `name` can be a constant or a
+//! uniform and get `value` without bytes that are not used by the type.
+static Error mpLayoutPrepareValue(Value& dst, const char* name, size_t size, uint32_t typeInfo, const Value& value) noexcept {
+  // They can only be read, hidden members like `@ret` can't be constant.
+  if ((typeInfo & (kTypeWrite | kTypeUniform)) != 0 || (name != nullptr && size != 0 && name[0] == '@'))
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  uint32_t typeId = typeInfo & kTypeIdMask;
+  if (typeId == kTypeVoid || typeId >= kTypeCount || TypeInfo::isPtrId(typeId))
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  // Only the bytes used by the type are kept, so unused lanes of `value`
+  // don't change the cache key.
+  dst.zero();
+  ::memcpy(&dst, &value, TypeInfo::widthOf(typeInfo));
+  return kErrorOk;
+}
+
+Error Layout::_addConst(const char* name, size_t size, uint32_t typeInfo, const Value& value) noexcept {
+  Value v;
+  MPSL_PROPAGATE(mpLayoutPrepareValue(v, name, size, typeInfo, value));
+
+  return mpLayoutAdd(this, name, size, typeInfo | kTypeRead, 0, &v);
+}
+
+Error Layout::_addUniform(const char* name, size_t size, uint32_t typeInfo, const Value& value) noexcept {
+  Value v;
+  MPSL_PROPAGATE(mpLayoutPrepareValue(v, name, size, typeInfo, value));
+
+  // The offset is relative to uniforms of this layout, see `ProgramUniforms`.
+  int32_t offset = static_cast<int32_t>(mpLayoutUniformsSize(this));
+  return mpLayoutAdd(this, name, size, typeInfo | kTypeRead | kTypeUniform, offset, &v);
+}
+
 // ============================================================================
 // [mpsl::Context - Construction / Destruction]
 // ============================================================================
 
-static const Context::Impl mpContextNull = { 0, nullptr };
+static const Context::Impl mpContextNull = { 0, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, 0 };
 
 Context::Context() noexcept
   : _d(const_cast<Impl*>(&mpContextNull)) {}
@@ -284,14 +404,30 @@ Context Context::create() noexcept {
   }
   else {
     RuntimeData* rt = static_cast<RuntimeData*>(::malloc(sizeof(RuntimeData)));
-    if (rt == nullptr) {
+    void* cacheData = mpProgramCacheCreate();
+    void* workspaceData = mpCompileWorkspacePoolCreate();
+    void* queueData = mpCompileQueueCreate(d);
+    AstBuiltIns* builtIns = AstBuiltIns::create();
+
+    if (rt == nullptr || cacheData == nullptr || workspaceData == nullptr || queueData == nullptr || builtIns == nullptr) {
       // Allocation failure.
+      ::free(rt);
+      mpProgramCacheDestroy(cacheData);
+      mpCompileWorkspacePoolDestroy(workspaceData);
+      mpCompileQueueDestroy(queueData);
+      if (builtIns) builtIns->destroy();
       ::free(d);
       d = const_cast<Impl*>(&mpContextNull);
     }
     else {
       d->_refCount = 1;
       d->_runtimeData = new(rt) RuntimeData();
+      d->_executorData = nullptr;
+      d->_cacheData = cacheData;
+      d->_builtInsData = builtIns;
+      d->_workspaceData = workspaceData;
+      d->_queueData = queueData;
+      d->_flags = 0;
     }
   }
 
@@ -309,19 +445,175 @@ Error Context::reset() noexcept {
   return kErrorOk;
 }
 
+// ============================================================================
+// [mpsl::Context - Constants]
+// ============================================================================
+
+Error Context::addConstant(const char* name, double value) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  if (isFrozen())
+    return MPSL_TRACE_ERROR(kErrorFrozenContext);
+
+  if (name == nullptr)
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  AstBuiltIns* builtIns = static_cast<AstBuiltIns*>(_d->_builtInsData);
+
+  // Copy the built-in scope if it's shared with a clone.
+  if (mpAtomicGet(&builtIns->_refCount) != 1) {
+    AstBuiltIns* copy = AstBuiltIns::clone(builtIns);
+    MPSL_NULLCHECK(copy);
+
+    Error err = copy->addConstant(StringRef(name, ::strlen(name)), value);
+    if (err) {
+      copy->destroy();
+      return err;
+    }
+
+    _d->_builtInsData = copy;
+    mpObjectRelease(builtIns);
+    return kErrorOk;
+  }
+
+  return builtIns->addConstant(StringRef(name, ::strlen(name)), value);
+}
+
+// ============================================================================
+// [mpsl::Context - Executor]
+// ============================================================================
+
+Executor Context::executor() const noexcept {
+  void* executorData = mpExecutorLoad(&_d->_executorData);
+  if (executorData == nullptr)
+    return Executor();
+
+  return Executor(static_cast<Executor::Impl*>(executorData));
+}
+
+Error Context::setExecutor(const Executor& executor) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  void* executorData = executor.isValid() ? mpExecutorAddRef(executor._d) : nullptr;
+  mpExecutorExchange(&_d->_executorData, executorData);
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::Context - Cache]
+// ============================================================================
+
+Error Context::setCacheLimit(size_t codeLimit) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  static_cast<ProgramCache*>(_d->_cacheData)->setLimit(codeLimit);
+  return kErrorOk;
+}
+
+Error Context::setCacheDirectory(const char* directory) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  return static_cast<ProgramCache*>(_d->_cacheData)->setDirectory(directory);
+}
+
+Error Context::clearCache() noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  static_cast<ProgramCache*>(_d->_cacheData)->clear();
+  return kErrorOk;
+}
+
+Error Context::getCacheInfo(CacheInfo& out) const noexcept {
+  if (!isValid()) {
+    ::memset(&out, 0, sizeof(out));
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+  }
+
+  static_cast<ProgramCache*>(_d->_cacheData)->getInfo(out);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::Context - Workspaces]
+// ============================================================================
+
+Error Context::setWorkspaceBlockSize(size_t blockSize) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  static_cast<CompileWorkspacePool*>(_d->_workspaceData)->setBlockSize(blockSize);
+  return kErrorOk;
+}
+
+Error Context::getWorkspaceInfo(WorkspaceInfo& out) const noexcept {
+  if (!isValid()) {
+    ::memset(&out, 0, sizeof(out));
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+  }
+
+  static_cast<CompileWorkspacePool*>(_d->_workspaceData)->getInfo(out);
+  return kErrorOk;
+}
+
 // ============================================================================
 // [mpsl::Context - Clone / Freeze]
 // ============================================================================
 
 Error Context::clone() noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
 
-  // TODO:
+  Impl* d = static_cast<Impl*>(::malloc(sizeof(Impl)));
+  MPSL_NULLCHECK(d);
+
+  void* cacheData = mpProgramCacheCreate();
+  void* workspaceData = mpCompileWorkspacePoolCreate();
+  void* queueData = mpCompileQueueCreate(d);
+
+  Error err = kErrorNoMemory;
+  if (cacheData && workspaceData && queueData)
+    err = static_cast<ProgramCache*>(cacheData)->copySettings(
+      *static_cast<ProgramCache*>(_d->_cacheData));
+
+  if (err) {
+    mpProgramCacheDestroy(cacheData);
+    mpCompileWorkspacePoolDestroy(workspaceData);
+    mpCompileQueueDestroy(queueData);
+    ::free(d);
+    return MPSL_TRACE_ERROR(err);
+  }
+
+  Context::WorkspaceInfo workspaceInfo;
+  static_cast<CompileWorkspacePool*>(_d->_workspaceData)->getInfo(workspaceInfo);
+  static_cast<CompileWorkspacePool*>(workspaceData)->setBlockSize(workspaceInfo.blockSize);
+  mpCompileQueueSetMaxThreads(queueData, mpCompileQueueGetMaxThreads(_d->_queueData));
+  mpCompileQueueSetTierThreshold(queueData, mpCompileQueueGetTierThreshold(_d->_queueData));
+
+  // Built-in symbols are shared, `addConstant()` copies them when needed.
+  d->_refCount = 1;
+  d->_runtimeData = mpObjectAddRef(static_cast<RuntimeData*>(_d->_runtimeData));
+  d->_executorData = mpExecutorLoad(&_d->_executorData);
+  d->_cacheData = cacheData;
+  d->_builtInsData = mpObjectAddRef(static_cast<AstBuiltIns*>(_d->_builtInsData));
+  d->_workspaceData = workspaceData;
+  d->_queueData = queueData;
+  d->_flags = 0;
+
+  mpObjectRelease(mpAtomicSetXchgT<Impl*>(&_d, d));
   return kErrorOk;
 }
 
 Error Context::freeze() noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
 
-  // TODO:
+  _d->_flags |= kFlagFrozen;
   return kErrorOk;
 }
 
@@ -329,6 +621,52 @@ Error Context::freeze() noexcept {
 // [mpsl::Context - Compile]
 // ============================================================================
 
+//! \internal
+//!
+//! Attach the code at `func` having `batch` entry-point to `program`, the
+//! code is released if this fails. The `tier` of a tiered program and the
+//! reference to `uniforms` are owned by the program if this succeeds.
+static Error mpProgramSetCode(Program& program, RuntimeData* rt, void* func, void* batch, uint32_t numArgs, size_t codeSize, ProgramTier* tier = nullptr, ProgramUniforms* uniforms = nullptr) noexcept {
+  Program::Impl* programD = program._d;
+
+  if (programD->_refCount == 1 && static_cast<RuntimeData*>(programD->_runtimeData) == rt &&
+      programD->_tierData == nullptr && tier == nullptr &&
+      programD->_uniformData == nullptr && uniforms == nullptr) {
+    rt->release(programD->_main);
+    programD->_main = func;
+    programD->_batch = reinterpret_cast<Program::Impl::BatchFunc>(batch);
+    programD->_argsCount = numArgs;
+    programD->_programSize = static_cast<uint32_t>(codeSize);
+  }
+  else {
+    programD = static_cast<Program::Impl*>(::malloc(sizeof(Program::Impl)));
+    if (programD == nullptr) {
+      rt->release(func);
+      return MPSL_TRACE_ERROR(kErrorNoMemory);
+    }
+
+    programD->_refCount = 1;
+    programD->_runtimeData = mpObjectAddRef(rt);
+    programD->_main = func;
+    programD->_batch = reinterpret_cast<Program::Impl::BatchFunc>(batch);
+    programD->_argsCount = numArgs;
+    programD->_programSize = static_cast<uint32_t>(codeSize);
+    programD->_tierData = tier;
+    programD->_uniformData = uniforms;
+
+    if (tier) {
+      tier->owner = programD;
+      tier->baseline = func;
+    }
+
+    mpObjectRelease(
+      mpAtomicSetXchgT<Program::Impl*>(
+        &program._d, programD));
+  }
+
+  return kErrorOk;
+}
+
 #define MPSL_PROPAGATE_AND_HANDLE_COLLISION(...)                              \
   do {                                                                        \
     AstSymbol* collidedSymbol = nullptr;                                      \
@@ -347,15 +685,20 @@ Error Context::freeze() noexcept {
     }                                                                         \
   } while (0)
 
-Error Context::_compile(Program& program, const CompileArgs& ca, OutputLog* log) noexcept {
+Error mpContextCompile(Context::Impl* d, AstBuiltIns* builtIns, Program& program, const Context::CompileArgs& ca, OutputLog* log, ProgramUniforms* uniforms) noexcept {
   const char* body = ca.body.data();
   size_t size = ca.body.size();
 
   uint32_t options = ca.options;
   uint32_t numArgs = ca.numArgs;
+  bool tiered = (options & kOptionTiered) != 0;
 
-  if (numArgs == 0 || numArgs > Globals::kMaxArgumentsCount)
-    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+  bool hasUniforms = false;
+  for (uint32_t slot = 0; slot < numArgs; slot++)
+    hasUniforms |= mpLayoutUniformsSize(ca.layout[slot]) != 0;
+
+  // Baseline code of tiered programs is compiled without optimizations.
+  uint32_t optLevel = tiered ? 0u : mpGetOptLevel(options);
 
   // --------------------------------------------------------------------------
   // [Debug Strings]
@@ -380,22 +723,85 @@ Error Context::_compile(Program& program, const CompileArgs& ca, OutputLog* log)
   if (size == Globals::kInvalidIndex)
     size = ::strlen(body);
 
-  Zone zone(32768 - Zone::kBlockOverhead);
-  ZoneAllocator allocator(&zone);
-  StringTmp<512> sbTmp;
+  // --------------------------------------------------------------------------
+  // [Cache]
+  // --------------------------------------------------------------------------
+
+  RuntimeData* rt = static_cast<RuntimeData*>(d->_runtimeData);
+  ProgramCache* cache = static_cast<ProgramCache*>(d->_cacheData);
+
+  // Everything allocated by the compilation is kept by the workspace, which
+  // is reset and returned to the pool when this function returns.
+  CompileWorkspaceScope ws(static_cast<CompileWorkspacePool*>(d->_workspaceData));
+  MPSL_NULLCHECK(ws.get());
+
+  String& cacheKey = ws->_key;
+
+  // Baseline code of tiered programs and code that reads uniforms refer to
+  // data of the program.
+  bool useCache = !tiered && !hasUniforms && cache != nullptr && cache->isEnabled();
+  bool useDisk = !tiered && !hasUniforms && cache != nullptr && cache->hasDirectory();
+
+  if (useCache || useDisk) {
+    MPSL_PROPAGATE(ProgramCache::makeKey(cacheKey, ca, body, size, options, builtIns->signature()));
+
+    // Programs are only shared if nothing has to be written to the log.
+    if ((options & (kOptionVerbose | kOptionDebugAst | kOptionDebugIR | kOptionDebugASM)) == 0) {
+      Program::Impl* cachedD = useCache ? cache->get(cacheKey) : nullptr;
+      if (cachedD) {
+        mpObjectRelease(
+          mpAtomicSetXchgT<Program::Impl*>(
+            &program._d, cachedD));
+        return kErrorOk;
+      }
+
+      void* func;
+      size_t batchOffset;
+      size_t codeSize;
+
+      if (useDisk && cache->load(rt, cacheKey, &func, batchOffset, codeSize)) {
+        MPSL_PROPAGATE(mpProgramSetCode(program, rt, func, static_cast<uint8_t*>(func) + batchOffset, numArgs, codeSize));
+        if (useCache)
+          cache->put(cacheKey, program, codeSize);
+        return kErrorOk;
+      }
+    }
+  }
+
+  ZoneAllocator& allocator = ws->_allocator;
+  String& sbTmp = ws->_sb;
 
   AstBuilder ast(&allocator);
   IRBuilder ir(&allocator, numArgs);
 
-  MPSL_PROPAGATE(ast.addProgramScope());
-  MPSL_PROPAGATE(ast.addBuiltInTypes(mpTypeInfo, kTypeCount));
-  MPSL_PROPAGATE(ast.addBuiltInConstants(mpConstInfo, MPSL_ARRAY_SIZE(mpConstInfo)));
-  MPSL_PROPAGATE(ast.addBuiltInIntrinsics());
+  // Built-in symbols are only resolved through the parent scope, they are
+  // never modified during compilation.
+  MPSL_PROPAGATE(ast.addProgramScope(builtIns->scope()));
 
+  uint32_t soaSlots = 0;
   for (uint32_t slot = 0; slot < numArgs; slot++) {
     MPSL_PROPAGATE_AND_HANDLE_COLLISION(ast.addBuiltInObject(slot, ca.layout[slot], &collidedSymbol));
+    if (ca.layout[slot]->isSoA())
+      soaSlots |= 1u << slot;
   }
 
+  // Structure-of-arrays layouts are only meaningful in SPMD mode.
+  if (options & kOptionSPMD)
+    MPSL_PROPAGATE(ir.initSPMD(Globals::kSPMDLanes, soaSlots));
+  else if (soaSlots != 0)
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  // The code reads uniforms from a block of the program at a fixed address,
+  // a recompiled tiered program reads the block of its baseline code.
+  if (uniforms)
+    mpObjectAddRef(uniforms);
+  else if (hasUniforms)
+    MPSL_PROPAGATE(ProgramUniforms::create(&uniforms, ca));
+  ProgramUniformsScope uniformsScope(uniforms);
+
+  if (uniforms)
+    MPSL_PROPAGATE(ir.initUniforms(uniforms->data()));
+
   // Setup basic data structures used during parsing and compilation.
   ErrorReporter errorReporter(body, size, options, log);
 
@@ -427,16 +833,18 @@ Error Context::_compile(Program& program, const CompileArgs& ca, OutputLog* log)
   // folding). This pass shouldn't do any unsafe optimizations and it's a bit
   // limited, but it's faster to do them now than doing these optimizations at
   // IR level.
-  { MPSL_PROPAGATE(AstOptimizer(&ast, &errorReporter).onProgram(ast.programNode())); }
+  if (optLevel >= 1) {
+    { MPSL_PROPAGATE(AstOptimizer(&ast, &errorReporter).onProgram(ast.programNode())); }
 
-  if (options & kOptionDebugAst) {
-    ast.dump(sbTmp);
-    log->log(
-      OutputLog::Message(
-        OutputLog::kMessageDump, 0, 0,
-        StringRef(kDebugHeadingAST, MPSL_ARRAY_SIZE(kDebugHeadingAST) - 1),
-        StringRef(sbTmp.data(), sbTmp.size())));
-    sbTmp.clear();
+    if (options & kOptionDebugAst) {
+      ast.dump(sbTmp);
+      log->log(
+        OutputLog::Message(
+          OutputLog::kMessageDump, 0, 0,
+          StringRef(kDebugHeadingAST, MPSL_ARRAY_SIZE(kDebugHeadingAST) - 1),
+          StringRef(sbTmp.data(), sbTmp.size())));
+      sbTmp.clear();
+    }
   }
 
   // --------------------------------------------------------------------------
@@ -445,8 +853,11 @@ Error Context::_compile(Program& program, const CompileArgs& ca, OutputLog* log)
 
   // Translate AST to IR.
   {
+    CodeGen codeGen(&ast, &ir);
+    codeGen._hasV256 = IRToX86::hasV256(options);
+
     CodeGen::Result unused(false);
-    MPSL_PROPAGATE(CodeGen(&ast, &ir).onProgram(ast.programNode(), unused));
+    MPSL_PROPAGATE(codeGen.onProgram(ast.programNode(), unused));
   }
 
   if (options & kOptionDebugIR) {
@@ -459,48 +870,96 @@ Error Context::_compile(Program& program, const CompileArgs& ca, OutputLog* log)
     sbTmp.clear();
   }
 
-  MPSL_PROPAGATE(mpIRPass(&ir));
+  // O2 passes run on the SSA form, which is translated back before the code
+  // is generated. O1 only removes dead stores and dead code.
+  if (optLevel >= 1) {
+    if (optLevel >= 2)
+      MPSL_PROPAGATE(mpIRToSSA(&ir));
 
-  if (options & kOptionDebugIR) {
-    ir.dump(sbTmp);
-    log->log(
-      OutputLog::Message(
-        OutputLog::kMessageDump, 0, 0,
-        StringRef(kDebugHeadingIR, MPSL_ARRAY_SIZE(kDebugHeadingIR) - 1),
-        StringRef(sbTmp.data(), sbTmp.size())));
-    sbTmp.clear();
+    MPSL_PROPAGATE(mpIRPass(&ir));
+
+    if (optLevel >= 2)
+      MPSL_PROPAGATE(mpIRFromSSA(&ir));
+
+    if (options & kOptionDebugIR) {
+      ir.dump(sbTmp);
+      log->log(
+        OutputLog::Message(
+          OutputLog::kMessageDump, 0, 0,
+          StringRef(kDebugHeadingIR, MPSL_ARRAY_SIZE(kDebugHeadingIR) - 1),
+          StringRef(sbTmp.data(), sbTmp.size())));
+      sbTmp.clear();
+    }
   }
 
   // --------------------------------------------------------------------------
   // [ASM]
   // --------------------------------------------------------------------------
 
-  // Compile and store the reference to the `main()` function.
-  RuntimeData* rt = static_cast<RuntimeData*>(_d->_runtimeData);
-  Program::Impl* programD = program._d;
+  // The baseline code of a tiered program counts records it processes, the
+  // counter has to exist before the code is generated.
+  ProgramTier* tier = nullptr;
+  if (tiered)
+    MPSL_PROPAGATE(ProgramTier::create(&tier, d->_queueData, builtIns, ca));
+  ProgramTierScope tierScope(tier, rt);
+
+  // At O0 the code is emitted directly by the assembler, which skips asmjit's
+  // register allocation, if the program doesn't need anything it can't do.
+  bool assemble = false;
+  if (optLevel == 0) {
+    const char* reason;
+    assemble = IRToX86::canAssemble(&ir, options, &reason);
+
+    // The warning has no position, it's about the whole program.
+    if (!assemble && !tiered)
+      errorReporter.onWarning(0xFFFFFFFFu, "O0 code is emitted by x86::Compiler as the program %s", reason);
+  }
 
+  // Compile and store the reference to the `main()` function.
   void* func = nullptr;
+  void* batch = nullptr;
+  size_t codeSize = 0;
   {
-    asmjit::StringLogger asmlog;
-    asmjit::CodeHolder code;
+    asmjit::StringLogger& asmlog = ws->_logger;
+    asmjit::CodeHolder& code = ws->_code;
+    asmjit::BaseEmitter* emitter = assemble
+      ? static_cast<asmjit::BaseEmitter*>(&ws->_assembler)
+      : static_cast<asmjit::BaseEmitter*>(&ws->_compiler);
 
-    code.init(rt->_runtime.codeInfo());
-    asmjit::x86::Compiler c(&code);
+    MPSL_PROPAGATE(ws->initCode(rt->runtime(), emitter));
 
     if (options & kOptionDebugASM)
       code.setLogger(&asmlog);
 
-    IRToX86 compiler(&allocator, &c);
-    if (options & kOptionDisableSSE4_1)
-      compiler._enableSSE4_1 = false;
-    MPSL_PROPAGATE(compiler.compileIRAsFunc(&ir));
+    // Both entry-points are compiled into the same code-block, `main()` must
+    // be the first as its address is used to release the whole block.
+    IRToX86 mainCompiler(&allocator, emitter);
+    mainCompiler.applyOptions(options);
+    if (tier) mainCompiler.setTierCounter(&tier->counter, ProgramTier::onHot, tier);
+    MPSL_PROPAGATE(mainCompiler.compileIRAsFunc(&ir));
+
+    ir.resetJitData();
 
-    asmjit::Error err = c.finalize();
+    IRToX86 batchCompiler(&allocator, emitter);
+    batchCompiler.applyOptions(options);
+    if (tier) batchCompiler.setTierCounter(&tier->counter, ProgramTier::onHot, tier);
+    MPSL_PROPAGATE(batchCompiler.compileIRAsBatchFunc(&ir));
+
+    asmjit::Error err = emitter->finalize();
     if (err) return MPSL_TRACE_ERROR(kErrorJITFailed);
 
-    err = rt->_runtime.add(&func, &code);
+    // Has to be saved before `add()`, which relocates the code in place. The
+    // program is valid even if it couldn't be saved.
+    if (useDisk)
+      cache->save(cacheKey, code, static_cast<size_t>(code.labelOffset(batchCompiler._funcLabel)));
+
+    err = rt->add(&func, &code);
     if (err) return MPSL_TRACE_ERROR(kErrorJITFailed);
 
+    codeSize = code.codeSize();
+    batch = static_cast<uint8_t*>(func) +
+      static_cast<size_t>(code.labelOffset(batchCompiler._funcLabel));
+
     if (options & kOptionDebugASM)
       log->log(
         OutputLog::Message(
@@ -509,29 +968,61 @@ Error Context::_compile(Program& program, const CompileArgs& ca, OutputLog* log)
           StringRef(asmlog.data(), asmlog.dataSize())));
   }
 
-  if (programD->_refCount == 1 && static_cast<RuntimeData*>(programD->_runtimeData) == rt) {
-    rt->_runtime.release(programD->_main);
-    programD->_main = func;
-  }
-  else {
-    programD = static_cast<Program::Impl*>(::malloc(sizeof(Program::Impl)));
-    if (programD == nullptr) {
-      rt->_runtime.release(func);
-      return MPSL_TRACE_ERROR(kErrorNoMemory);
-    }
+  MPSL_PROPAGATE(mpProgramSetCode(program, rt, func, batch, numArgs, codeSize, tier, uniforms));
+  tierScope.release();
+  uniformsScope.release();
 
-    programD->_refCount = 1;
-    programD->_runtimeData = mpObjectAddRef(rt);
-    programD->_main = func;
+  // The program is valid even if it couldn't be cached.
+  if (useCache)
+    cache->put(cacheKey, program, codeSize);
 
-    mpObjectRelease(
-      mpAtomicSetXchgT<Program::Impl*>(
-        &program._d, programD));
-  }
+  return kErrorOk;
+}
+
+Error Context::_compile(Program& program, const CompileArgs& ca, OutputLog* log) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  if (ca.numArgs == 0 || ca.numArgs > Globals::kMaxArgumentsCount)
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  return mpContextCompile(_d, static_cast<AstBuiltIns*>(_d->_builtInsData), program, ca, log);
+}
+
+// ============================================================================
+// [mpsl::Context - Compile Async]
+// ============================================================================
+
+Error Context::setCompileThreads(uint32_t numThreads) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  if (numThreads == 0)
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
 
+  mpCompileQueueSetMaxThreads(_d->_queueData, numThreads);
   return kErrorOk;
 }
 
+Error Context::setTierThreshold(uint32_t numRecords) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  mpCompileQueueSetTierThreshold(_d->_queueData, numRecords);
+  return kErrorOk;
+}
+
+Error Context::_compileAsync(CompileTask& task, const CompileArgs& ca, uint32_t priority) noexcept {
+  if (!isValid())
+    return MPSL_TRACE_ERROR(kErrorInvalidState);
+
+  if (ca.numArgs == 0 || ca.numArgs > Globals::kMaxArgumentsCount || priority >= CompileTask::kPriorityCount)
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  // The task keeps the built-in scope, `addConstant()` copies it if needed.
+  return mpCompileQueueSubmit(_d->_queueData, task, static_cast<AstBuiltIns*>(_d->_builtInsData), ca, priority);
+}
+
 // ============================================================================
 // [mpsl::Context - Operator Overload]
 // ============================================================================
@@ -548,7 +1039,7 @@ Context& Context::operator=(const Context& other) noexcept {
 // [mpsl::Program - Construction / Destruction]
 // ============================================================================
 
-static const Program::Impl mpProgramNull = { 0, nullptr, nullptr };
+static const Program::Impl mpProgramNull = { 0, nullptr, nullptr, nullptr };
 
 Program::Program() noexcept
   : _d(const_cast<Program::Impl*>(&mpProgramNull)) {}
@@ -570,6 +1061,50 @@ Error Program::reset() noexcept {
   return kErrorOk;
 }
 
+// ============================================================================
+// [mpsl::Program - Accessors]
+// ============================================================================
+
+uint32_t Program::tier() const noexcept {
+  ProgramTier* tier = static_cast<ProgramTier*>(_d->_tierData);
+  if (tier && !tier->isOptimized())
+    return kTierBaseline;
+  return kTierOptimized;
+}
+
+// ============================================================================
+// [mpsl::Program - Tiering]
+// ============================================================================
+
+Error Program::tierUp(bool wait) noexcept {
+  ProgramTier* tier = static_cast<ProgramTier*>(_d->_tierData);
+  if (tier == nullptr || tier->isOptimized())
+    return kErrorOk;
+
+  // Fails only if the recompilation couldn't be queued, which makes the job
+  // canceled, so waiting returns the same error.
+  Error err = tier->request();
+  if (!wait)
+    return err;
+
+  return tier->job->wait();
+}
+
+// ============================================================================
+// [mpsl::Program - Uniforms]
+// ============================================================================
+
+Error Program::_setUniform(const char* name, size_t size, const Value& value) noexcept {
+  ProgramUniforms* uniforms = static_cast<ProgramUniforms*>(_d->_uniformData);
+  if (uniforms == nullptr || name == nullptr)
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  if (size == Globals::kInvalidIndex)
+    size = ::strlen(name);
+
+  return uniforms->set(name, size, value);
+}
+
 // ============================================================================
 // [mpsl::Program - Operator Overload]
 // ============================================================================
@@ -24,8 +24,11 @@ namespace mpsl {
 // [Forward Declarations]
 // ============================================================================
 
+struct CompileTask;
 struct Context;
+struct Executor;
 struct Program;
+struct ProgramSlot;
 
 struct Layout;
 struct OutputLog;
@@ -118,7 +121,13 @@ enum ErrorCode {
   kErrorTooManyMembers,
 
   //! Context is frozen and can't be modified anymore.
-  kErrorFrozenContext
+  kErrorFrozenContext,
+
+  //! Compilation was canceled before it finished.
+  //!
+  //! Returned by `CompileTask::wait()` after `CompileTask::cancel()` or if the
+  //! context was destroyed before the task has been compiled.
+  kErrorCanceled
 };
 
 // ============================================================================
@@ -212,6 +221,9 @@ enum TypeIdFlags {
   //! `kTypeDenest`.
   kTypeDenest = 0x00040000,
 
+  //! Member is a uniform (only used by `Layout`, see `Layout::addUniform()`).
+  kTypeUniform = 0x00080000,
+
   // --------------------------------------------------------------------------
   // [Type-RW]
   // --------------------------------------------------------------------------
@@ -246,6 +258,32 @@ enum Options {
   //! Debug assembly generated.
   kOptionDebugASM = 0x0008,
 
+  //! Compile the program in SPMD mode.
+  //!
+  //! Each scalar variable of the program is mapped to `Globals::kSPMDLanes`
+  //! lanes of a SIMD register, which means that the program processes that
+  //! many records at a time. Members of layouts marked by `Layout::setSoA()`
+  //! are accessed as columns (one element per record), all other layouts are
+  //! uniform (read-only and shared by all records). Vector types cannot be
+  //! used by SPMD programs.
+  kOptionSPMD = 0x0010,
+
+  //! Use faster math functions (`exp`, `log`, `sin`, `pow`, ...) that are
+  //! accurate to about 4 ULPs instead of the default ones that are within
+  //! 1-2 ULPs of the C library in their primary domain.
+  kOptionFastMath = 0x0020,
+
+  //! Compile a baseline program quickly and recompile it with all optimizations
+  //! in background when it gets hot.
+  //!
+  //! The baseline (tier 0) skips AST and IR optimizations and counts records it
+  //! processes. When the count reaches `Context::setTierThreshold()` the program
+  //! is recompiled by the context's background threads (tier 1) and its entry
+  //! points are replaced in place, so all weak-copies of the program use the
+  //! optimized code. Tiered programs are never cached and stay at tier 0 if the
+  //! context is destroyed before they get hot.
+  kOptionTiered = 0x0040,
+
   //! Do not use SSE3 (and higher) even if the CPU supports it (X86/X64 only).
   kOptionDisableSSE3 = 0x0100,
   //! Do not use SSSE3 (and higher) even if the CPU supports it (X86/X64 only).
@@ -259,6 +297,24 @@ enum Options {
   //! Do not use AVX2 (and higher) even if the CPU supports it (X86/X64 only).
   kOptionDisableAVX2 = 0x2000,
 
+  //! Optimization level 0 - compile as fast as possible.
+  //!
+  //! No AST or IR optimizations are performed and the code is emitted by
+  //! `x86::Assembler` with MPSL's own linear-scan register allocator instead
+  //! of asmjit's `x86::Compiler`. Programs that call math functions, use
+  //! 256-bit vectors or uniform members, or are compiled in SPMD mode (and
+  //! all programs on X86) are still emitted by `x86::Compiler`, which is
+  //! reported as a warning if `kOptionVerbose` is set.
+  kOptionO0 = 0x4000,
+  //! Optimization level 1 - constant folding and dead code removal (AST),
+  //! dead store and dead code removal (IR).
+  kOptionO1 = 0x8000,
+  //! Optimization level 2 - all optimizations, the default if no optimization
+  //! level is specified.
+  kOptionO2 = 0xC000,
+  //! Mask of the optimization level.
+  kOptionOptLevelMask = 0xC000,
+
   //! \internal
   //!
   //! Mask of all accessible options, MPSL uses also \ref InternalOptions that
@@ -282,7 +338,9 @@ enum Limits {
   //! Maximum size of an identifier.
   kMaxIdentifierLength = 64,
   //! Maximum number of members of one data `Layout`.
-  kMaxMembersCount = 512
+  kMaxMembersCount = 512,
+  //! Number of records processed at a time by programs compiled in SPMD mode.
+  kSPMDLanes = 4
 };
 
 } // Globals namespace
@@ -533,12 +591,32 @@ struct StringRef {
 struct Layout {
   MPSL_NONCOPYABLE(Layout)
 
+  //! \internal
+  //!
+  //! Layout flags.
+  enum Flags {
+    kFlagSoA = 0x0001                    //!< Structure-of-arrays layout.
+  };
+
+  //! \internal
+  //!
+  //! Count of buckets of the hashed index of members.
+  enum { kBucketsCount = 64 };
+
   //! \internal
   struct Member {
     const char* name;                    //!< Member name, it's located somewhere at `Layout::_data`.
     uint32_t nameSize;                   //!< Member name size.
     uint32_t typeInfo;                   //!< Member type information.
     int32_t offset;                      //!< Member offset in the passed data (negative offset is allowed).
+    uint32_t hashCode;                   //!< Hash of the member name.
+    uint32_t hashNext;                   //!< Index of the next member in the same bucket plus one, zero if last.
+    const Value* value;                  //!< Value of a constant or initial value of a uniform member (located at `Layout::_data`), null otherwise.
+
+    //! Get whether the member is a constant (see `Layout::addConst()`).
+    MPSL_INLINE bool isConst() const noexcept { return value != nullptr && (typeInfo & kTypeUniform) == 0; }
+    //! Get whether the member is a uniform (see `Layout::addUniform()`).
+    MPSL_INLINE bool isUniform() const noexcept { return (typeInfo & kTypeUniform) != 0; }
   };
 
   // --------------------------------------------------------------------------
@@ -578,6 +656,10 @@ public:
   MPSL_API const Member* _get(const char* name, size_t nameSize) const noexcept;
   //! \internal
   MPSL_API Error _add(const char* name, size_t nameSize, uint32_t typeInfo, int32_t offset) noexcept;
+  //! \internal
+  MPSL_API Error _addConst(const char* name, size_t nameSize, uint32_t typeInfo, const Value& value) noexcept;
+  //! \internal
+  MPSL_API Error _addUniform(const char* name, size_t nameSize, uint32_t typeInfo, const Value& value) noexcept;
 
   //! Get whether the layout has a name. Name is an identifier that is used
   //! in a shader program to access the data and its members. Name has to be
@@ -588,6 +670,18 @@ public:
   MPSL_INLINE const char* name() const noexcept { return _name; }
   MPSL_INLINE uint32_t nameSize() const noexcept { return _nameSize; }
 
+  //! Get whether the layout describes structure-of-arrays data (SPMD only).
+  MPSL_INLINE bool isSoA() const noexcept { return (_flags & kFlagSoA) != 0; }
+
+  //! Mark the layout as structure-of-arrays (used by `kOptionSPMD` programs).
+  //!
+  //! The offset of each member is then an offset of its column, which is an
+  //! array of scalars, one per record. A record `i` of member `m` is located
+  //! at `data + m.offset + i * sizeof(m)`.
+  MPSL_INLINE void setSoA(bool value) noexcept {
+    _flags = value ? (_flags | kFlagSoA) : (_flags & ~kFlagSoA);
+  }
+
   MPSL_INLINE const Member* membersArray() const noexcept { return _members; }
   MPSL_INLINE uint32_t membersCount() const noexcept { return _membersCount; }
 
@@ -624,6 +718,39 @@ public:
     return _add(name.data(), name.size(), typeInfo, offset);
   }
 
+  //! Add a constant member of `value` to the arguments object.
+  //!
+  //! Constant members are not read from the passed data, the program is
+  //! specialized for `value` instead, which allows to fold expressions and
+  //! remove branches that depend on it. Constant members are read-only and
+  //! `value` is part of the key of cached programs, so programs compiled for
+  //! different values are not shared.
+  MPSL_INLINE Error addConst(const char* name, uint32_t typeInfo, const Value& value) noexcept {
+    return _addConst(name, Globals::kInvalidIndex, typeInfo, value);
+  }
+
+  //! \overload
+  MPSL_INLINE Error addConst(const StringRef& name, uint32_t typeInfo, const Value& value) noexcept {
+    return _addConst(name.data(), name.size(), typeInfo, value);
+  }
+
+  //! Add a uniform member initialized to `value` to the arguments object.
+  //!
+  //! Uniform members are not read from the passed data either, they are
+  //! stored in a writable block owned by the compiled program and can be
+  //! changed by `Program::setUniform()` without recompiling it. Uniforms are
+  //! read-only in the program and are loaded once per call of `main()` or
+  //! `batch()`. Programs that have uniforms are never cached as each of them
+  //! needs its own block.
+  MPSL_INLINE Error addUniform(const char* name, uint32_t typeInfo, const Value& value) noexcept {
+    return _addUniform(name, Globals::kInvalidIndex, typeInfo, value);
+  }
+
+  //! \overload
+  MPSL_INLINE Error addUniform(const StringRef& name, uint32_t typeInfo, const Value& value) noexcept {
+    return _addUniform(name.data(), name.size(), typeInfo, value);
+  }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -642,12 +769,18 @@ public:
 
   //! Count of members.
   uint32_t _membersCount;
+  //! Layout flags, see \ref Flags.
+  uint32_t _flags;
 
   //! Size of `_data` (in bytes).
   uint32_t _dataSize;
   //! The current data index, initially set to `_dataSize`, decreasing.
   uint32_t _dataIndex;
 
+  //! Hashed index of members, each bucket contains an index of the first
+  //! member of that bucket plus one, zero if the bucket is empty.
+  uint16_t _buckets[kBucketsCount];
+
   //! Used only by `LayoutTmp`,
   uint8_t _embeddedData[8];
 };
@@ -660,6 +793,121 @@ struct LayoutTmp : public Layout {
   uint8_t _embeddedDataTmp[N - 8];
 };
 
+// ============================================================================
+// [mpsl::CompileTask]
+// ============================================================================
+
+//! Program compiled in background, see `Context::compileAsync()`.
+//!
+//! The task is done when its program is compiled, fails to compile, or is
+//! canceled. Use `isDone()` to check it without blocking and `get()` to take
+//! the compiled program. The program is replaced atomically, so threads that
+//! keep their own weak-copy of the old program can keep running it.
+struct CompileTask {
+  //! Priority of a task.
+  enum Priority {
+    //! Compiled before all bulk tasks (for example a program being edited).
+    kPriorityInteractive = 0,
+    //! Compiled when no interactive task is queued (for example prefetching).
+    kPriorityBulk = 1,
+    //! Count of priorities.
+    kPriorityCount = 2
+  };
+
+  // --------------------------------------------------------------------------
+  // [Impl]
+  // --------------------------------------------------------------------------
+
+  //! \internal
+  struct Impl {
+    //! Implemented in `mpcompilequeue.cpp`.
+    MPSL_INLINE void destroy() noexcept;
+
+    //! Reference count.
+    uintptr_t _refCount;
+    //! Number of arguments of the program, zero if the task is null.
+    uint32_t _numArgs;
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a weak-copy of null task (is never done).
+  MPSL_API CompileTask() noexcept;
+  //! Create a weak-copy of `other` task.
+  MPSL_API CompileTask(const CompileTask& other) noexcept;
+  //! Destroy the task, it's compiled even if this was the last reference.
+  MPSL_API ~CompileTask() noexcept;
+
+#if defined(MPSL_EXPORTS)
+  explicit MPSL_INLINE CompileTask(Impl* d) noexcept : _d(d) {}
+#endif // MPSL_EXPORTS
+
+  // --------------------------------------------------------------------------
+  // [Reset]
+  // --------------------------------------------------------------------------
+
+  //! Reset the task.
+  MPSL_API Error reset() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  MPSL_INLINE bool isValid() const noexcept { return _d->_numArgs != 0; }
+
+  //! Get whether the task is done, never blocks.
+  MPSL_API bool isDone() const noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Wait until the task is done and return the result of the compilation.
+  MPSL_API Error wait() noexcept;
+
+  //! Cancel the task.
+  //!
+  //! A task that is queued is never compiled, a task that is being compiled
+  //! finishes, but its program is discarded. Either way the task is done
+  //! immediately and its result is `kErrorCanceled`. Does nothing if the
+  //! task is already done.
+  MPSL_API Error cancel() noexcept;
+
+  //! \internal
+  MPSL_API Error _get(Program& program, uint32_t numArgs) const noexcept;
+
+  //! Replace `program` by the program compiled by the task.
+  //!
+  //! Returns `kErrorInvalidState` if the task is not done yet, the result of
+  //! the compilation if it failed, and `kErrorInvalidArgument` if `program`
+  //! accepts a different number of arguments.
+  template<typename ProgramT>
+  MPSL_INLINE Error get(ProgramT& program) const noexcept {
+    return _get(program, ProgramT::kNumArgs);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Operator Overload]
+  // --------------------------------------------------------------------------
+
+  //! Assign a weak-copy of `other` task.
+  MPSL_API CompileTask& operator=(const CompileTask& other) noexcept;
+
+  //! Equality, only true if `other` is the same weak-copy of the task.
+  MPSL_INLINE bool operator==(const CompileTask& other) const noexcept { return _d == other._d; }
+  //! Inequality.
+  MPSL_INLINE bool operator!=(const CompileTask& other) const noexcept { return _d != other._d; }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Task data (private).
+  Impl* _d;
+};
+
 // ============================================================================
 // [mpsl::Context]
 // ============================================================================
@@ -668,6 +916,17 @@ struct LayoutTmp : public Layout {
 //!
 //! Contains a basic environment that is setup by the embedder. Contexts can be
 //! extended by embedder by custom constants, functions, and asmjit extensions.
+//!
+//! Thread-safety:
+//!
+//!   - Programs can be compiled by any number of threads using the same context
+//!     (or its clones) at the same time. Each compilation uses its own memory,
+//!     only adding its code into the shared JIT runtime is serialized.
+//!   - `addConstant()`, `freeze()`, and `reset()` must not be called while the
+//!     same context is used by another thread. Use `clone()` to get a context
+//!     that can be modified independently.
+//!   - `compileAsync()` never blocks on compilation, programs are compiled by
+//!     background threads owned by the context.
 struct Context {
   // --------------------------------------------------------------------------
   // [Impl]
@@ -682,6 +941,58 @@ struct Context {
     uintptr_t _refCount;
     //! Runtime data.
     void* _runtimeData;
+    //! Attached executor (`Executor::Impl`), see \ref setExecutor().
+    void* _executorData;
+    //! Cache of compiled programs, see \ref setCacheLimit().
+    void* _cacheData;
+    //! Built-in scope (shared with clones until modified), see \ref addConstant().
+    void* _builtInsData;
+    //! Pool of compilation workspaces, see \ref getWorkspaceInfo().
+    void* _workspaceData;
+    //! Queue of background compilations, see \ref compileAsync().
+    void* _queueData;
+    //! Context flags, see \ref Flags.
+    uint32_t _flags;
+  };
+
+  //! Context flags.
+  enum Flags {
+    //! The context is frozen, see \ref freeze().
+    kFlagFrozen = 0x00000001u
+  };
+
+  //! Statistics of the compiled-program cache, see \ref getCacheInfo().
+  struct CacheInfo {
+    //! Count of compilations that returned a cached program.
+    uint64_t hits;
+    //! Count of compilations that didn't find a cached program.
+    uint64_t misses;
+    //! Count of programs loaded from the cache directory.
+    uint64_t diskHits;
+    //! Count of programs not found (or invalid) in the cache directory.
+    uint64_t diskMisses;
+    //! Count of cached programs.
+    size_t entriesCount;
+    //! Size of machine code of all cached programs (in bytes).
+    size_t codeSize;
+    //! Maximum size of machine code of all cached programs (in bytes).
+    size_t codeLimit;
+  };
+
+  //! Statistics of compilation workspaces, see \ref getWorkspaceInfo().
+  struct WorkspaceInfo {
+    //! Count of workspaces created.
+    uint64_t created;
+    //! Count of compilations that reused an idle workspace.
+    uint64_t reused;
+    //! Count of idle workspaces.
+    size_t idleCount;
+    //! Size of zone blocks used by new workspaces (in bytes).
+    size_t blockSize;
+    //! Peak size of zone memory used by a single compilation (in bytes).
+    size_t peakZoneSize;
+    //! Peak size of machine code generated by a single compilation (in bytes).
+    size_t peakCodeSize;
   };
 
   // --------------------------------------------------------------------------
@@ -717,6 +1028,92 @@ struct Context {
     return _d->_runtimeData != nullptr;
   }
 
+  //! Get whether the context is frozen, see \ref freeze().
+  MPSL_INLINE bool isFrozen() const noexcept {
+    return (_d->_flags & kFlagFrozen) != 0;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Constants]
+  // --------------------------------------------------------------------------
+
+  //! Add a constant `name` of `double` type to all programs compiled by the
+  //! context.
+  //!
+  //! Constants are added to the same scope as built-in constants (like `PI`),
+  //! so they can't be redefined by global variables of a program. Returns
+  //! `kErrorAlreadyExists` if `name` is already a built-in symbol.
+  //!
+  //! \note The context must not be used to compile programs at the same time.
+  MPSL_API Error addConstant(const char* name, double value) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Executor]
+  // --------------------------------------------------------------------------
+
+  //! Get the executor attached to the context, null if there is none.
+  MPSL_API Executor executor() const noexcept;
+
+  //! Attach `executor` to the context, the context keeps a reference to it.
+  //!
+  //! The context doesn't use the executor itself, it only makes it available
+  //! to all code that has access to the context. Pass a null executor to
+  //! detach it.
+  MPSL_API Error setExecutor(const Executor& executor) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Cache]
+  // --------------------------------------------------------------------------
+
+  //! Cache compiled programs having up to `codeLimit` bytes of machine code.
+  //!
+  //! A program compiled from the same body, options, and layouts (including
+  //! names, types, and offsets of all members) is then shared instead of
+  //! compiled again. The least recently used programs are evicted when the
+  //! limit is exceeded. The cache is disabled by default, zero disables it
+  //! and releases all cached programs.
+  //!
+  //! \note Compilations that use `kOptionVerbose` or any debug option don't
+  //! use cached programs as they have to produce the output log.
+  MPSL_API Error setCacheLimit(size_t codeLimit) noexcept;
+
+  //! Save compiled programs to `directory` and load them from there.
+  //!
+  //! Each program is saved as a versioned binary blob, which contains its
+  //! machine code, relocations, and the whole key described by
+  //! \ref setCacheLimit() (including CPU features). A blob is validated when
+  //! it's loaded and the program is compiled again if it doesn't match. The
+  //! directory must exist, pass null to stop using it.
+  //!
+  //! \note The directory can be shared by multiple processes, but it must be
+  //! trusted - only writable by the user that runs them. Blobs contain machine
+  //! code that is executed as is and their checksum only detects corruption,
+  //! not tampering. On POSIX systems blobs that are not owned by the effective
+  //! user or that are writable by group or others are ignored.
+  MPSL_API Error setCacheDirectory(const char* directory) noexcept;
+
+  //! Release all cached programs and reset cache statistics.
+  MPSL_API Error clearCache() noexcept;
+
+  //! Get statistics of the compiled-program cache.
+  MPSL_API Error getCacheInfo(CacheInfo& out) const noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Workspaces]
+  // --------------------------------------------------------------------------
+
+  //! Set the size of zone blocks used by compilation (in bytes).
+  //!
+  //! Each compilation uses a workspace (memory used by AST, IR, and machine
+  //! code) that is reset and kept by the context when the compilation ends,
+  //! so programs compiled later don't allocate it again. Compare the block
+  //! size with `WorkspaceInfo::peakZoneSize` to tune it, zero resets it to
+  //! the default (32kB). Idle workspaces are released when the size changes.
+  MPSL_API Error setWorkspaceBlockSize(size_t blockSize) noexcept;
+
+  //! Get statistics of compilation workspaces.
+  MPSL_API Error getWorkspaceInfo(WorkspaceInfo& out) const noexcept;
+
   // --------------------------------------------------------------------------
   // [Clone / Freeze]
   // --------------------------------------------------------------------------
@@ -725,14 +1122,23 @@ struct Context {
   //!
   //! Clone will create a deep copy of the context and unfreeze it; the context
   //! can be modified after it has been cloned regardless of being frozen or
-  //! not before.
+  //! not before. Other weak-copies keep the original context.
+  //!
+  //! The clone shares the runtime, the executor, and built-in symbols with
+  //! the original context, built-in symbols are copied first time either of
+  //! them is modified. The clone gets an empty program cache that uses the
+  //! same limit and directory, and its own compilation workspaces.
   MPSL_API Error clone() noexcept;
 
   //! Freeze the context.
   //!
   //! No modifications are allowed after the context is frozen. This is useful
   //! when building a fixed environment for your programs that can't be modified
-  //! after it has been created (it becomes immutable).
+  //! after it has been created (it becomes immutable). Functions that modify a
+  //! frozen context return `kErrorFrozenContext`.
+  //!
+  //! \note The executor and cache settings can be changed even if the context
+  //! is frozen as they don't affect the compiled code.
   MPSL_API Error freeze() noexcept;
 
   // --------------------------------------------------------------------------
@@ -760,6 +1166,141 @@ struct Context {
   //! \internal
   MPSL_API Error _compile(Program& program, const CompileArgs& ca, OutputLog* log) noexcept;
 
+  // --------------------------------------------------------------------------
+  // [Compile Async]
+  // --------------------------------------------------------------------------
+
+  //! Set the maximum number of threads that compile programs in background
+  //! (the default is one), see \ref compileAsync().
+  //!
+  //! Threads are started when tasks are queued and none is idle, threads that
+  //! are already running are kept until the context is destroyed.
+  MPSL_API Error setCompileThreads(uint32_t numThreads) noexcept;
+
+  //! Set the number of records a program compiled with `kOptionTiered` has to
+  //! process before it's recompiled with all optimizations (the default is
+  //! 10000). Only programs compiled after the call are affected.
+  MPSL_API Error setTierThreshold(uint32_t numRecords) noexcept;
+
+  //! \internal
+  MPSL_API Error _compileAsync(CompileTask& task, const CompileArgs& ca, uint32_t priority) noexcept;
+
+  //! Compile a program that takes a single argument in background.
+  //!
+  //! The body and layouts are copied and the call returns immediately, `task`
+  //! is replaced by a new task that is done when the program is compiled, use
+  //! `CompileTask::get()` to take it. Tasks of the same priority are compiled
+  //! in the order they were queued, see \ref CompileTask::Priority.
+  //!
+  //! Background compilations use constants added to the context before this
+  //! call. Tasks that are still queued when the last reference to the context
+  //! is released are canceled.
+  //!
+  //! \note Nothing is written to a log, so debug options have no effect. Use
+  //! `Program1<>::compile()` to get error messages of a program that failed.
+  MPSL_INLINE Error compileAsync(CompileTask& task, const char* body, uint32_t options,
+    const Layout& layout0,
+    uint32_t priority = CompileTask::kPriorityInteractive) noexcept {
+
+    CompileArgs args(body, Globals::kInvalidIndex, options, 1);
+    args.layout[0] = &layout0;
+    return _compileAsync(task, args, priority);
+  }
+
+  //! \overload
+  MPSL_INLINE Error compileAsync(CompileTask& task, const StringRef& body, uint32_t options,
+    const Layout& layout0,
+    uint32_t priority = CompileTask::kPriorityInteractive) noexcept {
+
+    CompileArgs args(body.data(), body.size(), options, 1);
+    args.layout[0] = &layout0;
+    return _compileAsync(task, args, priority);
+  }
+
+  //! Compile a program that takes two arguments in background.
+  MPSL_INLINE Error compileAsync(CompileTask& task, const char* body, uint32_t options,
+    const Layout& layout0,
+    const Layout& layout1,
+    uint32_t priority = CompileTask::kPriorityInteractive) noexcept {
+
+    CompileArgs args(body, Globals::kInvalidIndex, options, 2);
+    args.layout[0] = &layout0;
+    args.layout[1] = &layout1;
+    return _compileAsync(task, args, priority);
+  }
+
+  //! \overload
+  MPSL_INLINE Error compileAsync(CompileTask& task, const StringRef& body, uint32_t options,
+    const Layout& layout0,
+    const Layout& layout1,
+    uint32_t priority = CompileTask::kPriorityInteractive) noexcept {
+
+    CompileArgs args(body.data(), body.size(), options, 2);
+    args.layout[0] = &layout0;
+    args.layout[1] = &layout1;
+    return _compileAsync(task, args, priority);
+  }
+
+  //! Compile a program that takes three arguments in background.
+  MPSL_INLINE Error compileAsync(CompileTask& task, const char* body, uint32_t options,
+    const Layout& layout0,
+    const Layout& layout1,
+    const Layout& layout2,
+    uint32_t priority = CompileTask::kPriorityInteractive) noexcept {
+
+    CompileArgs args(body, Globals::kInvalidIndex, options, 3);
+    args.layout[0] = &layout0;
+    args.layout[1] = &layout1;
+    args.layout[2] = &layout2;
+    return _compileAsync(task, args, priority);
+  }
+
+  //! \overload
+  MPSL_INLINE Error compileAsync(CompileTask& task, const StringRef& body, uint32_t options,
+    const Layout& layout0,
+    const Layout& layout1,
+    const Layout& layout2,
+    uint32_t priority = CompileTask::kPriorityInteractive) noexcept {
+
+    CompileArgs args(body.data(), body.size(), options, 3);
+    args.layout[0] = &layout0;
+    args.layout[1] = &layout1;
+    args.layout[2] = &layout2;
+    return _compileAsync(task, args, priority);
+  }
+
+  //! Compile a program that takes four arguments in background.
+  MPSL_INLINE Error compileAsync(CompileTask& task, const char* body, uint32_t options,
+    const Layout& layout0,
+    const Layout& layout1,
+    const Layout& layout2,
+    const Layout& layout3,
+    uint32_t priority = CompileTask::kPriorityInteractive) noexcept {
+
+    CompileArgs args(body, Globals::kInvalidIndex, options, 4);
+    args.layout[0] = &layout0;
+    args.layout[1] = &layout1;
+    args.layout[2] = &layout2;
+    args.layout[3] = &layout3;
+    return _compileAsync(task, args, priority);
+  }
+
+  //! \overload
+  MPSL_INLINE Error compileAsync(CompileTask& task, const StringRef& body, uint32_t options,
+    const Layout& layout0,
+    const Layout& layout1,
+    const Layout& layout2,
+    const Layout& layout3,
+    uint32_t priority = CompileTask::kPriorityInteractive) noexcept {
+
+    CompileArgs args(body.data(), body.size(), options, 4);
+    args.layout[0] = &layout0;
+    args.layout[1] = &layout1;
+    args.layout[2] = &layout2;
+    args.layout[3] = &layout3;
+    return _compileAsync(task, args, priority);
+  }
+
   // --------------------------------------------------------------------------
   // [Operator Overload]
   // --------------------------------------------------------------------------
@@ -780,11 +1321,34 @@ struct Context {
   Impl* _d;
 };
 
+// ============================================================================
+// [mpsl::mpLoadAcquire]
+// ============================================================================
+
+//! \internal
+//!
+//! Load `*p` with acquire semantics - loads that follow can't be moved before
+//! it. Pairs with the release store that publishes a new entry-point of a
+//! tiered program, so the code it points to is visible when it's called.
+template<typename T>
+static MPSL_INLINE T mpLoadAcquire(const T* p) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#else
+  // MSVC gives volatile accesses acquire/release semantics.
+  return *(const T volatile *)p;
+#endif
+}
+
 // ============================================================================
 // [mpsl::Program]
 // ============================================================================
 
 //! A base class for a shader program.
+//!
+//! \note Assigning a program releases the old one, its machine code is freed
+//! when the last weak-copy is released, even if another thread still runs it.
+//! Use `ProgramSlot` to replace a program that other threads are running.
 struct Program {
   // --------------------------------------------------------------------------
   // [Impl]
@@ -801,9 +1365,25 @@ struct Program {
     //! Prototype of `main()` that accepts four arguments.
     typedef Error (MPSL_CDECL *MainFunc4)(void* arg1, void* arg2, void* arg3, void* arg4);
 
+    //! Prototype of `batch()` that runs `main()` over records `[index, index
+    //! + count)`.
+    //!
+    //! Record `n` of argument `i` is at `args[i] + n * strides[i]`; a zero
+    //! stride passes the same data to all records. SPMD programs use `index`
+    //! as the first lane and ignore strides.
+    typedef Error (MPSL_CDECL *BatchFunc)(void** args, const intptr_t* strides, size_t index, size_t count);
+
     // Implemented in `mpsl.cpp`.
     MPSL_INLINE void destroy() noexcept;
 
+    //! Get the `main()` entry-point with acquire semantics, tiered compilation
+    //! replaces it while the program can run in other threads.
+    template<typename Func>
+    MPSL_INLINE Func mainFunc() const noexcept { return reinterpret_cast<Func>(mpLoadAcquire(&_main)); }
+
+    //! Get the `batch()` entry-point with acquire semantics, see \ref mainFunc().
+    MPSL_INLINE BatchFunc batchFunc() const noexcept { return mpLoadAcquire(&_batch); }
+
     //! Reference count.
     uintptr_t _refCount;
     //! Runtime data (set by \ref Context).
@@ -818,10 +1398,26 @@ struct Program {
       MainFunc4 _main4;
     };
 
+    //! Compiled `batch()` entry-point, shares the code-block with `_main`.
+    BatchFunc _batch;
+
     //! Number of arguments that is passed to the entry-point.
     uint32_t _argsCount;
     //! Size of the compiled function (in bytes).
     uint32_t _programSize;
+
+    //! Tiering data, null if the program was not compiled with `kOptionTiered`.
+    void* _tierData;
+    //! Uniform block, null if the program has no uniform members.
+    void* _uniformData;
+  };
+
+  //! Tier of the compiled code.
+  enum Tier {
+    //! Baseline code of a program compiled with `kOptionTiered`.
+    kTierBaseline = 0,
+    //! Code compiled with all optimizations.
+    kTierOptimized = 1
   };
 
   // --------------------------------------------------------------------------
@@ -846,7 +1442,46 @@ struct Program {
   // --------------------------------------------------------------------------
 
   //! Get whether the program has been compiled and is valid.
-  MPSL_INLINE bool isValid() const noexcept { return _d->_main != nullptr; }
+  MPSL_INLINE bool isValid() const noexcept { return _d->mainFunc<void*>() != nullptr; }
+
+  //! Get the tier of the code the program runs, see \ref Tier.
+  MPSL_API uint32_t tier() const noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Tiering]
+  // --------------------------------------------------------------------------
+
+  //! Recompile a program compiled with `kOptionTiered` with all optimizations
+  //! now instead of when it gets hot, and wait for it if `wait` is true.
+  //!
+  //! Returns the error of the recompilation if waiting, `kErrorCanceled` if
+  //! the context was destroyed before. Does nothing if the program is not
+  //! tiered or was already optimized.
+  MPSL_API Error tierUp(bool wait = true) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Uniforms]
+  // --------------------------------------------------------------------------
+
+  //! \internal
+  MPSL_API Error _setUniform(const char* name, size_t nameSize, const Value& value) noexcept;
+
+  //! Change the uniform member `name` (see `Layout::addUniform()`) to `value`.
+  //!
+  //! The first layout that has a uniform `name` is used. Calls that start
+  //! after `setUniform()` returns see the new value. A call that runs at the
+  //! same time in another thread sees either the old or the new value, also
+  //! if it's wider than a pointer (the program reloads uniforms that were
+  //! changed while it loaded them). Returns `kErrorInvalidArgument` if the
+  //! program doesn't have such uniform.
+  MPSL_INLINE Error setUniform(const char* name, const Value& value) noexcept {
+    return _setUniform(name, Globals::kInvalidIndex, value);
+  }
+
+  //! \overload
+  MPSL_INLINE Error setUniform(const StringRef& name, const Value& value) noexcept {
+    return _setUniform(name.data(), name.size(), value);
+  }
 
   // --------------------------------------------------------------------------
   // [Operator Overload]
@@ -869,6 +1504,295 @@ public:
   Impl* _d;
 };
 
+// ============================================================================
+// [mpsl::ProgramSlot]
+// ============================================================================
+
+//! A program that can be replaced while other threads run it.
+//!
+//! Writers replace the program by `publish()`, readers run it through their
+//! own `ProgramSlotReader`. Replaced programs are retired instead of being
+//! released, a retired program is released by `reclaim()` (also called by
+//! `publish()`) after all readers that could have seen it leave the read-side
+//! section. Readers never block and never modify memory shared with other
+//! readers, only their own epoch (epoch-based reclamation).
+struct ProgramSlot {
+  // --------------------------------------------------------------------------
+  // [Impl]
+  // --------------------------------------------------------------------------
+
+  //! \internal
+  struct Impl {
+    //! Implemented in `mpprogramslot.cpp`.
+    MPSL_INLINE void destroy() noexcept;
+
+    //! Reference count.
+    uintptr_t _refCount;
+    //! Versions and readers of the slot.
+    void* _slotData;
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a weak-copy of null slot (can't hold a program).
+  MPSL_API ProgramSlot() noexcept;
+  //! Create a weak-copy of `other` slot.
+  MPSL_API ProgramSlot(const ProgramSlot& other) noexcept;
+  //! Destroy the slot.
+  MPSL_API ~ProgramSlot() noexcept;
+
+  //! Create a new empty slot.
+  static MPSL_API ProgramSlot create() noexcept;
+
+#if defined(MPSL_EXPORTS)
+  explicit MPSL_INLINE ProgramSlot(Impl* d) noexcept : _d(d) {}
+#endif // MPSL_EXPORTS
+
+  // --------------------------------------------------------------------------
+  // [Reset]
+  // --------------------------------------------------------------------------
+
+  //! Reset the slot.
+  MPSL_API Error reset() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  MPSL_INLINE bool isValid() const noexcept { return _d->_slotData != nullptr; }
+
+  //! Get the count of retired programs that were not released yet.
+  MPSL_API size_t retiredCount() const noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Replace the program of the slot by `program`.
+  //!
+  //! Readers that enter after this call run `program`, readers that are in a
+  //! read-side section keep running the previous program, which is retired.
+  //! The program must accept the same arguments as readers expect.
+  MPSL_API Error publish(const Program& program) noexcept;
+
+  //! Release retired programs that can't be run by any reader anymore.
+  MPSL_API Error reclaim() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Operator Overload]
+  // --------------------------------------------------------------------------
+
+  //! Assign a weak-copy of `other` slot.
+  MPSL_API ProgramSlot& operator=(const ProgramSlot& other) noexcept;
+
+  //! Equality, only true if `other` is the same weak-copy of the slot.
+  MPSL_INLINE bool operator==(const ProgramSlot& other) const noexcept { return _d == other._d; }
+  //! Inequality.
+  MPSL_INLINE bool operator!=(const ProgramSlot& other) const noexcept { return _d != other._d; }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Slot data (private).
+  Impl* _d;
+};
+
+//! \internal
+//!
+//! Base of `ProgramSlotReader<>`, registers the reader to the slot.
+struct ProgramSlotReaderBase {
+  MPSL_NONCOPYABLE(ProgramSlotReaderBase)
+
+  //! Register a reader of `slot`, which is kept alive by the reader.
+  MPSL_API ProgramSlotReaderBase(const ProgramSlot& slot) noexcept;
+  //! Unregister the reader.
+  MPSL_API ~ProgramSlotReaderBase() noexcept;
+
+  //! Get whether the reader was registered (fails only if out of memory).
+  MPSL_INLINE bool isValid() const noexcept { return _readerData != nullptr; }
+
+  //! \internal
+  //!
+  //! Announce the reader and borrow the current program to `program`.
+  MPSL_API void _enter(Program& program) noexcept;
+  //! \internal
+  //!
+  //! Stop borrowing `program` and make the reader quiescent.
+  MPSL_API void _leave(Program& program) noexcept;
+
+  //! Slot the reader belongs to.
+  ProgramSlot _slot;
+  //! Reader record (private).
+  void* _readerData;
+};
+
+//! Reader of a `ProgramSlot`, each thread that runs the program has its own.
+//!
+//! A program returned by `enter()` is valid until `leave()`, which must be
+//! called by the same thread. Both are cheap - `enter()` stores the current
+//! epoch of the slot to the reader and loads the program, `leave()` clears
+//! the epoch. Read-side sections can't be nested. The returned program is
+//! borrowed, it's not valid if nothing was published yet.
+//!
+//! ```
+//! mpsl::ProgramSlotReader< mpsl::Program1<Args> > reader(slot);
+//!
+//! const mpsl::Program1<Args>& program = reader.enter();
+//! if (program.isValid())
+//!   program.run(&args);
+//! reader.leave();
+//! ```
+template<typename ProgramT>
+struct ProgramSlotReader : public ProgramSlotReaderBase {
+  MPSL_NONCOPYABLE(ProgramSlotReader)
+
+  MPSL_INLINE ProgramSlotReader(const ProgramSlot& slot) noexcept
+    : ProgramSlotReaderBase(slot) {}
+  MPSL_INLINE ~ProgramSlotReader() noexcept { _leave(_program); }
+
+  //! Enter a read-side section and get the current program.
+  MPSL_INLINE const ProgramT& enter() noexcept {
+    _enter(_program);
+    return _program;
+  }
+
+  //! Leave the read-side section.
+  MPSL_INLINE void leave() noexcept { _leave(_program); }
+
+  //! Program borrowed from the slot.
+  ProgramT _program;
+};
+
+// ============================================================================
+// [mpsl::Executor]
+// ============================================================================
+
+//! Executor runs batches of records on a pool of worker threads.
+//!
+//! A submitted batch is split into chunks of `grainSize()` records that are
+//! distributed across all participants. A participant that runs out of its
+//! own records steals a half of the records left to another one. The thread
+//! that calls `wait()` participates as well, so an executor that has no
+//! worker threads runs everything within `wait()`.
+//!
+//! Compiled programs are re-entrant, so a single `Program` can be executed
+//! by all workers at the same time.
+struct Executor {
+  //! Executor flags.
+  enum Flags {
+    //! Pin the worker thread `i` to the logical CPU `i`.
+    kFlagPinThreads = 0x0001
+  };
+
+  //! Use one worker thread less than the number of logical CPUs, the thread
+  //! that calls `wait()` is the remaining one.
+  static const uint32_t kAutoThreads = 0xFFFFFFFFu;
+
+  // --------------------------------------------------------------------------
+  // [Impl]
+  // --------------------------------------------------------------------------
+
+  //! \internal
+  struct Impl {
+    //! Implemented in `mpexecutor.cpp`.
+    MPSL_INLINE void destroy() noexcept;
+
+    //! Reference count.
+    uintptr_t _refCount;
+    //! Thread pool data.
+    void* _poolData;
+    //! Grain size (number of records of a chunk), zero if automatic.
+    size_t _grainSize;
+    //! Number of worker threads.
+    uint32_t _numThreads;
+    //! Executor flags, see \ref Flags.
+    uint32_t _flags;
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  //! Create a weak-copy of null executor (can't run anything).
+  MPSL_API Executor() noexcept;
+  //! Create a weak-copy of `other` executor.
+  MPSL_API Executor(const Executor& other) noexcept;
+  //! Destroy the executor, the last reference joins all worker threads.
+  MPSL_API ~Executor() noexcept;
+
+  //! Create a new executor having `numThreads` worker threads.
+  static MPSL_API Executor create(uint32_t numThreads = kAutoThreads, uint32_t flags = 0) noexcept;
+
+#if defined(MPSL_EXPORTS)
+  explicit MPSL_INLINE Executor(Impl* d) noexcept : _d(d) {}
+#endif // MPSL_EXPORTS
+
+  // --------------------------------------------------------------------------
+  // [Reset]
+  // --------------------------------------------------------------------------
+
+  //! Reset the executor.
+  MPSL_API Error reset() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Accessors]
+  // --------------------------------------------------------------------------
+
+  MPSL_INLINE bool isValid() const noexcept { return _d->_poolData != nullptr; }
+
+  //! Get the number of worker threads.
+  MPSL_INLINE uint32_t numThreads() const noexcept { return _d->_numThreads; }
+  //! Get executor flags, see \ref Flags.
+  MPSL_INLINE uint32_t flags() const noexcept { return _d->_flags; }
+
+  //! Get the number of records processed as a single chunk, zero if it's
+  //! calculated per batch so a chunk fits into the CPU cache.
+  MPSL_API size_t grainSize() const noexcept;
+  //! Set the number of records processed as a single chunk (zero - automatic).
+  //!
+  //! Only batches submitted after the change are affected.
+  MPSL_API Error setGrainSize(size_t grainSize) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! \internal
+  //!
+  //! Submit `count` records of `program` to be executed, see `Program1<>::
+  //! submitBatch()` and others.
+  MPSL_API Error _submit(const Program& program, uint32_t numArgs, void* const* args, const intptr_t* strides, size_t count) noexcept;
+
+  //! Wait until all submitted batches finish.
+  //!
+  //! The calling thread helps to process the remaining records, a batch is
+  //! joined by one of the threads that wait at the same time only. Returns
+  //! the first error reported by a batch submitted since the last `wait()`.
+  MPSL_API Error wait() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Operator Overload]
+  // --------------------------------------------------------------------------
+
+  //! Assign a weak-copy of `other` executor.
+  MPSL_API Executor& operator=(const Executor& other) noexcept;
+
+  //! Equality, only true if `other` is the same weak-copy of the executor.
+  MPSL_INLINE bool operator==(const Executor& other) const noexcept { return _d == other._d; }
+  //! Inequality.
+  MPSL_INLINE bool operator!=(const Executor& other) const noexcept { return _d != other._d; }
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  //! Executor data (private).
+  Impl* _d;
+};
+
 // ============================================================================
 // [mpsl::Program1<T1>]
 // ============================================================================
@@ -899,8 +1823,41 @@ struct Program1 : public Program {
     return context._compile(*this, args, log);
   }
 
+  //! Run the program.
+  //!
+  //! \note A program compiled with `kOptionSPMD` processes exactly
+  //! `Globals::kSPMDLanes` records per `run()`.
   MPSL_INLINE Error run(T0* a0) const noexcept {
-    return _d->_main1((void*)a0);
+    return _d->mainFunc<Impl::MainFunc1>()((void*)a0);
+  }
+
+  //! Run the program `count` times, advancing `a0` by `stride0` bytes after
+  //! each run. The loop is part of the compiled code, which makes it much
+  //! cheaper than calling `run()` per record.
+  //!
+  //! \note Strides are ignored by programs compiled with `kOptionSPMD`, these
+  //! index columns of structure-of-arrays layouts by a record index instead.
+  MPSL_INLINE Error runBatch(T0* a0, size_t count, size_t stride0) const noexcept {
+    void* args[kNumArgs] = { (void*)a0 };
+    intptr_t strides[kNumArgs] = { (intptr_t)stride0 };
+    return _d->batchFunc()(args, strides, 0, count);
+  }
+
+  //! Submit `count` records to `executor`, see `runBatch()` for the meaning
+  //! of arguments. The call returns immediately, use `Executor::wait()` to
+  //! wait for the result.
+  MPSL_INLINE Error submitBatch(Executor& executor, T0* a0, size_t count, size_t stride0) const noexcept {
+    void* args[kNumArgs] = { (void*)a0 };
+    intptr_t strides[kNumArgs] = { (intptr_t)stride0 };
+    return executor._submit(*this, kNumArgs, args, strides, count);
+  }
+
+  //! Run `count` records by using all threads of `executor`, the same as
+  //! `submitBatch()` followed by `Executor::wait()`.
+  MPSL_INLINE Error runParallel(Executor& executor, T0* a0, size_t count, size_t stride0) const noexcept {
+    Error err = submitBatch(executor, a0, count, stride0);
+    if (err != kErrorOk) return err;
+    return executor.wait();
   }
 
   MPSL_INLINE Program1& operator=(const Program1& other) noexcept {
@@ -944,7 +1901,25 @@ struct Program2 : public Program {
   }
 
   MPSL_INLINE Error run(T0* a0, T1* a1) const noexcept {
-    return _d->_main2((void*)a0, (void*)a1);
+    return _d->mainFunc<Impl::MainFunc2>()((void*)a0, (void*)a1);
+  }
+
+  MPSL_INLINE Error runBatch(T0* a0, T1* a1, size_t count, size_t stride0, size_t stride1) const noexcept {
+    void* args[kNumArgs] = { (void*)a0, (void*)a1 };
+    intptr_t strides[kNumArgs] = { (intptr_t)stride0, (intptr_t)stride1 };
+    return _d->batchFunc()(args, strides, 0, count);
+  }
+
+  MPSL_INLINE Error submitBatch(Executor& executor, T0* a0, T1* a1, size_t count, size_t stride0, size_t stride1) const noexcept {
+    void* args[kNumArgs] = { (void*)a0, (void*)a1 };
+    intptr_t strides[kNumArgs] = { (intptr_t)stride0, (intptr_t)stride1 };
+    return executor._submit(*this, kNumArgs, args, strides, count);
+  }
+
+  MPSL_INLINE Error runParallel(Executor& executor, T0* a0, T1* a1, size_t count, size_t stride0, size_t stride1) const noexcept {
+    Error err = submitBatch(executor, a0, a1, count, stride0, stride1);
+    if (err != kErrorOk) return err;
+    return executor.wait();
   }
 
   MPSL_INLINE Program2& operator=(const Program2& other) noexcept {
@@ -992,7 +1967,25 @@ struct Program3 : public Program {
   }
 
   MPSL_INLINE Error run(T1* a1, T2* a2, T3* a3) const noexcept {
-    return _d->_main3((void*)a1, (void*)a2, (void*)a3);
+    return _d->mainFunc<Impl::MainFunc3>()((void*)a1, (void*)a2, (void*)a3);
+  }
+
+  MPSL_INLINE Error runBatch(T1* a1, T2* a2, T3* a3, size_t count, size_t stride1, size_t stride2, size_t stride3) const noexcept {
+    void* args[kNumArgs] = { (void*)a1, (void*)a2, (void*)a3 };
+    intptr_t strides[kNumArgs] = { (intptr_t)stride1, (intptr_t)stride2, (intptr_t)stride3 };
+    return _d->batchFunc()(args, strides, 0, count);
+  }
+
+  MPSL_INLINE Error submitBatch(Executor& executor, T1* a1, T2* a2, T3* a3, size_t count, size_t stride1, size_t stride2, size_t stride3) const noexcept {
+    void* args[kNumArgs] = { (void*)a1, (void*)a2, (void*)a3 };
+    intptr_t strides[kNumArgs] = { (intptr_t)stride1, (intptr_t)stride2, (intptr_t)stride3 };
+    return executor._submit(*this, kNumArgs, args, strides, count);
+  }
+
+  MPSL_INLINE Error runParallel(Executor& executor, T1* a1, T2* a2, T3* a3, size_t count, size_t stride1, size_t stride2, size_t stride3) const noexcept {
+    Error err = submitBatch(executor, a1, a2, a3, count, stride1, stride2, stride3);
+    if (err != kErrorOk) return err;
+    return executor.wait();
   }
 
   MPSL_INLINE Program3& operator=(const Program3& other) noexcept {
@@ -1044,7 +2037,25 @@ struct Program4 : public Program {
   }
 
   MPSL_INLINE Error run(T1* a1, T2* a2, T3* a3, T4* a4) const noexcept {
-    return _d->_main4((void*)a1, (void*)a2, (void*)a3, (void*)a4);
+    return _d->mainFunc<Impl::MainFunc4>()((void*)a1, (void*)a2, (void*)a3, (void*)a4);
+  }
+
+  MPSL_INLINE Error runBatch(T1* a1, T2* a2, T3* a3, T4* a4, size_t count, size_t stride1, size_t stride2, size_t stride3, size_t stride4) const noexcept {
+    void* args[kNumArgs] = { (void*)a1, (void*)a2, (void*)a3, (void*)a4 };
+    intptr_t strides[kNumArgs] = { (intptr_t)stride1, (intptr_t)stride2, (intptr_t)stride3, (intptr_t)stride4 };
+    return _d->batchFunc()(args, strides, 0, count);
+  }
+
+  MPSL_INLINE Error submitBatch(Executor& executor, T1* a1, T2* a2, T3* a3, T4* a4, size_t count, size_t stride1, size_t stride2, size_t stride3, size_t stride4) const noexcept {
+    void* args[kNumArgs] = { (void*)a1, (void*)a2, (void*)a3, (void*)a4 };
+    intptr_t strides[kNumArgs] = { (intptr_t)stride1, (intptr_t)stride2, (intptr_t)stride3, (intptr_t)stride4 };
+    return executor._submit(*this, kNumArgs, args, strides, count);
+  }
+
+  MPSL_INLINE Error runParallel(Executor& executor, T1* a1, T2* a2, T3* a3, T4* a4, size_t count, size_t stride1, size_t stride2, size_t stride3, size_t stride4) const noexcept {
+    Error err = submitBatch(executor, a1, a2, a3, a4, count, stride1, stride2, stride3, stride4);
+    if (err != kErrorOk) return err;
+    return executor.wait();
   }
 
   MPSL_INLINE Program4& operator=(const Program4& other) noexcept {
@@ -110,10 +110,8 @@ namespace mpsl {
 // [Reuse]
 // ============================================================================
 
-// Reuse these classes for internal use as we depend on asmjit anyway.
-using asmjit::Lock;
-using asmjit::ScopedLock;
-
+// Reuse these classes for internal use as we depend on asmjit anyway. Locks
+// are provided by "mpthread_p.h" as they have to work with condition variables.
 using asmjit::String;
 using asmjit::StringTmp;
 
@@ -126,6 +124,8 @@ using asmjit::ZoneAllocator;
 // ============================================================================
 
 enum { kInvalidDataSlot = 0xFF };
+//! Data slot of the uniform block, follows slots of all arguments.
+enum { kUniformDataSlot = Globals::kMaxArgumentsCount };
 enum { kInvalidRegId = asmjit::BaseReg::kIdBad };
 enum { kPointerWidth = static_cast<int>(sizeof(void*)) };
 
@@ -147,6 +147,14 @@ enum InternalOptions {
   kInternalOptionLog = 0x10000000
 };
 
+//! \internal
+//!
+//! Get the optimization level of `options` (0 to 2), see \ref kOptionO0.
+static MPSL_INLINE uint32_t mpGetOptLevel(uint32_t options) noexcept {
+  uint32_t level = options & kOptionOptLevelMask;
+  return level == 0 ? 2u : (level >> 14) - 1;
+}
+
 // ============================================================================
 // [mpsl::mpAssertionFailed]
 // ============================================================================
@@ -168,46 +176,48 @@ void mpAssertionFailed(const char* exp, const char* file, int line) noexcept;
 Error mpTraceError(Error error) noexcept;
 
 // ============================================================================
-// [mpsl::RuntimeData]
+// [mpsl::mpLayoutFind]
 // ============================================================================
 
-class RuntimeData {
-public:
-  MPSL_NONCOPYABLE(RuntimeData)
-
-  // --------------------------------------------------------------------------
-  // [Construction / Destruction]
-  // --------------------------------------------------------------------------
+//! \internal
+//!
+//! Find a member `name` of `size` in `layout` through its hashed index, the
+//! `hashCode` must be `HashUtils::hashString(name, size)`.
+const Layout::Member* mpLayoutFind(const Layout* layout, const char* name, size_t size, uint32_t hashCode) noexcept;
 
-  MPSL_INLINE RuntimeData() noexcept
-    : _refCount(1),
-      _runtime() {}
-  MPSL_INLINE ~RuntimeData() noexcept {}
+// ============================================================================
+// [mpsl::mpLayoutCopy]
+// ============================================================================
 
-  // --------------------------------------------------------------------------
-  // [Internal]
-  // --------------------------------------------------------------------------
+//! \internal
+//!
+//! Copy the name, members, and flags of `src` to an empty layout `dst`.
+Error mpLayoutCopy(Layout* dst, const Layout* src) noexcept;
 
-  MPSL_INLINE void destroy() noexcept {
-    this->~RuntimeData();
-    ::free(this);
-  }
+// ============================================================================
+// [mpsl::mpLayoutUniformsSize]
+// ============================================================================
 
-  // --------------------------------------------------------------------------
-  // [Accessors]
-  // --------------------------------------------------------------------------
+//! \internal
+//!
+//! Get the size of uniform members of `layout` in the uniform block (in bytes).
+uint32_t mpLayoutUniformsSize(const Layout* layout) noexcept;
 
-  MPSL_INLINE asmjit::JitRuntime* runtime() const noexcept {
-    return const_cast<asmjit::JitRuntime*>(&_runtime);
-  }
+// ============================================================================
+// [mpsl::mpContextCompile]
+// ============================================================================
 
-  // --------------------------------------------------------------------------
-  // [Members]
-  // --------------------------------------------------------------------------
+class AstBuiltIns;
+struct ProgramUniforms;
 
-  uintptr_t _refCount;                   //!< Reference count.
-  asmjit::JitRuntime _runtime;           //!< JIT runtime.
-};
+//! \internal
+//!
+//! Compile `ca` into `program` by using the context `d` and built-in symbols
+//! `builtIns`, implements `Context::_compile()` and background compilation.
+//!
+//! The program reads uniforms from `uniforms` if given (used to recompile a
+//! tiered program), otherwise a new uniform block is created if needed.
+Error mpContextCompile(Context::Impl* d, AstBuiltIns* builtIns, Program& program, const Context::CompileArgs& ca, OutputLog* log, ProgramUniforms* uniforms = nullptr) noexcept;
 
 // ============================================================================
 // [mpsl::ErrorReporter]
@@ -0,0 +1,215 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _MPSL_MPTHREAD_P_H
+#define _MPSL_MPTHREAD_P_H
+
+// [Dependencies - MPSL]
+#include "./mpsl_p.h"
+
+// [Dependencies - OS]
+#if defined(_WIN32)
+# if !defined(WIN32_LEAN_AND_MEAN)
+#  define WIN32_LEAN_AND_MEAN
+# endif
+# if !defined(NOMINMAX)
+#  define NOMINMAX
+# endif
+# include <windows.h>
+#else
+# include <pthread.h>
+# include <sched.h>
+# include <unistd.h>
+#endif
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::Mutex]
+// ============================================================================
+
+//! \internal
+//!
+//! Lightweight mutex that wraps the native lock.
+class Mutex {
+public:
+  MPSL_NONCOPYABLE(Mutex)
+
+#if defined(_WIN32)
+  MPSL_INLINE Mutex() noexcept { ::InitializeSRWLock(&_handle); }
+  MPSL_INLINE ~Mutex() noexcept {}
+
+  MPSL_INLINE void lock() noexcept { ::AcquireSRWLockExclusive(&_handle); }
+  MPSL_INLINE void unlock() noexcept { ::ReleaseSRWLockExclusive(&_handle); }
+
+  SRWLOCK _handle;
+#else
+  MPSL_INLINE Mutex() noexcept { ::pthread_mutex_init(&_handle, nullptr); }
+  MPSL_INLINE ~Mutex() noexcept { ::pthread_mutex_destroy(&_handle); }
+
+  MPSL_INLINE void lock() noexcept { ::pthread_mutex_lock(&_handle); }
+  MPSL_INLINE void unlock() noexcept { ::pthread_mutex_unlock(&_handle); }
+
+  pthread_mutex_t _handle;
+#endif
+};
+
+//! \internal
+//!
+//! Locks the mutex for the lifetime of the scope.
+class ScopedLock {
+public:
+  MPSL_NONCOPYABLE(ScopedLock)
+
+  MPSL_INLINE ScopedLock(Mutex& mutex) noexcept : _mutex(mutex) { _mutex.lock(); }
+  MPSL_INLINE ~ScopedLock() noexcept { _mutex.unlock(); }
+
+  Mutex& _mutex;
+};
+
+// ============================================================================
+// [mpsl::ConditionVariable]
+// ============================================================================
+
+//! \internal
+class ConditionVariable {
+public:
+  MPSL_NONCOPYABLE(ConditionVariable)
+
+#if defined(_WIN32)
+  MPSL_INLINE ConditionVariable() noexcept { ::InitializeConditionVariable(&_handle); }
+  MPSL_INLINE ~ConditionVariable() noexcept {}
+
+  MPSL_INLINE void wait(Mutex& mutex) noexcept { ::SleepConditionVariableSRW(&_handle, &mutex._handle, INFINITE, 0); }
+  MPSL_INLINE void signal() noexcept { ::WakeConditionVariable(&_handle); }
+  MPSL_INLINE void broadcast() noexcept { ::WakeAllConditionVariable(&_handle); }
+
+  CONDITION_VARIABLE _handle;
+#else
+  MPSL_INLINE ConditionVariable() noexcept { ::pthread_cond_init(&_handle, nullptr); }
+  MPSL_INLINE ~ConditionVariable() noexcept { ::pthread_cond_destroy(&_handle); }
+
+  MPSL_INLINE void wait(Mutex& mutex) noexcept { ::pthread_cond_wait(&_handle, &mutex._handle); }
+  MPSL_INLINE void signal() noexcept { ::pthread_cond_signal(&_handle); }
+  MPSL_INLINE void broadcast() noexcept { ::pthread_cond_broadcast(&_handle); }
+
+  pthread_cond_t _handle;
+#endif
+};
+
+// ============================================================================
+// [mpsl::Thread]
+// ============================================================================
+
+//! \internal
+//!
+//! Native thread, started by `start()` and joined by `join()`.
+class Thread {
+public:
+  MPSL_NONCOPYABLE(Thread)
+
+  typedef void (*Entry)(void* arg);
+
+  MPSL_INLINE Thread() noexcept
+    : _entry(nullptr),
+      _arg(nullptr),
+      _started(false) {}
+  MPSL_INLINE ~Thread() noexcept { MPSL_ASSERT(!_started); }
+
+  //! Get the number of logical CPUs available to the process.
+  static MPSL_INLINE uint32_t cpuCount() noexcept {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? static_cast<uint32_t>(info.dwNumberOfProcessors) : 1u;
+#else
+    long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? static_cast<uint32_t>(n) : 1u;
+#endif
+  }
+
+  //! Pin the calling thread to `cpu`, returns false if not supported.
+  static MPSL_INLINE bool pinCurrent(uint32_t cpu) noexcept {
+#if defined(_WIN32)
+    if (cpu >= sizeof(DWORD_PTR) * 8)
+      return false;
+    return ::SetThreadAffinityMask(::GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set_t), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+  }
+
+  MPSL_INLINE Error start(Entry entry, void* arg) noexcept {
+    MPSL_ASSERT(!_started);
+
+    _entry = entry;
+    _arg = arg;
+
+#if defined(_WIN32)
+    _handle = ::CreateThread(nullptr, 0, _trampoline, this, 0, nullptr);
+    if (_handle == nullptr)
+      return MPSL_TRACE_ERROR(kErrorNoMemory);
+#else
+    if (::pthread_create(&_handle, nullptr, _trampoline, this) != 0)
+      return MPSL_TRACE_ERROR(kErrorNoMemory);
+#endif
+
+    _started = true;
+    return kErrorOk;
+  }
+
+  MPSL_INLINE void join() noexcept {
+    if (!_started)
+      return;
+
+#if defined(_WIN32)
+    ::WaitForSingleObject(_handle, INFINITE);
+    ::CloseHandle(_handle);
+#else
+    ::pthread_join(_handle, nullptr);
+#endif
+
+    _started = false;
+  }
+
+#if defined(_WIN32)
+  static DWORD WINAPI _trampoline(LPVOID self) noexcept {
+    static_cast<Thread*>(self)->_entry(static_cast<Thread*>(self)->_arg);
+    return 0;
+  }
+
+  HANDLE _handle;
+#else
+  static void* _trampoline(void* self) noexcept {
+    static_cast<Thread*>(self)->_entry(static_cast<Thread*>(self)->_arg);
+    return nullptr;
+  }
+
+  pthread_t _handle;
+#endif
+
+  Entry _entry;
+  void* _arg;
+  bool _started;
+};
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
+
+// [Guard]
+#endif // _MPSL_MPTHREAD_P_H
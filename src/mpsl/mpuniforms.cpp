@@ -0,0 +1,153 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define MPSL_EXPORTS
+
+// [Dependencies - MPSL]
+#include "./mplang_p.h"
+#include "./mpuniforms_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::ProgramUniforms - Construction / Destruction]
+// ============================================================================
+
+ProgramUniforms::ProgramUniforms() noexcept
+  : _refCount(1),
+    _data(nullptr),
+    _dataSize(0),
+    _count(0),
+    _entries(nullptr) {}
+
+ProgramUniforms::~ProgramUniforms() noexcept {}
+
+Error ProgramUniforms::create(ProgramUniforms** out, const Context::CompileArgs& ca) noexcept {
+  *out = nullptr;
+
+  uint32_t count = 0;
+  size_t namesSize = 0;
+
+  for (uint32_t slot = 0; slot < ca.numArgs; slot++) {
+    const Layout* layout = ca.layout[slot];
+    const Layout::Member* members = layout->membersArray();
+
+    for (uint32_t i = 0, n = layout->membersCount(); i < n; i++) {
+      if (members[i].isUniform()) {
+        count++;
+        namesSize += members[i].nameSize + 1;
+      }
+    }
+  }
+
+  if (count == 0)
+    return kErrorOk;
+
+  // The header, entries, names, the sequence counter, and the block are a
+  // single allocation, the block is aligned so each uniform can be loaded by
+  // a single instruction.
+  size_t entriesOffset = sizeof(ProgramUniforms);
+  size_t namesOffset = entriesOffset + count * sizeof(Entry);
+  size_t dataSize = count * sizeof(Value);
+
+  uint8_t* p = static_cast<uint8_t*>(::malloc(namesOffset + namesSize + sizeof(Value) - 1 + sizeof(Value) + dataSize));
+  MPSL_NULLCHECK(p);
+
+  ProgramUniforms* self = new(p) ProgramUniforms();
+  char* names = reinterpret_cast<char*>(p + namesOffset);
+
+  uintptr_t data = reinterpret_cast<uintptr_t>(names + namesSize);
+  data = (data + sizeof(Value) - 1) & ~static_cast<uintptr_t>(sizeof(Value) - 1);
+  data += sizeof(Value);
+
+  self->_data = reinterpret_cast<uint8_t*>(data);
+  self->_dataSize = static_cast<uint32_t>(dataSize);
+  self->_count = count;
+  self->_entries = reinterpret_cast<Entry*>(p + entriesOffset);
+  *self->sequence() = 0;
+
+  Entry* entry = self->_entries;
+  uint32_t base = 0;
+
+  for (uint32_t slot = 0; slot < ca.numArgs; slot++) {
+    const Layout* layout = ca.layout[slot];
+    const Layout::Member* members = layout->membersArray();
+
+    for (uint32_t i = 0, n = layout->membersCount(); i < n; i++) {
+      const Layout::Member& m = members[i];
+      if (!m.isUniform())
+        continue;
+
+      ::memcpy(names, m.name, m.nameSize + 1);
+      entry->name = names;
+      entry->nameSize = m.nameSize;
+      entry->typeInfo = m.typeInfo;
+      entry->offset = base + static_cast<uint32_t>(m.offset);
+
+      ::memcpy(self->_data + entry->offset, m.value, sizeof(Value));
+
+      names += m.nameSize + 1;
+      entry++;
+    }
+
+    base += mpLayoutUniformsSize(layout);
+  }
+
+  *out = self;
+  return kErrorOk;
+}
+
+// ============================================================================
+// [mpsl::ProgramUniforms - Interface]
+// ============================================================================
+
+const ProgramUniforms::Entry* ProgramUniforms::find(const char* name, size_t size) const noexcept {
+  for (uint32_t i = 0; i < _count; i++) {
+    const Entry& entry = _entries[i];
+    if (entry.nameSize == size && ::memcmp(entry.name, name, size) == 0)
+      return &entry;
+  }
+
+  return nullptr;
+}
+
+Error ProgramUniforms::set(const char* name, size_t size, const Value& value) noexcept {
+  const Entry* entry = find(name, size);
+  if (entry == nullptr)
+    return MPSL_TRACE_ERROR(kErrorInvalidArgument);
+
+  // Unused bytes are kept zero.
+  Value v;
+  v.zero();
+  ::memcpy(&v, &value, TypeInfo::widthOf(entry->typeInfo));
+
+  const uintptr_t* src = reinterpret_cast<const uintptr_t*>(&v);
+  uintptr_t* dst = reinterpret_cast<uintptr_t*>(_data + entry->offset);
+
+  // The counter is odd while the value is written, the compiled code reloads
+  // uniforms until it reads the same even counter before and after them. Each
+  // store is a release, so the odd counter is visible before any part of the
+  // value and the value before the even counter.
+  ScopedLock lock(_lock);
+  uintptr_t* sequence = this->sequence();
+  uintptr_t seq = mpAtomicGet(sequence);
+
+  mpAtomicSet(sequence, seq + 1);
+  for (size_t i = 0; i < sizeof(Value) / sizeof(uintptr_t); i++)
+    mpAtomicSetRelease(&dst[i], src[i]);
+  mpAtomicSetRelease(sequence, seq + 2);
+
+  return kErrorOk;
+}
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
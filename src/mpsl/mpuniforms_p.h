@@ -0,0 +1,127 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _MPSL_MPUNIFORMS_P_H
+#define _MPSL_MPUNIFORMS_P_H
+
+// [Dependencies - MPSL]
+#include "./mpatomic_p.h"
+#include "./mpsl_p.h"
+#include "./mpthread_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::ProgramUniforms]
+// ============================================================================
+
+//! \internal
+//!
+//! Writable block of uniform members of a compiled program.
+//!
+//! Uniforms of all layouts are stored consecutively, each in a slot of
+//! `sizeof(Value)` bytes, in the order of data slots and in the order they
+//! were added to their layout (see `mpLayoutUniformsSize()`). The compiled
+//! code refers to the block by its absolute address, which is why programs
+//! that have uniforms are never cached. The block is referenced by the
+//! program and by the optimized program of a tiered program, which reads
+//! the same uniforms as its baseline code.
+//!
+//! The block is preceded by a sequence counter (a seqlock), which is odd while
+//! `set()` writes a value. The compiled code loads all uniforms at the start
+//! of the function and loads them again if the counter was odd or changed, so
+//! values wider than a pointer are never seen torn.
+struct ProgramUniforms {
+  MPSL_NONCOPYABLE(ProgramUniforms)
+
+  //! Uniform member.
+  struct Entry {
+    const char* name;                    //!< Member name (located after entries).
+    uint32_t nameSize;                   //!< Member name size.
+    uint32_t typeInfo;                   //!< Member type information.
+    uint32_t offset;                     //!< Offset of the value in `_data`.
+  };
+
+  //! Offset of the sequence counter relative to the uniform block.
+  enum { kSequenceOffset = -static_cast<int>(sizeof(Value)) };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  ProgramUniforms() noexcept;
+  ~ProgramUniforms() noexcept;
+
+  //! Create a block of all uniform members of layouts of `ca` initialized to
+  //! their initial values, `out` is set to null if there are no uniforms.
+  static Error create(ProgramUniforms** out, const Context::CompileArgs& ca) noexcept;
+
+  MPSL_INLINE void destroy() noexcept {
+    this->~ProgramUniforms();
+    ::free(this);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Get the uniform block.
+  MPSL_INLINE void* data() const noexcept { return _data; }
+  //! Get the sequence counter.
+  MPSL_INLINE uintptr_t* sequence() const noexcept {
+    return reinterpret_cast<uintptr_t*>(_data + kSequenceOffset);
+  }
+
+  //! Find the first uniform `name` of `size`.
+  const Entry* find(const char* name, size_t size) const noexcept;
+  //! Store `value` to the uniform `name` of `size`.
+  Error set(const char* name, size_t size, const Value& value) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  uintptr_t _refCount;                   //!< Reference count.
+  Mutex _lock;                           //!< Serializes `set()`.
+
+  uint8_t* _data;                        //!< Uniform block (aligned to `sizeof(Value)`),
+                                         //!< preceded by the sequence counter.
+  uint32_t _dataSize;                    //!< Size of `_data` (in bytes).
+  uint32_t _count;                       //!< Count of `_entries`.
+  Entry* _entries;                       //!< Uniform members.
+};
+
+//! \internal
+//!
+//! Releases uniforms that weren't attached to a program when going out of
+//! scope.
+class ProgramUniformsScope {
+public:
+  MPSL_NONCOPYABLE(ProgramUniformsScope)
+
+  MPSL_INLINE explicit ProgramUniformsScope(ProgramUniforms* uniforms) noexcept
+    : _uniforms(uniforms) {}
+  MPSL_INLINE ~ProgramUniformsScope() noexcept {
+    if (_uniforms) mpObjectRelease(_uniforms);
+  }
+
+  //! Release the uniforms, they are referenced by a program now.
+  MPSL_INLINE void release() noexcept { _uniforms = nullptr; }
+
+  ProgramUniforms* _uniforms;
+};
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
+
+// [Guard]
+#endif // _MPSL_MPUNIFORMS_P_H
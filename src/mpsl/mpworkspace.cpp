@@ -0,0 +1,204 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Export]
+#define MPSL_EXPORTS
+
+// [Dependencies - MPSL]
+#include "./mpworkspace_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::CompileWorkspace - Construction / Destruction]
+// ============================================================================
+
+CompileWorkspace::CompileWorkspace(size_t blockSize) noexcept
+  : _next(nullptr),
+    _blockSize(blockSize),
+    _zone(blockSize - Zone::kBlockOverhead),
+    _allocator(&_zone),
+    _code(),
+    _compiler(),
+    _assembler() {}
+CompileWorkspace::~CompileWorkspace() noexcept {}
+
+// ============================================================================
+// [mpsl::CompileWorkspace - Interface]
+// ============================================================================
+
+Error CompileWorkspace::initCode(asmjit::JitRuntime* runtime, asmjit::BaseEmitter* emitter) noexcept {
+  if (_code.init(runtime->codeInfo()) != asmjit::kErrorOk ||
+      _code.attach(emitter) != asmjit::kErrorOk)
+    return MPSL_TRACE_ERROR(kErrorJITFailed);
+
+  return kErrorOk;
+}
+
+size_t CompileWorkspace::zoneUsage() const noexcept {
+  // The current block is used partially, blocks before it are used fully.
+  const Zone::Block* block = _zone._block;
+  size_t size = block->size - _zone.remainingSize();
+
+  while ((block = block->prev) != nullptr)
+    size += block->size;
+  return size;
+}
+
+void CompileWorkspace::reset() noexcept {
+  // Resetting the code detaches the emitter, `_compiler` keeps its own zones.
+  _code.reset();
+
+  _allocator.reset(&_zone);
+  _zone.reset();
+
+  _logger.clear();
+  _sb.clear();
+  _key.clear();
+}
+
+// ============================================================================
+// [mpsl::CompileWorkspacePool - Construction / Destruction]
+// ============================================================================
+
+CompileWorkspacePool::CompileWorkspacePool() noexcept
+  : _idle(nullptr),
+    _idleCount(0),
+    _blockSize(kDefaultBlockSize),
+    _created(0),
+    _reused(0),
+    _peakZoneSize(0),
+    _peakCodeSize(0) {}
+
+CompileWorkspacePool::~CompileWorkspacePool() noexcept {
+  _destroyIdle();
+}
+
+// ============================================================================
+// [mpsl::CompileWorkspacePool - Interface]
+// ============================================================================
+
+static MPSL_INLINE void mpCompileWorkspaceDestroy(CompileWorkspace* ws) noexcept {
+  ws->~CompileWorkspace();
+  ::free(ws);
+}
+
+CompileWorkspace* CompileWorkspacePool::acquire() noexcept {
+  size_t blockSize;
+  {
+    ScopedLock lock(_mutex);
+
+    CompileWorkspace* ws = _idle;
+    if (ws) {
+      _idle = ws->_next;
+      _idleCount--;
+      _reused++;
+
+      ws->_next = nullptr;
+      return ws;
+    }
+
+    blockSize = _blockSize;
+    _created++;
+  }
+
+  void* p = ::malloc(sizeof(CompileWorkspace));
+  if (MPSL_UNLIKELY(p == nullptr))
+    return nullptr;
+  return new(p) CompileWorkspace(blockSize);
+}
+
+void CompileWorkspacePool::release(CompileWorkspace* ws) noexcept {
+  size_t zoneSize = ws->zoneUsage();
+  size_t codeSize = ws->_code.codeSize();
+
+  ws->reset();
+  {
+    ScopedLock lock(_mutex);
+
+    if (_peakZoneSize < zoneSize) _peakZoneSize = zoneSize;
+    if (_peakCodeSize < codeSize) _peakCodeSize = codeSize;
+
+    // Workspaces created before the block size has changed are not kept.
+    if (ws->_blockSize == _blockSize && _idleCount < kMaxIdleCount) {
+      ws->_next = _idle;
+      _idle = ws;
+      _idleCount++;
+      return;
+    }
+  }
+
+  mpCompileWorkspaceDestroy(ws);
+}
+
+void CompileWorkspacePool::setBlockSize(size_t blockSize) noexcept {
+  if (blockSize == 0)
+    blockSize = kDefaultBlockSize;
+
+  // Must be able to hold at least the block header.
+  if (blockSize < 1024)
+    blockSize = 1024;
+
+  ScopedLock lock(_mutex);
+  if (_blockSize != blockSize) {
+    _blockSize = blockSize;
+    _destroyIdle();
+  }
+}
+
+void CompileWorkspacePool::getInfo(Context::WorkspaceInfo& out) noexcept {
+  ScopedLock lock(_mutex);
+
+  out.created = _created;
+  out.reused = _reused;
+  out.idleCount = _idleCount;
+  out.blockSize = _blockSize;
+  out.peakZoneSize = _peakZoneSize;
+  out.peakCodeSize = _peakCodeSize;
+}
+
+// ============================================================================
+// [mpsl::CompileWorkspacePool - Internal]
+// ============================================================================
+
+void CompileWorkspacePool::_destroyIdle() noexcept {
+  CompileWorkspace* ws = _idle;
+  while (ws) {
+    CompileWorkspace* next = ws->_next;
+    mpCompileWorkspaceDestroy(ws);
+    ws = next;
+  }
+
+  _idle = nullptr;
+  _idleCount = 0;
+}
+
+// ============================================================================
+// [mpsl::mpCompileWorkspacePool]
+// ============================================================================
+
+void* mpCompileWorkspacePoolCreate() noexcept {
+  void* p = ::malloc(sizeof(CompileWorkspacePool));
+  if (p == nullptr)
+    return nullptr;
+  return new(p) CompileWorkspacePool();
+}
+
+void mpCompileWorkspacePoolDestroy(void* poolData) noexcept {
+  if (poolData) {
+    CompileWorkspacePool* pool = static_cast<CompileWorkspacePool*>(poolData);
+    pool->~CompileWorkspacePool();
+    ::free(pool);
+  }
+}
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
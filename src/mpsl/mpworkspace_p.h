@@ -0,0 +1,182 @@
+// [MPSL]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Guard]
+#ifndef _MPSL_MPWORKSPACE_P_H
+#define _MPSL_MPWORKSPACE_P_H
+
+// [Dependencies - MPSL]
+#include "./mpsl_p.h"
+#include "./mpthread_p.h"
+
+// [Api-Begin]
+#include "./mpsl_apibegin.h"
+
+namespace mpsl {
+
+// ============================================================================
+// [mpsl::CompileWorkspace]
+// ============================================================================
+
+//! \internal
+//!
+//! Memory used by a single compilation.
+//!
+//! A workspace is reset after each compilation instead of being freed, so
+//! its zone blocks, code buffers, and strings are reused by the next one.
+class CompileWorkspace {
+public:
+  MPSL_NONCOPYABLE(CompileWorkspace)
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  CompileWorkspace(size_t blockSize) noexcept;
+  ~CompileWorkspace() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Prepare `_code` to generate code for `runtime` by `emitter`, which is
+  //! either `_compiler` or `_assembler`.
+  Error initCode(asmjit::JitRuntime* runtime, asmjit::BaseEmitter* emitter) noexcept;
+
+  //! Get the size of zone memory used by the last compilation (in bytes).
+  size_t zoneUsage() const noexcept;
+
+  //! Reset everything, but keep the memory.
+  void reset() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  CompileWorkspace* _next;               //!< Next idle workspace in the pool.
+  size_t _blockSize;                     //!< Size of zone blocks (including overhead).
+
+  Zone _zone;                            //!< Zone used by AST, IR, and IRToX86.
+  ZoneAllocator _allocator;              //!< Zone allocator.
+
+  asmjit::CodeHolder _code;              //!< Code holder, reinitialized by `initCode()`.
+  asmjit::x86::Compiler _compiler;       //!< Compiler, attached by `initCode()`.
+  asmjit::x86::Assembler _assembler;     //!< Assembler, attached by `initCode()`.
+  asmjit::StringLogger _logger;          //!< Logger used by `kOptionDebugASM`.
+
+  String _sb;                            //!< Buffer used by debug output.
+  String _key;                           //!< Key of the program, see `ProgramCache::makeKey()`.
+};
+
+// ============================================================================
+// [mpsl::CompileWorkspacePool]
+// ============================================================================
+
+//! \internal
+//!
+//! Idle compilation workspaces of a `Context`.
+//!
+//! Each compilation takes its own workspace, so concurrent compilations
+//! never share one. Up to `kMaxIdleCount` workspaces are kept when they are
+//! released, which is enough for one per thread that compiles.
+class CompileWorkspacePool {
+public:
+  MPSL_NONCOPYABLE(CompileWorkspacePool)
+
+  enum {
+    //! Default size of zone blocks (including overhead).
+    kDefaultBlockSize = 32768,
+    //! Maximum count of idle workspaces.
+    kMaxIdleCount = 16
+  };
+
+  // --------------------------------------------------------------------------
+  // [Construction / Destruction]
+  // --------------------------------------------------------------------------
+
+  CompileWorkspacePool() noexcept;
+  ~CompileWorkspacePool() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Interface]
+  // --------------------------------------------------------------------------
+
+  //! Get an idle workspace or create a new one, returns null on failure.
+  CompileWorkspace* acquire() noexcept;
+  //! Record statistics of `ws`, then reset and keep it, or destroy it.
+  void release(CompileWorkspace* ws) noexcept;
+
+  void setBlockSize(size_t blockSize) noexcept;
+  void getInfo(Context::WorkspaceInfo& out) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Internal]
+  // --------------------------------------------------------------------------
+
+  void _destroyIdle() noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Members]
+  // --------------------------------------------------------------------------
+
+  Mutex _mutex;                          //!< Guards everything below.
+
+  CompileWorkspace* _idle;               //!< Idle workspaces (linked by `_next`).
+  uint32_t _idleCount;                   //!< Count of idle workspaces.
+  size_t _blockSize;                     //!< Block size of new workspaces.
+
+  uint64_t _created;                     //!< Count of workspaces created.
+  uint64_t _reused;                      //!< Count of compilations that used an idle workspace.
+  size_t _peakZoneSize;                  //!< Peak zone usage of a compilation (in bytes).
+  size_t _peakCodeSize;                  //!< Peak code size of a compilation (in bytes).
+};
+
+// ============================================================================
+// [mpsl::CompileWorkspaceScope]
+// ============================================================================
+
+//! \internal
+//!
+//! Acquires a workspace from the pool and releases it at the end of scope.
+class CompileWorkspaceScope {
+public:
+  MPSL_NONCOPYABLE(CompileWorkspaceScope)
+
+  MPSL_INLINE CompileWorkspaceScope(CompileWorkspacePool* pool) noexcept
+    : _pool(pool),
+      _ws(pool->acquire()) {}
+  MPSL_INLINE ~CompileWorkspaceScope() noexcept {
+    if (_ws) _pool->release(_ws);
+  }
+
+  MPSL_INLINE CompileWorkspace* get() const noexcept { return _ws; }
+  MPSL_INLINE CompileWorkspace* operator->() const noexcept { return _ws; }
+
+  CompileWorkspacePool* _pool;
+  CompileWorkspace* _ws;
+};
+
+// ============================================================================
+// [mpsl::mpCompileWorkspacePool]
+// ============================================================================
+
+//! \internal
+//!
+//! Create a workspace pool stored as `void*` (used by `Context`).
+void* mpCompileWorkspacePoolCreate() noexcept;
+
+//! \internal
+//!
+//! Destroy a workspace pool stored as `void*` (used by `Context`).
+void mpCompileWorkspacePoolDestroy(void* poolData) noexcept;
+
+} // mpsl namespace
+
+// [Api-End]
+#include "./mpsl_apiend.h"
+
+// [Guard]
+#endif // _MPSL_MPWORKSPACE_P_H
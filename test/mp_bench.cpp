@@ -0,0 +1,127 @@
+// [MPSL-Test]
+// MathPresso's Shading Language with JIT Engine for C++.
+//
+// [License]
+// Zlib - See LICENSE.md file in the package.
+
+// [Dependencies]
+#include "./mpsl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// [BenchArgs]
+// ============================================================================
+
+struct BenchArgs {
+  int ia, ib, ic;
+  mpsl::Value ret;
+};
+
+static void initLayout(mpsl::Layout& layout) {
+  layout.addMember("ia"  , mpsl::kTypeInt | mpsl::kTypeRO, MPSL_OFFSET_OF(BenchArgs, ia));
+  layout.addMember("ib"  , mpsl::kTypeInt | mpsl::kTypeRO, MPSL_OFFSET_OF(BenchArgs, ib));
+  layout.addMember("ic"  , mpsl::kTypeInt | mpsl::kTypeRO, MPSL_OFFSET_OF(BenchArgs, ic));
+  layout.addMember("@ret", mpsl::kTypeInt                , MPSL_OFFSET_OF(BenchArgs, ret));
+}
+
+// ============================================================================
+// [BenchConcurrency]
+// ============================================================================
+
+// All threads compile different programs with the same context, compile
+// throughput should scale with the number of threads.
+static void benchConcurrency() {
+  const unsigned int kCompilesPerThread = 200;
+
+  mpsl::LayoutTmp<> layout;
+  initLayout(layout);
+
+  mpsl::Context ctx = mpsl::Context::create();
+  double baseRate = 0.0;
+
+  printf("[Concurrency]\n");
+  for (unsigned int numThreads = 1; numThreads <= 8; numThreads *= 2) {
+    std::atomic<unsigned int> failures(0);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned int t = 0; t < numThreads; t++) {
+      threads.emplace_back([&, t]() {
+        for (unsigned int i = 0; i < kCompilesPerThread; i++) {
+          char src[128];
+          snprintf(src, sizeof(src), "int main() { return ia * %u + ib; }", t * kCompilesPerThread + i);
+
+          mpsl::Program1<BenchArgs> program;
+          if (program.compile(ctx, src, mpsl::kNoOptions, layout) != mpsl::kErrorOk)
+            failures++;
+        }
+      });
+    }
+
+    for (std::thread& thread : threads)
+      thread.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double rate = static_cast<double>(numThreads * kCompilesPerThread) / elapsed.count();
+
+    if (numThreads == 1)
+      baseRate = rate;
+
+    printf("  Threads=%u Compiles/s=%.0f Speedup=%.2fx", numThreads, rate, rate / baseRate);
+    if (failures)
+      printf(" (%u failed)", static_cast<unsigned int>(failures));
+    printf("\n");
+  }
+}
+
+// ============================================================================
+// [BenchOptLevel]
+// ============================================================================
+
+// Compile the same program repeatedly at each optimization level to measure
+// the compilation speed.
+static void benchOptLevel() {
+  const char body[] = "int main() { int s = ia; for (int i = 0; i < ib; i++) s += i * ic; return s + ib * (2 + 3); }";
+  const unsigned int kNumCompiles = 200;
+
+  static const uint32_t levels[] = { mpsl::kOptionO0, mpsl::kOptionO1, mpsl::kOptionO2 };
+  static const char* levelNames[] = { "O0", "O1", "O2" };
+
+  mpsl::LayoutTmp<> layout;
+  initLayout(layout);
+
+  mpsl::Context ctx = mpsl::Context::create();
+
+  printf("[OptLevel]\n");
+  for (unsigned int i = 0; i < 3; i++) {
+    mpsl::Program1<BenchArgs> program;
+    mpsl::Error err = mpsl::kErrorOk;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int n = 0; n < kNumCompiles && err == mpsl::kErrorOk; n++)
+      err = program.compile(ctx, body, levels[i], layout);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (err != mpsl::kErrorOk)
+      printf("  %s: Compilation failed: ERROR 0x%08X\n", levelNames[i], static_cast<unsigned int>(err));
+    else
+      printf("  %s: Compiles/s=%.0f\n", levelNames[i], double(kNumCompiles) / elapsed.count());
+  }
+}
+
+// ============================================================================
+// [Main]
+// ============================================================================
+
+int main(int argc, char* argv[]) {
+  benchConcurrency();
+  benchOptLevel();
+  return 0;
+}
@@ -11,6 +11,9 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <thread>
 
 // ============================================================================
 // [CmdLine]
@@ -89,6 +92,126 @@ static mpsl::Value makeDVal(double x, double y = 0.0, double z = 0.0, double w =
   mpsl::Value v; v.d.set(x, y, z, w); return v;
 }
 
+// Count instructions `inst` in the IR `dump`, only those in loops if `inLoops`
+// is true. A block is in a loop if it's reachable from itself, successors are
+// the targets of jumps at the end of the block.
+static unsigned int countIRInsts(const char* dump, const char* inst, bool inLoops) {
+  enum { kMaxBlocks = 64 };
+
+  unsigned int ids[kMaxBlocks];
+  unsigned int counts[kMaxBlocks];
+  uint64_t reach[kMaxBlocks];
+
+  unsigned int numBlocks = 0;
+  size_t instSize = ::strlen(inst);
+  const char* p;
+
+  for (p = dump; (p = ::strstr(p, ".B")) != nullptr; p += 2) {
+    if ((p == dump || p[-1] == '\n') && numBlocks < kMaxBlocks)
+      ids[numBlocks++] = static_cast<unsigned int>(::strtoul(p + 2, nullptr, 10));
+  }
+
+  int current = -1;
+  for (p = dump; *p; ) {
+    const char* end = ::strchr(p, '\n');
+    if (!end) end = p + ::strlen(p);
+
+    if (p[0] == '.' && p[1] == 'B') {
+      current++;
+      if (current < kMaxBlocks) {
+        counts[current] = 0;
+        reach[current] = 0;
+      }
+    }
+    else if (current >= 0 && current < kMaxBlocks && p[0] == ' ' && p[1] == ' ') {
+      const char* name = p + 2;
+      size_t nameSize = ::strcspn(name, " @\n");
+
+      if (nameSize == instSize && ::memcmp(name, inst, instSize) == 0)
+        counts[current]++;
+
+      if (name[0] == 'j') {
+        for (const char* t = name + nameSize; t < end; t++) {
+          if (t[0] != 'B' || t[-1] == '.')
+            continue;
+
+          unsigned int id = static_cast<unsigned int>(::strtoul(t + 1, nullptr, 10));
+          for (unsigned int i = 0; i < numBlocks; i++)
+            if (ids[i] == id)
+              reach[current] |= uint64_t(1) << i;
+        }
+      }
+    }
+
+    p = *end ? end + 1 : end;
+  }
+
+  // Transitive closure of successors.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (unsigned int i = 0; i < numBlocks; i++) {
+      uint64_t r = reach[i];
+      for (unsigned int j = 0; j < numBlocks; j++)
+        if (reach[i] & (uint64_t(1) << j))
+          r |= reach[j];
+
+      if (r != reach[i]) {
+        reach[i] = r;
+        changed = true;
+      }
+    }
+  }
+
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < numBlocks; i++)
+    if (!inLoops || (reach[i] & (uint64_t(1) << i)))
+      count += counts[i];
+  return count;
+}
+
+// ============================================================================
+// [IRLog]
+// ============================================================================
+
+// Keeps the last IR dump, which is the IR after all passes.
+struct IRLog : public mpsl::OutputLog {
+  IRLog() { dump[0] = '\0'; }
+
+  virtual void log(const Message& msg) noexcept {
+    if (!msg.isDump() || msg.header().size() != 2 || ::memcmp(msg.header().data(), "IR", 2) != 0)
+      return;
+
+    size_t size = msg.content().size();
+    if (size >= sizeof(dump))
+      size = sizeof(dump) - 1;
+
+    ::memcpy(dump, msg.content().data(), size);
+    dump[size] = '\0';
+  }
+
+  char dump[32768];
+};
+
+// ============================================================================
+// [ErrorLog]
+// ============================================================================
+
+// Prints errors and remembers whether any of them has a position.
+struct ErrorLog : public TestLog {
+  ErrorLog() : hasPosition(false) {}
+
+  virtual void log(const Message& msg) noexcept {
+    if (!msg.isError())
+      return;
+
+    TestLog::log(msg);
+    hasPosition |= msg.hasPosition();
+  }
+
+  bool hasPosition;
+};
+
 // ============================================================================
 // [Test]
 // ============================================================================
@@ -97,9 +220,11 @@ class Test {
 public:
   struct Args {
     int ia, ib, ic;
+    int io;
     mpsl::Int2 i2a, i2b, i2c;
     mpsl::Int3 i3a, i3b, i3c;
     mpsl::Int4 i4a, i4b, i4c;
+    mpsl::Int4 i4o;
 
     float fa, fb, fc;
     mpsl::Float2 f2a, f2b, f2c;
@@ -133,7 +258,23 @@ public:
   void printFail(const char* body, const char* fmt, ...);
 
   bool basicTest(const char* body, uint32_t retType, const mpsl::Value& retValue);
+  bool mathTest(const char* body, uint32_t retType, const mpsl::Value& retValue, double epsilon);
+  bool irTest(const char* body, uint32_t retType, const mpsl::Value& retValue, const char* inst, bool inLoops, unsigned int maxCount);
+  bool ioTest(const char* body, int retValue, int ioValue);
   bool failureTest(const char* body);
+  bool spmdTest();
+  bool executorTest();
+  bool executorWaitersTest();
+  bool cacheTest();
+  bool contextTest();
+  bool workspaceTest();
+  bool concurrencyTest();
+  bool asyncTest();
+  bool slotTest();
+  bool tierTest();
+  bool optLevelTest();
+  bool constTest();
+  bool uniformTest();
 
   mpsl::Context _ctx;
   uint32_t _options;
@@ -157,6 +298,7 @@ void Test::initLayout(mpsl::Layout& layout, uint32_t retType) {
   layout.addMember("ia" , mpsl::kTypeInt     | mpsl::kTypeRO, MPSL_OFFSET_OF(Args, ia));
   layout.addMember("ib" , mpsl::kTypeInt     | mpsl::kTypeRO, MPSL_OFFSET_OF(Args, ib));
   layout.addMember("ic" , mpsl::kTypeInt     | mpsl::kTypeRO, MPSL_OFFSET_OF(Args, ic));
+  layout.addMember("io" , mpsl::kTypeInt     | mpsl::kTypeRW, MPSL_OFFSET_OF(Args, io));
 
   layout.addMember("i2a", mpsl::kTypeInt2    | mpsl::kTypeRO, MPSL_OFFSET_OF(Args, i2a));
   layout.addMember("i2b", mpsl::kTypeInt2    | mpsl::kTypeRO, MPSL_OFFSET_OF(Args, i2b));
@@ -169,6 +311,7 @@ void Test::initLayout(mpsl::Layout& layout, uint32_t retType) {
   layout.addMember("i4a", mpsl::kTypeInt4    | mpsl::kTypeRO, MPSL_OFFSET_OF(Args, i4a));
   layout.addMember("i4b", mpsl::kTypeInt4    | mpsl::kTypeRO, MPSL_OFFSET_OF(Args, i4b));
   layout.addMember("i4c", mpsl::kTypeInt4    | mpsl::kTypeRO, MPSL_OFFSET_OF(Args, i4c));
+  layout.addMember("i4o", mpsl::kTypeInt4    | mpsl::kTypeRW, MPSL_OFFSET_OF(Args, i4o));
 
   layout.addMember("fa" , mpsl::kTypeFloat   | mpsl::kTypeRO, MPSL_OFFSET_OF(Args, fa));
   layout.addMember("fb" , mpsl::kTypeFloat   | mpsl::kTypeRO, MPSL_OFFSET_OF(Args, fb));
@@ -209,6 +352,7 @@ void Test::initArgs(Args& args) {
   args.ia = a[0];
   args.ib = b[0];
   args.ic = c[0];
+  args.io = 5;
   args.i2a.set(a[0], a[1]);
   args.i2b.set(b[0], b[1]);
   args.i2c.set(c[0], c[1]);
@@ -218,6 +362,7 @@ void Test::initArgs(Args& args) {
   args.i4a.set(a[0], a[1], a[2], a[3]);
   args.i4b.set(b[0], b[1], b[2], b[3]);
   args.i4c.set(c[0], c[1], c[2], c[3]);
+  args.i4o.set(5, 5, 5, 5);
 
   args.fa = float(a[0]);
   args.fb = float(b[0]);
@@ -267,11 +412,15 @@ void Test::printFail(const char* body, const char* fmt, ...) {
 bool Test::basicTest(const char* body, uint32_t retType, const mpsl::Value& retValue) {
   mpsl::LayoutTmp<1024> layout;
   Args args;
+  Args batchArgs[4];
 
   initLayout(layout, retType);
   initArgs(args);
   printTest(body);
 
+  for (size_t j = 0; j < MPSL_ARRAY_SIZE(batchArgs); j++)
+    batchArgs[j] = args;
+
   TestLog log;
   mpsl::Program1<Args> program;
   mpsl::Error err = program.compile(_ctx, body, _options, layout, &log);
@@ -287,9 +436,22 @@ bool Test::basicTest(const char* body, uint32_t retType, const mpsl::Value& retV
     return false;
   }
 
+  err = program.runBatch(batchArgs, MPSL_ARRAY_SIZE(batchArgs), sizeof(Args));
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "BATCH EXECUTION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
+
   bool isOk = true;
   unsigned int i, n;
 
+  for (i = 0; i < MPSL_ARRAY_SIZE(batchArgs); i++) {
+    if (::memcmp(&batchArgs[i].ret, &args.ret, sizeof(mpsl::Value)) != 0) {
+      printf("[FAIL] batch[%u] doesn't match the result of run()\n", i);
+      isOk = false;
+    }
+  }
+
   switch (retType) {
     case mpsl::kTypeInt : n = 1; goto checkInt;
     case mpsl::kTypeInt2: n = 2; goto checkInt;
@@ -347,77 +509,1316 @@ checkDouble:
   return isOk;
 }
 
-bool Test::failureTest(const char* body) {
+bool Test::mathTest(const char* body, uint32_t retType, const mpsl::Value& retValue, double epsilon) {
+  mpsl::LayoutTmp<1024> layout;
+  Args args;
+
+  initLayout(layout, retType);
+  initArgs(args);
+  printTest(body);
+
+  TestLog log;
+  mpsl::Program1<Args> program;
+  mpsl::Error err = program.compile(_ctx, body, _options, layout, &log);
+
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
+
+  err = program.run(&args);
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "EXECUTION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
+
+  bool isOk = true;
+  bool isDouble = (retType & mpsl::kTypeIdMask) == mpsl::kTypeDouble;
+  unsigned int i, n = (retType & mpsl::kTypeVecMask) >> mpsl::kTypeVecShift;
+
+  if (n == 0)
+    n = 1;
+
+  // Math functions are approximated, compare with a relative tolerance.
+  for (i = 0; i < n; i++) {
+    double x = isDouble ? args.ret.d[i] : static_cast<double>(args.ret.f[i]);
+    double y = isDouble ? retValue.d[i] : static_cast<double>(retValue.f[i]);
+
+    if (!(::fabs(x - y) <= epsilon * ::fabs(y))) {
+      printf("[FAIL] ret[%u] %.17g != Expected(%.17g)\n", i, x, y);
+      isOk = false;
+    }
+  }
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+// Checks the result of `body` like `basicTest()` and that the IR after O2
+// passes has at most `maxCount` instructions `inst` (in loops if `inLoops`).
+bool Test::irTest(const char* body, uint32_t retType, const mpsl::Value& retValue, const char* inst, bool inLoops, unsigned int maxCount) {
+  if (!basicTest(body, retType, retValue))
+    return false;
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, retType);
+
+  // Debug output is never cached, so the program is always compiled.
+  IRLog log;
+  mpsl::Program1<Args> program;
+  uint32_t options = (_options & ~mpsl::kOptionOptLevelMask) | mpsl::kOptionO2 | mpsl::kOptionDebugIR;
+  mpsl::Error err = program.compile(_ctx, body, options, layout, &log);
+
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    _succeeded = false;
+    return false;
+  }
+
+  unsigned int count = countIRInsts(log.dump, inst, inLoops);
+  if (count > maxCount) {
+    printFail(body, "%u '%s' %s> Expected(%u).\n", count, inst, inLoops ? "in loops " : "", maxCount);
+    _succeeded = false;
+    return false;
+  }
+
   return true;
 }
 
-// ============================================================================
-// [Main]
-// ============================================================================
+// Checks the result of `body` like `basicTest()` and the value it leaves in
+// the read/write member `io`.
+bool Test::ioTest(const char* body, int retValue, int ioValue) {
+  mpsl::LayoutTmp<1024> layout;
+  Args args;
+  Args batchArgs[4];
 
-int main(int argc, char* argv[]) {
-  CmdLine cmd(argc, argv);
-  uint32_t options = 0;
+  initLayout(layout, mpsl::kTypeInt);
+  initArgs(args);
+  printTest(body);
 
-  if (cmd.hasKey("--verbose")) options |= mpsl::kOptionVerbose;
-  if (cmd.hasKey("--ast"    )) options |= mpsl::kOptionDebugAst;
-  if (cmd.hasKey("--ir"     )) options |= mpsl::kOptionDebugIR;
-  if (cmd.hasKey("--asm"    )) options |= mpsl::kOptionDebugASM;
+  for (size_t j = 0; j < MPSL_ARRAY_SIZE(batchArgs); j++)
+    batchArgs[j] = args;
 
-  // Variables are initialized to these:
-  //   a[0] = 1; a[1] = 2; a[2] = 3; a[3] = 4;
-  //   b[0] = 9; b[1] = 8; b[2] = 7; b[3] = 6;
-  //   c[0] =-2; c[1] =-3; c[2] =-4; c[3] =-5;
-  Test test(options);
+  TestLog log;
+  mpsl::Program1<Args> program;
+  mpsl::Error err = program.compile(_ctx, body, _options, layout, &log);
 
-  // Test MPSL basics.
-  test.basicTest("int     main() { return ia + ib; }", mpsl::kTypeInt    , makeIVal(10   ));
-  test.basicTest("float   main() { return fa + fb; }", mpsl::kTypeFloat  , makeFVal(10.0f));
-  test.basicTest("double  main() { return da + db; }", mpsl::kTypeDouble , makeDVal(10.0 ));
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
 
-  test.basicTest("int2    main() { return i2a + i2b; }", mpsl::kTypeInt2   , makeIVal(10   , 10   ));
-  test.basicTest("float2  main() { return f2a + f2b; }", mpsl::kTypeFloat2 , makeFVal(10.0f, 10.0f));
-  test.basicTest("double2 main() { return d2a + d2b; }", mpsl::kTypeDouble2, makeDVal(10.0 , 10.0 ));
+  err = program.run(&args);
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "EXECUTION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
 
-  test.basicTest("int3    main() { return i3a + i3b; }", mpsl::kTypeInt3   , makeIVal(10   , 10   , 10   ));
-  test.basicTest("float3  main() { return f3a + f3b; }", mpsl::kTypeFloat3 , makeFVal(10.0f, 10.0f, 10.0f));
-  test.basicTest("double3 main() { return d3a + d3b; }", mpsl::kTypeDouble3, makeDVal(10.0 , 10.0 , 10.0 ));
+  err = program.runBatch(batchArgs, MPSL_ARRAY_SIZE(batchArgs), sizeof(Args));
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "BATCH EXECUTION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
 
-  test.basicTest("int4    main() { return i4a + i4b; }", mpsl::kTypeInt4   , makeIVal(10   , 10   , 10   , 10   ));
-  test.basicTest("float4  main() { return f4a + f4b; }", mpsl::kTypeFloat4 , makeFVal(10.0f, 10.0f, 10.0f, 10.0f));
-  test.basicTest("double4 main() { return d4a + d4b; }", mpsl::kTypeDouble4, makeDVal(10.0 , 10.0 , 10.0 , 10.0 ));
+  bool isOk = true;
+  unsigned int i;
 
-  test.basicTest("int     main() { return (ia + ib) * ic - ia; }", mpsl::kTypeInt    , makeIVal(-21   ));
-  test.basicTest("float   main() { return (fa + fb) * fc - fa; }", mpsl::kTypeFloat  , makeFVal(-21.0f));
-  test.basicTest("double  main() { return (da + db) * dc - da; }", mpsl::kTypeDouble , makeDVal(-21.0 ));
+  if (args.ret.i[0] != retValue || args.io != ioValue) {
+    printf("[FAIL] ret %d, io %d != Expected(%d, %d)\n", args.ret.i[0], args.io, retValue, ioValue);
+    isOk = false;
+  }
 
-  test.basicTest("int2    main() { return (i2a + i2b) * i2c - i2a; }", mpsl::kTypeInt2   , makeIVal(-21   , -32   ));
-  test.basicTest("float2  main() { return (f2a + f2b) * f2c - f2a; }", mpsl::kTypeFloat2 , makeFVal(-21.0f, -32.0f));
-  test.basicTest("double2 main() { return (d2a + d2b) * d2c - d2a; }", mpsl::kTypeDouble2, makeDVal(-21.0 , -32.0 ));
+  for (i = 0; i < MPSL_ARRAY_SIZE(batchArgs); i++) {
+    if (batchArgs[i].ret.i[0] != retValue || batchArgs[i].io != ioValue) {
+      printf("[FAIL] batch[%u] ret %d, io %d != Expected(%d, %d)\n", i, batchArgs[i].ret.i[0], batchArgs[i].io, retValue, ioValue);
+      isOk = false;
+    }
+  }
 
-  test.basicTest("int3    main() { return (i3a + i3b) * i3c - i3a; }", mpsl::kTypeInt3   , makeIVal(-21   , -32   , 37   ));
-  test.basicTest("float3  main() { return (f3a + f3b) * f3c - f3a; }", mpsl::kTypeFloat3 , makeFVal(-21.0f, -32.0f, 37.0f));
-  test.basicTest("double3 main() { return (d3a + d3b) * d3c - d3a; }", mpsl::kTypeDouble3, makeDVal(-21.0 , -32.0 , 37.0 ));
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
 
-  test.basicTest("int4    main() { return (i4a + i4b) * i4c - i4a; }", mpsl::kTypeInt4   , makeIVal(-21   , -32   , 37   , 46   ));
-  test.basicTest("float4  main() { return (f4a + f4b) * f4c - f4a; }", mpsl::kTypeFloat4 , makeFVal(-21.0f, -32.0f, 37.0f, 46.0f));
-  test.basicTest("double4 main() { return (d4a + d4b) * d4c - d4a; }", mpsl::kTypeDouble4, makeDVal(-21.0 , -32.0 , 37.0 , 46.0 ));
+// Checks that `body` doesn't compile and that the error is reported at the
+// position of the code that caused it.
+bool Test::failureTest(const char* body) {
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  printTest(body);
 
-  // Test vector swizzling.
-  test.basicTest("int4    main() { return i4a.xxxx; }", mpsl::kTypeInt4   , makeIVal(1, 1, 1, 1));
-  test.basicTest("int4    main() { return i4a.xyxy; }", mpsl::kTypeInt4   , makeIVal(1, 2, 1, 2));
-  test.basicTest("float4  main() { return f4a.xxxx; }", mpsl::kTypeFloat4 , makeFVal(1, 1, 1, 1));
-  test.basicTest("float4  main() { return f4a.xyxy; }", mpsl::kTypeFloat4 , makeFVal(1, 2, 1, 2));
-  test.basicTest("double4 main() { return d4a.xxxx; }", mpsl::kTypeDouble4, makeDVal(1, 1, 1, 1));
-  test.basicTest("double4 main() { return d4a.xyxy; }", mpsl::kTypeDouble4, makeDVal(1, 2, 1, 2));
+  ErrorLog log;
+  mpsl::Program1<Args> program;
+  mpsl::Error err = program.compile(_ctx, body, _options, layout, &log);
 
-  // Test control flow - branches.
-  test.basicTest("int main() { if (ia == 1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal( 9));
-  test.basicTest("int main() { if (ia != 1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal(-2));
-  test.basicTest("int main() { if (ia >= 1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal( 9));
-  test.basicTest("int main() { if (ia >  1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal(-2));
-  test.basicTest("int main() { if (ia <= 1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal( 9));
-  test.basicTest("int main() { if (ia <  1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal(-2));
+  bool isOk = true;
+  if (err == mpsl::kErrorOk) {
+    printFail(body, "COMPILATION SUCCEEDED.\n");
+    isOk = false;
+  }
+  else if (!log.hasPosition) {
+    printFail(body, "ERROR 0x%08X NOT REPORTED.\n", static_cast<unsigned int>(err));
+    isOk = false;
+  }
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::spmdTest() {
+  // 7 records - one full gang of 4 lanes and partial gangs of 2 and 1 lanes.
+  struct Columns {
+    float fa[7];
+    int ia[7];
+    float ret[7];
+    float guard;
+  };
+
+  struct Uniforms {
+    float fk;
+  };
+
+  // The second kernel diverges - lanes 3..6 take the branch and lanes 5..6
+  // return early, the remaining lanes are merged at the end.
+  static const char* const bodies[] = {
+    "float main() { return fa * fk + (float)ia; }",
+    "float main() { float x = fa; if (ia > 20) { if (fa > 4.0f) return -1.0f; x = x * fk; } return x + 1.0f; }"
+  };
+
+  mpsl::LayoutTmp<> soaLayout;
+  soaLayout.addMember("fa"  , mpsl::kTypeFloat | mpsl::kTypeRO, MPSL_OFFSET_OF(Columns, fa));
+  soaLayout.addMember("ia"  , mpsl::kTypeInt   | mpsl::kTypeRO, MPSL_OFFSET_OF(Columns, ia));
+  soaLayout.addMember("@ret", mpsl::kTypeFloat | mpsl::kTypeWO, MPSL_OFFSET_OF(Columns, ret));
+  soaLayout.setSoA(true);
+
+  mpsl::LayoutTmp<> uniformLayout;
+  uniformLayout.addMember("fk", mpsl::kTypeFloat | mpsl::kTypeRO, MPSL_OFFSET_OF(Uniforms, fk));
+
+  bool allOk = true;
+
+  for (unsigned int k = 0; k < MPSL_ARRAY_SIZE(bodies); k++) {
+    const char* body = bodies[k];
+
+    Columns columns;
+    Uniforms uniforms;
+    unsigned int i;
+
+    for (i = 0; i < 7; i++) {
+      columns.fa[i] = static_cast<float>(i);
+      columns.ia[i] = static_cast<int>(i) * 10;
+      columns.ret[i] = 0.0f;
+    }
+    columns.guard = -1.0f;
+    uniforms.fk = 0.5f;
+
+    printTest(body);
+
+    TestLog log;
+    mpsl::Program2<Columns, Uniforms> program;
+    mpsl::Error err = program.compile(_ctx, body, _options | mpsl::kOptionSPMD, soaLayout, uniformLayout, &log);
+
+    if (err != mpsl::kErrorOk) {
+      printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+      allOk = false;
+      continue;
+    }
+
+    err = program.runBatch(&columns, &uniforms, 7, 0, 0);
+    if (err != mpsl::kErrorOk) {
+      printFail(body, "BATCH EXECUTION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+      allOk = false;
+      continue;
+    }
+
+    bool isOk = true;
+    for (i = 0; i < 7; i++) {
+      float x = columns.ret[i];
+      float y;
+
+      if (k == 0)
+        y = static_cast<float>(i) * 0.5f + static_cast<float>(i * 10);
+      else if (i <= 2)
+        y = static_cast<float>(i) + 1.0f;
+      else if (i <= 4)
+        y = static_cast<float>(i) * 0.5f + 1.0f;
+      else
+        y = -1.0f;
+
+      if (x != y) {
+        printf("[FAIL] ret[%u] %g != Expected(%g)\n", i, x, y);
+        isOk = false;
+      }
+    }
+
+    if (columns.guard != -1.0f) {
+      printf("[FAIL] SPMD tail wrote past the last record\n");
+      isOk = false;
+    }
+
+    if (isOk)
+      printPass(body);
+    else
+      allOk = false;
+  }
+
+  if (!allOk)
+    _succeeded = false;
+  return allOk;
+}
+
+bool Test::executorTest() {
+  // Small grain forces the workers to steal from each other.
+  const size_t kCount = 1000;
+  const char body[] = "int main() { return ia * 3 + ib; }";
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  printTest(body);
+
+  mpsl::Executor executor = mpsl::Executor::create(3);
+  if (!executor.isValid()) {
+    printFail(body, "EXECUTOR CREATION FAILED.\n");
+    return false;
+  }
+
+  executor.setGrainSize(16);
+  _ctx.setExecutor(executor);
+
+  TestLog log;
+  mpsl::Program1<Args> program;
+  mpsl::Error err = program.compile(_ctx, body, _options, layout, &log);
+
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
+
+  Args* records = new Args[kCount];
+  size_t i;
+
+  for (i = 0; i < kCount; i++) {
+    initArgs(records[i]);
+    records[i].ia = static_cast<int>(i);
+  }
+
+  mpsl::Executor attached = _ctx.executor();
+  err = program.runParallel(attached, records, kCount, sizeof(Args));
+  _ctx.setExecutor(mpsl::Executor());
+
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "PARALLEL EXECUTION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    delete[] records;
+    return false;
+  }
+
+  bool isOk = true;
+  for (i = 0; i < kCount; i++) {
+    int x = records[i].ret.i[0];
+    int y = static_cast<int>(i) * 3 + b[0];
+
+    if (x != y) {
+      printf("[FAIL] ret[%u] %d != Expected(%d)\n", static_cast<unsigned int>(i), x, y);
+      isOk = false;
+    }
+  }
+
+  delete[] records;
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::executorWaitersTest() {
+  // Two threads submit batches to the same executor and wait for them at the
+  // same time, both of them join jobs and steal records from the workers.
+  const size_t kCount = 1000;
+  const unsigned int kNumRounds = 50;
+  const char body[] = "int main() { return ia * 3 + ib; }";
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  printTest(body);
+
+  mpsl::Executor executor = mpsl::Executor::create(2);
+  if (!executor.isValid()) {
+    printFail(body, "EXECUTOR CREATION FAILED.\n");
+    return false;
+  }
+
+  executor.setGrainSize(16);
+
+  TestLog log;
+  mpsl::Program1<Args> program;
+  mpsl::Error err = program.compile(_ctx, body, _options, layout, &log);
+
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
+
+  Args* records[2] = { new Args[kCount], new Args[kCount] };
+  unsigned int failures[2] = { 0, 0 };
+
+  for (unsigned int round = 0; round < kNumRounds; round++) {
+    std::thread threads[2];
+
+    for (unsigned int t = 0; t < 2; t++) {
+      threads[t] = std::thread([&, t]() {
+        Args* r = records[t];
+        for (size_t i = 0; i < kCount; i++) {
+          initArgs(r[i]);
+          r[i].ia = static_cast<int>(i + t);
+          r[i].ret.i[0] = -1;
+        }
+
+        if (program.runParallel(executor, r, kCount, sizeof(Args)) != mpsl::kErrorOk) {
+          failures[t]++;
+          return;
+        }
+
+        for (size_t i = 0; i < kCount; i++)
+          if (r[i].ret.i[0] != static_cast<int>(i + t) * 3 + b[0])
+            failures[t]++;
+      });
+    }
+
+    threads[0].join();
+    threads[1].join();
+  }
+
+  delete[] records[0];
+  delete[] records[1];
+
+  bool isOk = failures[0] == 0 && failures[1] == 0;
+  if (!isOk)
+    printf("[FAIL] %u records not processed\n", failures[0] + failures[1]);
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::cacheTest() {
+  const char body[] = "int main() { return ia * 3 + ib; }";
+  const char other[] = "int main() { return ia * 4 + ib; }";
+
+  // Options that write to the log would bypass the cache.
+  uint32_t options = _options & ~(mpsl::kOptionVerbose   |
+                                  mpsl::kOptionDebugAst  |
+                                  mpsl::kOptionDebugIR   |
+                                  mpsl::kOptionDebugASM  );
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  printTest(body);
+
+  mpsl::Context ctx = mpsl::Context::create();
+  ctx.setCacheLimit(1024 * 1024);
+
+  // An implicit optimization level is the same as an explicit O2.
+  uint32_t explicitOptions = options;
+  if ((explicitOptions & mpsl::kOptionOptLevelMask) == 0)
+    explicitOptions |= mpsl::kOptionO2;
+
+  TestLog log;
+  mpsl::Program1<Args> p1, p2, p3, p4;
+
+  mpsl::Error err = p1.compile(ctx, body, options, layout, &log);
+  if (err == mpsl::kErrorOk) err = p2.compile(ctx, body, options, layout, &log);
+  if (err == mpsl::kErrorOk) err = p3.compile(ctx, other, options, layout, &log);
+  if (err == mpsl::kErrorOk) err = p4.compile(ctx, body, explicitOptions, layout, &log);
+
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
+
+  bool isOk = true;
+  mpsl::Context::CacheInfo info;
+  ctx.getCacheInfo(info);
+
+  if (p1 != p2 || p1 != p4 || p1 == p3) {
+    printf("[FAIL] Cached program not shared\n");
+    isOk = false;
+  }
+
+  if (info.hits != 2 || info.misses != 2 || info.entriesCount != 2) {
+    printf("[FAIL] Cache hits=%u misses=%u entries=%u != Expected(2, 2, 2)\n",
+      static_cast<unsigned int>(info.hits),
+      static_cast<unsigned int>(info.misses),
+      static_cast<unsigned int>(info.entriesCount));
+    isOk = false;
+  }
+
+  // Disabling the cache releases its programs, but not the compiled ones.
+  ctx.setCacheLimit(0);
+  ctx.getCacheInfo(info);
+
+  if (info.entriesCount != 0 || info.codeSize != 0) {
+    printf("[FAIL] Cache not empty after it has been disabled\n");
+    isOk = false;
+  }
+
+  Args args;
+  initArgs(args);
+
+  err = p2.run(&args);
+  if (err != mpsl::kErrorOk || args.ret.i[0] != a[0] * 3 + b[0]) {
+    printf("[FAIL] Cached program returned %d != Expected(%d)\n", args.ret.i[0], a[0] * 3 + b[0]);
+    isOk = false;
+  }
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::contextTest() {
+  const char body[] = "int main() { return ia * (int)K + (int)M_PI; }";
+  const char other[] = "int main() { return (int)(K + L); }";
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  printTest(body);
+
+  bool isOk = true;
+  mpsl::Context ctx = mpsl::Context::create();
+  ctx.addConstant("K", 3.0);
+
+  // Built-ins can't be redefined.
+  if (ctx.addConstant("K", 4.0) != mpsl::kErrorAlreadyExists ||
+      ctx.addConstant("M_PI", 3.0) != mpsl::kErrorAlreadyExists) {
+    printf("[FAIL] Redefined a built-in constant\n");
+    isOk = false;
+  }
+
+  // The clone is not frozen and its constants are not visible to `ctx`.
+  mpsl::Context clone = ctx;
+  ctx.freeze();
+  clone.clone();
+
+  if (ctx.addConstant("L", 5.0) != mpsl::kErrorFrozenContext ||
+      clone.addConstant("L", 5.0) != mpsl::kErrorOk) {
+    printf("[FAIL] Frozen context modified or clone not modifiable\n");
+    isOk = false;
+  }
+
+  TestLog log;
+  mpsl::Program1<Args> p1, p2, p3;
+
+  mpsl::Error err = p1.compile(ctx, body, _options, layout, &log);
+  if (err == mpsl::kErrorOk) err = p2.compile(clone, other, _options, layout, &log);
+
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
+
+  if (p3.compile(ctx, other, _options, layout, nullptr) == mpsl::kErrorOk) {
+    printf("[FAIL] Constant of a clone visible to the original context\n");
+    isOk = false;
+  }
+
+  Args args;
+  initArgs(args);
+
+  err = p1.run(&args);
+  if (err != mpsl::kErrorOk || args.ret.i[0] != a[0] * 3 + 3) {
+    printf("[FAIL] Program returned %d != Expected(%d)\n", args.ret.i[0], a[0] * 3 + 3);
+    isOk = false;
+  }
+
+  err = p2.run(&args);
+  if (err != mpsl::kErrorOk || args.ret.i[0] != 8) {
+    printf("[FAIL] Program of a clone returned %d != Expected(%d)\n", args.ret.i[0], 8);
+    isOk = false;
+  }
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::workspaceTest() {
+  const char body[] = "int main() { int s = 0; for (int i = 0; i < ib; i++) s += i; return s; }";
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  printTest(body);
+
+  bool isOk = true;
+  mpsl::Context ctx = mpsl::Context::create();
+
+  // Workspaces are reused by subsequent compilations, even after a failure.
+  TestLog log;
+  for (int i = 0; i < 3; i++) {
+    mpsl::Program1<Args> program;
+    mpsl::Error err = program.compile(ctx, i == 1 ? "int main() { return x; }" : body, _options, layout, &log);
+
+    if ((err != mpsl::kErrorOk) != (i == 1)) {
+      printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+      return false;
+    }
+
+    Args args;
+    initArgs(args);
+
+    if (err == mpsl::kErrorOk && (program.run(&args) != mpsl::kErrorOk || args.ret.i[0] != 36)) {
+      printf("[FAIL] Program returned %d != Expected(%d)\n", args.ret.i[0], 36);
+      isOk = false;
+    }
+  }
+
+  mpsl::Context::WorkspaceInfo info;
+  ctx.getWorkspaceInfo(info);
+
+  if (info.created != 1 || info.reused != 2 || info.idleCount != 1 || info.peakCodeSize == 0) {
+    printf("[FAIL] Workspaces created=%u reused=%u idle=%u != Expected(1, 2, 1)\n",
+      static_cast<unsigned int>(info.created),
+      static_cast<unsigned int>(info.reused),
+      static_cast<unsigned int>(info.idleCount));
+    isOk = false;
+  }
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::concurrencyTest() {
+  const char body[] = "int main() { return ia * <N> + ib; }";
+  const unsigned int kNumPrograms = 64;
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  printTest(body);
+
+  // Options that write to the log are not used, the log is not thread-safe.
+  uint32_t options = _options & ~(mpsl::kOptionVerbose   |
+                                  mpsl::kOptionDebugAst  |
+                                  mpsl::kOptionDebugIR   |
+                                  mpsl::kOptionDebugASM  );
+
+  // Background threads of the context compile programs while this thread
+  // compiles others, all of them share built-ins, workspaces, and the runtime
+  // of the context.
+  mpsl::Context ctx = mpsl::Context::create();
+  ctx.setCompileThreads(4);
+
+  mpsl::CompileTask tasks[kNumPrograms];
+  char src[128];
+
+  for (unsigned int i = 0; i < kNumPrograms; i++) {
+    snprintf(src, sizeof(src), "int main() { return ia * %u + ib; }", i);
+    ctx.compileAsync(tasks[i], src, options, layout);
+  }
+
+  unsigned int failures = 0;
+  Args args;
+  initArgs(args);
+
+  for (unsigned int i = 0; i < kNumPrograms * 2; i++) {
+    mpsl::Program1<Args> program;
+    int n = static_cast<int>(i);
+
+    if (i < kNumPrograms) {
+      // Compiled by this thread while the background tasks are running.
+      n += static_cast<int>(kNumPrograms);
+      snprintf(src, sizeof(src), "int main() { return ia * %d + ib; }", n);
+      if (program.compile(ctx, src, options, layout) != mpsl::kErrorOk) {
+        failures++;
+        continue;
+      }
+    }
+    else {
+      n -= static_cast<int>(kNumPrograms);
+      if (tasks[n].wait() != mpsl::kErrorOk || tasks[n].get(program) != mpsl::kErrorOk) {
+        failures++;
+        continue;
+      }
+    }
+
+    if (program.run(&args) != mpsl::kErrorOk || args.ret.i[0] != a[0] * n + b[0])
+      failures++;
+  }
+
+  bool isOk = failures == 0;
+  if (!isOk)
+    printf("[FAIL] %u concurrent compilations failed\n", failures);
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::asyncTest() {
+  const char body[] = "int main() { return ia * 3 + ib; }";
+  const char bulk[] = "int main() { return ia * 5 + ib; }";
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  printTest(body);
+
+  bool isOk = true;
+  mpsl::Context ctx = mpsl::Context::create();
+  ctx.setCompileThreads(2);
+
+  mpsl::CompileTask t1, t2, t3, t4;
+  ctx.compileAsync(t1, body, _options, layout);
+  ctx.compileAsync(t2, bulk, _options, layout, mpsl::CompileTask::kPriorityBulk);
+  ctx.compileAsync(t3, "int main() { return x; }", _options, layout);
+  ctx.compileAsync(t4, bulk, _options, layout, mpsl::CompileTask::kPriorityBulk);
+  t4.cancel();
+
+  mpsl::Error err = t1.wait();
+  if (err == mpsl::kErrorOk) err = t2.wait();
+
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
+
+  // Invalid programs fail and canceled tasks are done immediately.
+  if (t3.wait() == mpsl::kErrorOk || !t4.isDone() || t4.wait() != mpsl::kErrorCanceled) {
+    printf("[FAIL] Invalid program compiled or task not canceled\n");
+    isOk = false;
+  }
+
+  mpsl::Program1<Args> p1, p2;
+  mpsl::Program2<Args, Args> p3;
+
+  if (t1.get(p1) != mpsl::kErrorOk || t2.get(p2) != mpsl::kErrorOk || t1.get(p3) != mpsl::kErrorInvalidArgument) {
+    printf("[FAIL] Compiled program not returned by the task\n");
+    isOk = false;
+  }
+
+  Args args;
+  initArgs(args);
+
+  int expected1 = args.ia * 3 + args.ib;
+  if (p1.isValid() && (p1.run(&args) != mpsl::kErrorOk || args.ret.i[0] != expected1)) {
+    printf("[FAIL] Program returned %d != Expected(%d)\n", args.ret.i[0], expected1);
+    isOk = false;
+  }
+
+  int expected2 = args.ia * 5 + args.ib;
+  if (p2.isValid() && (p2.run(&args) != mpsl::kErrorOk || args.ret.i[0] != expected2)) {
+    printf("[FAIL] Program returned %d != Expected(%d)\n", args.ret.i[0], expected2);
+    isOk = false;
+  }
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::slotTest() {
+  const char body1[] = "int main() { return ia + ib; }";
+  const char body2[] = "int main() { return ia * ib; }";
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  printTest(body1);
+
+  mpsl::Context ctx = mpsl::Context::create();
+  mpsl::Program1<Args> p1, p2;
+
+  mpsl::Error err = p1.compile(ctx, body1, _options, layout, nullptr);
+  if (err == mpsl::kErrorOk) err = p2.compile(ctx, body2, _options, layout, nullptr);
+
+  if (err != mpsl::kErrorOk) {
+    printFail(body1, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
+
+  bool isOk = true;
+  mpsl::ProgramSlot slot = mpsl::ProgramSlot::create();
+  mpsl::ProgramSlotReader< mpsl::Program1<Args> > reader(slot);
+
+  Args args;
+  initArgs(args);
+
+  // Nothing was published yet.
+  if (reader.enter().isValid()) {
+    printf("[FAIL] Empty slot returned a program\n");
+    isOk = false;
+  }
+  reader.leave();
+
+  slot.publish(p1);
+  const mpsl::Program1<Args>& program = reader.enter();
+
+  // The entered program is retired, not released, when replaced.
+  slot.publish(p2);
+  p1.reset();
+
+  int expected1 = args.ia + args.ib;
+  if (!program.isValid() || program.run(&args) != mpsl::kErrorOk || args.ret.i[0] != expected1) {
+    printf("[FAIL] Program returned %d != Expected(%d)\n", args.ret.i[0], expected1);
+    isOk = false;
+  }
+
+  if (slot.retiredCount() != 1) {
+    printf("[FAIL] Entered program not retired\n");
+    isOk = false;
+  }
+
+  reader.leave();
+  slot.reclaim();
+
+  if (slot.retiredCount() != 0) {
+    printf("[FAIL] Retired program not reclaimed after leave()\n");
+    isOk = false;
+  }
+
+  int expected2 = args.ia * args.ib;
+  if (reader.enter().run(&args) != mpsl::kErrorOk || args.ret.i[0] != expected2) {
+    printf("[FAIL] Program returned %d != Expected(%d)\n", args.ret.i[0], expected2);
+    isOk = false;
+  }
+  reader.leave();
+
+  if (isOk)
+    printPass(body1);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::tierTest() {
+  const char body[] = "int main() { int x = ia * 4; return x + ib * (2 + 3); }";
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  printTest(body);
+
+  mpsl::Context ctx = mpsl::Context::create();
+  ctx.setTierThreshold(8);
+
+  mpsl::Program1<Args> program;
+  mpsl::Error err = program.compile(ctx, body, _options | mpsl::kOptionTiered, layout, nullptr);
+
+  if (err != mpsl::kErrorOk) {
+    printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+    return false;
+  }
+
+  bool isOk = true;
+  if (program.tier() != mpsl::Program::kTierBaseline) {
+    printf("[FAIL] Tiered program not compiled as baseline\n");
+    isOk = false;
+  }
+
+  Args args;
+  initArgs(args);
+  int expected = args.ia * 4 + args.ib * 5;
+
+  // The batch entry-point counts records as well, this batch gets it hot.
+  Args batchArgs[16];
+  for (uint32_t i = 0; i < MPSL_ARRAY_SIZE(batchArgs); i++)
+    initArgs(batchArgs[i]);
+
+  err = program.runBatch(batchArgs, MPSL_ARRAY_SIZE(batchArgs), sizeof(Args));
+  for (uint32_t i = 0; i < MPSL_ARRAY_SIZE(batchArgs); i++) {
+    if (err != mpsl::kErrorOk || batchArgs[i].ret.i[0] != expected) {
+      printf("[FAIL] batch[%u] returned %d != Expected(%d)\n", i, batchArgs[i].ret.i[0], expected);
+      isOk = false;
+      break;
+    }
+  }
+
+  // Gets hot while running, the last run waits for the optimized program.
+  for (uint32_t i = 0; i < 17; i++) {
+    if (i == 16)
+      err = program.tierUp(true);
+
+    if (err != mpsl::kErrorOk || program.run(&args) != mpsl::kErrorOk || args.ret.i[0] != expected) {
+      printf("[FAIL] Program returned %d != Expected(%d), Tier(%u)\n", args.ret.i[0], expected, program.tier());
+      isOk = false;
+      break;
+    }
+  }
+
+  if (program.tier() != mpsl::Program::kTierOptimized) {
+    printf("[FAIL] Hot program not optimized\n");
+    isOk = false;
+  }
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::optLevelTest() {
+  const char body[] = "int main() { int s = ia; for (int i = 0; i < ib; i++) s += i * ic; return s + ib * (2 + 3); }";
+
+  static const uint32_t levels[] = { mpsl::kOptionO0, mpsl::kOptionO1, mpsl::kOptionO2 };
+  static const char* levelNames[] = { "O0", "O1", "O2" };
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  printTest(body);
+
+  Args args;
+  initArgs(args);
+  int expected = args.ia + 36 * args.ic + args.ib * 5;
+
+  bool isOk = true;
+  for (uint32_t i = 0; i < 3 && isOk; i++) {
+    uint32_t options = (_options & ~mpsl::kOptionOptLevelMask) | levels[i];
+
+    mpsl::Program1<Args> program;
+    mpsl::Error err = program.compile(_ctx, body, options, layout, nullptr);
+
+    if (err != mpsl::kErrorOk) {
+      printFail(body, "COMPILATION ERROR 0x%08X at %s.\n", static_cast<unsigned int>(err), levelNames[i]);
+      isOk = false;
+      break;
+    }
+
+    if (program.run(&args) != mpsl::kErrorOk || args.ret.i[0] != expected) {
+      printf("[FAIL] Program returned %d != Expected(%d) at %s\n", args.ret.i[0], expected, levelNames[i]);
+      isOk = false;
+      break;
+    }
+  }
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::constTest() {
+  const char body[] = "int main() { int r = ia; if (mode == 1) r = r * 100; else if (mode == 2) r = r + ib * gain; else r = 0; return r; }";
+
+  static const uint32_t levels[] = { mpsl::kOptionO0, mpsl::kOptionO2 };
+  printTest(body);
+
+  Args args;
+  initArgs(args);
+
+  bool isOk = true;
+  for (int mode = 0; mode < 3 && isOk; mode++) {
+    mpsl::LayoutTmp<1024> layout;
+    initLayout(layout, mpsl::kTypeInt);
+
+    // Both members are baked into the program.
+    mpsl::Value modeValue = makeIVal(mode);
+    mpsl::Value gainValue = makeIVal(3);
+    layout.addConst("mode", mpsl::kTypeInt, modeValue);
+    layout.addConst("gain", mpsl::kTypeInt, gainValue);
+
+    int expected = mode == 1 ? args.ia * 100 : mode == 2 ? args.ia + args.ib * 3 : 0;
+    for (uint32_t i = 0; i < 2; i++) {
+      uint32_t options = (_options & ~mpsl::kOptionOptLevelMask) | levels[i];
+
+      mpsl::Program1<Args> program;
+      mpsl::Error err = program.compile(_ctx, body, options, layout, nullptr);
+
+      if (err != mpsl::kErrorOk) {
+        printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+        isOk = false;
+        break;
+      }
+
+      if (program.run(&args) != mpsl::kErrorOk || args.ret.i[0] != expected) {
+        printf("[FAIL] Program returned %d != Expected(%d), Mode(%d)\n", args.ret.i[0], expected, mode);
+        isOk = false;
+        break;
+      }
+    }
+  }
+
+  // Constants can only be read.
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  layout.addConst("mode", mpsl::kTypeInt, makeIVal(1));
+
+  mpsl::Program1<Args> program;
+  if (program.compile(_ctx, "int main() { mode = 2; return ia; }", _options, layout, nullptr) == mpsl::kErrorOk) {
+    printf("[FAIL] Constant member assigned\n");
+    isOk = false;
+  }
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+bool Test::uniformTest() {
+  const char body[] = "int main() { return ia * gain + ib; }";
+
+  static const uint32_t levels[] = { mpsl::kOptionO0, mpsl::kOptionO2 };
+  printTest(body);
+
+  mpsl::LayoutTmp<1024> layout;
+  initLayout(layout, mpsl::kTypeInt);
+  layout.addUniform("gain", mpsl::kTypeInt, makeIVal(3));
+
+  Args args;
+  initArgs(args);
+
+  bool isOk = true;
+  for (uint32_t i = 0; i < 2 && isOk; i++) {
+    uint32_t options = (_options & ~mpsl::kOptionOptLevelMask) | levels[i];
+
+    mpsl::Program1<Args> program;
+    mpsl::Error err = program.compile(_ctx, body, options, layout, nullptr);
+
+    if (err != mpsl::kErrorOk) {
+      printFail(body, "COMPILATION ERROR 0x%08X.\n", static_cast<unsigned int>(err));
+      isOk = false;
+      break;
+    }
+
+    // The same program runs with each gain, both by `run()` and `runBatch()`.
+    for (int gain = 3; gain < 6 && isOk; gain++) {
+      if (gain != 3 && program.setUniform("gain", makeIVal(gain)) != mpsl::kErrorOk) {
+        printf("[FAIL] Uniform not set\n");
+        isOk = false;
+        break;
+      }
+
+      Args batchArgs[4];
+      for (size_t j = 0; j < MPSL_ARRAY_SIZE(batchArgs); j++)
+        batchArgs[j] = args;
+
+      int expected = args.ia * gain + args.ib;
+      if (program.run(&args) != mpsl::kErrorOk || args.ret.i[0] != expected ||
+          program.runBatch(batchArgs, MPSL_ARRAY_SIZE(batchArgs), sizeof(Args)) != mpsl::kErrorOk ||
+          batchArgs[3].ret.i[0] != expected) {
+        printf("[FAIL] Program returned %d != Expected(%d), Gain(%d)\n", args.ret.i[0], expected, gain);
+        isOk = false;
+      }
+    }
+
+    if (isOk && program.setUniform("none", makeIVal(0)) == mpsl::kErrorOk) {
+      printf("[FAIL] Unknown uniform set\n");
+      isOk = false;
+    }
+  }
+
+  // Uniforms can only be read.
+  mpsl::Program1<Args> program;
+  if (program.compile(_ctx, "int main() { gain = 2; return ia; }", _options, layout, nullptr) == mpsl::kErrorOk) {
+    printf("[FAIL] Uniform member assigned\n");
+    isOk = false;
+  }
+
+  // A value wider than a pointer changed while batches run is never seen
+  // torn, each record is a separate chunk that loads the uniform again.
+  if (isOk) {
+    const size_t kCount = 20000;
+
+    mpsl::LayoutTmp<1024> wideLayout;
+    initLayout(wideLayout, mpsl::kTypeInt);
+    wideLayout.addUniform("u", mpsl::kTypeInt4, makeIVal(0, 0, 0, 0));
+
+    mpsl::Executor executor = mpsl::Executor::create(3);
+    executor.setGrainSize(1);
+
+    mpsl::Program1<Args> wide;
+    mpsl::Error err = wide.compile(_ctx, "int main() { return u.x * 4 - u.w + u.y * 3 - u.z * 2; }", _options, wideLayout, nullptr);
+
+    Args* records = new Args[kCount];
+    for (size_t i = 0; i < kCount; i++) {
+      initArgs(records[i]);
+      records[i].ret.i[0] = -1;
+    }
+
+    if (err == mpsl::kErrorOk)
+      err = wide.submitBatch(executor, records, kCount, sizeof(Args));
+
+    for (int k = 1; k <= 10000 && err == mpsl::kErrorOk; k++)
+      err = wide.setUniform("u", makeIVal(k, k * 2, k * 3, k * 4));
+
+    mpsl::Error waitErr = executor.wait();
+    if (err == mpsl::kErrorOk)
+      err = waitErr;
+
+    if (err != mpsl::kErrorOk) {
+      printf("[FAIL] Wide uniform: ERROR 0x%08X\n", static_cast<unsigned int>(err));
+      isOk = false;
+    }
+
+    for (size_t i = 0; i < kCount && isOk; i++) {
+      int x = records[i].ret.i[0];
+      if (x != 0) {
+        printf("[FAIL] Wide uniform: ret[%u] %d != Expected(0)\n", static_cast<unsigned int>(i), x);
+        isOk = false;
+      }
+    }
+
+    delete[] records;
+  }
+
+  if (isOk)
+    printPass(body);
+  else
+    _succeeded = false;
+  return isOk;
+}
+
+// ============================================================================
+// [Main]
+// ============================================================================
+
+int main(int argc, char* argv[]) {
+  CmdLine cmd(argc, argv);
+  uint32_t options = 0;
+
+  if (cmd.hasKey("--verbose")) options |= mpsl::kOptionVerbose;
+  if (cmd.hasKey("--ast"    )) options |= mpsl::kOptionDebugAst;
+  if (cmd.hasKey("--ir"     )) options |= mpsl::kOptionDebugIR;
+  if (cmd.hasKey("--asm"    )) options |= mpsl::kOptionDebugASM;
+
+  // Variables are initialized to these:
+  //   a[0] = 1; a[1] = 2; a[2] = 3; a[3] = 4;
+  //   b[0] = 9; b[1] = 8; b[2] = 7; b[3] = 6;
+  //   c[0] =-2; c[1] =-3; c[2] =-4; c[3] =-5;
+  Test test(options);
+
+  // Test MPSL basics.
+  test.basicTest("int     main() { return ia + ib; }", mpsl::kTypeInt    , makeIVal(10   ));
+  test.basicTest("float   main() { return fa + fb; }", mpsl::kTypeFloat  , makeFVal(10.0f));
+  test.basicTest("double  main() { return da + db; }", mpsl::kTypeDouble , makeDVal(10.0 ));
+
+  test.basicTest("int2    main() { return i2a + i2b; }", mpsl::kTypeInt2   , makeIVal(10   , 10   ));
+  test.basicTest("float2  main() { return f2a + f2b; }", mpsl::kTypeFloat2 , makeFVal(10.0f, 10.0f));
+  test.basicTest("double2 main() { return d2a + d2b; }", mpsl::kTypeDouble2, makeDVal(10.0 , 10.0 ));
+
+  test.basicTest("int3    main() { return i3a + i3b; }", mpsl::kTypeInt3   , makeIVal(10   , 10   , 10   ));
+  test.basicTest("float3  main() { return f3a + f3b; }", mpsl::kTypeFloat3 , makeFVal(10.0f, 10.0f, 10.0f));
+  test.basicTest("double3 main() { return d3a + d3b; }", mpsl::kTypeDouble3, makeDVal(10.0 , 10.0 , 10.0 ));
+
+  test.basicTest("int4    main() { return i4a + i4b; }", mpsl::kTypeInt4   , makeIVal(10   , 10   , 10   , 10   ));
+  test.basicTest("float4  main() { return f4a + f4b; }", mpsl::kTypeFloat4 , makeFVal(10.0f, 10.0f, 10.0f, 10.0f));
+  test.basicTest("double4 main() { return d4a + d4b; }", mpsl::kTypeDouble4, makeDVal(10.0 , 10.0 , 10.0 , 10.0 ));
+
+  test.basicTest("int     main() { return (ia + ib) * ic - ia; }", mpsl::kTypeInt    , makeIVal(-21   ));
+  test.basicTest("float   main() { return (fa + fb) * fc - fa; }", mpsl::kTypeFloat  , makeFVal(-21.0f));
+  test.basicTest("double  main() { return (da + db) * dc - da; }", mpsl::kTypeDouble , makeDVal(-21.0 ));
+
+  test.basicTest("int2    main() { return (i2a + i2b) * i2c - i2a; }", mpsl::kTypeInt2   , makeIVal(-21   , -32   ));
+  test.basicTest("float2  main() { return (f2a + f2b) * f2c - f2a; }", mpsl::kTypeFloat2 , makeFVal(-21.0f, -32.0f));
+  test.basicTest("double2 main() { return (d2a + d2b) * d2c - d2a; }", mpsl::kTypeDouble2, makeDVal(-21.0 , -32.0 ));
+
+  test.basicTest("int3    main() { return (i3a + i3b) * i3c - i3a; }", mpsl::kTypeInt3   , makeIVal(-21   , -32   , 37   ));
+  test.basicTest("float3  main() { return (f3a + f3b) * f3c - f3a; }", mpsl::kTypeFloat3 , makeFVal(-21.0f, -32.0f, 37.0f));
+  test.basicTest("double3 main() { return (d3a + d3b) * d3c - d3a; }", mpsl::kTypeDouble3, makeDVal(-21.0 , -32.0 , 37.0 ));
+
+  test.basicTest("int4    main() { return (i4a + i4b) * i4c - i4a; }", mpsl::kTypeInt4   , makeIVal(-21   , -32   , 37   , 46   ));
+  test.basicTest("float4  main() { return (f4a + f4b) * f4c - f4a; }", mpsl::kTypeFloat4 , makeFVal(-21.0f, -32.0f, 37.0f, 46.0f));
+  test.basicTest("double4 main() { return (d4a + d4b) * d4c - d4a; }", mpsl::kTypeDouble4, makeDVal(-21.0 , -32.0 , 37.0 , 46.0 ));
+
+  // Test vector swizzling.
+  test.basicTest("int4    main() { return i4a.xxxx; }", mpsl::kTypeInt4   , makeIVal(1, 1, 1, 1));
+  test.basicTest("int4    main() { return i4a.xyxy; }", mpsl::kTypeInt4   , makeIVal(1, 2, 1, 2));
+  test.basicTest("float4  main() { return f4a.xxxx; }", mpsl::kTypeFloat4 , makeFVal(1, 1, 1, 1));
+  test.basicTest("float4  main() { return f4a.xyxy; }", mpsl::kTypeFloat4 , makeFVal(1, 2, 1, 2));
+  test.basicTest("double4 main() { return d4a.xxxx; }", mpsl::kTypeDouble4, makeDVal(1, 1, 1, 1));
+  test.basicTest("double4 main() { return d4a.xyxy; }", mpsl::kTypeDouble4, makeDVal(1, 2, 1, 2));
+
+  // Test math functions.
+  test.mathTest("float4  main() { return exp(f4a); }", mpsl::kTypeFloat4, makeFVal(expf(1.0f), expf(2.0f), expf(3.0f), expf(4.0f)), 1e-6);
+  test.mathTest("float4  main() { return log(f4b); }", mpsl::kTypeFloat4, makeFVal(logf(9.0f), logf(8.0f), logf(7.0f), logf(6.0f)), 1e-6);
+  test.mathTest("float   main() { return atan2(fa, fc); }", mpsl::kTypeFloat, makeFVal(atan2f(1.0f, -2.0f)), 1e-6);
+  test.mathTest("double4 main() { return sin(d4b); }", mpsl::kTypeDouble4, makeDVal(sin(9.0), sin(8.0), sin(7.0), sin(6.0)), 1e-14);
+  test.mathTest("double2 main() { return cos(d2c); }", mpsl::kTypeDouble2, makeDVal(cos(-2.0), cos(-3.0)), 1e-14);
+  test.mathTest("double  main() { return pow(db, dc); }", mpsl::kTypeDouble, makeDVal(pow(9.0, -2.0)), 1e-14);
+
+  // Test exp() near the overflow threshold and in the denormal range.
+  test.mathTest ("float   main() { return exp(fa * 88.72283f); }", mpsl::kTypeFloat, makeFVal(expf(88.72283f)), 1e-6);
+  test.basicTest("float   main() { return exp(fa * 88.7229f); }", mpsl::kTypeFloat, makeFVal(INFINITY));
+  test.mathTest ("float   main() { return exp(fa * -95.0f); }", mpsl::kTypeFloat, makeFVal(expf(-95.0f)), 1e-3);
+  test.basicTest("float   main() { return exp(fa * -104.0f); }", mpsl::kTypeFloat, makeFVal(0.0f));
+  test.mathTest ("double  main() { return exp(da * 709.78); }", mpsl::kTypeDouble, makeDVal(exp(709.78)), 1e-14);
+  test.basicTest("double  main() { return exp(da * 709.79); }", mpsl::kTypeDouble, makeDVal(INFINITY));
+  test.mathTest ("double  main() { return exp(da * -730.0); }", mpsl::kTypeDouble, makeDVal(exp(-730.0)), 1e-6);
+  test.basicTest("double  main() { return exp(da * -746.0); }", mpsl::kTypeDouble, makeDVal(0.0));
+
+  // Test SPMD mode and structure-of-arrays layouts.
+  test.spmdTest();
+
+  // Test parallel execution of batches.
+  test.executorTest();
+  test.executorWaitersTest();
+
+  // Test the cache of compiled programs.
+  test.cacheTest();
+
+  // Test context constants, cloning, and freezing.
+  test.contextTest();
+
+  // Test reuse of compilation workspaces.
+  test.workspaceTest();
+
+  // Test compiling from more threads and in the background.
+  test.concurrencyTest();
+  test.asyncTest();
+
+  // Test replacing programs that other threads run.
+  test.slotTest();
+
+  // Test tiered compilation and optimization levels.
+  test.tierTest();
+  test.optLevelTest();
+
+  // Test constant and uniform members of the layout.
+  test.constTest();
+  test.uniformTest();
+
+  // Test control flow - branches.
+  test.basicTest("int main() { if (ia == 1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal( 9));
+  test.basicTest("int main() { if (ia != 1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal(-2));
+  test.basicTest("int main() { if (ia >= 1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal( 9));
+  test.basicTest("int main() { if (ia >  1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal(-2));
+  test.basicTest("int main() { if (ia <= 1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal( 9));
+  test.basicTest("int main() { if (ia <  1) return ib; else return ic; }", mpsl::kTypeInt, makeIVal(-2));
+
+  // Test control flow - loops.
+  test.basicTest("int main() { int s = 0; for (int i = 0; i < ib; i++) s += i; return s; }", mpsl::kTypeInt, makeIVal(36));
+  test.basicTest("int main() { int i = 0; while (i != ib) { i++; } return i; }", mpsl::kTypeInt, makeIVal(9));
+  test.basicTest("int main() { int s = 0; int i = 0; while (i != 100) { i++; if (i == 3) continue; if (i > ib) break; s += i; } return s; }", mpsl::kTypeInt, makeIVal(42));
+  test.basicTest("float main() { float x = fa; do { x = x + x; } while (x < fb); return x; }", mpsl::kTypeFloat, makeFVal(16.0f));
+  test.basicTest("int main() { int x = ia; int y = ib; for (int i = 0; i < 3; i++) { int t = x; x = y; y = t; } return x * 10 + y; }", mpsl::kTypeInt, makeIVal(91));
+  test.basicTest("int main() { int s = 0; for (int i = 0; i < ib; i++) for (int j = 0; j < i; j++) s += j; return s; }", mpsl::kTypeInt, makeIVal(84));
+  test.basicTest("int main() { int x = ia; int y = ib; for (int i = 0; i < ib + ia; i++) { int t = x; x = y; y = t; } return x * 10 + y; }", mpsl::kTypeInt, makeIVal(19));
+  test.basicTest("int main() { int x = ia; int y = ib; int z = ic; for (int i = 0; i < ib + 1; i++) { int t = x; x = y; y = z; z = t; } return x * 100 + y * 10 + z; }", mpsl::kTypeInt, makeIVal(881));
+  test.basicTest("int main() { int x = ia; int y = ib; for (int i = 0; i < ib; i++) { int t = x; x = y; y = t + x; } return x * 1000 + y; }", mpsl::kTypeInt, makeIVal(327529));
+  test.basicTest("int main() { int s = 0; for (int i = 0; i < ib; i++) { for (int j = 0; j < ib; j++) { if (j > i) break; s += j; } if (s > 50) break; } return s; }", mpsl::kTypeInt, makeIVal(56));
+  test.basicTest("int main() { int s = 0; int i = 0; while (i < 100) { int j = 0; while (j < i) { if (j == ib) break; s += j; j++; } i++; if (i == ib + 3) break; } return s * 100 + i; }", mpsl::kTypeInt, makeIVal(19212));
+  test.basicTest("int main() { int k = 2; int s = 0; for (int i = 0; i < ib; i++) { if (k * 3 > 5) s += i; else s -= ia; } return s; }", mpsl::kTypeInt, makeIVal(36));
+  test.basicTest("int main() { int s = 0; for (int i = 0; i < ib; i++) { if (i > ia * ia) s += ia * ia + i; } return s + ia * ia; }", mpsl::kTypeInt, makeIVal(43));
+  test.basicTest("int main() { int s = 0; int t = ia; for (int i = 0; i < ib; i++) { int u = t * 3; s += i; t = u + s; } return s; }", mpsl::kTypeInt, makeIVal(36));
+  test.basicTest("int main() { int s = 0; for (int i = 0; i < ib; i++) for (int j = 0; j < ib; j++) s += i * (ia + ib) + j * ib; return s; }", mpsl::kTypeInt, makeIVal(6156));
+
+  // Test control flow - conditions that are only known to be constant after
+  // propagating constants through branches and loops (not folded by the AST).
+  test.irTest("int main() { int k = 1; if (ia > 0) k = 2; else k = 2; int x = 0; if (k * 3 > 5) x = ia; else x = ib; return x + k; }", mpsl::kTypeInt, makeIVal(3), "jnz", false, 1);
+  test.irTest("int main() { int n = 0; if (ic > 0) n = 0; int s = ia; while (n > 0) { s += ib; n--; } return s; }", mpsl::kTypeInt, makeIVal(1), "jnz", false, 1);
+  test.irTest("int main() { int k = 3; int s = 0; for (int i = 0; i < ib; i++) { if (k != 3) s += 100; s += k; k = 3; } return s; }", mpsl::kTypeInt, makeIVal(27), "jnz", true, 1);
+  test.basicTest("int main() { int x = 5; if (ia > 0) x = ib; return x * 2; }", mpsl::kTypeInt, makeIVal(18));
+  test.basicTest("int main() { int k = 3; int s = 0; for (int i = 0; i < ib; i++) { s += k; k = i; } return s; }", mpsl::kTypeInt, makeIVal(31));
+
+  // Test value numbering - equal expressions in sibling blocks are not merged,
+  // commutative operands are, and loads are never merged across stores.
+  test.basicTest("int main() { int x = 0; if (ia > 0) x = ib * ic + 1; else x = ib * ic - 1; return x * 100 + ib * ic; }", mpsl::kTypeInt, makeIVal(-1718));
+  test.basicTest("int main() { int x = 0; if (ia < 0) x = ib * ic + 1; else x = ib * ic - 1; return x * 100 + ib * ic; }", mpsl::kTypeInt, makeIVal(-1918));
+  test.basicTest("int main() { int s = 0; for (int i = 0; i < ib; i++) { if (i % 3 == 0) s += ia * ic; else s -= ic * ia; } return s + ia * ic; }", mpsl::kTypeInt, makeIVal(4));
+  test.irTest("int main() { return ia * ib + ib * ia; }", mpsl::kTypeInt, makeIVal(18), "pmuld", false, 1);
+  test.irTest("int main() { return (ia + ic) * (ic + ia) - ib; }", mpsl::kTypeInt, makeIVal(-8), "paddd", false, 1);
+  test.irTest("int main() { int a = io * ib; int b = io * ib; return a + b; }", mpsl::kTypeInt, makeIVal(90), "fetch32", false, 2);
+  test.ioTest("int main() { int a = io; io = a + ia; int b = io; io = b * 3; return a * 100 + b * 10 + io; }", 578, 18);
+  test.ioTest("int main() { int a = io + ib; io = ia; return a + (io + ib); }", 24, 1);
+  test.ioTest("int main() { int a = io * ib; io = ic; int b = io * ib; return a + b; }", 27, -2);
+  test.ioTest("int main() { int a = io; if (ia > 0) io = ib; return a * 10 + io; }", 59, 9);
+
+  // Test dead stores - `io` and `@ret` written along different paths, stores
+  // that are overwritten on one path only must be kept.
+  test.ioTest("int main() { io = ia; if (ic > 0) io = ib; return 0; }", 0, 1);
+  test.ioTest("int main() { io = ia; if (ia > 0) io = ib; return 0; }", 0, 9);
+  test.ioTest("int main() { io = ic; for (int i = 0; i < ib; i++) { if (i == ia * 4) io = i; } return 1; }", 1, 4);
+  test.ioTest("int main() { io = ic; for (int i = 0; i < ib; i++) { if (i == ib) io = i; } return 1; }", 1, -2);
+  test.ioTest("int main() { io = ib; if (ia > 0) { io = ic; if (ic > 0) return ib; io = ia; return ic; } return ia; }", -2, 1);
+  test.ioTest("int main() { io = ib; if (ia < 0) { io = ic; if (ic > 0) return ib; io = ia; return ic; } return ia; }", 1, 9);
+  test.ioTest("int main() { io = ia * 3; if (ib > ia) { io = ic; return 1; } return 2; }", 1, -2);
+  test.ioTest("int main() { io = ia * 3; if (ib < ia) { io = ic; return 1; } return 2; }", 2, 3);
+  test.ioTest("int main() { io = ia; if (ic > 0) io = ib; else io = ic; return 0; }", 0, -2);
+  test.irTest("int main() { io = ia; if (ic > 0) io = ib; else io = ic; return 0; }", mpsl::kTypeInt, makeIVal(0), "store32", false, 3);
+
+  // Test loop optimizations - invariants are moved to the preheader of loops
+  // left by `break` and `continue` and of loops that are never entered, but
+  // not if they can fault or read memory written in the loop.
+  test.irTest("int main() { int s = 0; for (int i = 0; i < 100; i++) { if (i == 3) continue; if (i > ib) break; s += ia * ib + i; } return s; }", mpsl::kTypeInt, makeIVal(123), "pmuld", true, 0);
+  test.irTest("int main() { int s = 0; int i = 0; while (i < ib) { i++; if (i % 2 == 0) continue; s += ib * ic; } return s; }", mpsl::kTypeInt, makeIVal(-90), "pmuld", true, 0);
+  test.irTest("int main() { int s = ia; for (int i = 0; i < ic; i++) s += ib * ib + i; return s; }", mpsl::kTypeInt, makeIVal(1), "pmuld", true, 0);
+  test.irTest("int main() { int s = ia; for (int i = 0; i < ic; i++) s += i * ib; return s; }", mpsl::kTypeInt, makeIVal(1), "pmuld", true, 0);
+  test.basicTest("int main() { int s = ia; for (int i = 0; i < ic; i++) s += ib / (ia - 1); return s; }", mpsl::kTypeInt, makeIVal(1));
+  test.ioTest("int main() { for (int i = 0; i < 3; i++) io = io + ib * ia; return io; }", 32, 32);
+
+  // Test integer division and remainder by constants.
+  test.basicTest("int main() { return ib / 3 + ib % 7 * 10 + (ic - ib) / 4 * 100 + (ic - ib) % 4 * 1000; }", mpsl::kTypeInt, makeIVal(-3177));
+  test.irTest("int main() { return ib / 7 * 1000 + ib % 7 * 100 + (ic - ib) / 7 * 10 + (ic - ib) % 7; }", mpsl::kTypeInt, makeIVal(1186), "pdivsd", false, 0);
+  test.irTest("int main() { return ib / -3 * 1000 + ib % -3 * 100 + (ic - ib) / -4 * 10 + (ic - ib) % -4; }", mpsl::kTypeInt, makeIVal(-2983), "pdivsd", false, 0);
+  test.irTest("int main() { return ib / -7 * 1000 + ib % -7 * 100 + (ic - ib) / -7 * 10 + (ic - ib) % -7; }", mpsl::kTypeInt, makeIVal(-794), "pmodsd", false, 0);
+  test.irTest("int main() { return ib / 1 * 1000 + ib % 1 * 100 + ib / -1 * 10 + ib % -1; }", mpsl::kTypeInt, makeIVal(8910), "pdivsd", false, 0);
+  test.basicTest("int main() { int x = ic - 2147483646; return x / 7 + x % 7; }", mpsl::kTypeInt, makeIVal(-306783380));
+  test.basicTest("int main() { int x = ic - 2147483646; return x / -7 + x % -7; }", mpsl::kTypeInt, makeIVal(306783376));
+  test.basicTest("int main() { int x = ic - 2147483646; return x / 2 - x / -16 + x % 16; }", mpsl::kTypeInt, makeIVal(-1207959552));
+  test.basicTest("int main() { int x = ic - 2147483646; return x / 3 + x % 3 + x / 641 * 10; }", mpsl::kTypeInt, makeIVal(-749329964));
+  test.basicTest("int main() { int x = ic - 2147483646; return x / 1 + x % -1; }", mpsl::kTypeInt, makeIVal(-2147483647 - 1));
+
+  // Test vector division and remainder by constants (multiply-high emulated
+  // by `pmuldq` or `pmuludq`), including the lanes of INT_MIN.
+  test.irTest("int4 main() { return i4b / 3; }", mpsl::kTypeInt4, makeIVal(3, 2, 2, 2), "pdivsd", false, 0);
+  test.irTest("int4 main() { return i4c / 3 * 10 + i4c % 3; }", mpsl::kTypeInt4, makeIVal(-2, -10, 11, 12), "pmodsd", false, 0);
+  test.irTest("int4 main() { return (i4c - i4b) / 7 * 10 + (i4c - i4b) % 7; }", mpsl::kTypeInt4, makeIVal(-14, -14, -3, -1), "pdivsd", false, 0);
+  test.irTest("int4 main() { return (i4c - i4b) / -7; }", mpsl::kTypeInt4, makeIVal(1, 1, 0, 0), "pdivsd", false, 0);
+  test.basicTest("int4 main() { int4 x = i4c - 2147483646; return x / 7; }", mpsl::kTypeInt4, makeIVal(-306783378, 306783378, -306783377, -306783377));
+  test.basicTest("int4 main() { int4 x = i4c - 2147483646; return x % 7; }", mpsl::kTypeInt4, makeIVal(-2, 1, -3, -2));
+  test.basicTest("int4 main() { int4 x = i4c - 2147483646; return x / -2; }", mpsl::kTypeInt4, makeIVal(1073741824, -1073741823, 1073741821, 1073741820));
+  test.basicTest("int4 main() { int4 x = i4c - 2147483646; return x % -3; }", mpsl::kTypeInt4, makeIVal(-2, 1, -2, -1));
+  test.basicTest("int4 main() { return i4b / -1 + i4c % 1; }", mpsl::kTypeInt4, makeIVal(-9, -8, -7, -6));
+
+  // Test float division by constants - only divisions by powers of two are
+  // multiplied by the reciprocal, other divisions must round the same.
+  test.irTest("float main() { return fb / 4.0f + fc / -0.5f; }", mpsl::kTypeFloat, makeFVal(6.25f), "divf", false, 0);
+  test.irTest("double main() { return db / 0.125; }", mpsl::kTypeDouble, makeDVal(72.0), "divd", false, 0);
+  test.irTest("float4 main() { return f4b / 8.0f; }", mpsl::kTypeFloat4, makeFVal(1.125f, 1.0f, 0.875f, 0.75f), "divf", false, 0);
+  test.basicTest("float main() { return fb / 5.0f; }", mpsl::kTypeFloat, makeFVal(1.8f));
+  test.basicTest("double main() { return db / 7.0; }", mpsl::kTypeDouble, makeDVal(9.0 / 7.0));
+  test.basicTest("float4 main() { return f4b / 10.0f; }", mpsl::kTypeFloat4, makeFVal(0.9f, 0.8f, 0.7f, 0.6f));
+
+  // Test control flow - predicated branches.
+  test.basicTest("float4 main() { float4 x = f4a; if (f4a * 3.0f > f4b) x = f4b; else x += 1.0f; return x; }", mpsl::kTypeFloat4, makeFVal(2.0f, 3.0f, 7.0f, 6.0f));
+  test.basicTest("int4 main() { int4 x = i4b; if (i4a * 3 < i4b) x = i4a; return x; }", mpsl::kTypeInt4, makeIVal(1, 2, 7, 6));
+  test.basicTest("int4 main() { int4 x = i4c; if (i4a > 1) { x = i4b; if (i4a > 2) x = i4a * 10; } return x; }", mpsl::kTypeInt4, makeIVal(-2, 8, 30, 40));
+  test.basicTest("float4 main() { float4 x = f4a; if (f4a > 1.5f) { if (f4b > 6.5f) x = f4b; else x = -f4b; } else x = f4c; return x; }", mpsl::kTypeFloat4, makeFVal(-2.0f, 8.0f, 7.0f, -6.0f));
+  test.basicTest("int4 main() { int4 x = i4a; if (i4a < i4b - 6) x = i4b; else x = i4c; return x * 2; }", mpsl::kTypeInt4, makeIVal(18, -6, 8, 10));
+  test.basicTest("double4 main() { double4 x = d4c; if (d4a > d4c) x = d4b; else x = x + x; return x + d4a; }", mpsl::kTypeDouble4, makeDVal(10.0, 10.0, 11.0, 14.0));
+  test.basicTest("int4 main() { int4 x = i4a; if (i4a > 2) { int y = ib; y += ia; x = x + y; } return x; }", mpsl::kTypeInt4, makeIVal(1, 2, 13, 14));
+
+  // Test control flow - predicated writes to members, lanes that are not
+  // selected keep their previous value (`i4o` is initialized to 5).
+  test.basicTest("int4 main() { if (i4a > 2) i4o = i4b; return i4o; }", mpsl::kTypeInt4, makeIVal(5, 5, 7, 6));
+  test.basicTest("int4 main() { if (i4a < 3) i4o += i4a; else i4o = i4c; return i4o; }", mpsl::kTypeInt4, makeIVal(6, 7, 4, 5));
+
+  // Test control flow - assignments in a branch of a vector condition that
+  // can't be predicated.
+  test.failureTest("int main() { int x = ia; if (i4a > i4b) x = ib; return x; }");
+  test.failureTest("int main() { if (f4a > f4b) io = ib; return ia; }");
+  test.failureTest("int main() { float2 y = f2a; if (f4a > f4b) y++; return ia; }");
+  test.failureTest("int main() { int4 x = i4a; if (i4a > i4b) { if (d2a > d2b) x = i4b; } return ia; }");
 
 /*
   // Test creating and calling functions inside the shader.